@@ -47,6 +47,7 @@ static bencode_item_t __bencode_end_marker = {
 
 
 static bencode_item_t *__bencode_decode(bencode_buffer_t *buf, const char *s, const char *end);
+static void __bencode_hash_insert(bencode_item_t *key, struct __bencode_hash *hash);
 
 
 
@@ -167,6 +168,20 @@ bencode_item_t *bencode_dictionary(bencode_buffer_t *buf) {
 	return ret;
 }
 
+bencode_item_t *bencode_dictionary_hashed(bencode_buffer_t *buf) {
+	bencode_item_t *ret;
+	struct __bencode_hash *hash;
+
+	ret = __bencode_item_alloc(buf, sizeof(*hash));
+	if (!ret)
+		return NULL;
+	__bencode_dictionary_init(ret);
+	ret->value = 1;
+	hash = (void *) ret->__buf;
+	memset(hash, 0, sizeof(*hash));
+	return ret;
+}
+
 bencode_item_t *bencode_list(bencode_buffer_t *buf) {
 	bencode_item_t *ret;
 
@@ -274,6 +289,8 @@ bencode_item_t *bencode_dictionary_add_len(bencode_item_t *dict, const char *key
 		return NULL;
 	__bencode_container_add(dict, s);
 	__bencode_container_add(dict, val);
+	if (dict->value == 1)
+		__bencode_hash_insert(s, (void *) dict->__buf);
 	return val;
 }
 
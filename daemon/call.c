@@ -55,8 +55,7 @@ struct xmlrpc_helper {
 	GQueue			strings;
 };
 
-rwlock_t rtpe_callhash_lock;
-rtpe_calls_ht rtpe_callhash;
+struct call_hash_shard rtpe_callhash[CALL_HASH_SHARDS];
 struct call_iterator_list rtpe_call_iterators[NUM_CALL_ITERATORS];
 __thread call_t *call_memory_arena;
 static struct mqtt_timer *global_mqtt_timer;
@@ -583,11 +582,70 @@ enum thread_looper_action call_timer(void) {
 }
 
 
+// moves all of the call's sockets over to another poller
+static bool call_migrate_poller(call_t *c, struct poller *to) {
+	RWLOCK_W(&c->master_lock);
+
+	if (c->poller == to || c->destroyed.tv_sec)
+		return false;
+
+	struct poller *from = c->poller;
+	for (__auto_type l = c->stream_fds.head; l; l = l->next)
+		stream_fd_migrate(l->data, to);
+	c->poller = to;
+
+	poller_load_migrated(from, to);
+
+	ilog(LOG_DEBUG, "Moved call to another poller");
+	return true;
+}
+
+// returns the number of userspace packets received since the last call, or zero if this
+// is the first time
+static uint64_t call_load_sample(call_t *c) {
+	uint64_t packets = 0;
+
+	RWLOCK_R(&c->master_lock);
+
+	// kernel forwarded packets don't cost any poller time
+	for (__auto_type l = c->streams.head; l; l = l->next) {
+		struct packet_stream *ps = l->data;
+		if (PS_ISSET(ps, KERNELIZED))
+			continue;
+		packets += atomic64_get_na(&ps->stats_in->packets);
+	}
+
+	uint64_t last = c->load_packets;
+	c->load_packets = packets;
+	if (!last || packets < last)
+		return 0;
+	return packets - last;
+}
+
+void call_poller_rebalance(struct poller_rebalance *rb) {
+	ITERATE_CALL_LIST_START(CALL_ITERATOR_LOAD, c);
+		uint64_t pps = call_load_sample(c) / rb->interval;
+		// estimated share of the poller's CPU time taken up by this call
+		uint64_t ppm = rb->from ? pps * rb->from_ppm / rb->from_pps : 0;
+		if (ppm && ppm <= rb->budget_ppm && c->poller == rb->from) {
+			log_info_call(c);
+			if (call_migrate_poller(c, rb->to)) {
+				rb->budget_ppm -= ppm;
+				rb->moved++;
+			}
+			log_info_pop();
+		}
+	ITERATE_CALL_LIST_NEXT_END(c);
+}
+
+
 int call_init(void) {
-	rtpe_callhash = rtpe_calls_ht_new();
-	if (!t_hash_table_is_set(rtpe_callhash))
-		return -1;
-	rwlock_init(&rtpe_callhash_lock);
+	for (unsigned int i = 0; i < CALL_HASH_SHARDS; i++) {
+		rtpe_callhash[i].ht = rtpe_calls_ht_new();
+		if (!t_hash_table_is_set(rtpe_callhash[i].ht))
+			return -1;
+		rwlock_init(&rtpe_callhash[i].lock);
+	}
 
 	for (int i = 0; i < NUM_CALL_ITERATORS; i++)
 		mutex_init(&rtpe_call_iterators[i].lock);
@@ -646,15 +704,28 @@ static void __call_iterator_remove(call_t *c) {
 }
 void call_free(void) {
 	mqtt_timer_stop(&global_mqtt_timer);
-	rtpe_calls_ht_iter iter;
-	t_hash_table_iter_init(&iter, rtpe_callhash);
-	call_t *c;
-	while (t_hash_table_iter_next(&iter, NULL, &c)) {
-		__call_iterator_remove(c);
-		__call_cleanup(c);
-		obj_put(c);
+	for (unsigned int i = 0; i < CALL_HASH_SHARDS; i++) {
+		rtpe_calls_ht_iter iter;
+		t_hash_table_iter_init(&iter, rtpe_callhash[i].ht);
+		call_t *c;
+		while (t_hash_table_iter_next(&iter, NULL, &c)) {
+			__call_iterator_remove(c);
+			__call_cleanup(c);
+			obj_put(c);
+		}
+		t_hash_table_destroy(rtpe_callhash[i].ht);
+		rwlock_destroy(&rtpe_callhash[i].lock);
+	}
+}
+
+unsigned int call_hash_size(void) {
+	unsigned int ret = 0;
+	for (unsigned int i = 0; i < CALL_HASH_SHARDS; i++) {
+		rwlock_lock_r(&rtpe_callhash[i].lock);
+		ret += t_hash_table_size(rtpe_callhash[i].ht);
+		rwlock_unlock_r(&rtpe_callhash[i].lock);
 	}
-	t_hash_table_destroy(rtpe_callhash);
+	return ret;
 }
 
 
@@ -3840,18 +3911,19 @@ void call_destroy(call_t *c) {
 		return;
 	}
 
-	rwlock_lock_w(&rtpe_callhash_lock);
+	struct call_hash_shard *shard = call_hash_shard(&c->callid);
+	rwlock_lock_w(&shard->lock);
 	call_t *call_ht = NULL;
-	t_hash_table_steal_extended(rtpe_callhash, &c->callid, NULL, &call_ht);
+	t_hash_table_steal_extended(shard->ht, &c->callid, NULL, &call_ht);
 	if (call_ht) {
 		if (call_ht != c) {
-			t_hash_table_insert(rtpe_callhash, &call_ht->callid, call_ht);
+			t_hash_table_insert(shard->ht, &call_ht->callid, call_ht);
 			call_ht = NULL;
 		}
 		else
 			RTPE_GAUGE_DEC(total_sessions);
 	}
-	rwlock_unlock_w(&rtpe_callhash_lock);
+	rwlock_unlock_w(&shard->lock);
 
 	// if call not found in callhash => previously deleted
 	if (!call_ht)
@@ -4151,6 +4223,9 @@ static void __call_free(void *p) {
 		g_slice_free1(sizeof(*em), em);
 	}
 
+	if (c->redis_fields)
+		g_hash_table_destroy(c->redis_fields);
+
 	t_hash_table_destroy(c->tags);
 	t_hash_table_destroy(c->viabranches);
 	t_hash_table_destroy(c->labels);
@@ -4173,6 +4248,8 @@ static void __call_free(void *p) {
 	ice_fragments_cleanup(c->sdp_fragments, true);
 	t_hash_table_destroy(c->sdp_fragments);
 	rwlock_destroy(&c->master_lock);
+	mutex_destroy(&c->redis_lock);
+	poller_load_release(c->poller);
 
 	assert(c->stream_fds.head == NULL);
 }
@@ -4184,6 +4261,7 @@ static call_t *call_create(const str *callid) {
 	c = obj_alloc0("call", sizeof(*c), __call_free);
 	call_buffer_init(&c->buffer);
 	rwlock_init(&c->master_lock);
+	mutex_init(&c->redis_lock);
 	c->tags = tags_ht_new();
 	c->viabranches = tags_ht_new();
 	c->labels = labels_ht_new();
@@ -4192,7 +4270,7 @@ static call_t *call_create(const str *callid) {
 	c->created = rtpe_now;
 	c->dtls_cert = dtls_cert();
 	c->tos = rtpe_config.default_tos;
-	c->poller = rtpe_get_poller();
+	c->poller = poller_load_assign();
 	c->sdp_fragments = fragments_ht_new();
 	if (rtpe_config.cpu_affinity)
 		c->cpu_affinity = call_socket_cpu_affinity++ % rtpe_config.cpu_affinity;
@@ -4210,26 +4288,27 @@ static call_t *call_create(const str *callid) {
 /* returns call with master_lock held in W */
 call_t *call_get_or_create(const str *callid, bool exclusive) {
 	call_t *c;
+	struct call_hash_shard *shard = call_hash_shard(callid);
 
 restart:
-	rwlock_lock_r(&rtpe_callhash_lock);
-	c = t_hash_table_lookup(rtpe_callhash, callid);
+	rwlock_lock_r(&shard->lock);
+	c = t_hash_table_lookup(shard->ht, callid);
 	if (!c) {
-		rwlock_unlock_r(&rtpe_callhash_lock);
+		rwlock_unlock_r(&shard->lock);
 		/* completely new call-id, create call */
 		c = call_create(callid);
-		rwlock_lock_w(&rtpe_callhash_lock);
-		if (t_hash_table_lookup(rtpe_callhash, callid)) {
+		rwlock_lock_w(&shard->lock);
+		if (t_hash_table_lookup(shard->ht, callid)) {
 			/* preempted */
-			rwlock_unlock_w(&rtpe_callhash_lock);
+			rwlock_unlock_w(&shard->lock);
 			obj_put(c);
 			goto restart;
 		}
-		t_hash_table_insert(rtpe_callhash, &c->callid, obj_get(c));
+		t_hash_table_insert(shard->ht, &c->callid, obj_get(c));
 		RTPE_GAUGE_INC(total_sessions);
 
 		rwlock_lock_w(&c->master_lock);
-		rwlock_unlock_w(&rtpe_callhash_lock);
+		rwlock_unlock_w(&shard->lock);
 
 		for (int i = 0; i < NUM_CALL_ITERATORS; i++) {
 			c->iterator[i].link.data = obj_get(c);
@@ -4268,7 +4347,7 @@ restart:
 			obj_hold(c);
 			rwlock_lock_w(&c->master_lock);
 		}
-		rwlock_unlock_r(&rtpe_callhash_lock);
+		rwlock_unlock_r(&shard->lock);
 	}
 
 	if (c)
@@ -4287,17 +4366,18 @@ restart:
  */
 call_t *call_get(const str *callid) {
 	call_t *ret;
+	struct call_hash_shard *shard = call_hash_shard(callid);
 
-	rwlock_lock_r(&rtpe_callhash_lock);
-	ret = t_hash_table_lookup(rtpe_callhash, callid);
+	rwlock_lock_r(&shard->lock);
+	ret = t_hash_table_lookup(shard->ht, callid);
 	if (!ret) {
-		rwlock_unlock_r(&rtpe_callhash_lock);
+		rwlock_unlock_r(&shard->lock);
 		return NULL;
 	}
 
 	rwlock_lock_w(&ret->master_lock);
 	obj_hold(ret);
-	rwlock_unlock_r(&rtpe_callhash_lock);
+	rwlock_unlock_r(&shard->lock);
 
 	log_info_call(ret);
 	return ret;
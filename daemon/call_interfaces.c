@@ -454,11 +454,9 @@ static void call_status_iterator(call_t *c, struct streambuf_stream *s) {
 }
 
 void calls_status_tcp(struct streambuf_stream *s) {
-	rwlock_lock_r(&rtpe_callhash_lock);
 	streambuf_printf(s->outbuf, "proxy %u "UINT64F"/%i/%i\n",
-		t_hash_table_size(rtpe_callhash),
+		call_hash_size(),
 		atomic64_get(&rtpe_stats_rate.bytes_user) + atomic64_get(&rtpe_stats_rate.bytes_kernel), 0, 0);
-	rwlock_unlock_r(&rtpe_callhash_lock);
 
 	ITERATE_CALL_LIST_START(CALL_ITERATOR_MAIN, c);
 		call_status_iterator(c, s);
@@ -2117,8 +2115,7 @@ static enum load_limit_reasons call_offer_session_limit(void) {
 	enum load_limit_reasons ret = LOAD_LIMIT_NONE;
 
 	if (atomic_get_na(&rtpe_config.max_sessions) >= 0) {
-		rwlock_lock_r(&rtpe_callhash_lock);
-		if (t_hash_table_size(rtpe_callhash) -
+		if (call_hash_size() -
 				atomic64_get(&rtpe_stats_gauge.foreign_sessions) >= rtpe_config.max_sessions)
 		{
 			/* foreign calls can't get rejected
@@ -2128,7 +2125,6 @@ static enum load_limit_reasons call_offer_session_limit(void) {
 
 			ret = LOAD_LIMIT_MAX_SESSIONS;
 		}
-		rwlock_unlock_r(&rtpe_callhash_lock);
 	}
 
 	if (ret == LOAD_LIMIT_NONE && atomic_get_na(&rtpe_config.load_limit)) {
@@ -2851,15 +2847,18 @@ static void ng_list_calls(ng_command_ctx_t *ctx, parser_arg output, long long in
 	rtpe_calls_ht_iter iter;
 	const ng_parser_t *parser = ctx->parser_ctx.parser;
 
-	rwlock_lock_r(&rtpe_callhash_lock);
+	for (unsigned int i = 0; i < CALL_HASH_SHARDS && limit; i++) {
+		rwlock_lock_r(&rtpe_callhash[i].lock);
 
-	t_hash_table_iter_init (&iter, rtpe_callhash);
-	str *key;
-	while (limit-- && t_hash_table_iter_next (&iter, &key, NULL)) {
-		parser->list_add_str_dup(output, key);
-	}
+		t_hash_table_iter_init (&iter, rtpe_callhash[i].ht);
+		str *key;
+		while (limit && t_hash_table_iter_next (&iter, &key, NULL)) {
+			parser->list_add_str_dup(output, key);
+			limit--;
+		}
 
-	rwlock_unlock_r(&rtpe_callhash_lock);
+		rwlock_unlock_r(&rtpe_callhash[i].lock);
+	}
 }
 
 
@@ -470,11 +470,10 @@ static void cli_incoming_list_totals(str *instr, struct cli_writer *cw) {
 }
 
 static void cli_incoming_list_numsessions(str *instr, struct cli_writer *cw) {
-       rwlock_lock_r(&rtpe_callhash_lock);
-       cw->cw_printf(cw, "Current sessions own: "UINT64F"\n", t_hash_table_size(rtpe_callhash) - atomic64_get_na(&rtpe_stats_gauge.foreign_sessions));
+       unsigned int num_sessions = call_hash_size();
+       cw->cw_printf(cw, "Current sessions own: "UINT64F"\n", num_sessions - atomic64_get_na(&rtpe_stats_gauge.foreign_sessions));
        cw->cw_printf(cw, "Current sessions foreign: "UINT64F"\n", atomic64_get_na(&rtpe_stats_gauge.foreign_sessions));
-       cw->cw_printf(cw, "Current sessions total: %i\n", t_hash_table_size(rtpe_callhash));
-       rwlock_unlock_r(&rtpe_callhash_lock);
+       cw->cw_printf(cw, "Current sessions total: %i\n", num_sessions);
        cw->cw_printf(cw, "Current transcoded media: "UINT64F"\n", atomic64_get_na(&rtpe_stats_gauge.transcoded_media));
        cw->cw_printf(cw, "Current sessions ipv4 only media: " UINT64F "\n",
 		       atomic64_get_na(&rtpe_stats_gauge.ipv4_sessions));
@@ -1636,6 +1635,8 @@ static void cli_incoming_set_rediscmdtimeout(str *instr, struct cli_writer *cw)
 }
 
 static void cli_incoming_list_interfaces(str *instr, struct cli_writer *cw) {
+	stats_shards_fold();
+
 	for (GList *l = all_local_interfaces.head; l; l = l->next) {
 		struct local_intf *lif = l->data;
 		// only show first-order interface entries: socket families must match
@@ -1647,8 +1648,8 @@ static void cli_incoming_list_interfaces(str *instr, struct cli_writer *cw) {
 		cw->cw_printf(cw, " Port range: %5u - %5u\n",
 				lif->spec->port_pool.min,
 				lif->spec->port_pool.max);
-		unsigned int f = g_hash_table_size(lif->spec->port_pool.free_ports_ht);
-		unsigned int r = lif->spec->port_pool.max - lif->spec->port_pool.min + 1;
+		unsigned int f = port_pool_free_count(&lif->spec->port_pool);
+		unsigned int r = port_pool_size(&lif->spec->port_pool);
 		cw->cw_printf(cw, " Ports used: %5u / %5u (%5.1f%%)\n",
 				r - f, r, (double) (r - f) * 100.0 / r);
 		cw->cw_printf(cw, " Packets/bytes/errors:\n");
@@ -24,6 +24,7 @@
 #include "fix_frame_channel_layout.h"
 #endif
 #include "bufferpool.h"
+#include "poller.h"
 
 struct codec_timer {
 	struct timerthread_obj tt_obj;
@@ -52,6 +53,8 @@ static void __buffer_delay_raw(struct delay_buffer *dbuf, struct codec_handler *
 static codec_handler_func handler_func_passthrough;
 static struct timerthread codec_timers_thread;
 
+struct jobsched transcode_sched;
+
 static void rtp_payload_type_copy(rtp_payload_type *dst, const rtp_payload_type *src);
 static void codec_store_add_raw_order(struct codec_store *cs, rtp_payload_type *pt);
 static rtp_payload_type *codec_store_find_compatible(struct codec_store *cs,
@@ -101,6 +104,7 @@ static rtp_pt_list *__codec_store_delete_link(rtp_pt_list *link, struct codec_st
 #include <spandsp/logging.h>
 #include <spandsp/dtmf.h>
 #include "resample.h"
+#include "silence.h"
 #include "dtmf_rx_fillin.h"
 
 
@@ -182,23 +186,43 @@ struct silence_event {
 	uint64_t start;
 	uint64_t end;
 };
-TYPED_GQUEUE(silence_event, struct silence_event)
+// pending silence runs, kept until the encoder output has caught up with them
+#define SILENCE_EVENTS 16
+struct silence_events {
+	struct silence_event ev[SILENCE_EVENTS]; // ring
+	unsigned int head, len;
+};
 
 struct transcode_job {
+	struct jobsched_job job; // must be first
 	struct media_packet mp;
 	struct codec_ssrc_handler *ch;
 	struct codec_ssrc_handler *input_ch;
 	struct transcode_packet *packet;
 	bool done; // needed for in-order processing
 };
+// jobs run in one go for the same SSRC before yielding to others
+#define TRANSCODE_JOB_BATCH 16
 TYPED_GQUEUE(transcode_job, struct transcode_job);
 
+// decoders for the same input stream going to different sinks share their work
+struct decode_share {
+	struct call_media *media;
+	uint32_t ssrc;
+	rtp_payload_type pt;
+	unsigned int refs; // under decode_shares_lock
+	decode_cache_t *cache; // only once there's more than one sink, atomic for reading
+};
+
 struct codec_ssrc_handler {
 	struct ssrc_entry h; // must be first
 	struct codec_handler *handler;
 	decoder_t *decoder;
+	struct decode_share *decode_share;
+	bool decode_share_checked;
 	encoder_t *encoder;
 	codec_cc_t *chain;
+	codec_xlate_f *xlate;
 	format_t encoder_format;
 	int bitrate;
 	int ptime;
@@ -207,6 +231,7 @@ struct codec_ssrc_handler {
 	GString *sample_buffer;
 	struct dtx_buffer *dtx_buffer;
 	transcode_job_q async_jobs;
+	unsigned int async_worker; // scheduler affinity
 
 	// DTMF DSP stuff
 	dtmf_rx_state_t *dtmf_dsp;
@@ -218,7 +243,8 @@ struct codec_ssrc_handler {
 	struct dtmf_event dtmf_state; // state tracker for DTMF actions
 
 	// silence detection
-	silence_event_q silence_events;
+	struct silence_events silence_events;
+	bool dtx_silence; // DTX is producing silent frames
 
 	// DTMF audio suppression
 	unsigned long dtmf_start_ts;
@@ -256,13 +282,10 @@ struct rtcp_timer {
 
 
 
-static mutex_t transcode_lock = MUTEX_STATIC_INIT;
-static cond_t transcode_cond = COND_STATIC_INIT;
-static transcode_job_q transcode_jobs = TYPED_GQUEUE_INIT;
-
 static tc_code (*__rtp_decode)(struct codec_ssrc_handler *ch, struct codec_ssrc_handler *input_ch,
 		struct transcode_packet *packet, struct media_packet *mp);
 static void transcode_job_free(struct transcode_job *j);
+static void transcode_job_do(struct jobsched_job *);
 static void packet_encoded_tx(AVPacket *pkt, struct codec_ssrc_handler *ch, struct media_packet *mp,
 		str *inout, char *buf, unsigned int pkt_len, const struct fraction *cr_fact);
 static void packet_encoded_tx_seq_own(AVPacket *pkt, struct codec_ssrc_handler *ch, struct media_packet *mp,
@@ -1861,8 +1884,8 @@ static int __handler_func_sequencer(struct media_packet *mp, struct transcode_pa
 
 	atomic64_inc_na(&ssrc_in->stats->packets);
 	atomic64_add_na(&ssrc_in->stats->bytes, mp->payload.len);
-	atomic64_inc_na(&mp->sfd->local_intf->stats->in.packets);
-	atomic64_add_na(&mp->sfd->local_intf->stats->in.bytes, mp->payload.len);
+	INTF_STATS_SHARD_INC(mp->sfd->local_intf, in, packets);
+	INTF_STATS_SHARD_ADD(mp->sfd->local_intf, in, bytes, mp->payload.len);
 
 	struct codec_ssrc_handler *input_ch = get_ssrc(ssrc_in_p->h.ssrc, h->input_handler->ssrc_hash);
 
@@ -2801,7 +2824,7 @@ static void __buffer_delay_frame(struct delay_buffer *dbuf, struct codec_ssrc_ha
 		// input now
 		if (frame) {
 			input_func(ch->encoder, frame, ch->handler->packet_encoded, ch, mp);
-			av_frame_free(&frame);
+			codec_frame_free(&frame);
 		}
 		return;
 	}
@@ -2972,7 +2995,7 @@ static void send_buffered(struct media_packet *mp, unsigned int log_sys) {
 }
 
 static void delay_frame_free(struct delay_frame *dframe) {
-	av_frame_free(&dframe->frame);
+	codec_frame_free(&dframe->frame);
 	g_free(dframe->mp.raw.s);
 	media_packet_release(&dframe->mp);
 	if (dframe->ch)
@@ -3054,6 +3077,10 @@ static void delay_frame_manipulate(struct delay_frame *dframe) {
 	else if (!dtmf_recv)
 		return;
 
+	// decoded audio may be shared with other sinks
+	if (av_frame_make_writable(frame) < 0)
+		return;
+
 	// XXX this should be used for DTMF injection instead of a separate codec handler
 
 	switch (mode) {
@@ -3530,8 +3557,13 @@ static void __dtx_send_later(struct codec_timer *ct) {
 			// synthetic packet
 			mp_copy.rtp->seq_num = htons(ntohs(mp_copy.rtp->seq_num) + 1);
 
+			// Whether the gap is to be filled is decided by timing alone. What it's
+			// filled with goes through __silence_detect() like any decoded frame, and
+			// is sent as CN if silent. Silence DTX doesn't need to be scanned for that.
+			ch->dtx_silence = ch->decoder->dtx.method_id == DTX_SILENCE;
 			ret = decoder_dtx(ch->decoder, ts, ptime,
 					ch->handler->packet_decoded, ch, &mp_copy);
+			ch->dtx_silence = false;
 			if (ret)
 				ilogs(dtx, LOG_WARN | LOG_FLAG_LIMIT,
 						"Decoder error handling DTX/lost packet");
@@ -3701,72 +3733,121 @@ void codec_handlers_stop(codec_handlers_q *q, struct call_media *sink) {
 
 
 
-static void silence_event_free(struct silence_event *p) {
-	g_slice_free1(sizeof(*p), p);
+static struct silence_event *silence_event_first(struct silence_events *e) {
+	if (!e->len)
+		return NULL;
+	return &e->ev[e->head];
+}
+static struct silence_event *silence_event_last(struct silence_events *e) {
+	if (!e->len)
+		return NULL;
+	return &e->ev[(e->head + e->len - 1) % SILENCE_EVENTS];
+}
+static void silence_event_pop(struct silence_events *e) {
+	e->head = (e->head + 1) % SILENCE_EVENTS;
+	e->len--;
+}
+// returns NULL if the ring is full, in which case this run of silence is left alone
+static struct silence_event *silence_event_start(struct silence_events *e, uint64_t start) {
+	if (e->len == SILENCE_EVENTS)
+		return NULL;
+	e->len++;
+	struct silence_event *ev = silence_event_last(e);
+	*ev = (struct silence_event) { .start = start };
+	return ev;
 }
 
-#define __silence_detect_type(type) \
-static void __silence_detect_ ## type(struct codec_ssrc_handler *ch, AVFrame *frame, type thres) { \
-	type *s = (void *) frame->data[0]; \
-	struct silence_event *last = t_queue_peek_tail(&ch->silence_events); \
- \
-	if (last && last->end) /* last event finished? */ \
-		last = NULL; \
+// `flags` has one entry for each block of SILENCE_BLOCK samples starting at `pts`,
+// `silent` of them set
+static void __silence_detect_blocks(struct codec_ssrc_handler *ch, uint64_t pts, const uint8_t *flags,
+		unsigned int blocks, unsigned int silent)
+{
+	struct silence_event *last = silence_event_last(&ch->silence_events);
+
+	if (last && last->end) // last event finished?
+		last = NULL;
+
+	// all the same: no need to look at the blocks
+	if (silent == blocks) {
+		if (!last)
+			silence_event_start(&ch->silence_events, pts);
+		return;
+	}
+	if (!silent) {
+		if (last)
+			last->end = pts;
+		return;
+	}
+
+	for (unsigned int b = 0; b < blocks; b++) {
+		if (flags[b]) {
+			// silence
+			if (!last)
+				last = silence_event_start(&ch->silence_events, pts + b * SILENCE_BLOCK);
+		}
+		else if (last) {
+			// not silence: close off event
+			last->end = pts + b * SILENCE_BLOCK;
+			last = NULL;
+		}
+	}
+}
+
+#define __silence_detect_type(type, fmt) \
+static void __silence_detect_ ## fmt(struct codec_ssrc_handler *ch, AVFrame *frame, type thres) { \
+	uint8_t flags[256]; \
+	const type *s = (void *) frame->data[0]; \
+	uint64_t pts = frame->pts; \
+	unsigned int num = frame->nb_samples; \
  \
-	for (unsigned int i = 0; i < frame->nb_samples; i++) { \
-		if (s[i] <= thres && s[1] >= -thres) { \
-			/* silence */ \
-			if (!last) { \
-				/* new event */ \
-				last = g_slice_alloc0(sizeof(*last)); \
-				last->start = frame->pts + i; \
-				t_queue_push_tail(&ch->silence_events, last); \
-			} \
-		} \
-		else { \
-			/* not silence */ \
-			if (last && !last->end) { \
-				/* close off event */ \
-				last->end = frame->pts + i; \
-				last = NULL; \
-			} \
-		} \
+	while (num) { \
+		unsigned int chunk = MIN(num, G_N_ELEMENTS(flags) * SILENCE_BLOCK); \
+		unsigned int silent = silence_scan_ ## fmt(flags, s, chunk, thres); \
+		__silence_detect_blocks(ch, pts, flags, silence_blocks(chunk), silent); \
+		s += chunk; \
+		pts += chunk; \
+		num -= chunk; \
 	} \
 }
 
-__silence_detect_type(double)
-__silence_detect_type(float)
-__silence_detect_type(int32_t)
-__silence_detect_type(int16_t)
+__silence_detect_type(double, dbl)
+__silence_detect_type(float, flt)
+__silence_detect_type(int32_t, s32)
+__silence_detect_type(int16_t, s16)
 
 static void __silence_detect(struct codec_ssrc_handler *ch, AVFrame *frame) {
 	if (!rtpe_config.silence_detect_int)
 		return;
 	if (ch->handler->cn_payload_type < 0)
 		return;
+	if (ch->dtx_silence) {
+		// nothing to look at
+		__silence_detect_blocks(ch, frame->pts, NULL, 1, 1);
+		return;
+	}
 	switch (frame->format) {
 		case AV_SAMPLE_FMT_DBL:
-			__silence_detect_double(ch, frame, rtpe_config.silence_detect_double);
+			__silence_detect_dbl(ch, frame, rtpe_config.silence_detect_double);
 			break;
 		case AV_SAMPLE_FMT_FLT:
-			__silence_detect_float(ch, frame, rtpe_config.silence_detect_double);
+			__silence_detect_flt(ch, frame, rtpe_config.silence_detect_double);
 			break;
 		case AV_SAMPLE_FMT_S32:
-			__silence_detect_int32_t(ch, frame, rtpe_config.silence_detect_int);
+			__silence_detect_s32(ch, frame, MIN(rtpe_config.silence_detect_int, INT32_MAX));
 			break;
 		case AV_SAMPLE_FMT_S16:
-			__silence_detect_int16_t(ch, frame, rtpe_config.silence_detect_int >> 16);
+			__silence_detect_s16(ch, frame, MIN(rtpe_config.silence_detect_int >> 16, INT16_MAX));
 			break;
 		default:
 			ilogs(transcoding, LOG_WARN | LOG_FLAG_LIMIT, "Unsupported sample format %i for silence detection",
 					frame->format);
 	}
 }
-static int is_silence_event(str *inout, silence_event_q *events, uint64_t pts, uint64_t duration) {
+static int is_silence_event(str *inout, struct silence_events *events, uint64_t pts, uint64_t duration) {
 	uint64_t end = pts + duration;
+	struct silence_event *first;
 
-	while (events->length) {
-		struct silence_event *first = t_queue_peek_head(events);
+	while ((first = silence_event_first(events))) {
 		if (first->start > pts) // future event
 			return 0;
 		if (!first->end) // ongoing event
@@ -3774,14 +3855,11 @@ static int is_silence_event(str *inout, silence_event_q *events, uint64_t pts, u
 		if (first->end > end) // event finished with end in the future
 			goto silence;
 		// event has ended: remove it
-		t_queue_pop_head(events);
+		silence_event_pop(events);
 		// does the event fill the entire span?
-		if (first->end == end) {
-			silence_event_free(first);
+		if (first->end == end)
 			goto silence;
-		}
 		// keep going, there might be more
-		silence_event_free(first);
 	}
 	return 0;
 
@@ -3829,6 +3907,110 @@ static void async_chain_finish(AVPacket *pkt, void *async_cb_obj) {
 	transcode_job_free(j);
 }
 
+static mutex_t decode_shares_lock = MUTEX_STATIC_INIT;
+static GHashTable *decode_shares;
+
+static guint decode_share_hash(const void *p) {
+	const struct decode_share *s = p;
+	return g_direct_hash(s->media) ^ s->ssrc ^ s->pt.payload_type;
+}
+static gboolean decode_share_eq(const void *ap, const void *bp) {
+	const struct decode_share *a = ap, *b = bp;
+	return a->media == b->media && a->ssrc == b->ssrc && a->pt.payload_type == b->pt.payload_type;
+}
+
+static bool __decode_share_ok(struct codec_ssrc_handler *ch) {
+	struct codec_handler *h = ch->handler;
+	codec_def_t *def = h->source_pt.codec_def;
+	if (!ch->decoder || !h->media)
+		return false;
+	if (def->supplemental || def->dtmf)
+		return false;
+	// stateful DTX must stay in line with the decoder's own context
+	if (def->dtx_methods[DTX_NATIVE])
+		return false;
+	return true;
+}
+
+// registers the decoder with the share for its input stream, creating it if needed. A single
+// sink has nothing to share, so the cache itself is only set up once a second one shows up
+static void __decode_share_register(struct codec_ssrc_handler *ch) {
+	ch->decode_share_checked = true;
+	if (!__decode_share_ok(ch))
+		return;
+
+	struct codec_handler *h = ch->handler;
+	struct decode_share key = {
+		.media = h->media,
+		.ssrc = ch->h.ssrc,
+		.pt = h->source_pt,
+	};
+
+	LOCK(&decode_shares_lock);
+
+	if (!decode_shares)
+		decode_shares = g_hash_table_new(decode_share_hash, decode_share_eq);
+
+	struct decode_share *share = g_hash_table_lookup(decode_shares, &key);
+	if (share) {
+		// same payload type number but different codec: don't mix them up
+		if (!rtp_payload_type_eq_exact(&share->pt, &h->source_pt)
+				|| str_cmp_str(&share->pt.format_parameters, &h->source_pt.format_parameters)
+				|| str_cmp_str(&share->pt.codec_opts, &h->source_pt.codec_opts))
+			return;
+	}
+	else {
+		share = g_new(__typeof(*share), 1);
+		*share = key;
+		share->refs = 0;
+		share->cache = NULL;
+		g_hash_table_add(decode_shares, share);
+	}
+
+	share->refs++;
+	ch->decode_share = share;
+
+	if (share->refs < 2 || share->cache)
+		return;
+
+	ilogs(codec, LOG_DEBUG, "Sharing decoder for %s/%u/%i between %u sinks",
+			h->source_pt.codec_def->rtpname, h->source_pt.clock_rate,
+			h->source_pt.channels, share->refs);
+	decode_cache_t *cache = decode_cache_new(h->source_pt.codec_def, h->source_pt.clock_rate,
+			h->source_pt.channels, h->source_pt.ptime, &h->source_pt.format,
+			&h->source_pt.format_parameters, &h->source_pt.codec_opts);
+	__atomic_store_n(&share->cache, cache, __ATOMIC_RELEASE);
+}
+
+// switches the decoder over to the shared cache once there is one. A decoder that has been
+// decoding on its own keeps doing so until the cache's decoder has caught up with the
+// state of the stream, so that stateful codecs switch over without a glitch
+static void __decode_share_use(struct codec_ssrc_handler *ch) {
+	decode_cache_t *cache = __atomic_load_n(&ch->decode_share->cache, __ATOMIC_ACQUIRE);
+	if (!cache)
+		return;
+	if (ch->decoder->rtp_ts != (unsigned long) -1L && !decode_cache_warm(cache))
+		return;
+	decoder_set_cache(ch->decoder, cache);
+}
+
+static void __decode_share_put(struct decode_share **sharep) {
+	struct decode_share *share = *sharep;
+	if (!share)
+		return;
+	*sharep = NULL;
+
+	{
+		LOCK(&decode_shares_lock);
+		if (--share->refs)
+			return;
+		g_hash_table_remove(decode_shares, share);
+	}
+
+	decode_cache_free(share->cache);
+	g_free(share);
+}
+
 static bool __ssrc_handler_decode_common(struct codec_ssrc_handler *ch, struct codec_handler *h,
 		const format_t *enc_format)
 {
@@ -3925,6 +4107,11 @@ static struct ssrc_entry *__ssrc_handler_transcode_new(void *p) {
 	ch->bytes_per_packet = (ch->encoder->samples_per_packet ? : ch->encoder->samples_per_frame)
 		* h->dest_pt.codec_def->bits_per_sample / 8;
 
+	// PCMA <> PCMU doesn't need to go through PCM
+	if (!h->pcm_dtmf_detect && h->source_pt.clock_rate == h->dest_pt.clock_rate
+			&& h->source_pt.channels == h->dest_pt.channels)
+		ch->xlate = codec_xlate(h->source_pt.codec_def, h->dest_pt.codec_def);
+
 	ilogs(codec, LOG_DEBUG, "Encoder created with clockrate %i, %i channels, using sample format %i "
 			"(ptime %i for %i samples per frame and %i samples (%i bytes) per packet, bitrate %i)",
 			ch->encoder_format.clockrate, ch->encoder_format.channels, ch->encoder_format.format,
@@ -3972,6 +4159,7 @@ static void __free_ssrc_handler(void *chp) {
 	struct codec_ssrc_handler *ch = chp;
 	if (ch->decoder)
 		decoder_close(ch->decoder);
+	__decode_share_put(&ch->decode_share);
 	if (ch->encoder) {
 		// flush out queue to avoid ffmpeg warnings
 		int going;
@@ -3988,7 +4176,7 @@ static void __free_ssrc_handler(void *chp) {
 		dtmf_rx_free(ch->dtmf_dsp);
 	resample_shutdown(&ch->dtmf_resampler);
 	t_queue_clear_full(&ch->dtmf_events, dtmf_event_free);
-	t_queue_clear_full(&ch->silence_events, silence_event_free);
+	ch->silence_events.len = 0;
 	t_queue_clear(&ch->async_jobs);
 	dtx_buffer_stop(&ch->dtx_buffer);
 }
@@ -4180,7 +4368,7 @@ static void __dtmf_detect(struct codec_ssrc_handler *ch, AVFrame *frame) {
 		num_samples = ret;
 	}
 	ch->dtmf_ts = dsp_frame->pts + dsp_frame->nb_samples;
-	av_frame_free(&dsp_frame);
+	codec_frame_free(&dsp_frame);
 }
 
 static int packet_decoded_common(decoder_t *decoder, AVFrame *frame, void *u1, void *u2,
@@ -4246,7 +4434,7 @@ static int packet_decoded_common(decoder_t *decoder, AVFrame *frame, void *u1, v
 	frame = NULL; // consumed
 
 discard:
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 	obj_put(&new_ch->h);
 
 	return 0;
@@ -4277,6 +4465,64 @@ static int packet_decoded_audio_player(decoder_t *decoder, AVFrame *frame, void
 	return 0;
 }
 
+// anything that needs to see the decoded audio, or has audio of its own in the pipeline,
+// requires the packet to go through the decoder
+static bool __ssrc_handler_xlate_ok(struct codec_ssrc_handler *ch) {
+	struct codec_handler *h = ch->handler;
+	if (h->output_handler != h)
+		return false;
+	if (ch->skip_pts || ch->dtmf_dsp)
+		return false;
+	if (rtpe_config.silence_detect_int && h->cn_payload_type >= 0)
+		return false;
+	if (av_audio_fifo_size(ch->encoder->fifo))
+		return false;
+	if (!__buffer_delay_do_direct(h->input_handler ? h->input_handler->delay_buffer : h->delay_buffer))
+		return false;
+	return true;
+}
+
+// converts the payload directly into the output codec and hands it to the packetizer, as if it
+// had gone through the decoder and encoder
+static void __rtp_xlate(struct codec_ssrc_handler *ch, struct transcode_packet *packet,
+		struct media_packet *mp)
+{
+	struct codec_handler *h = ch->handler;
+	encoder_t *enc = ch->encoder;
+	unsigned int samples = packet->payload->len / (h->source_pt.channels ? : 1);
+
+	ilogs(transcoding, LOG_DEBUG, "Converting RTP payload directly: TS %lu, samples %u",
+			packet->ts, samples);
+
+	mp->ptime = samples * 1000L / h->source_pt.clock_rate;
+	if (!samples)
+		return;
+
+	if (h->stats_entry) {
+		int idx = rtpe_now.tv_sec & 1;
+		atomic64_add(&h->stats_entry->pcm_samples[idx], samples);
+		atomic64_add(&h->stats_entry->pcm_samples[2], samples);
+	}
+
+	// locking deliberately ignored
+	if (mp->media_out)
+		enc->callback = mp->media_out->encoder_callback;
+
+	if (codec_packet_new(enc->avpkt, packet->payload->len) < 0)
+		return;
+	ch->xlate(enc->avpkt->data, (unsigned char *) packet->payload->s, packet->payload->len);
+
+	// keep the encoder's timestamps in step
+	enc->avpkt->pts = enc->next_pts;
+	enc->avpkt->duration = samples;
+	enc->fifo_pts += samples;
+
+	h->packet_encoded(enc, ch, mp);
+
+	enc->next_pts += samples;
+	av_packet_unref(enc->avpkt);
+}
+
 static tc_code __rtp_decode_direct(struct codec_ssrc_handler *ch, struct codec_ssrc_handler *input_ch,
 		struct transcode_packet *packet, struct media_packet *mp)
 {
@@ -4296,7 +4542,13 @@ static tc_code __rtp_decode_direct(struct codec_ssrc_handler *ch, struct codec_s
 				av_packet_unref(pkt);
 			}
 		}
+		else if (ch->xlate && __ssrc_handler_xlate_ok(ch))
+			__rtp_xlate(ch, packet, mp);
 		else {
+			if (G_UNLIKELY(!ch->decode_share_checked))
+				__decode_share_register(ch);
+			if (ch->decode_share && !ch->decoder->cache)
+				__decode_share_use(ch);
 			int ret = decoder_input_data_ptime(ch->decoder, packet->payload, packet->ts, &mp->ptime,
 					ch->handler->packet_decoded,
 					ch, mp);
@@ -4315,16 +4567,15 @@ static tc_code __rtp_decode_async(struct codec_ssrc_handler *ch, struct codec_ss
 	j->input_ch = obj_get(&input_ch->h);
 	j->packet = packet;
 	j->done = false;
+	j->job.func = transcode_job_do;
+	j->job.affinity = &ch->async_worker;
 
 	// append-only here, with the SSRC handler locked
 	t_queue_push_tail(&ch->async_jobs, j);
 
-	// if this is the first job for this SSRC handler, notify async worker
-	if (ch->async_jobs.length == 1) {
-		LOCK(&transcode_lock);
-		t_queue_push_tail(&transcode_jobs, j);
-		cond_signal(&transcode_cond);
-	}
+	// if this is the first job for this SSRC handler, hand it to the scheduler
+	if (ch->async_jobs.length == 1)
+		jobsched_submit(&transcode_sched, &j->job);
 
 	return TCC_CONSUMED;
 }
@@ -5832,14 +6083,19 @@ static void transcode_job_free(struct transcode_job *j) {
 	g_free(j);
 }
 
-static void transcode_job_do(struct transcode_job *ref_j) {
+static void transcode_job_do(struct jobsched_job *sj) {
+	struct transcode_job *ref_j = (struct transcode_job *) sj;
+	struct codec_ssrc_handler *ch = ref_j->ch;
 	struct call *call = ref_j->mp.call;
+	unsigned int num = 0;
+
+	gettimeofday(&rtpe_now, NULL);
 
 	rwlock_lock_r(&call->master_lock);
 	__ssrc_lock_both(&ref_j->mp);
 
-	// the first job in the queue must be the one that was given to async worker
-	transcode_job_list *list = ref_j->ch->async_jobs.head;
+	// the first job in the queue must be the one that was given to the scheduler
+	transcode_job_list *list = ch->async_jobs.head;
 	// given: // assert(list->data == ref_j);
 
 	do {
@@ -5862,48 +6118,51 @@ static void transcode_job_do(struct transcode_job *ref_j) {
 		// added in the meantime.
 		__ssrc_lock_both(&ref_j->mp);
 		list = list->next;
+		num++;
+	}
+	while (list && num < TRANSCODE_JOB_BATCH);
+
+	// we will run no more jobs here and take over the ones we've done for cleanup,
+	// while holding the SSRC handler lock. if we've reached the end of the list,
+	// anything added after we release the lock will result in a new job given to
+	// the scheduler. otherwise we yield to other SSRCs, and give the remainder of
+	// the list back to the scheduler, starting with its new first job.
+	transcode_job_q q = ch->async_jobs;
+	struct transcode_job *next = NULL;
+	if (!list)
+		t_queue_init(&ch->async_jobs);
+	else {
+		q.tail = list->prev;
+		q.tail->next = NULL;
+		q.length = num;
+		list->prev = NULL;
+		ch->async_jobs.head = list;
+		ch->async_jobs.length -= num;
+		next = list->data;
 	}
-	while (list);
-
-	// we've reached the end of the list while holding the SSRC handler lock.
-	// we will run no more jobs here. we take over the list for cleanup and
-	// then release the lock, guaranteeing that anything added afterwards will
-	// run later and will result in a new job given to the async worker threads.
-	transcode_job_q q = ref_j->ch->async_jobs;
-	t_queue_init(&ref_j->ch->async_jobs);
 	__ssrc_unlock_both(&ref_j->mp);
 
+	// the remaining jobs hold a reference to the SSRC handler, and nothing else can
+	// touch the list until the scheduler runs `next`
+	if (next)
+		jobsched_submit(&transcode_sched, &next->job);
+
 	while ((ref_j = t_queue_pop_head(&q)))
 		transcode_job_free(ref_j);
 
 	rwlock_unlock_r(&call->master_lock);
-}
-
-static void codec_worker(void *d) {
-	struct thread_waker waker = { .lock = &transcode_lock, .cond = &transcode_cond };
-	thread_waker_add(&waker);
-
-	mutex_lock(&transcode_lock);
-
-	while (!rtpe_shutdown) {
-		// wait once, but then loop in case of shutdown
-		if (transcode_jobs.length == 0)
-			cond_wait(&transcode_cond, &transcode_lock);
-		if (transcode_jobs.length == 0)
-			continue;
-
-		struct transcode_job *j = t_queue_pop_head(&transcode_jobs);
 
-		mutex_unlock(&transcode_lock);
-
-		gettimeofday(&rtpe_now, NULL);
-		transcode_job_do(j);
+	// send out what's been batched up, as codec threads have no poll loop to do it
+	uring_thread_loop();
+}
 
-		mutex_lock(&transcode_lock);
-	}
+static void transcode_sched_wake(struct thread_waker *wk) {
+	jobsched_shutdown(&transcode_sched);
+}
+static struct thread_waker transcode_sched_waker = { .func = transcode_sched_wake };
 
-	mutex_unlock(&transcode_lock);
-	thread_waker_del(&waker);
+static void codec_worker(void *d) {
+	jobsched_worker(&transcode_sched, GPOINTER_TO_UINT(d));
 }
 #endif
 
@@ -5912,8 +6171,10 @@ void codecs_init(void) {
 
 #ifdef WITH_TRANSCODING
 	if (rtpe_config.codec_num_threads) {
+		jobsched_init(&transcode_sched, rtpe_config.codec_num_threads);
+		thread_waker_add_generic(&transcode_sched_waker);
 		for (unsigned int i = 0; i < rtpe_config.codec_num_threads; i++)
-			thread_create_detach(codec_worker, NULL, "transcode");
+			thread_create_detach(codec_worker, GUINT_TO_POINTER(i), "transcode");
 
 		__rtp_decode = __rtp_decode_async;
 	}
@@ -5923,6 +6184,12 @@ void codecs_init(void) {
 }
 void codecs_cleanup(void) {
 	timerthread_free(&codec_timers_thread);
+#ifdef WITH_TRANSCODING
+	if (transcode_sched.workers) {
+		thread_waker_del(&transcode_sched_waker);
+		jobsched_free(&transcode_sched);
+	}
+#endif
 }
 void codec_timers_launch(void) {
 	timerthread_launch(&codec_timers_thread, rtpe_config.scheduling, rtpe_config.priority, "codec timer");
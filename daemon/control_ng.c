@@ -938,7 +938,7 @@ int control_ng_process(str *buf, const endpoint_t *sin, char *addr, const sockad
 		cb(&cookie, cached->reply, sin, local, p1);
 		CH(homer_trace_msg_out, &hctx, cached->reply);
 
-		cache_entry_free(cached);
+		cache_entry_put(cached);
 		return 0;
 	}
 
@@ -78,7 +78,7 @@ static void control_udp_incoming(struct obj *obj, struct udp_buffer *udp_buf) {
 		reply = ce->reply;
 		ilogs(control, LOG_INFO, "Detected command from udp:%s as a duplicate", udp_buf->addr);
 		socket_sendto_from(udp_buf->listener, reply->s, reply->len, &udp_buf->sin, &udp_buf->local_addr);
-		cache_entry_free(ce);
+		cache_entry_put(ce);
 		goto out;
 	}
 
@@ -7,87 +7,162 @@
 #include "helpers.h"
 #include "poller.h"
 #include "str.h"
+#include "main.h"
 
-INLINE void cookie_cache_state_init(struct cookie_cache_state *s) {
+INLINE void cookie_cache_shard_init(struct cookie_cache_shard *s) {
 	s->in_use = g_hash_table_new((GHashFunc) str_hash, (GEqualFunc) str_equal);
-	s->cookies = g_hash_table_new_full((GHashFunc) str_hash, (GEqualFunc) str_equal, free, cache_entry_free);
-}
-INLINE void cookie_cache_state_cleanup(struct cookie_cache_state *s) {
-	g_hash_table_destroy(s->cookies);
-	g_hash_table_destroy(s->in_use);
+	s->cookies = g_hash_table_new((GHashFunc) str_hash, (GEqualFunc) str_equal);
+	for (unsigned int i = 0; i < COOKIE_CACHE_BUCKETS; i++)
+		g_queue_init(&s->buckets[i]);
+	s->slot = rtpe_now.tv_sec / COOKIE_CACHE_BUCKET_SECS;
+	s->size = 0;
+	mutex_init(&s->lock);
+	cond_init(&s->cond);
 }
 
 void cookie_cache_init(struct cookie_cache *c) {
-	cookie_cache_state_init(&c->current);
-	cookie_cache_state_init(&c->old);
-	c->swap_time = rtpe_now.tv_sec;
-	mutex_init(&c->lock);
-	cond_init(&c->cond);
+	for (unsigned int i = 0; i < COOKIE_CACHE_SHARDS; i++)
+		cookie_cache_shard_init(&c->shards[i]);
+	if (rtpe_config.cookie_cache_size > 0)
+		c->max_shard_size = (size_t) rtpe_config.cookie_cache_size * 1024 * 1024
+			/ COOKIE_CACHE_SHARDS;
+	else
+		c->max_shard_size = SIZE_MAX;
+}
+
+INLINE struct cookie_cache_shard *cookie_cache_shard(struct cookie_cache *c, const str *s) {
+	return &c->shards[str_hash(s) % COOKIE_CACHE_SHARDS];
+}
+
+/* lock must be held */
+static void __cookie_cache_drop(struct cookie_cache_shard *s, struct cookie_cache_entry *e) {
+	g_hash_table_remove(s->cookies, &e->cookie);
+	g_queue_unlink(&s->buckets[e->bucket], &e->link);
+	s->size -= e->size;
+	obj_put(e);
 }
 
 /* lock must be held */
-static void __cookie_cache_check_swap(struct cookie_cache *c) {
-	if (rtpe_now.tv_sec - c->swap_time >= 30) {
-		g_hash_table_remove_all(c->old.cookies);
-		swap_ptrs(&c->old.cookies, &c->current.cookies);
-		c->swap_time = rtpe_now.tv_sec;
+static void __cookie_cache_expire_bucket(struct cookie_cache_shard *s, unsigned int bucket) {
+	GList *l;
+	while ((l = s->buckets[bucket].head))
+		__cookie_cache_drop(s, l->data);
+}
+
+/* lock must be held. Empties the bucket that is now being reused, which holds the entries
+ * from COOKIE_CACHE_BUCKETS time slots ago. */
+static void __cookie_cache_check_expire(struct cookie_cache_shard *s) {
+	time_t slot = rtpe_now.tv_sec / COOKIE_CACHE_BUCKET_SECS;
+	if (slot <= s->slot)
+		return;
+	if (slot - s->slot > COOKIE_CACHE_BUCKETS)
+		s->slot = slot - COOKIE_CACHE_BUCKETS;
+	while (s->slot < slot) {
+		s->slot++;
+		__cookie_cache_expire_bucket(s, s->slot % COOKIE_CACHE_BUCKETS);
+	}
+}
+
+/* lock must be held. Drops the oldest entries until the shard is below its size limit. */
+static void __cookie_cache_check_size(struct cookie_cache *c, struct cookie_cache_shard *s) {
+	for (unsigned int i = 1; i <= COOKIE_CACHE_BUCKETS && s->size > c->max_shard_size; i++) {
+		GQueue *q = &s->buckets[(s->slot + i) % COOKIE_CACHE_BUCKETS];
+		while (q->head && s->size > c->max_shard_size)
+			__cookie_cache_drop(s, q->head->data);
 	}
 }
 
 cache_entry *cookie_cache_lookup(struct cookie_cache *c, const str *s) {
-	cache_entry *ret;
+	struct cookie_cache_shard *sh = cookie_cache_shard(c, s);
+	struct cookie_cache_entry *e;
 
-	mutex_lock(&c->lock);
+	mutex_lock(&sh->lock);
 
-	__cookie_cache_check_swap(c);
+	__cookie_cache_check_expire(sh);
 
 restart:
-	ret = g_hash_table_lookup(c->current.cookies, s);
-	if (!ret)
-		ret = g_hash_table_lookup(c->old.cookies, s);
-	if (ret) {
-		ret = cache_entry_dup(ret);
-		mutex_unlock(&c->lock);
-		return ret;
+	e = g_hash_table_lookup(sh->cookies, s);
+	if (e) {
+		obj_hold(e);
+		mutex_unlock(&sh->lock);
+		return &e->ce;
 	}
 
 	// is it being worked on right now by another thread?
-	void *p = g_hash_table_lookup(c->current.in_use, s);
-	if (!p)
-		p = g_hash_table_lookup(c->old.in_use, s);
-	if (p) {
-		cond_wait(&c->cond, &c->lock);
+	if (g_hash_table_lookup(sh->in_use, s)) {
+		cond_wait(&sh->cond, &sh->lock);
 		goto restart;
 	}
 
 	// caller is required to call cookie_cache_insert or cookie_cache_remove
 	// before `s` runs out of scope
-	g_hash_table_replace(c->current.in_use, (void *) s, (void *) 0x1);
-	mutex_unlock(&c->lock);
+	g_hash_table_replace(sh->in_use, (void *) s, (void *) 0x1);
+	mutex_unlock(&sh->lock);
 	return NULL;
 }
 
 void cookie_cache_insert(struct cookie_cache *c, const str *s, const struct cache_entry *entry) {
-	mutex_lock(&c->lock);
-	g_hash_table_remove(c->current.in_use, s);
-	g_hash_table_remove(c->old.in_use, s);
-	g_hash_table_replace(c->current.cookies, str_dup(s), cache_entry_dup(entry));
-	g_hash_table_remove(c->old.cookies, s);
-	cond_broadcast(&c->cond);
-	mutex_unlock(&c->lock);
+	struct cookie_cache_shard *sh = cookie_cache_shard(c, s);
+
+	// build the entry outside of the lock, as a single allocation
+	size_t size = sizeof(struct cookie_cache_entry) + s->len + entry->reply->len
+		+ entry->callid->len;
+	struct cookie_cache_entry *e = obj_alloc0("cookie_cache_entry", size, NULL);
+	char *p = (char *) (e + 1);
+
+	e->cookie = STR_LEN(p, s->len);
+	memcpy(p, s->s, s->len);
+	p += s->len;
+	e->reply = STR_LEN(p, entry->reply->len);
+	memcpy(p, entry->reply->s, entry->reply->len);
+	p += entry->reply->len;
+	e->callid = STR_LEN(p, entry->callid->len);
+	memcpy(p, entry->callid->s, entry->callid->len);
+
+	e->ce.reply = &e->reply;
+	e->ce.callid = &e->callid;
+	e->ce.command = entry->command;
+	e->link.data = e;
+	e->size = size;
+
+	mutex_lock(&sh->lock);
+
+	__cookie_cache_check_expire(sh);
+
+	g_hash_table_remove(sh->in_use, s);
+	struct cookie_cache_entry *old = g_hash_table_lookup(sh->cookies, s);
+	if (old)
+		__cookie_cache_drop(sh, old);
+
+	e->bucket = sh->slot % COOKIE_CACHE_BUCKETS;
+	g_queue_push_tail_link(&sh->buckets[e->bucket], &e->link);
+	g_hash_table_insert(sh->cookies, &e->cookie, e);
+	sh->size += size;
+
+	__cookie_cache_check_size(c, sh);
+
+	cond_broadcast(&sh->cond);
+	mutex_unlock(&sh->lock);
 }
 
 void cookie_cache_remove(struct cookie_cache *c, const str *s) {
-	mutex_lock(&c->lock);
-	g_hash_table_remove(c->current.in_use, s);
-	g_hash_table_remove(c->old.in_use, s);
-	g_hash_table_remove(c->current.cookies, s);
-	g_hash_table_remove(c->old.cookies, s);
-	cond_broadcast(&c->cond);
-	mutex_unlock(&c->lock);
+	struct cookie_cache_shard *sh = cookie_cache_shard(c, s);
+
+	mutex_lock(&sh->lock);
+	g_hash_table_remove(sh->in_use, s);
+	struct cookie_cache_entry *e = g_hash_table_lookup(sh->cookies, s);
+	if (e)
+		__cookie_cache_drop(sh, e);
+	cond_broadcast(&sh->cond);
+	mutex_unlock(&sh->lock);
 }
 
 void cookie_cache_cleanup(struct cookie_cache *c) {
-	cookie_cache_state_cleanup(&c->current);
-	cookie_cache_state_cleanup(&c->old);
+	for (unsigned int i = 0; i < COOKIE_CACHE_SHARDS; i++) {
+		struct cookie_cache_shard *sh = &c->shards[i];
+		for (unsigned int j = 0; j < COOKIE_CACHE_BUCKETS; j++)
+			__cookie_cache_expire_bucket(sh, j);
+		g_hash_table_destroy(sh->cookies);
+		g_hash_table_destroy(sh->in_use);
+	}
 }
@@ -1,6 +1,11 @@
 #include "crypto.h"
 
 #include <string.h>
+#include <stdbool.h>
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <glib.h>
@@ -31,6 +36,9 @@ static int hmac_sha1_rtcp(struct crypto_context *, char *out, str *in);
 static int aes_f8_encrypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, uint32_t idx);
 static int aes_f8_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, uint32_t idx);
 static int aes_cm_session_key_init(struct crypto_context *c);
+static int aes_cm_ctr_encrypt_rtp(struct crypto_context *, struct rtp_header *, str *, uint32_t);
+static int aes_cm_ctr_encrypt_rtcp(struct crypto_context *, struct rtcp_packet *, str *, uint32_t);
+static int aes_cm_ctr_session_key_init(struct crypto_context *c);
 static int aes_gcm_session_key_init(struct crypto_context *c);
 static int aes_f8_session_key_init(struct crypto_context *c);
 static int evp_session_key_cleanup(struct crypto_context *c);
@@ -515,8 +523,7 @@ int crypto_gen_session_key(struct crypto_context *c, str *out, unsigned char lab
  */
 
 /* rfc 3711 section 4.1.1 */
-static int aes_cm_encrypt(struct crypto_context *c, uint32_t ssrc, str *s, uint32_t idx) {
-	unsigned char iv[16];
+static void aes_cm_iv(unsigned char *iv, struct crypto_context *c, uint32_t ssrc, uint32_t idx) {
 	uint32_t *ivi;
 	uint32_t idxh, idxl;
 
@@ -529,7 +536,12 @@ static int aes_cm_encrypt(struct crypto_context *c, uint32_t ssrc, str *s, uint3
 	ivi[1] ^= ssrc;
 	ivi[2] ^= idxh;
 	ivi[3] ^= idxl;
+}
+
+static int aes_cm_encrypt(struct crypto_context *c, uint32_t ssrc, str *s, uint32_t idx) {
+	unsigned char iv[16];
 
+	aes_cm_iv(iv, c, ssrc, idx);
 	aes_ctr((void *) s->s, s, c->session_key_ctx[0], iv);
 
 	return 0;
@@ -545,6 +557,35 @@ static int aes_cm_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r,
 	return aes_cm_encrypt(c, r->ssrc, s, idx);
 }
 
+/* Same as above, but using the native CTR mode of the cipher instead of encrypting one
+ * counter block at a time. This lets OpenSSL generate the key stream for the whole packet
+ * in one go, which with AES-NI/VAES runs several blocks through the pipeline in parallel.
+ * The 16-bit block counter never wraps within a packet, so the 128-bit counter increment
+ * done by the CTR mode gives the same result. */
+static int aes_cm_ctr_encrypt(struct crypto_context *c, uint32_t ssrc, str *s, uint32_t idx) {
+	unsigned char iv[16];
+	int outlen;
+
+	if (!c->session_key_ctx[0])
+		return -1;
+
+	aes_cm_iv(iv, c, ssrc, idx);
+	EVP_EncryptInit_ex(c->session_key_ctx[0], NULL, NULL, NULL, iv);
+	EVP_EncryptUpdate(c->session_key_ctx[0], (unsigned char *) s->s, &outlen,
+			(unsigned char *) s->s, s->len);
+	assert(outlen == s->len);
+
+	return 0;
+}
+
+static int aes_cm_ctr_encrypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, uint32_t idx) {
+	return aes_cm_ctr_encrypt(c, r->ssrc, s, idx);
+}
+
+static int aes_cm_ctr_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, uint32_t idx) {
+	return aes_cm_ctr_encrypt(c, r->ssrc, s, idx);
+}
+
 /* rfc 7714 section 8 */
 
 union aes_gcm_rtp_iv {
@@ -791,45 +832,89 @@ static int aes_f8_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r,
 
 	return 0;
 }
-/* rfc 3711, sections 4.2 and 4.2.1 */
-static int hmac_sha1_rtp(struct crypto_context *c, char *out, str *in, uint32_t index) {
-	unsigned char hmac[20];
-	uint32_t roc;
-
-	roc = htonl((index & 0xffffffff0000ULL) >> 16);
+/* The HMAC context is keyed once per session key, which runs the key through the
+ * inner and outer pads. Re-initialising it without a key for each packet then only
+ * restores the precomputed state. */
+static void *hmac_sha1_keyed_ctx(struct crypto_context *c, unsigned int key_len) {
+	if (G_LIKELY(c->session_auth_ctx))
+		return c->session_auth_ctx;
 
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
-	EVP_MAC_CTX *hc;
+	EVP_MAC_CTX *hc = EVP_MAC_CTX_dup(rtpe_hmac_sha1_base);
+	if (!hc)
+		return NULL;
+	EVP_MAC_init(hc, (unsigned char *) c->session_auth_key, key_len, NULL);
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+	HMAC_CTX *hc = HMAC_CTX_new();
+	if (!hc)
+		return NULL;
+	HMAC_Init_ex(hc, c->session_auth_key, key_len, EVP_sha1(), NULL);
+#else
+	HMAC_CTX *hc = g_slice_alloc(sizeof(HMAC_CTX));
+	HMAC_CTX_init(hc);
+	HMAC_Init_ex(hc, c->session_auth_key, key_len, EVP_sha1(), NULL);
+#endif
 
-	hc = EVP_MAC_CTX_dup(rtpe_hmac_sha1_base);
-	EVP_MAC_init(hc, (unsigned char *) c->session_auth_key,
-			c->params.crypto_suite->srtp_auth_key_len, NULL);
-	EVP_MAC_update(hc, (unsigned char *) in->s, in->len);
-	EVP_MAC_update(hc, (unsigned char *) &roc, sizeof(roc));
-	size_t outsize = sizeof(hmac);
-	EVP_MAC_final(hc, hmac, &outsize, outsize);
-	EVP_MAC_CTX_free(hc);
-#else // <3.0
-	HMAC_CTX *hc;
+	c->session_auth_ctx = hc;
+	return hc;
+}
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	hc = HMAC_CTX_new();
+static void hmac_sha1_ctx_free(struct crypto_context *c) {
+	if (!c->session_auth_ctx)
+		return;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC_CTX_free(c->session_auth_ctx);
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+	HMAC_CTX_free(c->session_auth_ctx);
 #else
-	HMAC_CTX hc_s;
-	HMAC_CTX_init(&hc_s);
-	hc = &hc_s;
+	HMAC_CTX_cleanup(c->session_auth_ctx);
+	g_slice_free1(sizeof(HMAC_CTX), c->session_auth_ctx);
 #endif
+	c->session_auth_ctx = NULL;
+}
 
-	HMAC_Init_ex(hc, c->session_auth_key, c->params.crypto_suite->srtp_auth_key_len, EVP_sha1(), NULL);
-	HMAC_Update(hc, (unsigned char *) in->s, in->len);
-	HMAC_Update(hc, (unsigned char *) &roc, sizeof(roc));
-	HMAC_Final(hc, hmac, NULL);
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	HMAC_CTX_free(hc);
+/* `roc` is optional */
+static int hmac_sha1(struct crypto_context *c, unsigned char *hmac, unsigned int key_len, str *in,
+		const uint32_t *roc)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC_CTX *hc = hmac_sha1_keyed_ctx(c, key_len);
+	if (!hc)
+		return -1;
+	if (!EVP_MAC_init(hc, NULL, 0, NULL))
+		return -1;
+	EVP_MAC_update(hc, (unsigned char *) in->s, in->len);
+	if (roc)
+		EVP_MAC_update(hc, (unsigned char *) roc, sizeof(*roc));
+	size_t outsize = 20;
+	if (!EVP_MAC_final(hc, hmac, &outsize, outsize))
+		return -1;
 #else
-	HMAC_CTX_cleanup(hc);
-#endif
+	HMAC_CTX *hc = hmac_sha1_keyed_ctx(c, key_len);
+	if (!hc)
+		return -1;
+	if (!HMAC_Init_ex(hc, NULL, 0, NULL, NULL))
+		return -1;
+	HMAC_Update(hc, (unsigned char *) in->s, in->len);
+	if (roc)
+		HMAC_Update(hc, (unsigned char *) roc, sizeof(*roc));
+	if (!HMAC_Final(hc, hmac, NULL))
+		return -1;
 #endif
+	return 0;
+}
+
+/* rfc 3711, sections 4.2 and 4.2.1 */
+static int hmac_sha1_rtp(struct crypto_context *c, char *out, str *in, uint32_t index) {
+	unsigned char hmac[20];
+	uint32_t roc;
+
+	roc = htonl((index & 0xffffffff0000ULL) >> 16);
+
+	if (hmac_sha1(c, hmac, c->params.crypto_suite->srtp_auth_key_len, in, &roc)) {
+		memset(out, 0, c->params.crypto_suite->srtp_auth_tag);
+		return 1;
+	}
 
 	assert(sizeof(hmac) >= c->params.crypto_suite->srtp_auth_tag);
 	memcpy(out, hmac, c->params.crypto_suite->srtp_auth_tag);
@@ -841,9 +926,7 @@ static int hmac_sha1_rtp(struct crypto_context *c, char *out, str *in, uint32_t
 static int hmac_sha1_rtcp(struct crypto_context *c, char *out, str *in) {
 	unsigned char hmac[20];
 
-	if (!HMAC(EVP_sha1(), c->session_auth_key, c->params.crypto_suite->srtcp_auth_key_len,
-			(unsigned char *) in->s, in->len, hmac, NULL))
-	{
+	if (hmac_sha1(c, hmac, c->params.crypto_suite->srtcp_auth_key_len, in, NULL)) {
 		memset(out, 0, c->params.crypto_suite->srtcp_auth_tag);
 		return 1;
 	}
@@ -868,6 +951,20 @@ static int aes_cm_session_key_init(struct crypto_context *c) {
 	return 0;
 }
 
+static int aes_cm_ctr_session_key_init(struct crypto_context *c) {
+	evp_session_key_cleanup(c);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	c->session_key_ctx[0] = EVP_CIPHER_CTX_new();
+#else
+	c->session_key_ctx[0] = g_slice_alloc(sizeof(EVP_CIPHER_CTX));
+	EVP_CIPHER_CTX_init(c->session_key_ctx[0]);
+#endif
+	EVP_EncryptInit_ex(c->session_key_ctx[0], c->params.crypto_suite->aes_ctr_evp, NULL,
+			(unsigned char *) c->session_key, NULL);
+	return 0;
+}
+
 static int aes_gcm_session_key_init(struct crypto_context *c) {
 	evp_session_key_cleanup(c);
 
@@ -929,6 +1026,8 @@ static int evp_session_key_cleanup(struct crypto_context *c) {
 		c->session_key_ctx[i] = NULL;
 	}
 
+	hmac_sha1_ctx_free(c);
+
 	return 0;
 }
 
@@ -992,8 +1091,21 @@ out:
 	return *buf;
 }
 
+static bool crypto_cpu_has_aes(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("aes");
+#elif defined(__aarch64__) && defined(HWCAP_AES)
+	return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+	return false;
+#endif
+}
+
 void crypto_init_main(void) {
 	struct crypto_suite *cs;
+	bool aes_hw = crypto_cpu_has_aes();
+
 	for (unsigned int i = 0; i < num_crypto_suites; i++) {
 		cs = &__crypto_suites[i];
 		cs->idx = i;
@@ -1001,14 +1113,24 @@ void crypto_init_main(void) {
 		switch(cs->master_key_len) {
 		case 16:
 			cs->aes_evp = EVP_aes_128_ecb();
+			cs->aes_ctr_evp = EVP_aes_128_ctr();
 			break;
 		case 24:
 			cs->aes_evp = EVP_aes_192_ecb();
+			cs->aes_ctr_evp = EVP_aes_192_ctr();
 			break;
 		case 32:
 			cs->aes_evp = EVP_aes_256_ecb();
+			cs->aes_ctr_evp = EVP_aes_256_ctr();
 			break;
 		}
+
+		// hardware AES makes the native CTR mode worthwhile: switch AES-CM over to it
+		if (aes_hw && cs->session_key_init == aes_cm_session_key_init) {
+			cs->encrypt_rtp = cs->decrypt_rtp = aes_cm_ctr_encrypt_rtp;
+			cs->encrypt_rtcp = cs->decrypt_rtcp = aes_cm_ctr_encrypt_rtcp;
+			cs->session_key_init = aes_cm_ctr_session_key_init;
+		}
 	}
 }
 
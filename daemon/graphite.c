@@ -92,6 +92,7 @@ GString *print_graphite_data(void) {
 	long long time_diff_us = timeval_diff(&rtpe_now, &rtpe_latest_graphite_interval_start);
 	rtpe_latest_graphite_interval_start = rtpe_now;
 
+	stats_shards_fold();
 	stats_counters_calc_diff(rtpe_stats, &rtpe_stats_graphite_intv, &rtpe_stats_graphite_diff);
 	stats_rate_min_max_avg_sample(&rtpe_rate_graphite_min_max, &rtpe_rate_graphite_min_max_avg_sampled,
 			time_diff_us, &rtpe_stats_graphite_diff);
@@ -177,13 +178,13 @@ GString *print_graphite_data(void) {
 		// only show first-order interface entries: socket families must match
 		if (lif->logical->preferred_family != lif->spec->local_address.addr.family)
 			continue;
-		int num_ports = lif->spec->port_pool.max - lif->spec->port_pool.min + 1;
+		int num_ports = port_pool_size(&lif->spec->port_pool);
 		GPF("ports_free_%s_%s %i", lif->logical->name.s,
 				sockaddr_print_buf(&lif->spec->local_address.addr),
-				g_hash_table_size(lif->spec->port_pool.free_ports_ht));
+				port_pool_free_count(&lif->spec->port_pool));
 		GPF("ports_used_%s_%s %i", lif->logical->name.s,
 				sockaddr_print_buf(&lif->spec->local_address.addr),
-				num_ports - g_hash_table_size(lif->spec->port_pool.free_ports_ht));
+				num_ports - port_pool_free_count(&lif->spec->port_pool));
 	}
 
 	mutex_lock(&rtpe_codec_stats_lock);
@@ -16,6 +16,7 @@
 #include "media_socket.h"
 #include "uring.h"
 #include "poller.h"
+#include "codeclib.h"
 
 #if 0
 #define BSDB(x...) fprintf(stderr, x)
@@ -202,6 +203,7 @@ static void thread_detach_cleanup(void *dtp) {
 	if (rtpe_config.common.io_uring)
 		uring_thread_cleanup();
 #endif
+	codec_pools_thread_cleanup();
 	thread_join_me();
 }
 
@@ -259,6 +261,7 @@ static void *thread_detach_func(void *d) {
 	if (rtpe_config.common.io_uring)
 		uring_thread_init();
 #endif
+	uring_sendmsg_batch_init(rtpe_config.send_batch_size);
 
 	thread_cleanup_push(thread_detach_cleanup, dt);
 	dt->func(dt->data);
@@ -60,7 +60,7 @@ static void reset_jitter_buffer(struct jitter_buffer *jb) {
 	jb->prev_seq            = 0;
 
 	jb->num_resets++;
-	if(g_tree_nnodes(jb->ttq.entries) > 0)
+	if(timerthread_queue_len(&jb->ttq) > 0)
 		jitter_buffer_flush(jb);
 
 	//disable jitter buffer in case of more than 2 resets
@@ -125,7 +125,7 @@ static struct jb_packet* get_jb_packet(struct media_packet *mp, const str *s) {
 
 // jb is locked
 static void check_buffered_packets(struct jitter_buffer *jb) {
-	if (g_tree_nnodes(jb->ttq.entries) >= (3* rtpe_config.jb_length)) {
+	if (timerthread_queue_len(&jb->ttq) >= (3* rtpe_config.jb_length)) {
 		ilog(LOG_DEBUG, "Jitter reset due to buffer overflow");
 		reset_jitter_buffer(jb);
 	}
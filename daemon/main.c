@@ -60,6 +60,7 @@
 #include "bufferpool.h"
 #include "log_funcs.h"
 #include "uring.h"
+#include "poller_load.h"
 
 
 
@@ -98,6 +99,7 @@ struct rtpengine_config rtpe_config = {
 	.redis_allowed_errors = -1,
 	.redis_disable_time = 10,
 	.redis_connect_timeout = 1000,
+	.redis_write_delay = 50,
 	.media_num_threads = -1,
 	.dtls_rsa_key_size = 2048,
 	.dtls_mtu = 1200, // chrome default mtu
@@ -118,6 +120,8 @@ struct rtpengine_config rtpe_config = {
 		},
 	},
 	.max_recv_iters = MAX_RECV_ITERS,
+	.recv_batch_size = 1,
+	.send_batch_size = 1,
 	.kernel_player_media = 128,
 };
 
@@ -525,6 +529,8 @@ static void options(int *argc, char ***argv) {
 	g_autoptr(char) nftables_family = NULL;
 #endif
 	g_autoptr(char) redis_format = NULL;
+	g_autoptr(char) timer_backend = NULL;
+	g_autoptr(char) poller_assignment = NULL;
 
 	GOptionEntry e[] = {
 		{ "table",	't', 0, G_OPTION_ARG_INT,	&rtpe_config.kernel_table,		"Kernel table to use",		"INT"		},
@@ -553,6 +559,7 @@ static void options(int *argc, char ***argv) {
 		{ "tos",	'T', 0, G_OPTION_ARG_INT,	&rtpe_config.default_tos,		"Default TOS value to set on streams",	"INT"		},
 		{ "control-tos",0 , 0, G_OPTION_ARG_INT,	&rtpe_config.control_tos,		"Default TOS value to set on control-ng",	"INT"		},
 		{ "control-pmtu", 0,0,	G_OPTION_ARG_STRING,	&control_pmtu,	"Path MTU discovery behaviour on UDP control sockets",	"want|dont"		},
+		{ "cookie-cache-size",0,0,G_OPTION_ARG_INT,	&rtpe_config.cookie_cache_size,"Max size in MB of the cache of control replies","INT"},
 		{ "timeout",	'o', 0, G_OPTION_ARG_INT,	&rtpe_config.timeout,	"RTP timeout",			"SECS"		},
 		{ "silent-timeout",'s',0,G_OPTION_ARG_INT,	&rtpe_config.silent_timeout,"RTP timeout for muted",	"SECS"		},
 		{ "final-timeout",'a',0,G_OPTION_ARG_INT,	&rtpe_config.final_timeout,	"Call timeout",			"SECS"		},
@@ -568,7 +575,10 @@ static void options(int *argc, char ***argv) {
 		{ "redis-disable-time", 0, 0, G_OPTION_ARG_INT, &rtpe_config.redis_disable_time, "Number of seconds redis communication is disabled because of errors", "INT" },
 		{ "redis-cmd-timeout", 0, 0, G_OPTION_ARG_INT, &rtpe_config.redis_cmd_timeout, "Sets a timeout in milliseconds for redis commands", "INT" },
 		{ "redis-connect-timeout", 0, 0, G_OPTION_ARG_INT, &rtpe_config.redis_connect_timeout, "Sets a timeout in milliseconds for redis connections", "INT" },
-		{ "redis-format", 0, 0,	G_OPTION_ARG_STRING, &redis_format,		"Format for persistent storage in Redis/KeyDB", "native|bencode|JSON" },
+		{ "redis-write-threads", 0, 0, G_OPTION_ARG_INT, &rtpe_config.redis_write_threads, "Number of threads writing call updates to Redis in the background", "INT" },
+		{ "redis-write-delay", 0, 0, G_OPTION_ARG_INT, &rtpe_config.redis_write_delay, "Delay in milliseconds to coalesce background Redis call updates", "INT" },
+		{ "redis-delta", 0, 0,	G_OPTION_ARG_NONE, &rtpe_config.redis_delta,	"Store calls in Redis as hashes and only write changed parts", NULL },
+		{ "redis-format", 0, 0,	G_OPTION_ARG_STRING, &redis_format,		"Format for persistent storage in Redis/KeyDB", "native|bencode|JSON|binary" },
 #if 0
 		// temporarily disabled, see discussion on https://github.com/sipwise/rtpengine/commit/2ebf5a1526c1ce8093b3011a1e23c333b3f99400
 		// related to Change-Id: I83d9b9a844f4f494ad37b44f5d1312f272beff3f
@@ -653,6 +663,10 @@ static void options(int *argc, char ***argv) {
 		{ "silence-detect",0,0,	G_OPTION_ARG_DOUBLE,	&silence_detect,	"Audio level threshold in percent for silence detection","FLOAT"},
 		{ "cn-payload",0,0,	G_OPTION_ARG_STRING_ARRAY,&cn_payload,		"Comfort noise parameters to replace silence with","INT INT INT ..."},
 		{ "player-cache",0,0,	G_OPTION_ARG_NONE,	&rtpe_config.player_cache,"Cache media files for playback in memory",NULL},
+		{ "player-cache-size",0,0,G_OPTION_ARG_INT,	&rtpe_config.player_cache_size,"Max size in MB of the media player cache","INT"},
+		{ "player-cache-mmap",0,0,G_OPTION_ARG_NONE,	&rtpe_config.player_cache_mmap,"Keep cached media in one mapping per file",NULL},
+		{ "player-cache-preload",0,0,G_OPTION_ARG_STRING_ARRAY,&rtpe_config.player_cache_preload,"Media file to encode into the player cache at startup","FILE"},
+		{ "player-cache-preload-codec",0,0,G_OPTION_ARG_STRING_ARRAY,&rtpe_config.player_cache_preload_codecs,"Output codec to preload media files for","CODEC"},
 		{ "kernel-player",0,0,	G_OPTION_ARG_INT,	&rtpe_config.kernel_player,"Max number of kernel media player streams","INT"},
 		{ "kernel-player-media",0,0,G_OPTION_ARG_INT,	&rtpe_config.kernel_player_media,"Max number of kernel media files","INT"},
 		{ "audio-buffer-length",0,0,	G_OPTION_ARG_INT,&rtpe_config.audio_buffer_length,"Length in milliseconds of audio buffer","INT"},
@@ -684,6 +698,11 @@ static void options(int *argc, char ***argv) {
 		{ "janus-secret", 0,0,	G_OPTION_ARG_STRING,	&rtpe_config.janus_secret,"Admin secret for Janus protocol","STRING"},
 		{ "rtcp-interval", 0,0,	G_OPTION_ARG_INT,	&rtpe_config.rtcp_interval,"Delay in milliseconds between RTCP packets when generate-rtcp flag is on, where random dispersion < 1 sec is added on top","INT"},
 		{ "max-recv-iters", 0, 0, G_OPTION_ARG_INT,    &rtpe_config.max_recv_iters,  "Maximum continuous reading cycles in UDP poller loop.", "INT"},
+		{ "recv-batch-size", 0, 0, G_OPTION_ARG_INT,	&rtpe_config.recv_batch_size,	"Maximum number of packets to receive per system call from a media socket", "INT"},
+		{ "send-batch-size", 0, 0, G_OPTION_ARG_INT,	&rtpe_config.send_batch_size,	"Maximum number of outgoing packets to collect per thread before sending", "INT"},
+		{ "timer-backend", 0, 0, G_OPTION_ARG_STRING,	&timer_backend,	"Data structure used for scheduling timer threads", "tree|wheel"},
+		{ "poller-assignment", 0, 0, G_OPTION_ARG_STRING,	&poller_assignment,	"How new calls are distributed across media pollers", "round-robin|load"},
+		{ "poller-rebalance-interval", 0, 0, G_OPTION_ARG_INT,	&rtpe_config.poller_rebalance_interval,	"Seconds between attempts to even out load across media pollers", "SECS"},
 		{ "vsc-start-rec",0,0,	G_OPTION_ARG_STRING,	&rtpe_config.vsc_start_rec.s,"DTMF VSC to start recording.", "STRING"},
 		{ "vsc-stop-rec",0,0,	G_OPTION_ARG_STRING,	&rtpe_config.vsc_stop_rec.s,"DTMF VSC to stop recording.", "STRING"},
 		{ "vsc-start-stop-rec",0,0,G_OPTION_ARG_STRING,	&rtpe_config.vsc_start_stop_rec.s,"DTMF VSC to start/stop recording.", "STRING"},
@@ -803,6 +822,8 @@ static void options(int *argc, char ***argv) {
 			rtpe_config.redis_format = REDIS_FORMAT_BENCODE;
 		else if (!strcasecmp(redis_format, "JSON"))
 			rtpe_config.redis_format = REDIS_FORMAT_JSON;
+		else if (!strcasecmp(redis_format, "binary"))
+			rtpe_config.redis_format = REDIS_FORMAT_BINARY;
 		else
 			die("Invalid --redis-format value given");
 	}
@@ -851,6 +872,13 @@ static void options(int *argc, char ***argv) {
 	if (rtpe_config.max_recv_iters < 1)
 		die("Invalid max-recv-iters value");
 
+	if (rtpe_config.recv_batch_size < 1 || rtpe_config.recv_batch_size > MAX_SOCKET_BATCH)
+		die("Invalid recv-batch-size value (must be between 1 and %i)", MAX_SOCKET_BATCH);
+	if (rtpe_config.send_batch_size < 1 || rtpe_config.send_batch_size > MAX_SOCKET_BATCH)
+		die("Invalid send-batch-size value (must be between 1 and %i)", MAX_SOCKET_BATCH);
+	if (rtpe_config.poller_rebalance_interval < 0)
+		die("Invalid poller-rebalance-interval value");
+
 	if (rtpe_config.timeout <= 0)
 		rtpe_config.timeout = 60;
 
@@ -1057,6 +1085,24 @@ static void options(int *argc, char ***argv) {
 			die("Invalid --mos option ('%s')", mos);
 	}
 
+	if (timer_backend) {
+		if (!strcasecmp(timer_backend, "tree"))
+			rtpe_config.timer_backend = TT_BACKEND_TREE;
+		else if (!strcasecmp(timer_backend, "wheel"))
+			rtpe_config.timer_backend = TT_BACKEND_WHEEL;
+		else
+			die("Invalid --timer-backend option ('%s')", timer_backend);
+	}
+
+	if (poller_assignment) {
+		if (!strcasecmp(poller_assignment, "round-robin"))
+			rtpe_config.poller_assignment = PA_ROUND_ROBIN;
+		else if (!strcasecmp(poller_assignment, "load"))
+			rtpe_config.poller_assignment = PA_LOAD;
+		else
+			die("Invalid --poller-assignment option ('%s')", poller_assignment);
+	}
+
 	if (dcc) {
 		if (!strcasecmp(dcc, "rsa"))
 			rtpe_config.dtls_cert_cipher = DCC_RSA;
@@ -1213,8 +1259,10 @@ static void clib_init(void) {
 	if (rtpe_config.common.io_uring)
 		uring_thread_init();
 #endif
+	uring_sendmsg_batch_init(rtpe_config.send_batch_size);
 }
 static void clib_cleanup(void) {
+	codec_pools_thread_cleanup();
 	bufferpool_destroy(media_bufferpool);
 #ifdef HAVE_LIBURING
 	if (rtpe_config.common.io_uring)
@@ -1344,6 +1392,7 @@ static void create_everything(void) {
 			die("poller creation failed");
 	}
 	rtpe_control_poller = rtpe_pollers[num_rtpe_pollers - 1];
+	poller_load_init();
 
 	if (call_init())
 		abort();
@@ -1468,6 +1517,16 @@ static void uring_poller_loop(void *ptr) {
 }
 #endif
 
+static void media_poller_loop(void *p) {
+	poller_load_thread_init(p);
+#ifdef HAVE_LIBURING
+	if (rtpe_config.common.io_uring)
+		uring_poller_loop(p);
+	else
+#endif
+		poller_loop(p);
+}
+
 
 int main(int argc, char **argv) {
 	early_init();
@@ -1496,6 +1555,11 @@ int main(int argc, char **argv) {
 	thread_create_looper(call_timer, rtpe_config.idle_scheduling,
 			rtpe_config.idle_priority, "kill calls", 1000000);
 
+	/* per-poller load sampling and call migration */
+	if (rtpe_poller_load)
+		thread_create_looper(poller_load_updater, rtpe_config.idle_scheduling,
+				rtpe_config.idle_priority, "poller load", 1000000);
+
 	/* thread to refresh DTLS certificate */
 	dtls_timer();
 
@@ -1507,6 +1571,8 @@ int main(int argc, char **argv) {
 
 	do_redis_restore();
 
+	redis_wb_launch();
+
 	if (graphite_is_enabled())
 		thread_create_detach(graphite_loop, NULL, "graphite");
 
@@ -1522,11 +1588,7 @@ int main(int argc, char **argv) {
 	service_notify("READY=1\n");
 
 	for (unsigned int idx = 0; idx < num_poller_threads; ++idx)
-		thread_create_detach_prio(
-#ifdef HAVE_LIBURING
-				rtpe_config.common.io_uring ? uring_poller_loop :
-#endif
-				poller_loop,
+		thread_create_detach_prio(media_poller_loop,
 				rtpe_pollers[idx % num_rtpe_pollers],
 				rtpe_config.scheduling, rtpe_config.priority,
 				idx < rtpe_config.num_threads ? "poller" : "cpoller");
@@ -1548,6 +1610,8 @@ int main(int argc, char **argv) {
 
 	websocket_stop();
 
+	redis_wb_stop();
+
 	if (!is_addr_unspecified(&rtpe_config.redis_ep.address) && initial_rtpe_config.redis_delete_async)
 		redis_async_event_base_action(rtpe_redis_write, EVENT_BASE_LOOPBREAK);
 
@@ -1568,6 +1632,7 @@ int main(int argc, char **argv) {
 
 	unfill_initial_rtpe_cfg(&initial_rtpe_config);
 
+	redis_wb_free();
 	call_free();
 
 	jitter_buffer_init_free();
@@ -1594,6 +1659,7 @@ int main(int argc, char **argv) {
 	release_listeners(&rtpe_tcp);
 	release_listeners(&rtpe_control_ng);
 	release_listeners(&rtpe_control_ng_tcp);
+	poller_load_free();
 	for (unsigned int idx = 0; idx < num_rtpe_pollers; ++idx)
 #ifdef HAVE_LIBURING
 		if (rtpe_config.common.io_uring)
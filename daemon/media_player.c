@@ -1,6 +1,7 @@
 #include "media_player.h"
 
 #include <glib.h>
+#include <sys/mman.h>
 #ifdef WITH_TRANSCODING
 #include <mysql.h>
 #include <mysql/errmsg.h>
@@ -24,6 +25,7 @@
 #include "kernel.h"
 #include "bufferpool.h"
 #include "uring.h"
+#include "statistics.h"
 
 #define DEFAULT_AVIO_BUFSIZE 4096
 
@@ -65,6 +67,15 @@ struct media_player_cache_entry {
 	struct media_player_coder coder; // de/encoder data
 
 	char *info_str; // for logging
+
+	// protected by media_player_cache_lock:
+	struct media_player_cache_index *key;
+	GList lru_link; // in media_player_cache_lru
+	unsigned int readers; // players plus decoder thread. not evicted while in use
+
+	size_t size; // bytes held, for the cache size limit
+	char *arena; // packet data in one read-only mapping, once finished, if enabled
+	size_t arena_size;
 };
 struct media_player_cache_packet {
 	char *buf;
@@ -75,9 +86,11 @@ struct media_player_cache_packet {
 };
 
 static mutex_t media_player_cache_lock;
-static GHashTable *media_player_cache; // keys and values only ever freed at shutdown
+static GHashTable *media_player_cache;
+static GQueue media_player_cache_lru; // most recently used first
 
 static bool media_player_read_packet(struct media_player *mp);
+static void media_player_cache_entry_put(struct media_player_cache_entry *entry);
 #endif
 
 static struct timerthread send_timer_thread;
@@ -145,6 +158,8 @@ static void media_player_shutdown(struct media_player *mp) {
 		mutex_unlock(&mp->cache_entry->lock);
 	}
 
+	media_player_cache_entry_put(mp->cache_entry);
+
 	mp->cache_index.type = MP_OTHER;
 	if (mp->cache_index.file.s)
 		g_free(mp->cache_index.file.s);
@@ -318,8 +333,8 @@ static bool __send_timer_send_1(struct rtp_header *rh, struct packet_stream *sin
 
 	atomic64_inc_na(&sink->stats_out->packets);
 	atomic64_add_na(&sink->stats_out->bytes, cp->s.len);
-	atomic64_inc_na(&sink_fd->local_intf->stats->out.packets);
-	atomic64_add_na(&sink_fd->local_intf->stats->out.bytes, cp->s.len);
+	INTF_STATS_SHARD_INC(sink_fd->local_intf, out, packets);
+	INTF_STATS_SHARD_ADD(sink_fd->local_intf, out, bytes, cp->s.len);
 
 	log_info_pop();
 
@@ -480,14 +495,15 @@ retry:;
 
 	mp->cache_read_idx++;
 
-	if (!finished)
-		mutex_unlock(&entry->lock);
-
-	// make a copy to send out
+	// make a copy to send out. while unfinished, the packet data may still be moved
+	// into the arena, so keep holding the lock until done
 	size_t len = pkt->s.len + sizeof(struct rtp_header) + RTP_BUFFER_TAIL_ROOM;
 	char *buf = bufferpool_alloc(media_bufferpool, len);
 	memcpy(buf, pkt->buf, len);
 
+	if (!finished)
+		mutex_unlock(&entry->lock);
+
 	struct media_packet packet = {
 		.tv = rtpe_now,
 		.call = mp->call,
@@ -611,54 +627,29 @@ static void cache_packet_free(struct media_player_cache_packet *p) {
 }
 
 
-// returns: true = entry exists, decoding handled separately, use entry for playback
-//          false = no entry exists, OR entry is a new one, proceed to open decoder, then call _play_start
-static bool media_player_cache_get_entry(struct media_player *mp,
-		const rtp_payload_type *dst_pt, str_case_value_ht codec_set)
+// creates a new cache entry and adds it to the cache, with one reader held for the caller
+// must hold media_player_cache_lock
+static struct media_player_cache_entry *media_player_cache_entry_new(
+		const struct media_player_cache_index *lookup)
 {
-	if (!rtpe_config.player_cache)
-		return false;
-	if (mp->cache_index.type <= 0)
-		return false;
-	if (!dst_pt)
-		return false;
-
-	struct media_player_cache_index lookup;
-	lookup.index = mp->cache_index;
-	lookup.dst_pt = *dst_pt;
-
-	mutex_lock(&media_player_cache_lock);
-	struct media_player_cache_entry *entry = mp->cache_entry
-		= g_hash_table_lookup(media_player_cache, &lookup);
-
-	bool ret = true; // entry exists, use cached data
-	if (entry) {
-		media_player_cached_reader_start(mp, codec_set);
-		goto out;
-	}
-
-	ret = false; // new entry, open decoder, then call media_player_play_start
-
-	// initialise object
-
 	struct media_player_cache_index *ins_key = g_slice_alloc(sizeof(*ins_key));
-	*ins_key = lookup;
-	ins_key->index.file = str_dup_str(&lookup.index.file);
+	*ins_key = *lookup;
+	ins_key->index.file = str_dup_str(&lookup->index.file);
 	codec_init_payload_type(&ins_key->dst_pt, MT_UNKNOWN); // duplicate contents
 
-	entry = mp->cache_entry = g_slice_alloc0(sizeof(*entry));
+	struct media_player_cache_entry *entry = g_slice_alloc0(sizeof(*entry));
 	mutex_init(&entry->lock);
 	cond_init(&entry->cond);
 	entry->packets = cache_packet_arr_new_sized(64);
 	entry->wait_queue = media_player_ht_new();
 
-	switch (lookup.index.type) {
+	switch (lookup->index.type) {
 		case MP_DB:
-			entry->info_str = g_strdup_printf("DB media file #%llu", lookup.index.db_id);
+			entry->info_str = g_strdup_printf("DB media file #%llu", lookup->index.db_id);
 			break;
 		case MP_FILE:
 			entry->info_str = g_strdup_printf("media file '" STR_FORMAT "'",
-					STR_FMT(&lookup.index.file));
+					STR_FMT(&lookup->index.file));
 			break;
 		case MP_BLOB:
 			entry->info_str = g_strdup_printf("binary media blob");
@@ -667,6 +658,11 @@ static bool media_player_cache_get_entry(struct media_player *mp,
 	}
 
 	g_hash_table_insert(media_player_cache, ins_key, entry);
+	entry->key = ins_key;
+	entry->readers = 1;
+	entry->lru_link.data = entry;
+	g_queue_push_head_link(&media_player_cache_lru, &entry->lru_link);
+	atomic64_inc(&rtpe_stats_gauge.player_cache_entries);
 
 	entry->kernel_idx = -1;
 	if (kernel.use_player) {
@@ -677,6 +673,41 @@ static bool media_player_cache_get_entry(struct media_player *mp,
 			ilog(LOG_DEBUG, "Using kernel packet stream index %i", entry->kernel_idx);
 	}
 
+	return entry;
+}
+
+// returns: true = entry exists, decoding handled separately, use entry for playback
+//          false = no entry exists, OR entry is a new one, proceed to open decoder, then call _play_start
+static bool media_player_cache_get_entry(struct media_player *mp,
+		const rtp_payload_type *dst_pt, str_case_value_ht codec_set)
+{
+	if (!rtpe_config.player_cache)
+		return false;
+	if (mp->cache_index.type <= 0)
+		return false;
+	if (!dst_pt)
+		return false;
+
+	struct media_player_cache_index lookup;
+	lookup.index = mp->cache_index;
+	lookup.dst_pt = *dst_pt;
+
+	mutex_lock(&media_player_cache_lock);
+	struct media_player_cache_entry *entry = mp->cache_entry
+		= g_hash_table_lookup(media_player_cache, &lookup);
+
+	bool ret = true; // entry exists, use cached data
+	if (entry) {
+		entry->readers++;
+		g_queue_unlink(&media_player_cache_lru, &entry->lru_link);
+		g_queue_push_head_link(&media_player_cache_lru, &entry->lru_link);
+		media_player_cached_reader_start(mp, codec_set);
+		goto out;
+	}
+
+	ret = false; // new entry, open decoder, then call media_player_play_start
+	mp->cache_entry = media_player_cache_entry_new(&lookup);
+
 out:
 	mutex_unlock(&media_player_cache_lock);
 
@@ -701,6 +732,77 @@ static void media_player_cache_packet(struct media_player_cache_entry *entry, ch
 	entry->coder.handler->handler_func(entry->coder.handler, &packet);
 }
 
+// moves all packet data into one contiguous read-only mapping
+// must hold entry->lock, before `finished` is set
+static void media_player_cache_entry_map(struct media_player_cache_entry *entry) {
+	size_t len = 0;
+	for (unsigned int i = 0; i < entry->packets->len; i++) {
+		struct media_player_cache_packet *pkt = entry->packets->pdata[i];
+		len += pkt->s.len + sizeof(struct rtp_header) + RTP_BUFFER_TAIL_ROOM;
+	}
+	if (!len)
+		return;
+
+	char *arena = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (arena == MAP_FAILED) {
+		ilog(LOG_WARN, "Failed to map %zu bytes for %s: %s", len, entry->info_str, strerror(errno));
+		return;
+	}
+
+	size_t pos = 0;
+	for (unsigned int i = 0; i < entry->packets->len; i++) {
+		struct media_player_cache_packet *pkt = entry->packets->pdata[i];
+		size_t pkt_len = pkt->s.len + sizeof(struct rtp_header) + RTP_BUFFER_TAIL_ROOM;
+		memcpy(arena + pos, pkt->buf, pkt_len);
+		pkt->s.s = arena + pos + (pkt->s.s - pkt->buf);
+		bufferpool_unref(pkt->buf);
+		pkt->buf = arena + pos;
+		pos += pkt_len;
+	}
+
+	mprotect(arena, len, PROT_READ);
+
+	entry->arena = arena;
+	entry->arena_size = len;
+
+	size_t size = entry->packets->len * sizeof(struct media_player_cache_packet) + len;
+	atomic64_add(&rtpe_stats_gauge.player_cache_size, size - entry->size);
+	entry->size = size;
+
+	ilog(LOG_DEBUG, "Mapped %u packets (%zu bytes) for %s", entry->packets->len, len, entry->info_str);
+}
+
+// drops least recently used entries that aren't in use until below the size limit
+// must hold media_player_cache_lock
+static void media_player_cache_evict(void) {
+	if (rtpe_config.player_cache_size <= 0)
+		return;
+
+	uint64_t limit = (uint64_t) rtpe_config.player_cache_size << 20;
+
+	for (GList *l = media_player_cache_lru.tail; l; ) {
+		if (atomic64_get(&rtpe_stats_gauge.player_cache_size) <= limit)
+			break;
+		struct media_player_cache_entry *entry = l->data;
+		l = l->prev;
+		if (entry->readers)
+			continue;
+		ilog(LOG_DEBUG, "Evicting %s (%zu bytes) from player cache", entry->info_str, entry->size);
+		g_queue_unlink(&media_player_cache_lru, &entry->lru_link);
+		g_hash_table_remove(media_player_cache, entry->key);
+	}
+}
+
+static void media_player_cache_entry_put(struct media_player_cache_entry *entry) {
+	if (!entry)
+		return;
+	mutex_lock(&media_player_cache_lock);
+	entry->readers--;
+	if (!entry->readers)
+		media_player_cache_evict();
+	mutex_unlock(&media_player_cache_lock);
+}
+
 static void media_player_cache_entry_decoder_thread(void *p) {
 	struct media_player_cache_entry *entry = p;
 
@@ -727,6 +829,8 @@ static void media_player_cache_entry_decoder_thread(void *p) {
 	ilog(LOG_DEBUG, "Decoder thread for %s finished", entry->info_str);
 
 	mutex_lock(&entry->lock);
+	if (rtpe_config.player_cache_mmap)
+		media_player_cache_entry_map(entry);
 	entry->finished = true;
 	cond_broadcast(&entry->cond);
 
@@ -741,6 +845,8 @@ static void media_player_cache_entry_decoder_thread(void *p) {
 	entry->wait_queue = media_player_ht_null();
 
 	mutex_unlock(&entry->lock);
+
+	media_player_cache_entry_put(entry);
 }
 
 static void packet_encoded_cache(AVPacket *pkt, struct codec_ssrc_handler *ch, struct media_packet *mp,
@@ -761,6 +867,8 @@ static void packet_encoded_cache(AVPacket *pkt, struct codec_ssrc_handler *ch, s
 
 	mutex_lock(&entry->lock);
 	t_ptr_array_add(entry->packets, ep);
+	entry->size += sizeof(*ep) + pkt_len;
+	atomic64_add(&rtpe_stats_gauge.player_cache_size, sizeof(*ep) + pkt_len);
 
 	if (entry->kernel_idx != -1) {
 		ilog(LOG_DEBUG, "Adding media packet (length %zu, TS %" PRIu64 ", delay %lu ms) to kernel packet stream %i",
@@ -806,6 +914,10 @@ static bool media_player_cache_entry_init(struct media_player *mp, const rtp_pay
 
 	entry->coder.handler->packet_encoded = media_player_packet_cache;
 
+	mutex_lock(&media_player_cache_lock);
+	entry->readers++; // released by decoder thread
+	mutex_unlock(&media_player_cache_lock);
+
 	// use low priority (10 nice)
 	thread_create_detach_prio(media_player_cache_entry_decoder_thread, entry, NULL, 10, "mp decoder");
 
@@ -815,6 +927,188 @@ static bool media_player_cache_entry_init(struct media_player *mp, const rtp_pay
 }
 
 
+struct media_player_preload_job {
+	char *file;
+	const rtp_payload_type *dst_pt;
+};
+
+static mutex_t media_player_preload_lock = MUTEX_STATIC_INIT;
+static GQueue media_player_preload_jobs = G_QUEUE_INIT;
+static GPtrArray *media_player_preload_pts; // output codecs, referenced by jobs and cache keys
+static GPtrArray *media_player_preload_arenas; // fake calls holding payload type strings, one per worker
+
+static void media_player_preload_arena_free(void *p) {
+	call_t *c = p;
+	call_buffer_free(&c->buffer);
+}
+static call_t *media_player_preload_arena_new(void) {
+	call_t *c = obj_alloc0("call", sizeof(*c), media_player_preload_arena_free);
+	call_buffer_init(&c->buffer);
+	g_ptr_array_add(media_player_preload_arenas, c);
+	return c;
+}
+
+// decodes and encodes one file for one output codec into the cache, in the calling thread
+static void media_player_preload_one(struct media_player_preload_job *job) {
+	struct media_player_cache_index lookup = {
+		.index = {
+			.type = MP_FILE,
+			.file = STR(job->file),
+		},
+		.dst_pt = *job->dst_pt,
+	};
+
+	mutex_lock(&media_player_cache_lock);
+	bool exists = g_hash_table_lookup(media_player_cache, &lookup) != NULL;
+	mutex_unlock(&media_player_cache_lock);
+	if (exists)
+		return;
+
+	struct media_player_coder coder = {0};
+
+	int ret = avformat_open_input(&coder.fmtctx, job->file, NULL, NULL);
+	if (ret < 0) {
+		ilog(LOG_ERR, "Failed to open media file '%s' for preloading: %s", job->file, av_error(ret));
+		return;
+	}
+	avformat_find_stream_info(coder.fmtctx, NULL);
+	if (!coder.fmtctx->nb_streams || !(coder.avstream = coder.fmtctx->streams[0])) {
+		ilog(LOG_ERR, "No AVStream present in media file '%s'", job->file);
+		goto err;
+	}
+
+	// synthesise rtp payload type, same as __ensure_codec_handler
+	rtp_payload_type src_pt = { .payload_type = -1 };
+	src_pt.codec_def = codec_find_by_av(coder.avstream->CODECPAR->codec_id);
+	if (!src_pt.codec_def) {
+		ilog(LOG_ERR, "Unsupported file format/codec in media file '%s'", job->file);
+		goto err;
+	}
+	src_pt.encoding = src_pt.codec_def->rtpname_str;
+	src_pt.channels = GET_CHANNELS(coder.avstream->CODECPAR);
+	src_pt.clock_rate = coder.avstream->CODECPAR->sample_rate;
+	codec_init_payload_type(&src_pt, MT_AUDIO);
+
+	coder.handler = codec_handler_make_playback(&src_pt, job->dst_pt, 0, NULL, ssl_random(),
+			str_case_value_ht_null());
+	payload_type_clear(&src_pt);
+	if (!coder.handler)
+		goto err;
+	coder.handler->packet_encoded = media_player_packet_cache;
+	coder.pkt = av_packet_alloc();
+	coder.duration = coder.avstream->duration * 1000 * coder.avstream->time_base.num
+		/ coder.avstream->time_base.den;
+
+	mutex_lock(&media_player_cache_lock);
+	if (g_hash_table_lookup(media_player_cache, &lookup)) {
+		// lost a race against a player
+		mutex_unlock(&media_player_cache_lock);
+		goto err;
+	}
+	struct media_player_cache_entry *entry = media_player_cache_entry_new(&lookup);
+	entry->coder = coder;
+	mutex_unlock(&media_player_cache_lock);
+
+	ilog(LOG_DEBUG, "Preloading %s for " STR_FORMAT, entry->info_str,
+			STR_FMT(&job->dst_pt->encoding_with_full_params));
+
+	// releases our reader reference when done
+	media_player_cache_entry_decoder_thread(entry);
+	return;
+
+err:
+	media_player_coder_shutdown(&coder);
+	av_packet_free(&coder.pkt);
+}
+
+static void media_player_preload_job_free(struct media_player_preload_job *job) {
+	g_free(job->file);
+	g_slice_free1(sizeof(*job), job);
+}
+
+static void media_player_preload_worker(void *p) {
+	call_memory_arena_set(p);
+
+	while (true) {
+		thread_cancel_enable();
+		pthread_testcancel();
+		thread_cancel_disable();
+
+		mutex_lock(&media_player_preload_lock);
+		struct media_player_preload_job *job = g_queue_pop_head(&media_player_preload_jobs);
+		mutex_unlock(&media_player_preload_lock);
+		if (!job)
+			break;
+
+		media_player_preload_one(job);
+
+		media_player_preload_job_free(job);
+		atomic64_dec(&rtpe_stats_gauge.player_preload_pending);
+	}
+
+	call_memory_arena_release();
+}
+
+// queues up all configured files for all configured output codecs and starts
+// a pool of low priority workers to encode them into the cache
+static void media_player_preload_start(void) {
+	if (!media_player_cache)
+		return;
+	if (!rtpe_config.player_cache_preload || !rtpe_config.player_cache_preload[0])
+		return;
+	if (!rtpe_config.player_cache_preload_codecs || !rtpe_config.player_cache_preload_codecs[0]) {
+		ilog(LOG_WARN, "Player cache preload files given, but no codecs to preload them for");
+		return;
+	}
+
+	media_player_preload_pts = g_ptr_array_new_with_free_func((GDestroyNotify) payload_type_free);
+	media_player_preload_arenas = g_ptr_array_new();
+
+	// parse codecs once, into an arena that outlives all workers
+	call_memory_arena_set(media_player_preload_arena_new());
+
+	for (char **c = rtpe_config.player_cache_preload_codecs; *c; c++) {
+		str codec = STR(*c);
+		rtp_payload_type *pt = codec_make_payload_type(&codec, MT_AUDIO);
+		if (!pt)
+			continue;
+		if (!pt->codec_def || !pt->codec_def->support_encoding || pt->codec_def->supplemental) {
+			ilog(LOG_WARN, "Unable to preload media for unsupported codec '%s'", *c);
+			payload_type_free(pt);
+			continue;
+		}
+		g_ptr_array_add(media_player_preload_pts, pt);
+	}
+
+	for (char **f = rtpe_config.player_cache_preload; *f; f++) {
+		for (unsigned int i = 0; i < media_player_preload_pts->len; i++) {
+			struct media_player_preload_job *job = g_slice_alloc(sizeof(*job));
+			job->file = g_strdup(*f);
+			job->dst_pt = media_player_preload_pts->pdata[i];
+			g_queue_push_tail(&media_player_preload_jobs, job);
+		}
+	}
+
+	call_memory_arena_release();
+
+	unsigned int num = media_player_preload_jobs.length;
+	if (!num)
+		return;
+	atomic64_set(&rtpe_stats_gauge.player_preload_pending, num);
+
+	unsigned int num_threads = num_cpu_cores(4);
+	if (num_threads > num)
+		num_threads = num;
+
+	ilog(LOG_INFO, "Preloading %u media file and codec combinations into player cache using %u threads",
+			num, num_threads);
+
+	for (unsigned int i = 0; i < num_threads; i++)
+		thread_create_detach_prio(media_player_preload_worker, media_player_preload_arena_new(),
+				NULL, 10, "mp preload");
+}
+
+
 
 // find suitable output payload type
 static rtp_payload_type *media_player_get_dst_pt(struct media_player *mp) {
@@ -1499,6 +1793,16 @@ static void media_player_cache_index_free(void *p) {
 }
 static void media_player_cache_entry_free(void *p) {
 	struct media_player_cache_entry *e = p;
+	if (e->arena) {
+		// packet data isn't owned by the packets
+		for (unsigned int i = 0; i < e->packets->len; i++) {
+			struct media_player_cache_packet *pkt = e->packets->pdata[i];
+			pkt->buf = NULL;
+		}
+		munmap(e->arena, e->arena_size);
+	}
+	atomic64_add(&rtpe_stats_gauge.player_cache_size, -e->size);
+	atomic64_dec(&rtpe_stats_gauge.player_cache_entries);
 	t_ptr_array_free(e->packets, true);
 	mutex_destroy(&e->lock);
 	g_free(e->info_str);
@@ -1550,6 +1854,20 @@ void media_player_free(void) {
 		mutex_destroy(&media_player_cache_lock);
 		g_hash_table_destroy(media_player_cache);
 	}
+
+	// cache keys are gone, so the preload codecs and their strings can go too
+	struct media_player_preload_job *job;
+	while ((job = g_queue_pop_head(&media_player_preload_jobs)))
+		media_player_preload_job_free(job);
+	if (media_player_preload_pts)
+		g_ptr_array_free(media_player_preload_pts, true);
+	if (media_player_preload_arenas) {
+		for (unsigned int i = 0; i < media_player_preload_arenas->len; i++) {
+			call_t *c = media_player_preload_arenas->pdata[i];
+			obj_put(c);
+		}
+		g_ptr_array_free(media_player_preload_arenas, true);
+	}
 #endif
 	timerthread_free(&send_timer_thread);
 }
@@ -1558,6 +1876,7 @@ void media_player_free(void) {
 void media_player_launch(void) {
 #ifdef WITH_TRANSCODING
 	timerthread_launch(&media_player_thread, rtpe_config.scheduling, rtpe_config.priority, "media player");
+	media_player_preload_start();
 #endif
 }
 void send_timer_launch(void) {
@@ -63,6 +63,7 @@ struct packet_handler_ctx {
 
 	sink_handler_q *sinks; // where to send output packets to (forward destination)
 	rewrite_func decrypt_func, encrypt_func; // handlers for decrypt/encrypt
+	str srtp_raw, srtp_payload; // original packet for SRTP pass-through sinks, if also decrypted
 	rtcp_filter_func *rtcp_filter;
 	struct packet_stream *in_srtp, *out_srtp; // SRTP contexts for decrypt/encrypt (relevant for muxed RTCP)
 	int payload_type; // -1 if unknown or not RTP
@@ -448,7 +449,7 @@ static int has_free_ports_loc(struct local_intf *loc, unsigned int num_ports) {
 		return 0;
 	}
 
-	if (num_ports > g_hash_table_size(loc->spec->port_pool.free_ports_ht)) {
+	if (num_ports > port_pool_free_count(&loc->spec->port_pool)) {
 		ilog(LOG_ERR, "Didn't find %d ports available for " STR_FORMAT "/%s",
 			num_ports, STR_FMT(&loc->logical->name),
 			sockaddr_print_buf(&loc->spec->local_address.addr));
@@ -458,7 +459,7 @@ static int has_free_ports_loc(struct local_intf *loc, unsigned int num_ports) {
 	__C_DBG("Found %d ports available for " STR_FORMAT "/%s from total of %d free ports",
 		num_ports, STR_FMT(&loc->logical->name),
 		sockaddr_print_buf(&loc->spec->local_address.addr),
-		g_hash_table_size(loc->spec->port_pool.free_ports_ht));
+		port_pool_free_count(&loc->spec->port_pool));
 
 	return 1;
 }
@@ -676,74 +677,14 @@ int is_local_endpoint(const struct intf_address *addr, unsigned int port) {
 	return 0;
 }
 
-/**
- * This function just (globally) reserves a port number, it doesn't provide any binding/unbinding.
- */
-static void reserve_port(GQueue * free_ports_q, GHashTable * free_ports_ht,
-		GList * value_looked_up, unsigned int port) {
-
-		g_queue_delete_link(free_ports_q, value_looked_up);
-		g_hash_table_remove(free_ports_ht, GUINT_TO_POINTER(port));
-}
-/**
- * This function just releases reserved port number, it doesn't provide any binding/unbinding.
- */
-static void release_reserved_port(GQueue * free_ports_q, GHashTable * free_ports_ht,
-		unsigned int port) {
-
-		g_queue_push_tail(free_ports_q, GUINT_TO_POINTER(port));
-		GList * l = free_ports_q->tail;
-		g_hash_table_replace(free_ports_ht, GUINT_TO_POINTER(port), l);
-}
-/* Append a list of free ports within the min-max range */
-static void __append_free_ports_to_int(struct intf_spec *spec) {
-	unsigned int ports_amount, count;
-
-	GQueue * free_ports_q = &spec->port_pool.free_ports_q;
-	GHashTable ** free_ports_ht = &spec->port_pool.free_ports_ht;
-
-	if (!*free_ports_ht)
-		*free_ports_ht = g_hash_table_new(g_direct_hash, g_direct_equal);
-
-	if (spec->port_pool.max < spec->port_pool.min) {
+/* Set up the pool of free ports within the min-max range */
+static void __init_port_pool(struct intf_spec *spec, unsigned int min, unsigned int max) {
+	if (max < min) {
 		ilog(LOG_WARNING, "Ports range: max value cannot be less than min");
 		return;
 	}
-
-	/* range of possible ports */
-	ports_amount = spec->port_pool.max - spec->port_pool.min + 1;
-	count = ports_amount;
-
-	if (ports_amount == 0) {
-		ilog(LOG_WARNING, "Ports range: there must be at least 1 port in the range");
-		return;
-	}
-
-	int port_values[ports_amount];
-
-	/* create an array to store the initial values within the range */
-	for (int i = 0; i < ports_amount; i++)
-		port_values[i] = spec->port_pool.min + i;
-
-	/* generate N random numbers within the given range without duplicates,
-	 * using the rolling dice algorithm */
-	for (int i = 0; i < ports_amount; i++)
-	{
-		int j = ssl_random() % count;
-		int value = port_values[j];
-
-		mutex_lock(&spec->port_pool.free_list_lock);
-		g_queue_push_tail(free_ports_q, GUINT_TO_POINTER(value));
-		/* store this new GList as value into the hash table */
-		GList * l = free_ports_q->tail;
-		/* The value retrieved from the hash table would then point
-		 * into the queue for quick removal */
-		g_hash_table_replace(*free_ports_ht, GUINT_TO_POINTER(value), l);
-		mutex_unlock(&spec->port_pool.free_list_lock);
-
-		port_values[j] = port_values[count - 1];
-		count--;
-	}
+	if (!port_pool_init(&spec->port_pool, min, max))
+		ilog(LOG_WARNING, "Ports range: invalid range %u - %u", min, max);
 }
 // called during single-threaded startup only
 static void __add_intf_rr_1(struct logical_intf *lif, str *name_base, sockfamily_t *fam) {
@@ -824,13 +765,9 @@ static void __interface_append(struct intf_config *ifa, sockfamily_t *fam, bool
 	if (!spec) {
 		spec = g_slice_alloc0(sizeof(*spec));
 		spec->local_address = ifa->local_address;
-		spec->port_pool.min = ifa->port_min;
-		spec->port_pool.max = ifa->port_max;
-
-		mutex_init(&spec->port_pool.free_list_lock);
 
 		/* pre-fill the range of used ports */
-		__append_free_ports_to_int(spec);
+		__init_port_pool(spec, ifa->port_min, ifa->port_max);
 
 		g_hash_table_insert(__intf_spec_addr_type_hash, &spec->local_address, spec);
 	}
@@ -843,6 +780,7 @@ static void __interface_append(struct intf_config *ifa, sockfamily_t *fam, bool
 	ifc->stats = bufferpool_alloc0(shm_bufferpool, sizeof(*ifc->stats));
 
 	g_queue_push_tail(&all_local_interfaces, ifc);
+	ifc->stats_idx = all_local_interfaces.length;
 
 	__insert_local_intf_addr_type(&spec->local_address, ifc);
 	__insert_local_intf_addr_type(&ifc->advertised_address, ifc);
@@ -885,27 +823,14 @@ void interfaces_init(intf_config_q *interfaces) {
 }
 
 void interfaces_exclude_port(unsigned int port) {
-	GList *vals, *l, *ll;
+	GList *vals, *l;
 	struct intf_spec *spec;
 
-	struct port_pool *pp;
-	GQueue * free_ports_q;
-	GHashTable * free_ports_ht;
-
 	vals = g_hash_table_get_values(__intf_spec_addr_type_hash);
 
 	for (l = vals; l; l = l->next) {
 		spec = l->data;
-
-		pp = &spec->port_pool;
-		free_ports_q = &pp->free_ports_q;
-		free_ports_ht = pp->free_ports_ht;
-
-		mutex_lock(&pp->free_list_lock);
-		ll = g_hash_table_lookup(free_ports_ht, GUINT_TO_POINTER(port));
-		if (ll)
-			reserve_port(free_ports_q, free_ports_ht, ll, port);
-		mutex_unlock(&pp->free_list_lock);
+		port_pool_reserve(&spec->port_pool, port);
 	}
 
 	g_list_free(vals);
@@ -985,10 +910,6 @@ static void free_port(socket_t *r, struct intf_spec *spec) {
  */
 static void release_port_now(socket_t *r, struct intf_spec *spec) {
 	unsigned int port = r->local.port;
-	struct port_pool *pp = &spec->port_pool;
-
-	GQueue * free_ports_q = &pp->free_ports_q;
-	GHashTable * free_ports_ht = pp->free_ports_ht;
 
 	__C_DBG("Trying to release the port '%u'", port);
 
@@ -998,9 +919,7 @@ static void release_port_now(socket_t *r, struct intf_spec *spec) {
 		iptables_del_rule(r);
 
 		/* first return the engaged port back */
-		mutex_lock(&pp->free_list_lock);
-		release_reserved_port(free_ports_q, free_ports_ht, port);
-		mutex_unlock(&pp->free_list_lock);
+		port_pool_release(&spec->port_pool, port);
 	} else {
 		ilog(LOG_WARNING, "Unable to close the socket for port '%u'", port);
 	}
@@ -1051,13 +970,13 @@ void append_thread_lpr_to_glob_lpr(void) {
 int __get_consecutive_ports(socket_q *out, unsigned int num_ports, unsigned int wanted_start_port,
 		struct intf_spec *spec, const str *label)
 {
-	unsigned int allocation_attempts = 0, available_ports = 0, additional_port = 0, port = 0;
+	unsigned int allocation_attempts = 0, available_ports = 0, port = 0, contention = 0;
 	socket_t * sk;
-	GQueue ports_to_engage = G_QUEUE_INIT;		/* usually it's only one RTCP port, theoretically can be more */
+	struct timeval alloc_start, alloc_stop;
 
 	struct port_pool * pp = &spec->port_pool;	/* port pool for a given local interface */
-	GQueue * free_ports_q;
-	GHashTable * free_ports_ht;
+
+	gettimeofday(&alloc_start, NULL);
 
 	if (num_ports == 0) {
 		ilog(LOG_ERR, "Number of ports to be engaged is '%d', can't handle it like that",
@@ -1071,11 +990,8 @@ int __get_consecutive_ports(socket_q *out, unsigned int num_ports, unsigned int
 		goto fail;
 	}
 
-	free_ports_q = &pp->free_ports_q;
-	free_ports_ht = pp->free_ports_ht;
-
-	/* a presence of free lists data is critical for us */
-	if (!(free_ports_q && free_ports_q->head) || !free_ports_ht) {
+	/* a presence of the pool is critical for us */
+	if (!pp->ring_len) {
 		ilog(LOG_ERR, "Failure while trying to get a list of free ports");
 		goto fail;
 	}
@@ -1083,24 +999,15 @@ int __get_consecutive_ports(socket_q *out, unsigned int num_ports, unsigned int
 	/* specifically requested port */
 	if (wanted_start_port > 0) {
 		ilog(LOG_DEBUG, "A specific port value is requested, wanted_start_port: '%d'", wanted_start_port);
-		mutex_lock(&pp->free_list_lock);
-		GList *l = g_hash_table_lookup(free_ports_ht, GUINT_TO_POINTER(wanted_start_port));
-		if (!l) {
+		if (!port_pool_reserve(pp, wanted_start_port)) {
 			/* if engaged already, just select any other (so default logic) */
 			ilog(LOG_WARN, "This requested port has been already engaged, can't take it.");
-			wanted_start_port = 0; /* take what is proposed by FIFO instead */
-		} else {
-			/* we got the port, and we are sure it wasn't engaged */
-			reserve_port(free_ports_q, free_ports_ht, l, wanted_start_port);
-			port = wanted_start_port;
+			wanted_start_port = 0; /* take what is proposed by the pool instead */
 		}
-		mutex_unlock(&pp->free_list_lock);
 	}
 
 	/* make sure we have ports to be used */
-	mutex_lock(&pp->free_list_lock);
-	available_ports = g_queue_get_length(free_ports_q);
-	mutex_unlock(&pp->free_list_lock);
+	available_ports = port_pool_free_count(pp);
 
 	if (!available_ports && wanted_start_port == 0) {
 		ilog(LOG_ERR, "Empty ports queue, no more ports left to use");
@@ -1124,97 +1031,40 @@ int __get_consecutive_ports(socket_q *out, unsigned int num_ports, unsigned int
 	 */
 	while (1)
 	{
-new_cycle:
 		if (++allocation_attempts > available_ports) {
 			ilog(LOG_ERR, "Failure while trying to bind a port to the socket");
 			goto fail;
 		}
 
-		if (!wanted_start_port) {
+		if (wanted_start_port)
+			port = wanted_start_port;
+		else {
 			/* For cases with no rtcp-mux: RTP must be an even port,
-			 * and RTCP port is always the next one to that.
+			 * and RTCP port is always the next one to that. The pool
+			 * hands out all of them in one go.
 			 */
-
-			/* Now only get first possible port for RTP.
-			 * Then additionally make sure that the RTCP port can also be engaged, if needed.
-			 */
-			mutex_lock(&pp->free_list_lock);
-			port = GPOINTER_TO_UINT(g_queue_pop_head(free_ports_q)); /* RTP */
-
+			port = port_pool_get(pp, num_ports, &contention);
 			if (!port) {
-				mutex_unlock(&pp->free_list_lock);
 				ilog(LOG_ERR, "Failure while trying to get a port from the list");
 				goto fail;
 			}
-			g_hash_table_remove(free_ports_ht, GUINT_TO_POINTER(port)); /* RTP */
-			mutex_unlock(&pp->free_list_lock);
-
-			/* ports for RTP must be even, if there is an additional port for RTCP */
-			if (num_ports > 1 && (port & 1)) {
-				/* return port for RTP back and try again */
-				mutex_lock(&pp->free_list_lock);
-				release_reserved_port(free_ports_q, free_ports_ht, port);
-				mutex_unlock(&pp->free_list_lock);
-				goto new_cycle;
-			}
-
-			/* find additional ports, usually it's only RTCP */
-			additional_port = port;
-			for (int i = 1; i < num_ports; i++)
-			{
-				additional_port++;
-
-				mutex_lock(&pp->free_list_lock);
-				GList *l = g_hash_table_lookup(free_ports_ht, GUINT_TO_POINTER(additional_port));
-
-				if (!l) {
-					/* return port for RTP back and try again */
-					release_reserved_port(free_ports_q, free_ports_ht, port);
-					mutex_unlock(&pp->free_list_lock);
-
-					/* check if we managed to enagage anything in previous for-cycles */
-					while ((additional_port = GPOINTER_TO_UINT(g_queue_pop_head(&ports_to_engage))))
-					{
-						mutex_lock(&pp->free_list_lock);
-						/* return additional ports back */
-						release_reserved_port(free_ports_q, free_ports_ht, additional_port);
-						mutex_unlock(&pp->free_list_lock);
-					}
-					goto new_cycle;
-
-				} else {
-					/* engage this port right away */
-					reserve_port(free_ports_q, free_ports_ht, l, additional_port);
-					mutex_unlock(&pp->free_list_lock);
-
-					/* track for which additional ports, we have to open sockets */
-					g_queue_push_tail(&ports_to_engage, GUINT_TO_POINTER(additional_port));
-				}
-			}
 		}
 
 		ilog(LOG_DEBUG, "Trying to bind the socket for RTP/RTCP ports (allocation attempt = '%d')",
 				allocation_attempts);
 
-		/* at this point we consider all things before as successfull. Now just add the RTP port */
-		g_queue_push_head(&ports_to_engage, GUINT_TO_POINTER(port));
-
-		while ((port = GPOINTER_TO_UINT(g_queue_pop_head(&ports_to_engage))))
+		for (unsigned int i = 0; i < num_ports; i++)
 		{
-			ilog(LOG_DEBUG, "Trying to bind the socket for port = '%d'", port);
+			ilog(LOG_DEBUG, "Trying to bind the socket for port = '%d'", port + i);
 			sk = g_slice_alloc0(sizeof(*sk));
 			sk->fd = -1;
 			t_queue_push_tail(out, sk);
 
 			/* if not possible to engage this socket, try to reallocate it again */
-			if (add_socket(sk, port, spec, label)) {
-				/* if something has been left in the `ports_to_engage` queue, release it right away */
-				while ((port = GPOINTER_TO_UINT(g_queue_pop_head(&ports_to_engage))))
-				{
-					mutex_lock(&pp->free_list_lock);
-					release_reserved_port(free_ports_q, free_ports_ht, port);
-					mutex_unlock(&pp->free_list_lock);
-				}
+			if (add_socket(sk, port + i, spec, label)) {
+				/* release the remaining ones right away */
+				for (unsigned int j = i + 1; j < num_ports; j++)
+					port_pool_release(pp, port + j);
 				/* ports which are already bound to a socket, will be freed by `free_port()` */
 				goto release_restart;
 			}
@@ -1236,11 +1086,17 @@ release_restart:
 	}
 
 	/* success */
+	gettimeofday(&alloc_stop, NULL);
+	RTPE_STATS_INC(port_allocs);
+	RTPE_STATS_ADD(port_alloc_time, timeval_diff(&alloc_stop, &alloc_start));
+	RTPE_STATS_ADD(port_alloc_contention, contention);
+
 	ilog(LOG_DEBUG, "Opened a socket on port '%u' (on interface '%s') for a media relay",
 		((socket_t *) out->head->data)->local.port, sockaddr_print_buf(&spec->local_address.addr));
 	return 0;
 
 fail:
+	RTPE_STATS_ADD(port_alloc_contention, contention);
 	ilog(LOG_ERR, "Failed to get %u consecutive ports on interface %s for media relay (last error: %s)",
 			num_ports, sockaddr_print_buf(&spec->local_address.addr), strerror(errno));
 	return -1;
@@ -1670,6 +1526,28 @@ static void kernelize_one_sink_handler(struct rtpengine_target_info *reti, GQueu
 	if (err)
 		ilog(LOG_WARNING, "No support for kernel packet forwarding available (%s)", err);
 }
+// The kernel module decrypts once for all outputs, so it can't have SRTP pass-through
+// outputs alongside outputs that need the packet decrypted. RTP and RTCP are decrypted
+// separately, so each list is checked on its own.
+static bool __sinks_list_mixed_decrypt(struct packet_stream *stream, sink_handler_q *sinks, bool rtcp) {
+	bool first = true, decrypt = false;
+
+	for (__auto_type l = sinks->head; l; l = l->next) {
+		const struct streamhandler *sh = __determine_handler(stream, l->data);
+		bool d = (rtcp ? sh->in->rtcp_crypt : sh->in->rtp_crypt) != NULL;
+		if (first) {
+			decrypt = d;
+			first = false;
+		}
+		else if (d != decrypt)
+			return true;
+	}
+	return false;
+}
+static bool __sinks_mixed_decrypt(struct packet_stream *stream) {
+	return __sinks_list_mixed_decrypt(stream, &stream->rtp_sinks, false)
+		|| __sinks_list_mixed_decrypt(stream, &stream->rtcp_sinks, true);
+}
 /* called with in_lock held */
 void kernelize(struct packet_stream *stream) {
 	call_t *call = stream->call;
@@ -1694,6 +1572,8 @@ void kernelize(struct packet_stream *stream) {
 		goto no_kernel;
 	if (!stream->endpoint.address.family)
 		goto no_kernel;
+	if (__sinks_mixed_decrypt(stream))
+		goto no_kernel;
 
 	struct rtpengine_target_info reti;
 	ZERO(reti); // reti.local.family determines if anything can be done
@@ -1915,8 +1795,6 @@ static const struct streamhandler *__determine_handler(struct packet_stream *in,
 		must_recrypt = true;
 	else if (in->call->recording)
 		must_recrypt = true;
-	else if (in->rtp_sinks.length > 1 || in->rtcp_sinks.length > 1) // need a proper decrypter?
-		must_recrypt = true;
 	else if (in_proto->srtp && out_proto && out_proto->srtp
 			&& in->selected_sfd && out && out->selected_sfd
 			&& (crypto_params_cmp(&in->crypto.params, &out->selected_sfd->crypto.params)
@@ -2170,8 +2048,8 @@ static void media_packet_rtp_in(struct packet_handler_ctx *phc)
 					phc->payload_type,
 					FMT_M(endpoint_print_buf(&phc->mp.fsin)));
 			atomic64_inc_na(&phc->mp.stream->stats_in->errors);
-			atomic64_inc_na(&phc->mp.sfd->local_intf->stats->in.errors);
-			RTPE_STATS_INC(errors_user);
+			INTF_STATS_SHARD_INC(phc->mp.sfd->local_intf, in, errors);
+			RTPE_STATS_SHARD_INC(errors_user);
 		}
 		else {
 			atomic64_inc(&rtp_s->packets);
@@ -2213,20 +2091,46 @@ static void media_packet_rtp_out(struct packet_handler_ctx *phc, struct sink_han
 static int media_packet_decrypt(struct packet_handler_ctx *phc)
 {
 	mutex_lock(&phc->in_srtp->in_lock);
-	struct sink_handler *first_sh = phc->sinks->length ? phc->sinks->head->data : NULL;
-	const struct streamhandler *sh = __determine_handler(phc->in_srtp, first_sh);
 
-	// XXX use an array with index instead of if/else
-	if (G_LIKELY(!phc->rtcp))
-		phc->decrypt_func = sh->in->rtp_crypt;
-	else
-		phc->decrypt_func = sh->in->rtcp_crypt;
+	// The packet is decrypted once for all sinks that need it. Sinks using the same
+	// SRTP context as the input (pass-through) get the packet as it was received,
+	// with its original auth tag, so keep a copy if both kinds are present.
+	const struct streamhandler *sh;
+	rewrite_func func;
+	bool passthru = false;
+
+	phc->decrypt_func = NULL;
+	if (!phc->sinks->length) {
+		sh = __determine_handler(phc->in_srtp, NULL);
+		phc->decrypt_func = phc->rtcp ? sh->in->rtcp_crypt : sh->in->rtp_crypt;
+	}
+	for (__auto_type l = phc->sinks->head; l; l = l->next) {
+		sh = __determine_handler(phc->in_srtp, l->data);
+		// XXX use an array with index instead of if/else
+		if (G_LIKELY(!phc->rtcp))
+			func = sh->in->rtp_crypt;
+		else
+			func = sh->in->rtcp_crypt;
+		if (func)
+			phc->decrypt_func = func;
+		else
+			passthru = true;
+	}
 
 	/* return values are: 0 = forward packet, -1 = error/don't forward,
 	 * 1 = forward and push update to redis */
 	int ret = 0;
 	if (phc->decrypt_func) {
 		str ori_s = phc->s;
+		if (passthru && !phc->srtp_raw.s) {
+			phc->srtp_raw = STR_LEN(bufferpool_alloc(media_bufferpool,
+						ori_s.len + RTP_BUFFER_TAIL_ROOM), ori_s.len);
+			memcpy(phc->srtp_raw.s, ori_s.s, ori_s.len);
+			// not set for RTCP or if the RTP header couldn't be parsed
+			if (phc->mp.payload.s)
+				phc->srtp_payload = STR_LEN(phc->srtp_raw.s + (phc->mp.payload.s - ori_s.s),
+						phc->mp.payload.len);
+		}
 		ret = phc->decrypt_func(&phc->s, phc->in_srtp, phc->mp.ssrc_in);
 		// XXX for stripped auth tag and duplicate invocations of rtp_payload
 		// XXX transcoder uses phc->mp.payload
@@ -2373,7 +2277,7 @@ static bool media_packet_address_check(struct packet_handler_ctx *phc)
 					FMT_M(sockaddr_print_buf(&ps_endpoint->address),
 					ps_endpoint->port));
 				atomic64_inc_na(&phc->mp.stream->stats_in->errors);
-				atomic64_inc_na(&phc->mp.sfd->local_intf->stats->in.errors);
+				INTF_STATS_SHARD_INC(phc->mp.sfd->local_intf, in, errors);
 				ret = true;
 			}
 		}
@@ -2729,11 +2633,11 @@ static int stream_packet(struct packet_handler_ctx *phc) {
 		}
 	}
 	atomic64_add_na(&phc->mp.stream->stats_in->bytes, phc->s.len);
-	atomic64_inc_na(&phc->mp.sfd->local_intf->stats->in.packets);
-	atomic64_add_na(&phc->mp.sfd->local_intf->stats->in.bytes, phc->s.len);
+	INTF_STATS_SHARD_INC(phc->mp.sfd->local_intf, in, packets);
+	INTF_STATS_SHARD_ADD(phc->mp.sfd->local_intf, in, bytes, phc->s.len);
 	atomic64_set(&phc->mp.stream->last_packet, rtpe_now.tv_sec);
-	RTPE_STATS_INC(packets_user);
-	RTPE_STATS_ADD(bytes_user, phc->s.len);
+	RTPE_STATS_SHARD_INC(packets_user);
+	RTPE_STATS_SHARD_ADD(bytes_user, phc->s.len);
 
 	///////////////// EGRESS HANDLING
 
@@ -2794,14 +2698,33 @@ static int stream_packet(struct packet_handler_ctx *phc) {
 		media_packet_set_encrypt(phc, sh);
 
 		if (phc->rtcp) {
-			if (do_rtcp_output(phc))
+			// SRTCP pass-through sink: hand over the packet as received
+			str plain_raw = phc->mp.raw;
+			if (phc->srtp_raw.s && !sh->handler->in->rtcp_crypt)
+				phc->mp.raw = phc->srtp_raw;
+			int rtcp_ret = do_rtcp_output(phc);
+			phc->mp.raw = plain_raw;
+			if (rtcp_ret)
 				goto err_next;
 		}
 		else {
 			struct codec_handler *transcoder = codec_handler_get(phc->mp.media, phc->payload_type,
 					phc->mp.media_out, sh);
+			// SRTP pass-through sink: hand over the packet as received
+			str plain_raw = phc->mp.raw, plain_payload = phc->mp.payload;
+			struct rtp_header *plain_rtp = phc->mp.rtp;
+			if (phc->srtp_raw.s && !sh->handler->in->rtp_crypt) {
+				phc->mp.raw = phc->srtp_raw;
+				phc->mp.payload = phc->srtp_payload;
+				if (plain_rtp)
+					phc->mp.rtp = (void *) phc->srtp_raw.s;
+			}
 			// this transfers the packet from 's' to 'packets_out'
-			if (transcoder->handler_func(transcoder, &phc->mp))
+			int tc_ret = transcoder->handler_func(transcoder, &phc->mp);
+			phc->mp.raw = plain_raw;
+			phc->mp.payload = plain_payload;
+			phc->mp.rtp = plain_rtp;
+			if (tc_ret)
 				goto err_next;
 		}
 
@@ -2888,8 +2811,8 @@ err_next:
 		ilog(LOG_DEBUG | LOG_FLAG_LIMIT ,"Error when sending message. Error: %s", strerror(errno));
 		atomic64_inc_na(&sink->stats_in->errors);
 		if (sink->selected_sfd)
-			atomic64_inc_na(&sink->selected_sfd->local_intf->stats->out.errors);
-		RTPE_STATS_INC(errors_user);
+			INTF_STATS_SHARD_INC(sink->selected_sfd->local_intf, out, errors);
+		RTPE_STATS_SHARD_INC(errors_user);
 		goto next;
 
 next:
@@ -2939,8 +2862,8 @@ out:
 
 	if (handler_ret < 0) {
 		atomic64_inc_na(&phc->mp.stream->stats_in->errors);
-		atomic64_inc_na(&phc->mp.sfd->local_intf->stats->in.errors);
-		RTPE_STATS_INC(errors_user);
+		INTF_STATS_SHARD_INC(phc->mp.sfd->local_intf, in, errors);
+		RTPE_STATS_SHARD_INC(errors_user);
 	}
 
 	rwlock_unlock_r(&phc->mp.call->master_lock);
@@ -2951,6 +2874,8 @@ out:
 	ssrc_ctx_put(&phc->mp.ssrc_in);
 	rtcp_list_free(&phc->rtcp_list);
 	g_queue_clear_full(&free_list, bufferpool_unref);
+	if (phc->srtp_raw.s)
+		bufferpool_unref(phc->srtp_raw.s);
 
 	return ret;
 }
@@ -2959,6 +2884,8 @@ out:
 static void __stream_fd_readable(struct packet_handler_ctx *phc) {
 	struct stream_fd *sfd = phc->mp.sfd;
 
+	poller_load_packets(1);
+
 	if (phc->mp.tv.tv_sec < 0) {
 		// kernel-handled RTCP
 		phc->kernel_handled = true;
@@ -2984,6 +2911,75 @@ static void __stream_fd_readable(struct packet_handler_ctx *phc) {
 		ilog(LOG_WARNING | LOG_FLAG_LIMIT, "Write error on media socket: %s", strerror(-ret));
 }
 
+// Receives up to `recv-batch-size` packets with a single system call while holding
+// the call lock once, then feeds them into the packet handler one by one.
+// Returns the number of packets received, 0 if the socket was drained, or -1 if
+// the socket was closed.
+static int stream_fd_readable_batch(stream_fd *sfd, int fd, call_t *ca, bool *update) {
+	unsigned int num = rtpe_config.recv_batch_size;
+	char *bufs[MAX_SOCKET_BATCH];
+	void *data[MAX_SOCKET_BATCH];
+	size_t lens[MAX_SOCKET_BATCH];
+	endpoint_t eps[MAX_SOCKET_BATCH];
+	struct timeval tvs[MAX_SOCKET_BATCH];
+	int ret;
+
+	for (unsigned int i = 0; i < num; i++) {
+		bufs[i] = bufferpool_alloc(media_bufferpool, RTP_BUFFER_SIZE);
+		data[i] = bufs[i] + RTP_BUFFER_HEAD_ROOM;
+	}
+
+	if (ca) {
+		rwlock_lock_r(&ca->master_lock);
+		if (sfd->socket.fd != fd) {
+			rwlock_unlock_r(&ca->master_lock);
+			ret = -1;
+			goto out;
+		}
+	}
+
+	do
+		ret = socket_recvmmsg_ts(&sfd->socket, data, MAX_RTP_PACKET_SIZE, num, lens, eps, tvs);
+	while (ret < 0 && errno == EINTR);
+
+	if (ca)
+		rwlock_unlock_r(&ca->master_lock);
+
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			ret = 0;
+			goto out;
+		}
+		stream_fd_closed(fd, sfd);
+		ret = -1;
+		goto out;
+	}
+
+	RTPE_STATS_INC(recv_batches);
+	RTPE_STATS_ADD(recv_batch_packets, ret);
+
+	for (int i = 0; i < ret; i++) {
+		if (lens[i] >= MAX_RTP_PACKET_SIZE)
+			ilog(LOG_WARNING | LOG_FLAG_LIMIT, "UDP packet possibly truncated");
+
+		struct packet_handler_ctx phc;
+		ZERO(phc);
+		phc.mp.sfd = sfd;
+		phc.mp.fsin = eps[i];
+		phc.mp.tv = tvs[i];
+		phc.s = STR_LEN(data[i], lens[i]);
+
+		__stream_fd_readable(&phc);
+
+		*update |= phc.update;
+	}
+
+out:
+	for (unsigned int i = 0; i < num; i++)
+		bufferpool_unref(bufs[i]);
+	return ret;
+}
+
 static void stream_fd_readable(int fd, void *p) {
 	stream_fd *sfd = p;
 	int ret, iters;
@@ -3024,6 +3020,16 @@ restart:
 		}
 #endif
 
+		if (rtpe_config.recv_batch_size > 1) {
+			ret = stream_fd_readable_batch(sfd, fd, ca, &update);
+			if (ret < 0)
+				goto done;
+			if (ret == 0)
+				break;
+			iters += ret - 1; // count packets, not batches
+			continue;
+		}
+
 		struct packet_handler_ctx phc;
 		ZERO(phc);
 		phc.mp.sfd = sfd;
@@ -3123,6 +3129,15 @@ static void stream_fd_free(void *p) {
 	obj_put(f->call);
 }
 
+static void stream_fd_poller_item(stream_fd *sfd, struct poller_item *pi) {
+	ZERO(*pi);
+	pi->fd = sfd->socket.fd;
+	pi->obj = &sfd->obj;
+	pi->readable = stream_fd_readable;
+	pi->recv = stream_fd_recv;
+	pi->closed = stream_fd_closed;
+}
+
 stream_fd *stream_fd_new(socket_t *fd, call_t *call, struct local_intf *lif) {
 	stream_fd *sfd;
 	struct poller_item pi;
@@ -3137,12 +3152,7 @@ stream_fd *stream_fd_new(socket_t *fd, call_t *call, struct local_intf *lif) {
 
 	__C_DBG("stream_fd_new localport=%d", sfd->socket.local.port);
 
-	ZERO(pi);
-	pi.fd = sfd->socket.fd;
-	pi.obj = &sfd->obj;
-	pi.readable = stream_fd_readable;
-	pi.recv = stream_fd_recv;
-	pi.closed = stream_fd_closed;
+	stream_fd_poller_item(sfd, &pi);
 
 	if (sfd->socket.fd != -1) {
 		struct poller *p = call->poller;
@@ -3167,6 +3177,37 @@ stream_fd *stream_fd_lookup(const endpoint_t *ep) {
 	return ret;
 }
 
+static void stream_fd_migrate_keep(void *p) {
+	// socket stays open, to be added to the new poller
+}
+
+/**
+ * Moves the socket over to another poller. Requires the call's master_lock held in W mode,
+ * so that it can't be released at the same time. An event that the old poller has already
+ * picked up may still be processed after this returns, but stream_fd_readable() makes sure
+ * that only one thread at a time reads from the socket, so nothing is lost or reordered.
+ */
+bool stream_fd_migrate(stream_fd *sfd, struct poller *p) {
+	struct poller_item pi;
+
+	if (sfd->socket.fd == -1 || !sfd->poller || sfd->poller == p)
+		return false;
+
+	if (!rtpe_poller_del_item_callback(sfd->poller, sfd->socket.fd, stream_fd_migrate_keep, NULL))
+		return false;
+
+	stream_fd_poller_item(sfd, &pi);
+	if (!rtpe_poller_add_item(p, &pi)) {
+		ilog(LOG_ERR, "Failed to add stream_fd to new poller");
+		if (!rtpe_poller_add_item(sfd->poller, &pi))
+			sfd->poller = NULL;
+		return false;
+	}
+	sfd->poller = p;
+
+	return true;
+}
+
 void stream_fd_release(stream_fd *sfd) {
 	if (!sfd)
 		return;
@@ -3237,12 +3278,7 @@ void interfaces_free(void) {
 	ll = g_hash_table_get_values(__intf_spec_addr_type_hash);
 	for (GList *l = ll; l; l = l->next) {
 		struct intf_spec *spec = l->data;
-		struct port_pool *pp = &spec->port_pool;
-		if (pp->free_ports_ht) {
-			g_hash_table_destroy(pp->free_ports_ht);
-		}
-		g_queue_clear(&pp->free_ports_q);
-		mutex_destroy(&pp->free_list_lock);
+		port_pool_cleanup(&spec->port_pool);
 		g_slice_free1(sizeof(*spec), spec);
 	}
 	g_list_free(ll);
@@ -0,0 +1,203 @@
+#include "poller_load.h"
+#include <pthread.h>
+#include <glib.h>
+#include "main.h"
+#include "call.h"
+
+
+// minimum spread of CPU usage between pollers before calls are moved (15% of a core)
+#define REBALANCE_THRESHOLD_PPM 150000
+// assumed cost of a new call before anything is known about it
+#define MIN_CALL_PPM 1000
+
+struct poller_load *rtpe_poller_load;
+__thread struct poller_load *poller_thread_load;
+
+static uint64_t last_sample_us;
+static unsigned int rebalance_countdown;
+
+
+static uint64_t __clock_us(clockid_t clock) {
+	struct timespec ts;
+	if (clock_gettime(clock, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct poller_load *__load_for(struct poller *p) {
+	if (!rtpe_poller_load || !p)
+		return NULL;
+	for (unsigned int i = 0; i < num_media_pollers; i++) {
+		if (rtpe_poller_load[i].poller == p)
+			return &rtpe_poller_load[i];
+	}
+	return NULL;
+}
+
+
+void poller_load_init(void) {
+	// with a single shared poller there's nothing to compare, and several threads would
+	// be counting into the same entry
+	if (!rtpe_config.poller_per_thread || num_media_pollers < 2)
+		return;
+
+	rtpe_poller_load = g_new0(struct poller_load, num_media_pollers);
+	for (unsigned int i = 0; i < num_media_pollers; i++)
+		rtpe_poller_load[i].poller = rtpe_pollers[i];
+}
+
+void poller_load_free(void) {
+	g_free(rtpe_poller_load);
+	rtpe_poller_load = NULL;
+}
+
+void poller_load_thread_init(struct poller *p) {
+	struct poller_load *pl = __load_for(p);
+	if (!pl)
+		return;
+	poller_thread_load = pl;
+	if (!pthread_getcpuclockid(pthread_self(), &pl->clock))
+		__atomic_store_n(&pl->have_clock, true, __ATOMIC_RELEASE);
+}
+
+bool poller_load_can_migrate(void) {
+	// io_uring has no synchronous removal of a socket: cancelled receives are reported as
+	// closed sockets, which would tear down the call
+	return rtpe_poller_load && !rtpe_config.common.io_uring;
+}
+
+
+struct poller *poller_load_assign(void) {
+	if (!rtpe_poller_load)
+		return rtpe_get_poller();
+
+	struct poller_load *pl = NULL;
+
+	if (rtpe_config.poller_assignment != PA_LOAD)
+		pl = __load_for(rtpe_get_poller());
+	else {
+		uint64_t total_ppm = 0;
+		unsigned int total_calls = 0;
+		for (unsigned int i = 0; i < num_media_pollers; i++) {
+			total_ppm += atomic64_get_na(&rtpe_poller_load[i].cpu_ppm);
+			total_calls += atomic_get_na(&rtpe_poller_load[i].calls);
+		}
+		uint64_t call_ppm = total_calls ? total_ppm / total_calls : 0;
+		if (call_ppm < MIN_CALL_PPM)
+			call_ppm = MIN_CALL_PPM;
+
+		// calls placed since the last update haven't shown up in the CPU usage yet,
+		// so count them at the average cost per call
+		uint64_t best_score = 0;
+		for (unsigned int i = 0; i < num_media_pollers; i++) {
+			struct poller_load *c = &rtpe_poller_load[i];
+			uint64_t score = atomic64_get_na(&c->cpu_ppm)
+				+ atomic_get_na(&c->new_calls) * call_ppm;
+			if (pl && score > best_score)
+				continue;
+			if (pl && score == best_score) {
+				if (atomic_get_na(&c->calls) > atomic_get_na(&pl->calls))
+					continue;
+				if (atomic_get_na(&c->calls) == atomic_get_na(&pl->calls)
+						&& atomic64_get_na(&c->pps) >= atomic64_get_na(&pl->pps))
+					continue;
+			}
+			pl = c;
+			best_score = score;
+		}
+	}
+
+	__atomic_fetch_add(&pl->calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&pl->new_calls, 1, __ATOMIC_RELAXED);
+	return pl->poller;
+}
+
+void poller_load_release(struct poller *p) {
+	struct poller_load *pl = __load_for(p);
+	if (pl)
+		__atomic_fetch_sub(&pl->calls, 1, __ATOMIC_RELAXED);
+}
+
+void poller_load_migrated(struct poller *from, struct poller *to) {
+	struct poller_load *f = __load_for(from);
+	struct poller_load *t = __load_for(to);
+	if (!f || !t)
+		return;
+	__atomic_fetch_sub(&f->calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&t->calls, 1, __ATOMIC_RELAXED);
+	atomic64_inc(&f->migrations);
+}
+
+
+static void poller_load_rebalance(void) {
+	struct poller_load *busiest = NULL, *idlest = NULL;
+
+	for (unsigned int i = 0; i < num_media_pollers; i++) {
+		struct poller_load *pl = &rtpe_poller_load[i];
+		if (!busiest || atomic64_get_na(&pl->cpu_ppm) > atomic64_get_na(&busiest->cpu_ppm))
+			busiest = pl;
+		if (!idlest || atomic64_get_na(&pl->cpu_ppm) < atomic64_get_na(&idlest->cpu_ppm))
+			idlest = pl;
+	}
+
+	struct poller_rebalance rb = {
+		.interval = rtpe_config.poller_rebalance_interval,
+	};
+
+	// moving half the difference leaves both at the same level. per-call packet rates are
+	// sampled in every pass, so the calls are walked even if nothing is to be moved
+	uint64_t spread = atomic64_get_na(&busiest->cpu_ppm) - atomic64_get_na(&idlest->cpu_ppm);
+	if (spread >= REBALANCE_THRESHOLD_PPM && atomic64_get_na(&busiest->pps)) {
+		rb.from = busiest->poller;
+		rb.to = idlest->poller;
+		rb.budget_ppm = spread / 2;
+		rb.from_ppm = atomic64_get_na(&busiest->cpu_ppm);
+		rb.from_pps = atomic64_get_na(&busiest->pps);
+	}
+
+	call_poller_rebalance(&rb);
+
+	if (rb.moved)
+		ilog(LOG_INFO, "Moved %u calls between pollers to even out load", rb.moved);
+}
+
+enum thread_looper_action poller_load_updater(void) {
+	if (!rtpe_poller_load)
+		return TLA_BREAK;
+
+	uint64_t now = __clock_us(CLOCK_MONOTONIC);
+	uint64_t elapsed = now - last_sample_us;
+	bool have_rates = last_sample_us && elapsed;
+	last_sample_us = now;
+
+	for (unsigned int i = 0; i < num_media_pollers; i++) {
+		struct poller_load *pl = &rtpe_poller_load[i];
+
+		uint64_t packets = atomic64_get(&pl->packets);
+		if (have_rates)
+			atomic64_set(&pl->pps, (packets - pl->last_packets) * 1000000 / elapsed);
+		pl->last_packets = packets;
+
+		if (__atomic_load_n(&pl->have_clock, __ATOMIC_ACQUIRE)) {
+			uint64_t cpu_us = __clock_us(pl->clock);
+			if (have_rates && pl->last_cpu_us) {
+				uint64_t ppm = (cpu_us - pl->last_cpu_us) * 1000000 / elapsed;
+				uint64_t old = atomic64_get_na(&pl->cpu_ppm);
+				atomic64_set(&pl->cpu_ppm, (old * 3 + ppm) / 4);
+			}
+			pl->last_cpu_us = cpu_us;
+		}
+
+		atomic_set_na(&pl->new_calls, 0);
+	}
+
+	if (!rtpe_config.poller_rebalance_interval || !poller_load_can_migrate())
+		return TLA_CONTINUE;
+	if (++rebalance_countdown < rtpe_config.poller_rebalance_interval)
+		return TLA_CONTINUE;
+	rebalance_countdown = 0;
+
+	poller_load_rebalance();
+
+	return TLA_CONTINUE;
+}
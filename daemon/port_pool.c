@@ -0,0 +1,147 @@
+#include "port_pool.h"
+#include <glib.h>
+
+
+#define PORT_POOL_CHUNK 16
+#define PORT_POOL_CACHES 4
+
+struct port_pool_cache {
+	const struct port_pool *pp;
+	unsigned int pos, end;		/* ring positions owned by this thread */
+};
+
+static __thread struct port_pool_cache port_pool_caches[PORT_POOL_CACHES];
+
+
+bool port_pool_init(struct port_pool *pp, unsigned int min, unsigned int max) {
+	pp->min = min;
+	pp->max = max;
+	pp->bitmap = NULL;
+	pp->ring = NULL;
+	pp->ring_len = 0;
+	pp->ring_pos = 0;
+	pp->free_ports = 0;
+
+	if (max < min || max > 65535)
+		return false;
+
+	pp->bitmap_base = min & ~63U;
+	pp->bitmap = g_new0(atomic64, (max - pp->bitmap_base) / 64 + 1);
+	pp->ring_len = max - min + 1;
+	pp->ring = g_new(uint16_t, pp->ring_len);
+
+	for (unsigned int port = min; port <= max; port++) {
+		unsigned int bit = port - pp->bitmap_base;
+		pp->bitmap[bit / 64].a |= 1ULL << (bit % 64);
+		pp->ring[port - min] = port;
+	}
+
+	/* shuffle the ring, using the rolling dice algorithm */
+	for (unsigned int i = pp->ring_len - 1; i > 0; i--) {
+		unsigned int j = ssl_random() % (i + 1);
+		uint16_t t = pp->ring[i];
+		pp->ring[i] = pp->ring[j];
+		pp->ring[j] = t;
+	}
+
+	pp->free_ports = pp->ring_len;
+	return true;
+}
+
+void port_pool_cleanup(struct port_pool *pp) {
+	g_free(pp->bitmap);
+	g_free(pp->ring);
+	pp->bitmap = NULL;
+	pp->ring = NULL;
+	pp->ring_len = 0;
+	pp->free_ports = 0;
+}
+
+
+/* returns bits to the bitmap without touching the free count */
+static void __unclaim(struct port_pool *pp, unsigned int port, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++) {
+		unsigned int bit = port + i - pp->bitmap_base;
+		atomic64_or(&pp->bitmap[bit / 64], 1ULL << (bit % 64));
+	}
+}
+
+/* clears the bits for `num` consecutive ports, but only if they're all set */
+static bool __claim(struct port_pool *pp, unsigned int port, unsigned int num, unsigned int *contention) {
+	unsigned int i = 0;
+
+	while (i < num) {
+		unsigned int bit = port + i - pp->bitmap_base;
+		unsigned int n = MIN(num - i, 64 - bit % 64);
+		uint64_t mask = (n == 64 ? ~0ULL : ((1ULL << n) - 1)) << (bit % 64);
+		atomic64 *word = &pp->bitmap[bit / 64];
+		uint64_t old = atomic64_get_na(word);
+
+		while (1) {
+			if ((old & mask) != mask) {
+				__unclaim(pp, port, i);
+				return false;
+			}
+			if (__atomic_compare_exchange_n(&word->a, &old, old & ~mask, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				break;
+			if (contention)
+				(*contention)++;
+		}
+
+		i += n;
+	}
+
+	__atomic_fetch_sub(&pp->free_ports, num, __ATOMIC_RELAXED);
+	return true;
+}
+
+
+unsigned int port_pool_get(struct port_pool *pp, unsigned int num, unsigned int *contention) {
+	if (!num || !pp->ring_len)
+		return 0;
+
+	struct port_pool_cache *c = &port_pool_caches[((uintptr_t) pp / sizeof(*pp)) % PORT_POOL_CACHES];
+	if (c->pp != pp) {
+		c->pp = pp;
+		c->pos = c->end = 0;
+	}
+
+	for (unsigned int tries = 0; tries < pp->ring_len; tries++) {
+		if (port_pool_free_count(pp) < num)
+			return 0;
+
+		if (c->pos == c->end) {
+			c->pos = __atomic_fetch_add(&pp->ring_pos, PORT_POOL_CHUNK, __ATOMIC_RELAXED);
+			c->end = c->pos + PORT_POOL_CHUNK;
+		}
+
+		unsigned int port = pp->ring[c->pos++ % pp->ring_len];
+		/* first port must be even for RTP/RTCP pairs, so take the pair this one belongs to */
+		if (num > 1)
+			port &= ~1U;
+		if (port < pp->min || port + num - 1 > pp->max)
+			continue;
+
+		if (__claim(pp, port, num, contention))
+			return port;
+	}
+
+	return 0;
+}
+
+bool port_pool_reserve(struct port_pool *pp, unsigned int port) {
+	if (!pp->ring_len || port < pp->min || port > pp->max)
+		return false;
+	return __claim(pp, port, 1, NULL);
+}
+
+void port_pool_release(struct port_pool *pp, unsigned int port) {
+	if (!pp->ring_len || port < pp->min || port > pp->max)
+		return;
+	unsigned int bit = port - pp->bitmap_base;
+	uint64_t mask = 1ULL << (bit % 64);
+	if ((atomic64_or(&pp->bitmap[bit / 64], mask) & mask))
+		return; /* wasn't in use */
+	__atomic_fetch_add(&pp->free_ports, 1, __ATOMIC_RELAXED);
+}
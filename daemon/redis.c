@@ -33,6 +33,9 @@
 #include "ssrc.h"
 #include "main.h"
 #include "codec.h"
+#include "statistics.h"
+#include "redis_bin.h"
+#include "wbqueue.h"
 
 typedef union {
 	GQueue *q;
@@ -54,6 +57,7 @@ static __thread const ng_parser_t *redis_parser = &ng_parser_json;
 static const ng_parser_t *const redis_format_parsers[__REDIS_FORMAT_MAX] = {
 	&ng_parser_native,
 	&ng_parser_json,
+	&ng_parser_native, // REDIS_FORMAT_BINARY, encoded from the bencode tree
 };
 
 
@@ -98,7 +102,7 @@ static int redisCommandNR(redisContext *r, const char *fmt, ...)
 // before existing calls are restored (restore_thread). Therefore the following
 // scenario is possible:
 // NOTIF THREAD:   receives SET, creates call
-// RESTORE THREAD: executes KEYS *
+// RESTORE THREAD: executes SCAN
 // NOTIF THREAD:   receives another SET:
 // NOTIF THREAD:      does call_destroy(), which:
 //                       adds ports to late-release list
@@ -111,7 +115,7 @@ static cond_t redis_ports_release_cond = COND_STATIC_INIT;
 static int redis_ports_release_balance = 0; // negative = releasers, positive = allocators
 
 static int redis_check_conn(struct redis *r);
-static void json_restore_call(struct redis *r, const str *id, bool foreign);
+static bool json_restore_call(struct redis *r, const str *id, bool foreign);
 static int redis_connect(struct redis *r, int wait);
 static int json_build_ssrc(struct call_monologue *ml, parser_arg arg);
 
@@ -213,8 +217,27 @@ static int redis_check_type(struct redis *r, char *key, char *suffix, char *type
 
 
 /* called with r->lock held */
-static void redis_consume(struct redis *r) {
+static void redis_delta_reset(call_t *c);
+
+// nil if the transaction was aborted, otherwise one reply for each queued command
+static bool redis_exec_ok(const redisReply *rp) {
+	if (!rp || rp->type != REDIS_REPLY_ARRAY)
+		return false;
+	for (size_t i = 0; i < rp->elements; i++) {
+		if (rp->element[i]->type == REDIS_REPLY_ERROR)
+			return false;
+	}
+	return true;
+}
+
+// `calls` and `execs` list the calls written as delta transactions (see redis_pipe_delta),
+// in pipeline order, together with the position of their EXEC reply, or 0 for none. Calls
+// whose transaction failed are rewritten in full next time.
+static void redis_consume_execs(struct redis *r, call_t **calls, const unsigned int *execs,
+		unsigned int num)
+{
 	redisReply *rp;
+	unsigned int pos = 0, i = 0;
 
 	if (!r->ctx) {
 		ilog(LOG_ERROR, "Unable to consume pipelined replies. No redis context");
@@ -222,12 +245,31 @@ static void redis_consume(struct redis *r) {
 		return;
 	}
 	while (r->pipeline) {
-		if (redisGetReply(r->ctx, (void **) &rp) == REDIS_OK)
+		if (redisGetReply(r->ctx, (void **) &rp) != REDIS_OK)
+			rp = NULL;
+		pos++;
+
+		while (i < num && execs[i] < pos)
+			i++;
+		if (i < num && execs[i] == pos) {
+			if (!redis_exec_ok(rp)) {
+				rlog(LOG_ERR, "Redis transaction for call '" STR_FORMAT_M "' failed",
+						STR_FMT_M(&calls[i]->callid));
+				redis_delta_reset(calls[i]);
+			}
+			i++;
+		}
+
+		if (rp)
 			freeReplyObject(rp);
 		r->pipeline--;
 	}
 }
 
+static void redis_consume(struct redis *r) {
+	redis_consume_execs(r, NULL, NULL, 0);
+}
+
 int redis_set_timeout(struct redis* r, int timeout) {
 	struct timeval tv_cmd;
 
@@ -422,7 +464,7 @@ void on_redis_notification(redisAsyncContext *actx, void *reply, void *privdata)
 		goto err;
 	}
 
-	if (strncmp(rr->element[3]->str,"set",3)==0) {
+	if (strncmp(rr->element[3]->str,"set",3)==0 || strncmp(rr->element[3]->str,"hset",4)==0) {
 		c = call_get(&callid);
 		if (c) {
 			rwlock_unlock_w(&c->master_lock);
@@ -1982,8 +2024,59 @@ static int json_build_ssrc(struct call_monologue *ml, parser_arg arg) {
 	return 0;
 }
 
-static void json_restore_call(struct redis *r, const str *callid, bool foreign) {
-	redisReply* rr_jsonStr;
+// field holding the version of a call stored in the delta format
+#define REDIS_DELTA_VERSION "version"
+
+/* called with r->lock held. Fetches the stored document of a call, reassembling it if it's
+ * stored in the delta format. Returns an empty string on failure. */
+static str redis_get_call(struct redis *r, const str *callid, redisReply **rrp, char **to_free) {
+	*rrp = NULL;
+	*to_free = NULL;
+
+	if (!r->ctx) {
+		ilog(LOG_ERROR, "Unable to get redis reply. No redis context");
+		return STR_NULL;
+	}
+
+	redisReply *rr = redisCommand(r->ctx, "GET " PB, PBSTR(callid));
+	if (!rr)
+		return STR_NULL;
+	if (rr->type == REDIS_REPLY_STRING) {
+		*rrp = rr;
+		return STR_LEN(rr->str, rr->len);
+	}
+	bool is_hash = rr->type == REDIS_REPLY_ERROR && !strncmp(rr->str, "WRONGTYPE", 9);
+	freeReplyObject(rr);
+	if (!is_hash)
+		return STR_NULL;
+
+	rr = redis_get(r, REDIS_REPLY_ARRAY, "HGETALL " PB, PBSTR(callid));
+	if (!rr)
+		return STR_NULL;
+	*rrp = rr;
+
+	str *fields = g_new(str, rr->elements);
+	unsigned int num = 0;
+
+	for (size_t i = 0; i + 1 < rr->elements; i += 2) {
+		redisReply *k = rr->element[i];
+		redisReply *v = rr->element[i + 1];
+		if (k->type != REDIS_REPLY_STRING || v->type != REDIS_REPLY_STRING || !v->len)
+			continue;
+		if (!strcmp(k->str, REDIS_DELTA_VERSION))
+			continue;
+		fields[num * 2] = STR_LEN(k->str, k->len);
+		fields[num * 2 + 1] = STR_LEN(v->str, v->len);
+		num++;
+	}
+
+	str doc = redis_fields_assemble(fields, num);
+	g_free(fields);
+	*to_free = doc.s;
+	return doc;
+}
+
+static bool json_restore_call_doc(struct redis *r, const str *callid, const str *doc, bool foreign) {
 	struct redis_hash call;
 	struct redis_list tags, sfds, streams, medias, maps;
 	call_t *c = NULL;
@@ -1998,23 +2091,19 @@ static void json_restore_call(struct redis *r, const str *callid, bool foreign)
 	bencode_item_t *benc_root = NULL;
 	bencode_buffer_t buf = {0};
 
-	mutex_lock(&r->lock);
-	rr_jsonStr = redis_get(r, REDIS_REPLY_STRING, "GET " PB, PBSTR(callid));
-	mutex_unlock(&r->lock);
-
 	bool must_release_pop = true;
 	redis_ports_release_push(false);
 
 	err = "could not retrieve JSON data from redis";
-	if (!rr_jsonStr)
+	if (!doc->len)
 		goto err1;
 
 	parser_arg root = {.json = json_root};
 
-	if (rr_jsonStr->str[0] == '{') {
+	if (doc->s[0] == '{') {
 		parser = json_parser_new();
 		err = "could not parse JSON data";
-		if (!json_parser_load_from_data (parser, rr_jsonStr->str, -1, NULL))
+		if (!json_parser_load_from_data (parser, doc->s, doc->len, NULL))
 			goto err1;
 		json_root = json_parser_get_root(parser);
 		err = "could not read JSON data";
@@ -2023,19 +2112,31 @@ static void json_restore_call(struct redis *r, const str *callid, bool foreign)
 		root.json = json_root;
 		redis_parser = &ng_parser_json;
 	}
-	else if (rr_jsonStr->str[0] == 'd') {
+	else if (doc->s[0] == 'd') {
 		int ret = bencode_buffer_init(&buf);
 		err = "failed to initialise bencode buffer";
 		if (ret)
 			goto err1;
 		err = "failed to decode bencode dictionary";
-		benc_root = bencode_decode_expect_str(&buf, &STR_LEN(rr_jsonStr->str, rr_jsonStr->len),
+		benc_root = bencode_decode_expect_str(&buf, doc,
 				BENCODE_DICTIONARY);
 		if (!benc_root)
 			goto err1;
 		redis_parser = &ng_parser_native;
 		root.benc = benc_root;
 	}
+	else if (redis_bin_is(doc)) {
+		int ret = bencode_buffer_init(&buf);
+		err = "failed to initialise bencode buffer";
+		if (ret)
+			goto err1;
+		err = "failed to decode binary call data";
+		benc_root = redis_bin_decode(&buf, doc);
+		if (!benc_root || benc_root->type != BENCODE_DICTIONARY)
+			goto err1;
+		redis_parser = &ng_parser_native;
+		root.benc = benc_root;
+	}
 
 	c = call_get_or_create(callid, false);
 	err = "failed to create call struct";
@@ -2178,8 +2279,6 @@ err2:
 err1:
 	if (parser)
 		g_object_unref (parser);
-	if (rr_jsonStr)
-		freeReplyObject(rr_jsonStr);	
 	bencode_buffer_free(&buf);
 	if (err) {
 		mutex_lock(&r->lock);
@@ -2215,40 +2314,138 @@ err1:
 	if (must_release_pop)
 		redis_ports_release_pop(false);
 	log_info_reset();
+
+	return err == NULL;
 }
 
+static bool json_restore_call(struct redis *r, const str *callid, bool foreign) {
+	redisReply *rr;
+	g_autoptr(char) delta_doc = NULL;
+
+	mutex_lock(&r->lock);
+	str doc = redis_get_call(r, callid, &rr, &delta_doc);
+	mutex_unlock(&r->lock);
+
+	bool ret = json_restore_call_doc(r, callid, &doc, foreign);
+
+	if (rr)
+		freeReplyObject(rr);
+
+	return ret;
+}
+
+// Restore walks the keyspace with SCAN instead of a single KEYS, and hands each page of keys
+// to a pool of threads as soon as it arrives. Each thread fetches its whole page with a
+// single MGET on its own connection and restores the calls from that reply. Keys that MGET
+// can't return (calls stored as a hash in the delta format) are fetched individually.
+
+#define REDIS_RESTORE_BATCH 256
+#define REDIS_RESTORE_PROGRESS 10000
+
 struct thread_ctx {
 	GQueue r_q;
 	mutex_t r_m;
 	bool foreign;
+	struct timeval start;
+	atomic64 done;
+	atomic64 restored;
 };
 
-static void restore_thread(void *call_p, void *ctx_p) {
+static int64_t restore_elapsed(struct thread_ctx *ctx) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return timeval_diff(&now, &ctx->start);
+}
+
+static void restore_progress(struct thread_ctx *ctx, unsigned int num) {
+	uint64_t before = atomic64_add(&ctx->done, num);
+	uint64_t after = before + num;
+	if (before / REDIS_RESTORE_PROGRESS == after / REDIS_RESTORE_PROGRESS)
+		return;
+
+	int64_t elapsed = restore_elapsed(ctx);
+	rlog(LOG_INFO, "Processed %" PRIu64 " calls from Redis so far, %.0f calls per second",
+			after, elapsed > 0 ? (double) after * 1000000.0 / elapsed : 0.0);
+}
+
+static void restore_thread(void *keys_p, void *ctx_p) {
 	struct thread_ctx *ctx = ctx_p;
-	redisReply *call = call_p;
+	redisReply *page = keys_p;
+	redisReply *keys = page->element[1];
 	struct redis *r;
-	str callid = STR_LEN(call->str, call->len);
-
-	rlog(LOG_DEBUG, "Processing call ID '%s%.*s%s' from Redis", FMT_M(REDIS_FMT(call)));
 
 	mutex_lock(&ctx->r_m);
 	r = g_queue_pop_head(&ctx->r_q);
 	mutex_unlock(&ctx->r_m);
 
-	gettimeofday(&rtpe_now, NULL);
-	json_restore_call(r, &callid, ctx->foreign);
+	const char **argv = g_new(const char *, keys->elements + 1);
+	size_t *argvlen = g_new(size_t, keys->elements + 1);
+	unsigned int argc = 0;
+
+	argv[argc] = "MGET";
+	argvlen[argc++] = 4;
+	for (size_t i = 0; i < keys->elements; i++) {
+		if (keys->element[i]->type != REDIS_REPLY_STRING)
+			continue;
+		argv[argc] = keys->element[i]->str;
+		argvlen[argc++] = keys->element[i]->len;
+	}
+
+	redisReply *docs = NULL;
+	if (argc > 1) {
+		mutex_lock(&r->lock);
+		if (r->ctx)
+			docs = redisCommandArgv(r->ctx, argc, argv, argvlen);
+		mutex_unlock(&r->lock);
+		if (docs && (docs->type != REDIS_REPLY_ARRAY || docs->elements != argc - 1)) {
+			freeReplyObject(docs);
+			docs = NULL;
+		}
+	}
+
+	unsigned int restored = 0;
+
+	for (unsigned int i = 1; i < argc; i++) {
+		str callid = STR_LEN(argv[i], argvlen[i]);
+
+		rlog(LOG_DEBUG, "Processing call ID '" STR_FORMAT_M "' from Redis", STR_FMT_M(&callid));
+
+		gettimeofday(&rtpe_now, NULL);
+
+		redisReply *doc = docs ? docs->element[i - 1] : NULL;
+		if (doc && doc->type == REDIS_REPLY_STRING) {
+			str s = STR_LEN(doc->str, doc->len);
+			if (json_restore_call_doc(r, &callid, &s, ctx->foreign))
+				restored++;
+		}
+		else {
+			// not a plain string, or the batch failed: fall back to a regular GET
+			if (json_restore_call(r, &callid, ctx->foreign))
+				restored++;
+		}
+	}
+
+	if (docs)
+		freeReplyObject(docs);
+	freeReplyObject(page);
+	g_free(argv);
+	g_free(argvlen);
 
 	mutex_lock(&ctx->r_m);
 	g_queue_push_tail(&ctx->r_q, r);
 	mutex_unlock(&ctx->r_m);
 	release_closed_sockets();
+
+	atomic64_add(&ctx->restored, restored);
+	restore_progress(ctx, argc - 1);
 }
 
 int redis_restore(struct redis *r, bool foreign, int db) {
-	redisReply *calls = NULL, *call;
 	int ret = -1;
-	GThreadPool *gtp;
-	struct thread_ctx ctx;
+	GThreadPool *gtp = NULL;
+	struct thread_ctx ctx = {0};
+	char cursor[32] = "0";
+	struct redis *tr;
 
 	if (!r)
 		return 0;
@@ -2258,63 +2455,82 @@ int redis_restore(struct redis *r, bool foreign, int db) {
 
 	rlog(LOG_DEBUG, "Restoring calls from Redis...");
 
+	mutex_init(&ctx.r_m);
+	g_queue_init(&ctx.r_q);
+	ctx.foreign = foreign;
+	gettimeofday(&ctx.start, NULL);
+
 	mutex_lock(&r->lock);
 	// coverity[sleep : FALSE]
 	if (redis_check_conn(r) == REDIS_STATE_DISCONNECTED) {
 		mutex_unlock(&r->lock);
 		ret = 0;
-		goto err;
+		goto out;
 	}
-	if (db != -1)
-		redis_select_db(r, db);
+	mutex_unlock(&r->lock);
 
-	calls = redis_get(r, REDIS_REPLY_ARRAY, "KEYS *");
+	do {
+		mutex_lock(&r->lock);
+		if (db != -1)
+			redis_select_db(r, db);
 
-	if (db != -1)
-		redis_select_db(r, r->db);
-	else
-		db = r->db;
+		redisReply *page = redis_get(r, REDIS_REPLY_ARRAY, "SCAN %s COUNT %i", cursor,
+				REDIS_RESTORE_BATCH);
 
-	mutex_unlock(&r->lock);
+		if (db != -1)
+			redis_select_db(r, r->db);
 
-	if (!calls) {
-		rlog(LOG_ERR, "Could not retrieve call list from Redis: %s",
-				r->ctx ? r->ctx->errstr : "No redis context");
-		goto err;
-	}
+		mutex_unlock(&r->lock);
 
-	if (calls->elements == 0)
-		goto out;
+		if (!page || page->elements != 2 || page->element[0]->type != REDIS_REPLY_STRING
+				|| page->element[1]->type != REDIS_REPLY_ARRAY)
+		{
+			rlog(LOG_ERR, "Could not retrieve call list from Redis: %s",
+					r->ctx ? r->ctx->errstr : "No redis context");
+			if (page)
+				freeReplyObject(page);
+			goto out;
+		}
 
-	mutex_init(&ctx.r_m);
-	g_queue_init(&ctx.r_q);
-	ctx.foreign = foreign;
-	for (int i = 0; i < rtpe_config.redis_num_threads; i++)
-		g_queue_push_tail(&ctx.r_q,
-				redis_dup(r, db));
-	gtp = g_thread_pool_new(restore_thread, &ctx, rtpe_config.redis_num_threads, TRUE, NULL);
-
-	for (int i = 0; i < calls->elements; i++) {
-		call = calls->element[i];
-		if (call->type != REDIS_REPLY_STRING)
+		snprintf(cursor, sizeof(cursor), "%.*s", REDIS_FMT(page->element[0]));
+
+		if (!page->element[1]->elements) {
+			freeReplyObject(page);
 			continue;
+		}
 
-		g_thread_pool_push(gtp, call, NULL);
-	}
+		if (!gtp) {
+			for (int i = 0; i < rtpe_config.redis_num_threads; i++)
+				g_queue_push_tail(&ctx.r_q,
+						redis_dup(r, db));
+			gtp = g_thread_pool_new(restore_thread, &ctx, rtpe_config.redis_num_threads,
+					TRUE, NULL);
+		}
 
-	g_thread_pool_stop_unused_threads();
-	g_thread_pool_set_max_unused_threads(0);
+		g_thread_pool_push(gtp, page, NULL);
+	} while (strcmp(cursor, "0"));
 
-	g_thread_pool_free(gtp, FALSE, TRUE);
-	while ((r = g_queue_pop_head(&ctx.r_q)))
-		redis_close(r);
+	ret = 0;
 
 out:
-	ret = 0;
+	if (gtp) {
+		g_thread_pool_stop_unused_threads();
+		g_thread_pool_set_max_unused_threads(0);
 
-	freeReplyObject(calls);
+		g_thread_pool_free(gtp, FALSE, TRUE);
+		while ((tr = g_queue_pop_head(&ctx.r_q)))
+			redis_close(tr);
+
+		int64_t elapsed = restore_elapsed(&ctx);
+		uint64_t restored = atomic64_get_na(&ctx.restored);
+		RTPE_STATS_ADD(redis_restored, restored);
+		RTPE_STATS_ADD(redis_restore_time, elapsed);
+		rlog(LOG_INFO, "Restored %" PRIu64 " out of %" PRIu64 " calls from Redis in %.3f seconds",
+				restored, atomic64_get_na(&ctx.done), elapsed / 1000000.0);
+	}
+
+	mutex_destroy(&ctx.r_m);
 
-err:
 	for (unsigned int i = 0; i < num_log_levels; i++)
 		if (rtpe_config.common.log_levels[i] > 0)
 			rtpe_config.common.log_levels[i] &= ~LOG_FLAG_RESTORE;
@@ -2414,7 +2630,7 @@ static void json_update_dtls_fingerprint(const ng_parser_t *parser, parser_arg i
  * encodes the few (k,v) pairs for one call under one json structure
  */
 
-static str redis_encode_json(ng_parser_ctx_t *ctx, call_t *c, void **to_free) {
+static parser_arg redis_encode_json(ng_parser_ctx_t *ctx, call_t *c) {
 
 	char tmp[2048];
 	const ng_parser_t *parser = ctx->parser;
@@ -2734,52 +2950,425 @@ static str redis_encode_json(ng_parser_ctx_t *ctx, call_t *c, void **to_free) {
 
 	}
 
-	return parser->collapse(ctx, root, to_free);
+	return root;
 }
 
 
-void redis_update_onekey(call_t *c, struct redis *r) {
-	unsigned int redis_expires_s;
+/*** DELTA UPDATES ***/
+
+// With delta updates enabled, a call is stored as a hash with one field per top-level key of
+// the encoded document ("json", "sfd-N", "stream-N", "tag-N", ...). The call remembers a
+// digest of each field as it was last written and only fields that have changed are sent,
+// together with deletions of fields that have disappeared, as one transaction. A call
+// without remembered digests (first write, after an error, or every REDIS_DELTA_FULL_EVERY
+// versions) is rewritten in full. On restore the fields are reassembled into the regular
+// document.
+
+#define REDIS_DELTA_FULL_EVERY 64
+
+struct redis_delta {
+	call_t *call;
+	GHashTable *fields; // field name -> digest
+	GPtrArray *argv;
+	GArray *argvlen;
+	GPtrArray *to_free;
+};
+
+INLINE uint64_t redis_delta_digest(const str *s) {
+	// FNV-1a
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < s->len; i++) {
+		h ^= (unsigned char) s->s[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static str redis_collapse_item(const ng_parser_t *parser, parser_arg item, void **to_free) {
+	if (parser == &ng_parser_json) {
+		JsonGenerator *g = json_generator_new();
+		json_generator_set_root(g, item.json);
+		size_t len;
+		char *s = json_generator_to_data(g, &len);
+		g_object_unref(g);
+		*to_free = s;
+		return STR_LEN(s, len);
+	}
+	if (rtpe_config.redis_format == REDIS_FORMAT_BINARY) {
+		str s = redis_bin_encode_entry(item.benc);
+		*to_free = s.s;
+		return s;
+	}
+	return bencode_collapse_str(item.benc);
+}
+
+static void redis_delta_argv_add(struct redis_delta *d, const char *s, size_t len) {
+	g_ptr_array_add(d->argv, (void *) s);
+	g_array_append_val(d->argvlen, len);
+}
+
+static void redis_delta_field(const ng_parser_t *parser, str *key, parser_arg val, helper_arg arg) {
+	struct redis_delta *d = arg.generic;
+	call_t *c = d->call;
+
+	void *to_free = NULL;
+	str enc = redis_collapse_item(parser, val, &to_free);
+	uint64_t *digest = g_new(uint64_t, 1);
+	*digest = redis_delta_digest(&enc);
+
+	char *name = g_strndup(key->s, key->len);
+	uint64_t *old = c->redis_fields ? g_hash_table_lookup(c->redis_fields, name) : NULL;
+	g_hash_table_insert(d->fields, name, digest);
+
+	if (old && *old == *digest) {
+		g_free(to_free);
+		return;
+	}
+
+	// JSON output must stay around until the command is formatted
+	if (to_free)
+		g_ptr_array_add(d->to_free, to_free);
+	redis_delta_argv_add(d, name, key->len);
+	redis_delta_argv_add(d, enc.s, enc.len);
+}
+
+/* c->redis_lock must be held */
+static void __redis_delta_reset(call_t *c) {
+	if (c->redis_fields)
+		g_hash_table_destroy(c->redis_fields);
+	c->redis_fields = NULL;
+}
+
+static void redis_delta_reset(call_t *c) {
+	LOCK(&c->redis_lock);
+	__redis_delta_reset(c);
+}
+
+/* called with r->lock held and c->master_lock held. `exec_pos` is set to the position of
+ * the reply to EXEC in the pipeline, if there is one */
+static bool redis_pipe_delta(call_t *c, struct redis *r, const ng_parser_t *parser, parser_arg root,
+		unsigned int *exec_pos)
+{
+	char version[32];
+
+	if (!r->ctx)
+		return false;
+
+	// c->master_lock is only held in R, so concurrent writers must be kept apart
+	LOCK(&c->redis_lock);
+
+	if (c->redis_version % REDIS_DELTA_FULL_EVERY == 0)
+		__redis_delta_reset(c);
+	bool full = !c->redis_fields;
+
+	g_autoptr(GPtrArray) free_list = g_ptr_array_new_with_free_func(g_free);
+	struct redis_delta d = {
+		.call = c,
+		.fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free),
+		.argv = g_ptr_array_new(),
+		.argvlen = g_array_new(false, false, sizeof(size_t)),
+		.to_free = free_list,
+	};
+
+	redis_delta_argv_add(&d, "HSET", 4);
+	redis_delta_argv_add(&d, c->callid.s, c->callid.len);
+
+	if (!parser->dict_iter(parser, root, redis_delta_field, &d)) {
+		g_hash_table_destroy(d.fields);
+		g_ptr_array_free(d.argv, true);
+		g_array_free(d.argvlen, true);
+		return false;
+	}
+
+	unsigned int num_set = (d.argv->len - 2) / 2;
+
+	// fields that have disappeared
+	g_autoptr(GPtrArray) dels = g_ptr_array_new();
+	if (c->redis_fields) {
+		GHashTableIter iter;
+		g_hash_table_iter_init(&iter, c->redis_fields);
+		char *name;
+		while (g_hash_table_iter_next(&iter, (void **) &name, NULL)) {
+			if (!g_hash_table_contains(d.fields, name))
+				g_ptr_array_add(dels, name);
+		}
+	}
+
+	bool changed = num_set || dels->len || full;
+
+	if (changed) {
+		redis_pipe(r, "MULTI");
+
+		if (full)
+			redis_pipe(r, "DEL " PB, PBSTR(&c->callid));
 
+		if (dels->len) {
+			const char *dargv[dels->len + 2];
+			size_t dargvlen[dels->len + 2];
+			dargv[0] = "HDEL";
+			dargvlen[0] = 4;
+			dargv[1] = c->callid.s;
+			dargvlen[1] = c->callid.len;
+			for (unsigned int i = 0; i < dels->len; i++) {
+				dargv[i + 2] = dels->pdata[i];
+				dargvlen[i + 2] = strlen(dels->pdata[i]);
+			}
+			redisAppendCommandArgv(r->ctx, dels->len + 2, dargv, dargvlen);
+			r->pipeline++;
+		}
+
+		c->redis_version++;
+		size_t len = snprintf(version, sizeof(version), "%" PRIu64, c->redis_version);
+		redis_delta_argv_add(&d, REDIS_DELTA_VERSION, strlen(REDIS_DELTA_VERSION));
+		redis_delta_argv_add(&d, version, len);
+		redisAppendCommandArgv(r->ctx, d.argv->len, (const char **) d.argv->pdata,
+				(size_t *) d.argvlen->data);
+		r->pipeline++;
+	}
+
+	redis_pipe(r, "EXPIRE " PB " %i", PBSTR(&c->callid), rtpe_config.redis_expires_secs);
+
+	if (changed) {
+		redis_pipe(r, "EXEC");
+		*exec_pos = r->pipeline;
+	}
+
+	// field names are referenced by argv until here
+	__redis_delta_reset(c);
+	c->redis_fields = d.fields;
+	g_ptr_array_free(d.argv, true);
+	g_array_free(d.argvlen, true);
+
+	return true;
+}
+
+/* called with r->lock held and the target DB selected. See redis_pipe_delta() for `exec_pos`,
+ * which is set to 0 if there's no transaction */
+static bool redis_pipe_call(call_t *c, struct redis *r, unsigned int *exec_pos) {
+	*exec_pos = 0;
+
+	rwlock_lock_r(&c->master_lock);
+
+	c->redis_hosted_db = r->db;
+
+	ng_parser_ctx_t ctx;
+	bencode_buffer_t bbuf;
+	const ng_parser_t *parser = redis_format_parsers[rtpe_config.redis_format];
+	parser->init(&ctx, &bbuf);
+
+	parser_arg root = redis_encode_json(&ctx, c);
+	bool ret;
+
+	if (rtpe_config.redis_delta) {
+		ret = redis_pipe_delta(c, r, parser, root, exec_pos);
+		if (parser == &ng_parser_json)
+			json_node_unref(root.json);
+		rwlock_unlock_r(&c->master_lock);
+		bencode_buffer_free(ctx.buffer);
+		return ret;
+	}
+
+	void *to_free = NULL;
+	str result;
+	if (rtpe_config.redis_format == REDIS_FORMAT_BINARY) {
+		result = redis_bin_encode(root.benc);
+		to_free = result.s;
+	}
+	else
+		result = parser->collapse(&ctx, root, &to_free);
+	if (result.len)
+		redis_pipe(r, "SET " PB " " PB " EX %i", PBSTR(&c->callid), PBSTR(&result),
+				rtpe_config.redis_expires_secs);
+
+	rwlock_unlock_r(&c->master_lock);
+
+	g_free(to_free);
+	bencode_buffer_free(ctx.buffer);
+
+	return result.len != 0;
+}
+
+static void redis_count_writes(unsigned int num, const struct timeval *start) {
+	struct timeval end;
+	gettimeofday(&end, NULL);
+	RTPE_STATS_ADD(redis_writes, num);
+	RTPE_STATS_INC(redis_write_batches);
+	RTPE_STATS_ADD(redis_write_time, timeval_diff(&end, start));
+}
+
+
+/*** WRITE-BEHIND ***/
+
+// Calls marked for update are queued oldest first, at most once each, see wbqueue.h.
+// Workers pick up entries once they've aged past the configured delay and pipeline them in
+// batches, each over its own connection.
+
+#define REDIS_WB_BATCH 64
+#define REDIS_WB_STOP_TIMEOUT 10 // seconds
+
+static struct wbqueue redis_wbq;
+static unsigned int redis_wb_workers;
+
+static void redis_wb_get(void *c) {
+	obj_get((call_t *) c);
+}
+static void redis_wb_put(void *c) {
+	obj_put((call_t *) c);
+}
+// once deleted from Redis, a call must not be written back
+static bool redis_wb_skip(void *c) {
+	return CALL_ISSET((call_t *) c, REDIS_DELETED);
+}
+static void redis_wb_length(unsigned int len) {
+	RTPE_GAUGE_SET(redis_write_queue, len);
+}
+
+static const struct wbqueue_ops redis_wb_ops = {
+	.get = redis_wb_get,
+	.put = redis_wb_put,
+	.skip = redis_wb_skip,
+	.length = redis_wb_length,
+};
+
+static void redis_wb_write(struct redis *r, call_t **batch, unsigned int num) {
+	struct timeval start;
+	gettimeofday(&start, NULL);
+
+	LOCK(&r->lock);
+	// coverity[sleep : FALSE]
+	if (redis_check_conn(r) == REDIS_STATE_DISCONNECTED)
+		return;
+
+	if (redis_select_db(r, r->db)) {
+		rlog(LOG_ERR, "Failed to select Redis DB %i for write-behind", r->db);
+		goto err;
+	}
+
+	unsigned int written = 0;
+	unsigned int execs[REDIS_WB_BATCH];
+	for (unsigned int i = 0; i < num; i++) {
+		if (redis_pipe_call(batch[i], r, &execs[i]))
+			written++;
+		else
+			rlog(LOG_ERR, "Failed to encode call '" STR_FORMAT_M "' for Redis",
+					STR_FMT_M(&batch[i]->callid));
+	}
+
+	redis_consume_execs(r, batch, execs, num);
+
+	if (r->ctx && r->ctx->err)
+		goto err;
+
+	redis_count_writes(written, &start);
+	return;
+
+err:
+	if (r->ctx && r->ctx->err)
+		rlog(LOG_ERR, "Redis error: %s", r->ctx->errstr);
+	redisFree(r->ctx);
+	r->ctx = NULL;
+	r->pipeline = 0;
+
+	// we don't know what made it, so rewrite these in full next time
+	for (unsigned int i = 0; i < num; i++)
+		redis_delta_reset(batch[i]);
+}
+
+static void redis_wb_worker(void *d) {
+	struct redis *r = d;
+	call_t *batch[REDIS_WB_BATCH];
+	unsigned int num;
+
+	while ((num = wbqueue_next(&redis_wbq, (void **) batch, REDIS_WB_BATCH))) {
+		redis_wb_write(r, batch, num);
+		wbqueue_done(&redis_wbq, (void **) batch, num);
+	}
+
+	redis_close(r);
+}
+
+void redis_wb_launch(void) {
+	if (!rtpe_config.redis_write_threads || !rtpe_redis_write)
+		return;
+
+	wbqueue_init(&redis_wbq, (long long) rtpe_config.redis_write_delay * 1000, &redis_wb_ops);
+
+	for (int i = 0; i < rtpe_config.redis_write_threads; i++) {
+		struct redis *r = redis_dup(rtpe_redis_write, -1);
+		if (!r) {
+			ilog(LOG_ERR, "Failed to connect Redis write-behind thread to %s",
+					endpoint_print_buf(&rtpe_redis_write->endpoint));
+			continue;
+		}
+		redis_wb_workers++;
+		thread_create_detach(redis_wb_worker, r, "redis write");
+	}
+
+	if (!redis_wb_workers) {
+		ilog(LOG_WARN, "No Redis write-behind threads running, writing call updates synchronously");
+		wbqueue_free(&redis_wbq);
+	}
+}
+
+// to be called after `rtpe_shutdown` is set and before the threads are cancelled. Lets the
+// workers write out everything that is still queued, but doesn't wait forever.
+void redis_wb_stop(void) {
+	if (!redis_wb_workers)
+		return;
+
+	unsigned int left = wbqueue_stop(&redis_wbq, REDIS_WB_STOP_TIMEOUT * 1000000LL);
+	if (left)
+		ilog(LOG_WARN, "Timed out writing call updates to Redis, %u calls not written", left);
+}
+
+void redis_wb_free(void) {
+	if (!redis_wb_workers)
+		return;
+
+	wbqueue_free(&redis_wbq);
+	redis_wb_workers = 0;
+}
+
+
+void redis_update_onekey(call_t *c, struct redis *r) {
 	if (!r)
 		return;
 	if (IS_FOREIGN_CALL(c))
 		return;
 
+	RTPE_STATS_INC(redis_updates);
+
+	if (redis_wb_workers) {
+		atomic64_set_na(&c->last_redis_update, rtpe_now.tv_sec);
+		wbqueue_push(&redis_wbq, c);
+		return;
+	}
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+
 	LOCK(&r->lock);
+	// already deleted by another thread
+	if (CALL_ISSET(c, REDIS_DELETED))
+		return;
 	// coverity[sleep : FALSE]
 	if (redis_check_conn(r) == REDIS_STATE_DISCONNECTED)
 		return;
 
 	atomic64_set_na(&c->last_redis_update, rtpe_now.tv_sec);
 
-	rwlock_lock_r(&c->master_lock);
-
-	redis_expires_s = rtpe_config.redis_expires_secs;
-
-	c->redis_hosted_db = r->db;
-	if (redis_select_db(r, c->redis_hosted_db)) {
+	if (redis_select_db(r, r->db)) {
 		rlog(LOG_ERR, " >>>>>>>>>>>>>>>>> Redis error.");
 		goto err;
 	}
 
-	ng_parser_ctx_t ctx;
-	bencode_buffer_t bbuf;
-	redis_format_parsers[rtpe_config.redis_format]->init(&ctx, &bbuf);
-
-	void *to_free = NULL;
-	str result = redis_encode_json(&ctx, c, &to_free);
-	if (!result.len)
+	unsigned int exec_pos;
+	if (!redis_pipe_call(c, r, &exec_pos))
 		goto err;
 
-	redis_pipe(r, "SET " PB " " PB " EX %i", PBSTR(&c->callid), PBSTR(&result), redis_expires_s);
+	redis_consume_execs(r, &c, &exec_pos, 1);
 
-	redis_consume(r);
-
-	rwlock_unlock_r(&c->master_lock);
-
-	g_free(to_free);
-	bencode_buffer_free(ctx.buffer);
+	redis_count_writes(1, &start);
 
 	return;
 err:
@@ -2787,8 +3376,9 @@ err:
 		rlog(LOG_ERR, "Redis error: %s", r->ctx->errstr);
 	redisFree(r->ctx);
 	r->ctx = NULL;
+	r->pipeline = 0;
 
-	rwlock_unlock_r(&c->master_lock);
+	redis_delta_reset(c);
 }
 
 /* must be called lock-free */
@@ -2802,9 +3392,16 @@ void redis_delete(call_t *c, struct redis *r) {
 	if (IS_FOREIGN_CALL(c))
 		return;
 
+	// keeps any later update from writing the call back, then drops a pending write and
+	// waits for one in progress, so that nothing can overwrite the delete
+	CALL_SET(c, REDIS_DELETED);
+	if (redis_wb_workers)
+		wbqueue_cancel(&redis_wbq, c);
+
 	if (delete_async) {
 		LOCK(&r->async_lock);
 		rwlock_lock_r(&c->master_lock);
+		redis_delta_reset(c);
 		redis_delete_async_call_json(c, r);
 		rwlock_unlock_r(&c->master_lock);
 		return;
@@ -2820,6 +3417,7 @@ void redis_delete(call_t *c, struct redis *r) {
 		goto err;
 
 	redis_delete_call_json(c, r);
+	redis_delta_reset(c);
 
 	rwlock_unlock_r(&c->master_lock);
 	return;
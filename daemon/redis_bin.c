@@ -0,0 +1,511 @@
+#include "redis_bin.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <glib.h>
+
+
+
+enum redis_bin_type {
+	RB_DICT = 1,
+	RB_LIST,
+	RB_STR,		// varint length + raw bytes
+	RB_EMPTY,	// empty string
+	RB_UINT,	// canonical decimal string as varint
+	RB_NEG,		// canonical negative decimal string as varint of its absolute value
+	RB_INT,		// bencode integer, zigzag varint
+	RB_REF,		// varint index of an earlier RB_STR in the same top-level entry
+};
+
+enum redis_bin_key_kind {
+	RBK_KNOWN = 0,	// index into redis_bin_keys
+	RBK_PREFIX,	// index into redis_bin_prefixes, followed by varint number
+	RBK_INLINE,	// length, followed by raw bytes
+};
+
+#define RB_MAX_DEPTH 16
+#define RB_MIN_REF_LEN 2
+#define RB_MAX_STR_LEN 99999 // imposed by bencode_string_len()
+
+// The order of both tables is part of the format: only ever append to them, and bump
+// REDIS_BIN_VERSION if anything else needs to change.
+static const char *const redis_bin_keys[] = {
+	"json", "media", "sfd", "rtcp_sibling", "last_packet", "ps_flags", "component",
+	"endpoint", "advertised_endpoint", "stats-packets", "stats-bytes", "stats-errors",
+	"pref_family", "localport", "fd", "logical_intf", "local_intf_uid", "stream",
+	"tag", "index", "type", "format_str", "media_id", "protocol", "desired_family",
+	"ptime", "maxptime", "media_flags", "wildcard", "num_ports", "intf_preferred_family",
+	"created", "deleted", "block_dtmf", "ml_flags", "via-branch", "label", "metadata",
+	"sdp_session_name", "sdp_session_timing", "destroyed", "last_signal", "tos",
+	"num_sfds", "num_streams", "num_medias", "num_tags", "num_maps", "ml_deleted",
+	"created_from", "created_from_addr", "redis_hosted_db", "recording_metadata",
+	"call_flags", "recording_meta_prefix", "recording_file", "recording_path",
+	"recording_pattern", "recording_random_tag", "ssrc", "in_srtp_index",
+	"in_srtcp_index", "in_payload_type", "out_srtp_index", "out_srtcp_index",
+	"out_payload_type", "bandwidth_as", "bandwidth_rr", "bandwidth_rs", "hash_func",
+	"fingerprint", "sdp_session_as", "sdp_session_ct", "sdp_session_rr", "sdp_session_rs",
+	"sdp_orig_username", "sdp_orig_session_id", "sdp_orig_version_str",
+	"sdp_orig_version_num", "sdp_orig_parsed", "sdp_orig_address_network_type",
+	"sdp_orig_address_address_type", "sdp_orig_address_address",
+	"last_sdp_orig_username", "last_sdp_orig_session_id", "last_sdp_orig_version_str",
+	"last_sdp_orig_version_num", "last_sdp_orig_parsed",
+	"last_sdp_orig_address_network_type", "last_sdp_orig_address_address_type",
+	"last_sdp_orig_address_address",
+	"-crypto_suite", "-master_key", "-master_salt", "-unenc-srtp", "-unenc-srtcp",
+	"-unauth-srtp", "-mki",
+	"sdes_in_tag", "sdes_in-crypto_suite", "sdes_in-master_key", "sdes_in-master_salt",
+	"sdes_in-unenc-srtp", "sdes_in-unenc-srtcp", "sdes_in-unauth-srtp", "sdes_in-mki",
+	"sdes_out_tag", "sdes_out-crypto_suite", "sdes_out-master_key", "sdes_out-master_salt",
+	"sdes_out-unenc-srtp", "sdes_out-unenc-srtcp", "sdes_out-unauth-srtp", "sdes_out-mki",
+};
+
+// keys of the form "<prefix>-<number>"
+static const char *const redis_bin_prefixes[] = {
+	"stream", "sfd", "stream_sfds", "rtp_sinks", "rtcp_sinks", "media", "streams", "maps",
+	"payload_types", "media-subscriptions", "tag", "associated_tags", "tag_aliases", "medias",
+	"ssrc_table", "map", "map_sfds",
+};
+
+static str redis_bin_key_strs[G_N_ELEMENTS(redis_bin_keys)];
+static str redis_bin_prefix_strs[G_N_ELEMENTS(redis_bin_prefixes)];
+static GHashTable *redis_bin_key_ht; // str -> index + 1
+static GHashTable *redis_bin_prefix_ht;
+
+
+static void redis_bin_tables_init(void) {
+	static gsize done;
+
+	if (!g_once_init_enter(&done))
+		return;
+
+	redis_bin_key_ht = g_hash_table_new((GHashFunc) str_hash, (GEqualFunc) str_equal);
+	for (unsigned int i = 0; i < G_N_ELEMENTS(redis_bin_keys); i++) {
+		redis_bin_key_strs[i] = STR(redis_bin_keys[i]);
+		g_hash_table_insert(redis_bin_key_ht, &redis_bin_key_strs[i], GUINT_TO_POINTER(i + 1));
+	}
+	redis_bin_prefix_ht = g_hash_table_new((GHashFunc) str_hash, (GEqualFunc) str_equal);
+	for (unsigned int i = 0; i < G_N_ELEMENTS(redis_bin_prefixes); i++) {
+		redis_bin_prefix_strs[i] = STR(redis_bin_prefixes[i]);
+		g_hash_table_insert(redis_bin_prefix_ht, &redis_bin_prefix_strs[i],
+				GUINT_TO_POINTER(i + 1));
+	}
+
+	g_once_init_leave(&done, 1);
+}
+
+
+/*** ENCODING ***/
+
+struct redis_bin_enc {
+	GString *out;
+	GHashTable *refs; // str -> index + 1
+	GPtrArray *ref_strs;
+};
+
+static void redis_bin_put_varint(GString *out, uint64_t v) {
+	while (v >= 0x80) {
+		g_string_append_c(out, (v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	g_string_append_c(out, v);
+}
+
+// accepts only what prints back identically
+static bool redis_bin_parse_uint(const char *s, size_t len, uint64_t *out) {
+	if (len == 0 || len > 20)
+		return false;
+	if (s[0] == '0' && len > 1)
+		return false;
+	uint64_t v = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] < '0' || s[i] > '9')
+			return false;
+		unsigned int d = s[i] - '0';
+		if (v > (UINT64_MAX - d) / 10)
+			return false;
+		v = v * 10 + d;
+	}
+	*out = v;
+	return true;
+}
+
+static void redis_bin_put_key(GString *out, const str *key) {
+	unsigned int idx = GPOINTER_TO_UINT(g_hash_table_lookup(redis_bin_key_ht, key));
+	if (idx) {
+		redis_bin_put_varint(out, ((uint64_t) (idx - 1) << 2) | RBK_KNOWN);
+		return;
+	}
+
+	const char *dash = memrchr(key->s, '-', key->len);
+	if (dash) {
+		str prefix = STR_LEN(key->s, dash - key->s);
+		uint64_t num;
+		idx = GPOINTER_TO_UINT(g_hash_table_lookup(redis_bin_prefix_ht, &prefix));
+		if (idx && redis_bin_parse_uint(dash + 1, key->len - prefix.len - 1, &num)) {
+			redis_bin_put_varint(out, ((uint64_t) (idx - 1) << 2) | RBK_PREFIX);
+			redis_bin_put_varint(out, num);
+			return;
+		}
+	}
+
+	redis_bin_put_varint(out, ((uint64_t) key->len << 2) | RBK_INLINE);
+	g_string_append_len(out, key->s, key->len);
+}
+
+static void redis_bin_put_str(struct redis_bin_enc *e, const char *s, size_t len) {
+	uint64_t num;
+
+	if (!len) {
+		g_string_append_c(e->out, RB_EMPTY);
+		return;
+	}
+	if (redis_bin_parse_uint(s, len, &num)) {
+		g_string_append_c(e->out, RB_UINT);
+		redis_bin_put_varint(e->out, num);
+		return;
+	}
+	if (s[0] == '-' && redis_bin_parse_uint(s + 1, len - 1, &num) && num) {
+		g_string_append_c(e->out, RB_NEG);
+		redis_bin_put_varint(e->out, num);
+		return;
+	}
+
+	if (len >= RB_MIN_REF_LEN) {
+		str k = STR_LEN(s, len);
+		unsigned int idx = GPOINTER_TO_UINT(g_hash_table_lookup(e->refs, &k));
+		if (idx) {
+			g_string_append_c(e->out, RB_REF);
+			redis_bin_put_varint(e->out, idx - 1);
+			return;
+		}
+		str *ks = g_new(str, 1);
+		*ks = k;
+		g_ptr_array_add(e->ref_strs, ks);
+		g_hash_table_insert(e->refs, ks, GUINT_TO_POINTER(e->ref_strs->len));
+	}
+
+	g_string_append_c(e->out, RB_STR);
+	redis_bin_put_varint(e->out, len);
+	g_string_append_len(e->out, s, len);
+}
+
+static void redis_bin_refs_reset(struct redis_bin_enc *e) {
+	g_hash_table_remove_all(e->refs);
+	g_ptr_array_set_size(e->ref_strs, 0);
+}
+
+static void redis_bin_put_item(struct redis_bin_enc *e, bencode_item_t *item, unsigned int depth) {
+	unsigned int num = 0;
+
+	switch (item->type) {
+		case BENCODE_STRING:
+			redis_bin_put_str(e, item->iov[1].iov_base, item->iov[1].iov_len);
+			break;
+
+		case BENCODE_INTEGER:
+			g_string_append_c(e->out, RB_INT);
+			redis_bin_put_varint(e->out,
+					((uint64_t) item->value << 1) ^ (uint64_t) (item->value >> 63));
+			break;
+
+		case BENCODE_LIST:
+			for (bencode_item_t *c = item->child; c; c = c->sibling)
+				num++;
+			g_string_append_c(e->out, RB_LIST);
+			redis_bin_put_varint(e->out, num);
+			for (bencode_item_t *c = item->child; c; c = c->sibling)
+				redis_bin_put_item(e, c, depth + 1);
+			break;
+
+		case BENCODE_DICTIONARY:
+			for (bencode_item_t *c = item->child; c; c = c->sibling->sibling)
+				num++;
+			g_string_append_c(e->out, RB_DICT);
+			redis_bin_put_varint(e->out, num);
+			for (bencode_item_t *c = item->child; c; c = c->sibling->sibling) {
+				str key = STR_LEN(c->iov[1].iov_base, c->iov[1].iov_len);
+				redis_bin_put_key(e->out, &key);
+				// back-references don't cross top-level entries, so that those can
+				// be stored and reassembled individually
+				if (depth == 0)
+					redis_bin_refs_reset(e);
+				redis_bin_put_item(e, c->sibling, depth + 1);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+bool redis_bin_is(const str *s) {
+	return s->len >= REDIS_BIN_HDR_LEN && !memcmp(s->s, REDIS_BIN_MAGIC, 2);
+}
+
+static str redis_bin_encode_at(bencode_item_t *root, unsigned int depth) {
+	redis_bin_tables_init();
+
+	struct redis_bin_enc e = {
+		.out = g_string_sized_new(root->str_len / 2 + 16),
+		.refs = g_hash_table_new((GHashFunc) str_hash, (GEqualFunc) str_equal),
+		.ref_strs = g_ptr_array_new_with_free_func(g_free),
+	};
+
+	g_string_append(e.out, REDIS_BIN_MAGIC);
+	g_string_append_c(e.out, REDIS_BIN_VERSION);
+	redis_bin_put_item(&e, root, depth);
+
+	g_hash_table_destroy(e.refs);
+	g_ptr_array_free(e.ref_strs, true);
+
+	size_t len = e.out->len;
+	return STR_LEN(g_string_free(e.out, FALSE), len);
+}
+
+str redis_bin_encode(bencode_item_t *root) {
+	return redis_bin_encode_at(root, 0);
+}
+
+// encodes the value of a single top-level entry, see redis_bin_dict_add()
+str redis_bin_encode_entry(bencode_item_t *item) {
+	return redis_bin_encode_at(item, 1);
+}
+
+void redis_bin_dict_start(GString *out, unsigned int num) {
+	g_string_append(out, REDIS_BIN_MAGIC);
+	g_string_append_c(out, REDIS_BIN_VERSION);
+	g_string_append_c(out, RB_DICT);
+	redis_bin_put_varint(out, num);
+}
+
+bool redis_bin_dict_add(GString *out, const str *key, const str *encoded) {
+	if (!redis_bin_is(encoded) || encoded->s[2] != REDIS_BIN_VERSION)
+		return false;
+	redis_bin_tables_init();
+	redis_bin_put_key(out, key);
+	g_string_append_len(out, encoded->s + REDIS_BIN_HDR_LEN, encoded->len - REDIS_BIN_HDR_LEN);
+	return true;
+}
+
+str redis_fields_assemble(const str *fields, unsigned int num) {
+	if (!num)
+		return STR_NULL;
+
+	// all fields are in the same format as the first one
+	bool binary = redis_bin_is(&fields[1]);
+	bool json = !binary && fields[1].len && (fields[1].s[0] == '{' || fields[1].s[0] == '[');
+
+	GString *doc = g_string_new("");
+	if (binary)
+		redis_bin_dict_start(doc, num);
+	else
+		g_string_append_c(doc, json ? '{' : 'd');
+
+	for (unsigned int i = 0; i < num; i++) {
+		const str *key = &fields[i * 2];
+		const str *val = &fields[i * 2 + 1];
+
+		if (binary) {
+			if (!redis_bin_dict_add(doc, key, val)) {
+				g_string_free(doc, TRUE);
+				return STR_NULL;
+			}
+			continue;
+		}
+
+		if (json) {
+			if (i)
+				g_string_append_c(doc, ',');
+			g_string_append_printf(doc, "\"" STR_FORMAT "\":", STR_FMT(key));
+		}
+		else
+			g_string_append_printf(doc, "%zu:" STR_FORMAT, key->len, STR_FMT(key));
+		g_string_append_len(doc, val->s, val->len);
+	}
+
+	if (!binary)
+		g_string_append_c(doc, json ? '}' : 'e');
+
+	size_t len = doc->len;
+	return STR_LEN(g_string_free(doc, FALSE), len);
+}
+
+
+/*** DECODING ***/
+
+struct redis_bin_dec {
+	const unsigned char *p, *end;
+	bencode_buffer_t *buf;
+	GArray *refs; // str
+};
+
+static bool redis_bin_get_varint(struct redis_bin_dec *d, uint64_t *out) {
+	uint64_t v = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (d->p >= d->end)
+			return false;
+		unsigned char c = *d->p++;
+		v |= (uint64_t) (c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*out = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool redis_bin_get_bytes(struct redis_bin_dec *d, size_t len, str *out) {
+	if (len > d->end - d->p)
+		return false;
+	*out = STR_LEN((char *) d->p, len);
+	d->p += len;
+	return true;
+}
+
+static bencode_item_t *redis_bin_print(struct redis_bin_dec *d, const char *fmt, const char *pre,
+		uint64_t v)
+{
+	char *s = bencode_buffer_alloc(d->buf, 24);
+	if (!s)
+		return NULL;
+	int len = snprintf(s, 24, fmt, pre, v);
+	return bencode_string_len(d->buf, s, len);
+}
+
+static bool redis_bin_get_key(struct redis_bin_dec *d, str *out) {
+	uint64_t k, num;
+
+	if (!redis_bin_get_varint(d, &k))
+		return false;
+
+	uint64_t idx = k >> 2;
+
+	switch (k & 3) {
+		case RBK_KNOWN:
+			if (idx >= G_N_ELEMENTS(redis_bin_keys))
+				return false;
+			*out = redis_bin_key_strs[idx];
+			return true;
+
+		case RBK_PREFIX:
+			if (idx >= G_N_ELEMENTS(redis_bin_prefixes))
+				return false;
+			if (!redis_bin_get_varint(d, &num))
+				return false;
+			size_t len = redis_bin_prefix_strs[idx].len + 22;
+			char *s = bencode_buffer_alloc(d->buf, len);
+			if (!s)
+				return false;
+			*out = STR_LEN(s, snprintf(s, len, "%s-%" PRIu64, redis_bin_prefixes[idx], num));
+			return true;
+
+		case RBK_INLINE:
+			if (idx > RB_MAX_STR_LEN)
+				return false;
+			return redis_bin_get_bytes(d, idx, out);
+	}
+
+	return false;
+}
+
+static bencode_item_t *redis_bin_get_item(struct redis_bin_dec *d, unsigned int depth) {
+	uint64_t v;
+	str s;
+
+	if (depth > RB_MAX_DEPTH || d->p >= d->end)
+		return NULL;
+
+	switch (*d->p++) {
+		case RB_STR:
+			if (!redis_bin_get_varint(d, &v) || v > RB_MAX_STR_LEN)
+				return NULL;
+			if (!redis_bin_get_bytes(d, v, &s))
+				return NULL;
+			if (s.len >= RB_MIN_REF_LEN)
+				g_array_append_val(d->refs, s);
+			return bencode_string_len(d->buf, s.s, s.len);
+
+		case RB_EMPTY:
+			return bencode_string_len(d->buf, "", 0);
+
+		case RB_REF:
+			if (!redis_bin_get_varint(d, &v) || v >= d->refs->len)
+				return NULL;
+			s = g_array_index(d->refs, str, v);
+			return bencode_string_len(d->buf, s.s, s.len);
+
+		case RB_UINT:
+			if (!redis_bin_get_varint(d, &v))
+				return NULL;
+			return redis_bin_print(d, "%s%" PRIu64, "", v);
+
+		case RB_NEG:
+			if (!redis_bin_get_varint(d, &v) || !v)
+				return NULL;
+			return redis_bin_print(d, "%s%" PRIu64, "-", v);
+
+		case RB_INT:
+			if (!redis_bin_get_varint(d, &v))
+				return NULL;
+			return bencode_integer(d->buf, (long long) ((v >> 1) ^ -(v & 1)));
+
+		case RB_LIST: {
+			if (!redis_bin_get_varint(d, &v) || v > d->end - d->p)
+				return NULL;
+			bencode_item_t *list = bencode_list(d->buf);
+			if (!list)
+				return NULL;
+			for (uint64_t i = 0; i < v; i++) {
+				bencode_item_t *item = redis_bin_get_item(d, depth + 1);
+				if (!item)
+					return NULL;
+				bencode_list_add(list, item);
+			}
+			return list;
+		}
+
+		case RB_DICT: {
+			if (!redis_bin_get_varint(d, &v) || v > (d->end - d->p) / 2)
+				return NULL;
+			bencode_item_t *dict = bencode_dictionary_hashed(d->buf);
+			if (!dict)
+				return NULL;
+			for (uint64_t i = 0; i < v; i++) {
+				if (!redis_bin_get_key(d, &s))
+					return NULL;
+				if (depth == 0)
+					g_array_set_size(d->refs, 0);
+				bencode_item_t *item = redis_bin_get_item(d, depth + 1);
+				if (!item)
+					return NULL;
+				bencode_dictionary_add_len(dict, s.s, s.len, item);
+			}
+			return dict;
+		}
+	}
+
+	return NULL;
+}
+
+bencode_item_t *redis_bin_decode(bencode_buffer_t *buf, const str *s) {
+	if (!redis_bin_is(s) || s->s[2] != REDIS_BIN_VERSION)
+		return NULL;
+
+	redis_bin_tables_init();
+
+	struct redis_bin_dec d = {
+		.p = (unsigned char *) s->s + REDIS_BIN_HDR_LEN,
+		.end = (unsigned char *) s->s + s->len,
+		.buf = buf,
+		.refs = g_array_new(false, false, sizeof(str)),
+	};
+
+	bencode_item_t *ret = redis_bin_get_item(&d, 0);
+	if (ret && d.p != d.end)
+		ret = NULL;
+
+	g_array_free(d.refs, true);
+	return ret;
+}
@@ -56,6 +56,22 @@ static void add_ssrc_entry(uint32_t ssrc, struct ssrc_entry *ent, struct ssrc_ha
 	obj_hold(ent); // HT entry
 	g_queue_push_tail(&ht->q, ent);
 	obj_hold(ent); // queue entry
+
+	for (unsigned int i = 0; i < SSRC_HASH_INLINE; i++) {
+		struct ssrc_hash_slot *slot = &ht->slots[i];
+		if (slot->entry)
+			continue;
+		slot->ssrc = ssrc;
+		g_atomic_pointer_set(&slot->entry, ent);
+		break;
+	}
+}
+static bool ssrc_entry_is_inline(struct ssrc_entry *ent, struct ssrc_hash *ht) {
+	for (unsigned int i = 0; i < SSRC_HASH_INLINE; i++) {
+		if (ht->slots[i].entry == ent)
+			return true;
+	}
+	return false;
 }
 static void free_sender_report(struct ssrc_sender_report_item *i) {
 	g_slice_free1(sizeof(*i), i);
@@ -188,6 +204,18 @@ static void mos_calc_legacy(struct ssrc_stats_block *ssb) {
 }
 
 static void *find_ssrc(uint32_t ssrc, struct ssrc_hash *ht) {
+	// fast path without locking
+	for (unsigned int i = 0; i < SSRC_HASH_INLINE; i++) {
+		struct ssrc_entry *ret = g_atomic_pointer_get(&ht->slots[i].entry);
+		if (!ret)
+			return NULL; // no more entries anywhere
+		if (ht->slots[i].ssrc != ssrc)
+			continue;
+		obj_hold(ret);
+		ret->last_used = rtpe_now.tv_sec;
+		return ret;
+	}
+
 	rwlock_lock_r(&ht->lock);
 	struct ssrc_entry *ret = g_atomic_pointer_get(&ht->cache);
 	if (!ret || ret->ssrc != ssrc) {
@@ -249,7 +277,12 @@ restart:
 
 	while (G_UNLIKELY(ht->q.length > 20)) { // arbitrary limit
 		g_queue_sort(&ht->q, ssrc_time_cmp, NULL);
-		struct ssrc_entry *old_ent = g_queue_pop_head(&ht->q);
+		// oldest entry that isn't in an inline slot, those are pinned (see struct ssrc_hash)
+		GList *link = ht->q.head;
+		while (ssrc_entry_is_inline(link->data, ht))
+			link = link->next;
+		struct ssrc_entry *old_ent = link->data;
+		g_queue_delete_link(&ht->q, link);
 		ilog(LOG_DEBUG, "SSRC hash table exceeded size limit (trying to add %s%x%s) - "
 				"deleting SSRC %s%x%s",
 				FMT_M(ssrc), FMT_M(old_ent->ssrc));
@@ -8,6 +8,7 @@
 #include "main.h"
 #include "control_ng.h"
 #include "bufferpool.h"
+#include "codec.h"
 
 struct timeval rtpe_started;
 
@@ -26,6 +27,23 @@ struct global_stats_counter *rtpe_stats;			// total, cumulative, master
 struct global_stats_counter rtpe_stats_rate;			// per-second, calculated once per timer run
 struct global_stats_counter rtpe_stats_intv;			// calculated once per sec by `call_rate_stats_updater()`
 
+__thread struct stats_shard *stats_shard;
+static mutex_t stats_shards_lock = MUTEX_STATIC_INIT;
+static GQueue stats_shards = G_QUEUE_INIT;
+
+#define STATS_SHARD_ALIGN 64
+
+// Prometheus exposition, shared by all scrapes until it's out of date, and then rebuilt by
+// the next scrape. It's built at most once per second no matter how many scrapers there are,
+// and not at all when nobody is scraping.
+#define STATS_SNAPSHOT_MAX_AGE_US	1000000
+
+static mutex_t stats_snapshot_lock = MUTEX_STATIC_INIT;
+static mutex_t stats_snapshot_build_lock = MUTEX_STATIC_INIT; // one build at a time
+static struct stats_snapshot *stats_snapshot;
+static atomic64 stats_snapshot_build_us;
+static atomic64 stats_snapshot_scrapes;
+
 
 // op can be CMC_INCREMENT or CMC_DECREMENT
 // check not to multiple decrement or increment
@@ -319,13 +337,13 @@ stats_metric_q *statistics_gather_metrics(struct interface_sampled_rate_stats *i
 	double calls_dur_iv;
 	uint64_t cur_sessions, num_sessions, min_sess_iv, max_sess_iv;
 
+	stats_shards_fold();
+
 	HEADER("{", "");
 	HEADER("currentstatistics", "Statistics over currently running sessions:");
 	HEADER("{", "");
 
-	rwlock_lock_r(&rtpe_callhash_lock);
-	cur_sessions = t_hash_table_size(rtpe_callhash);
-	rwlock_unlock_r(&rtpe_callhash_lock);
+	cur_sessions = call_hash_size();
 
 	METRIC("sessionsown", "Owned sessions", UINT64F, UINT64F, cur_sessions - atomic64_get_na(&rtpe_stats_gauge.foreign_sessions));
 	PROM("sessions", "gauge");
@@ -337,6 +355,15 @@ stats_metric_q *statistics_gather_metrics(struct interface_sampled_rate_stats *i
 	METRIC("sessionstotal", "Total sessions", UINT64F, UINT64F, cur_sessions);
 	METRIC("transcodedmedia", "Transcoded media", UINT64F, UINT64F, atomic64_get_na(&rtpe_stats_gauge.transcoded_media));
 	PROM("transcoded_media", "gauge");
+	METRIC("playercachesize", "Player cache size in bytes", UINT64F, UINT64F,
+			atomic64_get_na(&rtpe_stats_gauge.player_cache_size));
+	PROM("player_cache_bytes", "gauge");
+	METRIC("playercacheentries", "Player cache entries", UINT64F, UINT64F,
+			atomic64_get_na(&rtpe_stats_gauge.player_cache_entries));
+	PROM("player_cache_entries", "gauge");
+	METRIC("playerpreloadpending", "Player cache preloads pending", UINT64F, UINT64F,
+			atomic64_get_na(&rtpe_stats_gauge.player_preload_pending));
+	PROM("player_preload_pending", "gauge");
 
 	METRIC("packetrate_user", "Packets per second (userspace)", UINT64F, UINT64F,
 			atomic64_get_na(&rtpe_stats_rate.packets_user));
@@ -446,6 +473,72 @@ stats_metric_q *statistics_gather_metrics(struct interface_sampled_rate_stats *i
 			atomic64_get_na(&rtpe_stats->bytes_kernel) +
 			atomic64_get_na(&rtpe_stats->bytes_user));
 
+	uint64_t recv_batches = atomic64_get_na(&rtpe_stats->recv_batches);
+	uint64_t recv_batch_packets = atomic64_get_na(&rtpe_stats->recv_batch_packets);
+	METRIC("recvbatches", "Total batched receive calls (userspace)", UINT64F, UINT64F, recv_batches);
+	PROM("recv_batches_total", "counter");
+	METRIC("recvbatchpackets", "Total packets received in batches (userspace)", UINT64F, UINT64F,
+			recv_batch_packets);
+	PROM("recv_batch_packets_total", "counter");
+	METRICva("avgrecvbatchdepth", "Average receive batch depth", "%.6f", "%.6f",
+			recv_batches ? (double) recv_batch_packets / recv_batches : 0.0);
+	PROM("recv_batch_depth_avg", "gauge");
+
+	uint64_t port_allocs = atomic64_get_na(&rtpe_stats->port_allocs);
+	METRIC("portallocs", "Total media port allocations", UINT64F, UINT64F, port_allocs);
+	PROM("port_allocs_total", "counter");
+	METRICva("avgportalloctime", "Average media port allocation time", "%.6f", "%.6f seconds",
+			port_allocs ? (double) atomic64_get_na(&rtpe_stats->port_alloc_time) / port_allocs / 1000000.0
+			: 0.0);
+	PROM("port_alloc_time_avg", "gauge");
+	METRIC("portalloccontention", "Total contended port pool updates", UINT64F, UINT64F,
+			atomic64_get_na(&rtpe_stats->port_alloc_contention));
+	PROM("port_alloc_contention_total", "counter");
+
+	METRICva("metricsbuildtime", "Time to build the last metrics snapshot", "%.6f", "%.6f seconds",
+			(double) atomic64_get_na(&stats_snapshot_build_us) / 1000000.0);
+	PROM("metrics_snapshot_build_seconds", "gauge");
+	METRIC("metricsscrapes", "Total metrics scrapes served", UINT64F, UINT64F,
+			atomic64_get_na(&stats_snapshot_scrapes));
+	PROM("metrics_scrapes_total", "counter");
+
+	METRIC("redisqueue", "Calls queued for Redis write-behind", UINT64F, UINT64F,
+			atomic64_get_na(&rtpe_stats_gauge.redis_write_queue));
+	PROM("redis_write_queue", "gauge");
+	uint64_t redis_writes = atomic64_get_na(&rtpe_stats->redis_writes);
+	uint64_t redis_write_batches = atomic64_get_na(&rtpe_stats->redis_write_batches);
+	METRIC("rediswrites", "Total calls written to Redis", UINT64F, UINT64F, redis_writes);
+	PROM("redis_writes_total", "counter");
+	METRICva("rediscoalesceratio", "Average call updates per Redis write", "%.6f", "%.6f",
+			redis_writes ? (double) atomic64_get_na(&rtpe_stats->redis_updates) / redis_writes : 0.0);
+	PROM("redis_coalesce_ratio", "gauge");
+	METRICva("avgrediswritetime", "Average Redis write round trip time", "%.6f", "%.6f seconds",
+			redis_write_batches ? (double) atomic64_get_na(&rtpe_stats->redis_write_time)
+			/ redis_write_batches / 1000000.0 : 0.0);
+	PROM("redis_write_time_avg", "gauge");
+	uint64_t redis_restore_time = atomic64_get_na(&rtpe_stats->redis_restore_time);
+	uint64_t redis_restored = atomic64_get_na(&rtpe_stats->redis_restored);
+	METRIC("redisrestored", "Total calls restored from Redis", UINT64F, UINT64F, redis_restored);
+	PROM("redis_restored_total", "counter");
+	METRICva("redisrestorerate", "Calls restored from Redis per second", "%.6f", "%.6f",
+			redis_restore_time ? (double) redis_restored * 1000000.0 / redis_restore_time : 0.0);
+	PROM("redis_restore_rate", "gauge");
+
+#ifndef WITHOUT_CODECLIB
+	METRIC("framepoolhits", "Total audio frame allocations served from pools", UINT64F, UINT64F,
+			atomic64_get_na(&codec_pool_stats.frame_hits));
+	PROM("frame_pool_hits_total", "counter");
+	METRIC("framepoolmisses", "Total audio frame allocations not served from pools", UINT64F, UINT64F,
+			atomic64_get_na(&codec_pool_stats.frame_misses));
+	PROM("frame_pool_misses_total", "counter");
+	METRIC("packetpoolhits", "Total codec packet allocations served from pools", UINT64F, UINT64F,
+			atomic64_get_na(&codec_pool_stats.packet_hits));
+	PROM("packet_pool_hits_total", "counter");
+	METRIC("packetpoolmisses", "Total codec packet allocations not served from pools", UINT64F, UINT64F,
+			atomic64_get_na(&codec_pool_stats.packet_misses));
+	PROM("packet_pool_misses_total", "counter");
+#endif
+
 	METRIC("zerowaystreams", "Total number of streams with no relayed packets", UINT64F, UINT64F, atomic64_get_na(&rtpe_stats->nopacket_relayed_sess));
 	PROM("zero_packet_streams_total", "counter");
 	METRIC("onewaystreams", "Total number of 1-way streams", UINT64F, UINT64F,atomic64_get_na(&rtpe_stats->oneway_stream_sess));
@@ -666,8 +759,8 @@ stats_metric_q *statistics_gather_metrics(struct interface_sampled_rate_stats *i
 
 		METRICs("min", "%u", lif->spec->port_pool.min);
 		METRICs("max", "%u", lif->spec->port_pool.max);
-		unsigned int f = g_hash_table_size(lif->spec->port_pool.free_ports_ht);
-		unsigned int r = lif->spec->port_pool.max - lif->spec->port_pool.min + 1;
+		unsigned int f = port_pool_free_count(&lif->spec->port_pool);
+		unsigned int r = port_pool_size(&lif->spec->port_pool);
 		METRICs("used", "%u", r - f);
 		PROM("ports_used", "gauge");
 		PROMLAB("name=\"%s\",address=\"%s\"", lif->logical->name.s,
@@ -872,6 +965,90 @@ stats_metric_q *statistics_gather_metrics(struct interface_sampled_rate_stats *i
 	}
 	HEADER("]", NULL);
 
+	HEADER("pollers", NULL);
+	HEADER("[", NULL);
+	for (unsigned int i = 0; rtpe_poller_load && i < num_media_pollers; i++) {
+		struct poller_load *pl = &rtpe_poller_load[i];
+
+		HEADER("{", NULL);
+
+		METRICs("index", "%u", i);
+		METRICs("calls", "%u", atomic_get_na(&pl->calls));
+		PROM("poller_calls", "gauge");
+		PROMLAB("poller=\"%u\"", i);
+		METRICs("packetrate", UINT64F, atomic64_get_na(&pl->pps));
+		PROM("poller_packetrate", "gauge");
+		PROMLAB("poller=\"%u\"", i);
+		METRICs("packets", UINT64F, atomic64_get_na(&pl->packets));
+		PROM("poller_packets_total", "counter");
+		PROMLAB("poller=\"%u\"", i);
+		METRICs("cpu_pct", "%.2f", (double) atomic64_get_na(&pl->cpu_ppm) / 10000.0);
+		PROM("poller_cpu_usage", "gauge");
+		PROMLAB("poller=\"%u\"", i);
+		METRICs("migrations", UINT64F, atomic64_get_na(&pl->migrations));
+		PROM("poller_migrations_total", "counter");
+		PROMLAB("poller=\"%u\"", i);
+
+		HEADER("}", NULL);
+	}
+	HEADER("]", NULL);
+
+	HEADER("transcodeworkers", NULL);
+	HEADER("[", NULL);
+	for (unsigned int i = 0; i < transcode_sched.num_workers; i++) {
+		struct jobsched_worker *w = &transcode_sched.workers[i];
+		uint64_t jobs = atomic64_get_na(&w->jobs);
+		uint64_t latency_sum = atomic64_get_na(&w->latency_sum);
+
+		HEADER("{", NULL);
+
+		METRICs("index", "%u", i);
+		METRICs("queuedepth", "%u", jobsched_depth(w));
+		PROM("transcode_worker_queue_depth", "gauge");
+		PROMLAB("worker=\"%u\"", i);
+		METRICs("maxqueuedepth", "%u", atomic_get_na(&w->max_depth));
+		PROM("transcode_worker_max_queue_depth", "gauge");
+		PROMLAB("worker=\"%u\"", i);
+		METRICs("jobs", UINT64F, jobs);
+		PROM("transcode_worker_jobs_total", "counter");
+		PROMLAB("worker=\"%u\"", i);
+		METRICs("steals", UINT64F, atomic64_get_na(&w->steals));
+		PROM("transcode_worker_steals_total", "counter");
+		PROMLAB("worker=\"%u\"", i);
+		METRICs("avglatency_us", UINT64F, jobs ? latency_sum / jobs : 0);
+		METRICs("latency_sum", "%.6f", (double) latency_sum / 1000000.0);
+		PROM("transcode_job_latency_seconds_sum", "counter");
+		PROMLAB("worker=\"%u\"", i);
+
+		// cumulative, as a Prometheus histogram would have it
+		HEADER("latency", NULL);
+		HEADER("[", NULL);
+		uint64_t cumul = 0;
+		for (unsigned int b = 0; b < JOBSCHED_LATENCY_BUCKETS; b++) {
+			unsigned int bound = jobsched_latency_bounds[b];
+			cumul += atomic64_get_na(&w->latency[b]);
+
+			HEADER("{", NULL);
+			if (bound == UINT_MAX) {
+				METRICs("le_us", "%s", "\"inf\"");
+				METRICs("jobs", UINT64F, cumul);
+				PROM("transcode_job_latency_seconds_bucket", "counter");
+				PROMLAB("worker=\"%u\",le=\"+Inf\"", i);
+			}
+			else {
+				METRICs("le_us", "%u", bound);
+				METRICs("jobs", UINT64F, cumul);
+				PROM("transcode_job_latency_seconds_bucket", "counter");
+				PROMLAB("worker=\"%u\",le=\"%g\"", i, (double) bound / 1000000.0);
+			}
+			HEADER("}", NULL);
+		}
+		HEADER("]", NULL);
+
+		HEADER("}", NULL);
+	}
+	HEADER("]", NULL);
+
 	mutex_lock(&rtpe_codec_stats_lock);
 	HEADER("transcoders", NULL);
 	HEADER("[", "");
@@ -929,9 +1106,81 @@ void statistics_free_metrics(stats_metric_q *q) {
 	t_queue_free_full(q, free_stats_metric);
 }
 
+static struct stats_shard_counters *stats_shard_counters_new(unsigned int num_intfs) {
+	size_t len = sizeof(struct stats_shard_counters) + num_intfs * sizeof(struct stats_shard_intf);
+	// own cache lines, not shared with anything else
+	len = (len + STATS_SHARD_ALIGN - 1) & ~(STATS_SHARD_ALIGN - 1);
+	void *ret;
+	if (posix_memalign(&ret, STATS_SHARD_ALIGN, len))
+		abort();
+	memset(ret, 0, len);
+	return ret;
+}
+
+// called once per thread on first use. shards are kept until shutdown
+struct stats_shard *stats_shard_new(void) {
+	struct stats_shard *s = g_slice_alloc0(sizeof(*s));
+	s->num_intfs = all_local_interfaces.length; // read-only during runtime
+	s->cur = stats_shard_counters_new(s->num_intfs);
+	s->folded = stats_shard_counters_new(s->num_intfs);
+
+	mutex_lock(&stats_shards_lock);
+	g_queue_push_tail(&stats_shards, s);
+	mutex_unlock(&stats_shards_lock);
+
+	return s;
+}
+
+static void stats_shard_fold(atomic64 *cur, atomic64 *folded, atomic64 *dst) {
+	uint64_t val = atomic64_get_na(cur);
+	uint64_t diff = val - atomic64_get_na(folded);
+	if (!diff)
+		return;
+	atomic64_add(dst, diff);
+	atomic64_set_na(folded, val);
+}
+
+// adds everything counted by all threads since the last run to the shared stats
+void stats_shards_fold(void) {
+	mutex_lock(&stats_shards_lock);
+
+	for (GList *l = stats_shards.head; l; l = l->next) {
+		struct stats_shard *s = l->data;
+
+#define F(x) stats_shard_fold(&s->cur->x, &s->folded->x, &rtpe_stats->x);
+#include "shard_stats_fields.inc"
+#undef F
+
+		for (GList *k = all_local_interfaces.head; k; k = k->next) {
+			struct local_intf *lif = k->data;
+			if (!lif->stats_idx || lif->stats_idx > s->num_intfs)
+				continue;
+			struct stats_shard_intf *cur = &s->cur->intf[lif->stats_idx - 1];
+			struct stats_shard_intf *folded = &s->folded->intf[lif->stats_idx - 1];
+#define F(x) \
+			stats_shard_fold(&cur->in.x, &folded->in.x, &lif->stats->in.x); \
+			stats_shard_fold(&cur->out.x, &folded->out.x, &lif->stats->out.x);
+#include "interface_counter_stats_fields_dir.inc"
+#undef F
+		}
+	}
+
+	mutex_unlock(&stats_shards_lock);
+}
+
+static void stats_shard_free(struct stats_shard *s) {
+	free(s->cur);
+	free(s->folded);
+	g_slice_free1(sizeof(*s), s);
+}
+
 void statistics_free(void) {
 	mutex_destroy(&rtpe_codec_stats_lock);
 	t_hash_table_destroy(rtpe_codec_stats);
+	g_queue_clear_full(&stats_shards, (GDestroyNotify) stats_shard_free);
+	if (stats_snapshot)
+		obj_put(stats_snapshot);
+	stats_snapshot = NULL;
 	bufferpool_unref(rtpe_stats);
 	rtpe_stats = NULL;
 }
@@ -1021,6 +1270,97 @@ const char *statistics_ng(ng_command_ctx_t *ctx) {
 	return NULL;
 }
 
+TYPED_GHASHTABLE(metric_types_ht, char, void, c_str_hash, c_str_equal, NULL, NULL)
+
+static GString *statistics_prometheus(stats_metric_q *metrics) {
+	GString *outp = g_string_new("");
+	g_auto(metric_types_ht) metric_types = metric_types_ht_new();
+
+	for (__auto_type l = metrics->head; l; l = l->next) {
+		stats_metric *m = l->data;
+		if (!m->label)
+			continue;
+		if (!m->value_short)
+			continue;
+		if (!m->prom_name)
+			continue;
+
+		if (!t_hash_table_lookup(metric_types, m->prom_name)) {
+			if (m->descr)
+				g_string_append_printf(outp, "# HELP rtpengine_%s %s\n",
+						m->prom_name, m->descr);
+			if (m->prom_type)
+				g_string_append_printf(outp, "# TYPE rtpengine_%s %s\n",
+						m->prom_name, m->prom_type);
+			t_hash_table_insert(metric_types, (void *) m->prom_name, (void *) 0x1);
+		}
+
+		g_string_append_printf(outp, "rtpengine_%s", m->prom_name);
+		if (m->prom_label)
+			g_string_append_printf(outp, "{%s}", m->prom_label);
+		g_string_append_printf(outp, " %s\n", m->value_short);
+	}
+
+
+	return outp;
+}
+
+static void stats_snapshot_free(void *p) {
+	struct stats_snapshot *s = p;
+	g_string_free(s->prom, TRUE);
+}
+
+// returns a new reference
+static struct stats_snapshot *stats_snapshot_build(void) {
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	g_autoptr(stats_metric_q) metrics = statistics_gather_metrics(NULL);
+	struct stats_snapshot *s = obj_alloc0("stats_snapshot", sizeof(*s), stats_snapshot_free);
+	s->prom = statistics_prometheus(metrics);
+	s->created = rtpe_now;
+
+	gettimeofday(&end, NULL);
+	atomic64_set_na(&stats_snapshot_build_us, timeval_diff(&end, &start));
+
+	mutex_lock(&stats_snapshot_lock);
+	struct stats_snapshot *old = stats_snapshot;
+	stats_snapshot = obj_get(s);
+	mutex_unlock(&stats_snapshot_lock);
+
+	if (old)
+		obj_put(old);
+
+	return s;
+}
+
+// returns a new reference to the current snapshot, or NULL if it's out of date
+static struct stats_snapshot *stats_snapshot_get_current(void) {
+	LOCK(&stats_snapshot_lock);
+	if (!stats_snapshot)
+		return NULL;
+	if (timeval_diff(&rtpe_now, &stats_snapshot->created) >= STATS_SNAPSHOT_MAX_AGE_US)
+		return NULL;
+	return obj_get(stats_snapshot);
+}
+
+// returns a new reference to the current snapshot, building a new one first if there is
+// none yet or if it's out of date
+struct stats_snapshot *statistics_snapshot_get(void) {
+	atomic64_inc_na(&stats_snapshot_scrapes);
+
+	struct stats_snapshot *ret = stats_snapshot_get_current();
+	if (ret)
+		return ret;
+
+	LOCK(&stats_snapshot_build_lock);
+	// concurrent scrapes wait here for the one doing the build
+	ret = stats_snapshot_get_current();
+	if (ret)
+		return ret;
+	return stats_snapshot_build();
+}
+
 /**
  * Separate thread for update of running min/max call counters.
  */
@@ -1029,6 +1369,8 @@ enum thread_looper_action call_rate_stats_updater(void) {
 
 	stats_rate_min_max(&rtpe_rate_graphite_min_max, &rtpe_stats_rate);
 
+	stats_shards_fold();
+
 	if (last_run.tv_sec) { /* `stats_counters_calc_rate()` shouldn't be called on the very first cycle */
 		long long run_diff_us = timeval_diff(&rtpe_now, &last_run);
 		stats_counters_calc_rate(rtpe_stats, run_diff_us, &rtpe_stats_intv, &rtpe_stats_rate);
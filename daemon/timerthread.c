@@ -3,6 +3,11 @@
 #include "helpers.h"
 #include "log_funcs.h"
 #include "poller.h"
+#include "main.h"
+
+
+#define tt_obj_of_node(n) ((struct timerthread_obj *) \
+		((char *) (n) - G_STRUCT_OFFSET(struct timerthread_obj, wheel_node)))
 
 
 static int tt_obj_cmp(const void *a, const void *b) {
@@ -10,8 +15,33 @@ static int tt_obj_cmp(const void *a, const void *b) {
 	return timeval_cmp_ptr(&A->next_check, &B->next_check);
 }
 
+// tt->lock must be held for these
+static void tt_insert(struct timerthread_thread *tt, struct timerthread_obj *tt_obj) {
+	if (tt->wheel)
+		timer_wheel_add(tt->wheel, &tt_obj->wheel_node, &tt_obj->next_check);
+	else
+		g_tree_insert(tt->tree, tt_obj, tt_obj);
+}
+static bool tt_remove(struct timerthread_thread *tt, struct timerthread_obj *tt_obj) {
+	if (tt->wheel)
+		return timer_wheel_del(tt->wheel, &tt_obj->wheel_node);
+	return g_tree_remove(tt->tree, tt_obj);
+}
+static struct timerthread_obj *tt_first(struct timerthread_thread *tt) {
+	if (tt->wheel) {
+		struct timer_wheel_node *n = timer_wheel_first(tt->wheel, &rtpe_now);
+		return n ? tt_obj_of_node(n) : NULL;
+	}
+	return g_tree_find_first(tt->tree, NULL, NULL);
+}
+
 static void timerthread_thread_init(struct timerthread_thread *tt, struct timerthread *parent) {
-	tt->tree = g_tree_new(tt_obj_cmp);
+	if (parent->backend == TT_BACKEND_WHEEL) {
+		tt->wheel = g_new(struct timer_wheel, 1);
+		timer_wheel_init(tt->wheel, &rtpe_now);
+	}
+	else
+		tt->tree = g_tree_new(tt_obj_cmp);
 	mutex_init(&tt->lock);
 	cond_init(&tt->cond);
 	tt->parent = parent;
@@ -21,6 +51,7 @@ static void timerthread_thread_init(struct timerthread_thread *tt, struct timert
 
 void timerthread_init(struct timerthread *tt, unsigned int num, void (*func)(void *)) {
 	tt->func = func;
+	tt->backend = rtpe_config.timer_backend;
 	tt->num_threads = num;
 	tt->threads = g_malloc(sizeof(*tt->threads) * num);
 	for (unsigned int i = 0; i < num; i++)
@@ -35,8 +66,16 @@ static int __tt_put_all(void *k, void *d, void *p) {
 }
 
 static void timerthread_thread_destroy(struct timerthread_thread *tt) {
-	g_tree_foreach(tt->tree, __tt_put_all, tt);
-	g_tree_destroy(tt->tree);
+	if (tt->wheel) {
+		struct timer_wheel_node *n;
+		while ((n = timer_wheel_steal(tt->wheel)))
+			obj_put(tt_obj_of_node(n));
+		g_free(tt->wheel);
+	}
+	else {
+		g_tree_foreach(tt->tree, __tt_put_all, tt);
+		g_tree_destroy(tt->tree);
+	}
 	if (tt->obj)
 		obj_put(tt->obj);
 	mutex_destroy(&tt->lock);
@@ -64,13 +103,12 @@ static void timerthread_run(void *p) {
 		// find the first element if we haven't determined it yet
 		struct timerthread_obj *tt_obj = tt->obj;
 		if (!tt_obj) {
-			tt_obj = g_tree_find_first(tt->tree, NULL, NULL);
+			tt_obj = tt_first(tt);
 			if (!tt_obj)
 				goto sleep_now;
 
 			// immediately steal reference
-			// XXX ideally we would have a tree_steal_first() function
-			g_tree_remove(tt->tree, tt_obj);
+			tt_remove(tt, tt_obj);
 		}
 
 		// scheduled to run? if not, then we remember this object/reference and go to sleep
@@ -128,19 +166,19 @@ void timerthread_obj_schedule_abs_nl(struct timerthread_obj *tt_obj, const struc
 
 	if (tt_obj->next_check.tv_sec && timeval_cmp(&tt_obj->next_check, tv) <= 0)
 		return; /* already scheduled sooner */
-	if (!g_tree_remove(tt->tree, tt_obj)) {
+	if (!tt_remove(tt, tt_obj)) {
 		if (tt->obj == tt_obj)
 			tt->obj = NULL;
 		else
 			obj_hold(tt_obj); /* if it wasn't removed, we make a new reference */
 	}
 	tt_obj->next_check = *tv;
-	g_tree_insert(tt->tree, tt_obj, tt_obj);
+	tt_insert(tt, tt_obj);
 	// need to wake the thread?
 	if (tt->next_wake.tv_sec && timeval_cmp(tv, &tt->next_wake) < 0) {
 		// make sure we can get picked first: move pre-picked object back into tree
 		if (tt->obj && tt->obj != tt_obj) {
-			g_tree_insert(tt->tree, tt->obj, tt->obj);
+			tt_insert(tt, tt->obj);
 			tt->obj = NULL;
 		}
 		cond_signal(&tt->cond);
@@ -158,7 +196,7 @@ void timerthread_obj_deschedule(struct timerthread_obj *tt_obj) {
 	mutex_lock(&tt->lock);
 	if (!tt_obj->next_check.tv_sec)
 		goto nope; /* already descheduled */
-	gboolean ret = g_tree_remove(tt->tree, tt_obj);
+	gboolean ret = tt_remove(tt, tt_obj);
 	if (!ret) {
 		if (tt->obj == tt_obj) {
 			tt->obj = NULL;
@@ -184,6 +222,69 @@ static int timerthread_queue_run_one(struct timerthread_queue *ttq,
 }
 
 
+static int ttqe_compare(const void *a, const void *b) {
+	const struct timerthread_queue_entry *t1 = a;
+	const struct timerthread_queue_entry *t2 = b;
+	int ret = timeval_cmp_zero(&t1->when, &t2->when);
+	if (ret)
+		return ret;
+	if (t1->idx < t2->idx)
+		return -1;
+	if (t1->idx == t2->idx)
+		return 0;
+	return 1;
+}
+
+// With the wheel backend, queue entries are kept in an intrusive list sorted by time and
+// index. Entries are nearly always queued in order, so inserting from the tail is O(1).
+// ttq->lock must be held for these.
+static void ttq_list_insert_after(struct timerthread_queue *ttq, struct timerthread_queue_entry *prev,
+		struct timerthread_queue_entry *ttqe)
+{
+	ttqe->prev = prev;
+	ttqe->next = prev ? prev->next : ttq->head;
+	if (ttqe->next)
+		ttqe->next->prev = ttqe;
+	else
+		ttq->tail = ttqe;
+	if (prev)
+		prev->next = ttqe;
+	else
+		ttq->head = ttqe;
+	ttq->num_entries++;
+}
+static void ttq_insert(struct timerthread_queue *ttq, struct timerthread_queue_entry *ttqe) {
+	if (ttq->entries) {
+		g_tree_insert(ttq->entries, ttqe, ttqe);
+		return;
+	}
+	struct timerthread_queue_entry *prev = ttq->tail;
+	while (prev && ttqe_compare(prev, ttqe) > 0)
+		prev = prev->prev;
+	ttq_list_insert_after(ttq, prev, ttqe);
+}
+static void ttq_remove(struct timerthread_queue *ttq, struct timerthread_queue_entry *ttqe) {
+	if (ttq->entries) {
+		g_tree_remove(ttq->entries, ttqe);
+		return;
+	}
+	if (ttqe->prev)
+		ttqe->prev->next = ttqe->next;
+	else
+		ttq->head = ttqe->next;
+	if (ttqe->next)
+		ttqe->next->prev = ttqe->prev;
+	else
+		ttq->tail = ttqe->prev;
+	ttqe->next = ttqe->prev = NULL;
+	ttq->num_entries--;
+}
+static struct timerthread_queue_entry *ttq_first(struct timerthread_queue *ttq) {
+	if (ttq->entries)
+		return g_tree_find_first(ttq->entries, NULL, NULL);
+	return ttq->head;
+}
+
 void timerthread_queue_run(void *ptr) {
 	struct timerthread_queue *ttq = ptr;
 
@@ -193,10 +294,10 @@ void timerthread_queue_run(void *ptr) {
 
 	mutex_lock(&ttq->lock);
 
-	while (g_tree_nnodes(ttq->entries)) {
-		struct timerthread_queue_entry *ttqe = g_tree_find_first(ttq->entries, NULL, NULL);
+	while (timerthread_queue_len(ttq)) {
+		struct timerthread_queue_entry *ttqe = ttq_first(ttq);
 		assert(ttqe != NULL);
-		g_tree_remove(ttq->entries, ttqe);
+		ttq_remove(ttq, ttqe);
 
 		mutex_unlock(&ttq->lock);
 
@@ -207,7 +308,7 @@ void timerthread_queue_run(void *ptr) {
 		if (!ret)
 			continue;
 		// couldn't send the last one. remember time to schedule
-		g_tree_insert(ttq->entries, ttqe, ttqe);
+		ttq_insert(ttq, ttqe);
 		next_send = ttqe->when;
 		break;
 	}
@@ -227,26 +328,22 @@ static int ttqe_free_all(void *k, void *v, void *d) {
 
 static void __timerthread_queue_free(void *p) {
 	struct timerthread_queue *ttq = p;
-	g_tree_foreach(ttq->entries, ttqe_free_all, ttq);
-	g_tree_destroy(ttq->entries);
+	if (ttq->entries) {
+		g_tree_foreach(ttq->entries, ttqe_free_all, ttq);
+		g_tree_destroy(ttq->entries);
+	}
+	else {
+		struct timerthread_queue_entry *ttqe;
+		while ((ttqe = ttq->head)) {
+			ttq_remove(ttq, ttqe);
+			ttqe_free_all(ttqe, ttqe, ttq);
+		}
+	}
 	mutex_destroy(&ttq->lock);
 	if (ttq->free_func)
 		ttq->free_func(p);
 }
 
-static int ttqe_compare(const void *a, const void *b) {
-	const struct timerthread_queue_entry *t1 = a;
-	const struct timerthread_queue_entry *t2 = b;
-	int ret = timeval_cmp_zero(&t1->when, &t2->when);
-	if (ret)
-		return ret;
-	if (t1->idx < t2->idx)
-		return -1;
-	if (t1->idx == t2->idx)
-		return 0;
-	return 1;
-}
- 
 void *timerthread_queue_new(const char *type, size_t size,
 		struct timerthread *tt,
 		void (*run_now_func)(struct timerthread_queue *, void *),
@@ -265,7 +362,8 @@ void *timerthread_queue_new(const char *type, size_t size,
 	ttq->free_func = free_func;
 	ttq->entry_free_func = entry_free_func;
 	mutex_init(&ttq->lock);
-	ttq->entries = g_tree_new(ttqe_compare);
+	if (tt->backend == TT_BACKEND_TREE)
+		ttq->entries = g_tree_new(ttqe_compare);
 	return ttq;
 }
 
@@ -305,22 +403,35 @@ void timerthread_queue_push(struct timerthread_queue *ttq, struct timerthread_qu
 
 	mutex_lock(&ttq->lock);
 
-	// check for most common case: no timestamp collision exists
-	if (!g_tree_lookup(ttq->entries, ttqe))
-		;
+	// this hands over ownership of cp, so we must copy the timeval out
+	struct timeval tv_send = ttqe->when;
+
+	if (!ttq->entries) {
+		// go after everything with the same timestamp
+		struct timerthread_queue_entry *prev = ttq->tail;
+		while (prev && timeval_cmp_zero(&prev->when, &ttqe->when) > 0)
+			prev = prev->prev;
+		if (prev && !timeval_cmp_zero(&prev->when, &ttqe->when))
+			ttqe->idx = prev->idx + 1;
+		ttq_list_insert_after(ttq, prev, ttqe);
+	}
 	else {
-		// something else exists with the same timestamp. find the highest idx
-		void *data[2];
-		data[0] = ttqe;
-		data[1] = 0;
-		g_tree_search(ttq->entries, __ttqe_find_last_idx, data);
-		ttqe->idx = GPOINTER_TO_UINT(data[1] + 1);
+		// check for most common case: no timestamp collision exists
+		if (!g_tree_lookup(ttq->entries, ttqe))
+			;
+		else {
+			// something else exists with the same timestamp. find the highest idx
+			void *data[2];
+			data[0] = ttqe;
+			data[1] = 0;
+			g_tree_search(ttq->entries, __ttqe_find_last_idx, data);
+			ttqe->idx = GPOINTER_TO_UINT(data[1] + 1);
+		}
+
+		g_tree_insert(ttq->entries, ttqe, ttqe);
 	}
 
-	// this hands over ownership of cp, so we must copy the timeval out
-	struct timeval tv_send = ttqe->when;
-	g_tree_insert(ttq->entries, ttqe, ttqe);
-	struct timerthread_queue_entry *first_ttqe = g_tree_find_first(ttq->entries, NULL, NULL);
+	struct timerthread_queue_entry *first_ttqe = ttq_first(ttq);
 	mutex_unlock(&ttq->lock);
 
 	// first packet in? we're probably not scheduled yet
@@ -340,11 +451,18 @@ unsigned int timerthread_queue_flush(struct timerthread_queue *ttq, void *ptr) {
 
 	unsigned int num = 0;
 	GQueue matches = G_QUEUE_INIT;
-	g_tree_find_all(&matches, ttq->entries, ttqe_ptr_match, ptr);
+	if (ttq->entries)
+		g_tree_find_all(&matches, ttq->entries, ttqe_ptr_match, ptr);
+	else {
+		for (struct timerthread_queue_entry *ttqe = ttq->head; ttqe; ttqe = ttqe->next) {
+			if (ttqe_ptr_match(ttqe, ptr))
+				g_queue_push_tail(&matches, ttqe);
+		}
+	}
 
 	while (matches.length) {
 		struct timerthread_queue_entry *ttqe = g_queue_pop_head(&matches);
-		g_tree_remove(ttq->entries, ttqe);
+		ttq_remove(ttq, ttqe);
 		if (ttq->entry_free_func)
 			ttq->entry_free_func(ttqe);
 		num++;
@@ -361,10 +479,10 @@ void timerthread_queue_flush_data(void *ptr) {
         //ilog(LOG_DEBUG, "timerthread_queue_flush_data");
 
         mutex_lock(&ttq->lock);
-        while (g_tree_nnodes(ttq->entries)) {
-                struct timerthread_queue_entry *ttqe = g_tree_find_first(ttq->entries, NULL, NULL);
+        while (timerthread_queue_len(ttq)) {
+                struct timerthread_queue_entry *ttqe = ttq_first(ttq);
                 assert(ttqe != NULL);
-                g_tree_remove(ttq->entries, ttqe);
+                ttq_remove(ttq, ttqe);
 
                 mutex_unlock(&ttq->lock);
 
@@ -384,41 +384,12 @@ static const char *websocket_http_ping(struct websocket_message *wm) {
 }
 
 
-TYPED_GHASHTABLE(metric_types_ht, char, void, c_str_hash, c_str_equal, NULL, NULL)
-
 static const char *websocket_http_metrics(struct websocket_message *wm) {
 	ilogs(http, LOG_DEBUG, "Respoding to GET /metrics");
 
-	g_autoptr(stats_metric_q) metrics = statistics_gather_metrics(NULL);
-	g_autoptr(GString) outp = g_string_new("");
-	g_auto(metric_types_ht) metric_types = metric_types_ht_new();
-
-	for (__auto_type l = metrics->head; l; l = l->next) {
-		stats_metric *m = l->data;
-		if (!m->label)
-			continue;
-		if (!m->value_short)
-			continue;
-		if (!m->prom_name)
-			continue;
-
-		if (!t_hash_table_lookup(metric_types, m->prom_name)) {
-			if (m->descr)
-				g_string_append_printf(outp, "# HELP rtpengine_%s %s\n",
-						m->prom_name, m->descr);
-			if (m->prom_type)
-				g_string_append_printf(outp, "# TYPE rtpengine_%s %s\n",
-						m->prom_name, m->prom_type);
-			t_hash_table_insert(metric_types, (void *) m->prom_name, (void *) 0x1);
-		}
-
-		g_string_append_printf(outp, "rtpengine_%s", m->prom_name);
-		if (m->prom_label)
-			g_string_append_printf(outp, "{%s}", m->prom_label);
-		g_string_append_printf(outp, " %s\n", m->value_short);
-	}
-
-	websocket_http_complete(wm->wc, 200, "text/plain", outp->len, outp->str);
+	struct stats_snapshot *snap = statistics_snapshot_get();
+	websocket_http_complete(wm->wc, 200, "text/plain", snap->prom->len, snap->prom->str);
+	obj_put(snap);
 	return NULL;
 }
 
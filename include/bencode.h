@@ -73,6 +73,10 @@ void bencode_buffer_free(bencode_buffer_t *buf);
  * Returns NULL if no memory could be allocated. */
 bencode_item_t *bencode_dictionary(bencode_buffer_t *buf);
 
+/* Same as bencode_dictionary() but with a lookup hash like a decoded dictionary has, for
+ * dictionaries that are built up for reading. */
+bencode_item_t *bencode_dictionary_hashed(bencode_buffer_t *buf);
+
 /* Creates a new empty list object. Memory will be allocated from the bencode_buffer_t object.
  * Returns NULL if no memory could be allocated. */
 bencode_item_t *bencode_list(bencode_buffer_t *buf);
@@ -105,6 +105,7 @@ enum {
 	CALL_ITERATOR_TIMER,
 	CALL_ITERATOR_GRAPHITE,
 	CALL_ITERATOR_MQTT,
+	CALL_ITERATOR_LOAD,
 
 	NUM_CALL_ITERATORS
 };
@@ -240,6 +241,7 @@ enum {
 #define CALL_FLAG_BLOCK_MEDIA			0x10000000
 #define CALL_FLAG_SILENCE_MEDIA			0x20000000
 #define CALL_FLAG_NO_REC_DB			0x40000000
+#define CALL_FLAG_REDIS_DELETED			0x80000000
 
 /* access macros */
 #define SP_ISSET(p, f)		bf_isset(&(p)->sp_flags, SP_FLAG_ ## f)
@@ -303,6 +305,7 @@ struct ice_agent;
 struct ssrc_hash;
 struct codec_handler;
 struct media_player;
+struct poller_rebalance;
 struct send_timer;
 struct transport_protocol;
 struct jitter_buffer;
@@ -722,7 +725,8 @@ struct call {
 	call_buffer_t		buffer;
 
 	// use a single poller for all sockets within the call
-	struct poller		*poller;
+	struct poller		*poller;		/* LOCK: master_lock W to change */
+	uint64_t		load_packets;		/* poller load updater only */
 
 	/* master_lock protects the entire call and all the contained objects.
 	 * 
@@ -762,6 +766,9 @@ struct call {
 
 	unsigned int		redis_hosted_db;
 	atomic64		last_redis_update;
+	mutex_t			redis_lock;		// protects redis_fields and redis_version
+	GHashTable		*redis_fields;		// delta updates: field -> digest last written
+	uint64_t		redis_version;
 
 	struct recording 	*recording;
 	str			metadata;
@@ -782,22 +789,38 @@ struct call {
 
 /**
  * The main entry point into call objects for signalling events is the call-ID:
- * Therefore the main entry point is the global hash table rtpe_callhash (protected by rtpe_callhash_lock),
+ * Therefore the main entry point is the global hash table rtpe_callhash,
  * which uses call-IDs as keys and call objects as values,
  * while holding a reference to each contained call.
+ * It's split into CALL_HASH_SHARDS shards by call-ID hash, each protected by its own lock,
+ * so that signalling for unrelated calls doesn't contend on a single lock.
  */
 TYPED_GHASHTABLE(rtpe_calls_ht, str, struct call, str_hash, str_equal, NULL, NULL)
 
-extern rwlock_t rtpe_callhash_lock;
-extern rtpe_calls_ht rtpe_callhash;
+#define CALL_HASH_SHARD_BITS 6
+#define CALL_HASH_SHARDS (1 << CALL_HASH_SHARD_BITS)
+
+struct call_hash_shard {
+	rwlock_t		lock;
+	rtpe_calls_ht		ht;
+} __attribute__ ((aligned (64)));
+
+extern struct call_hash_shard rtpe_callhash[CALL_HASH_SHARDS];
 extern struct call_iterator_list rtpe_call_iterators[NUM_CALL_ITERATORS];
 extern __thread call_t *call_memory_arena;
 
+INLINE struct call_hash_shard *call_hash_shard(const str *callid) {
+	// top bits of a multiplicative hash, independent of the bucket the shard's own table picks
+	return &rtpe_callhash[(str_hash(callid) * 0x9e3779b1U) >> (32 - CALL_HASH_SHARD_BITS)];
+}
+
 
 
 int call_init(void);
 void call_free(void);
 
+unsigned int call_hash_size(void);
+
 struct call_monologue *__monologue_create(call_t *call);
 void __monologue_free(struct call_monologue *m);
 void __monologue_tag(struct call_monologue *ml, const str *tag);
@@ -859,6 +882,7 @@ int call_stream_address(GString *, struct packet_stream *ps, enum stream_address
 
 void add_total_calls_duration_in_interval(struct timeval *interval_tv);
 enum thread_looper_action call_timer(void);
+void call_poller_rebalance(struct poller_rebalance *);
 
 void __rtp_stats_update(GHashTable *dst, struct codec_store *);
 int __init_stream(struct packet_stream *ps);
@@ -11,6 +11,7 @@
 #include "rtplib.h"
 #include "timerthread.h"
 #include "types.h"
+#include "jobsched.h"
 
 struct call_media;
 struct codec_handler;
@@ -91,6 +92,8 @@ typedef union {
 } codec_timer_callback_arg_t __attribute__ ((__transparent_union__));
 
 
+extern struct jobsched transcode_sched; // unused without codec_num_threads
+
 void codecs_init(void);
 void codecs_cleanup(void);
 void codec_timers_launch(void);
@@ -6,11 +6,11 @@
 
 #include "helpers.h"
 #include "str.h"
+#include "obj.h"
 
-struct cookie_cache_state {
-	GHashTable *in_use;
-	GHashTable *cookies;
-};
+#define COOKIE_CACHE_SHARDS		16
+#define COOKIE_CACHE_BUCKETS		4
+#define COOKIE_CACHE_BUCKET_SECS	10	// entries are kept for 30 to 40 seconds
 
 typedef struct cache_entry {
 	str *reply;
@@ -18,29 +18,31 @@ typedef struct cache_entry {
 	int command;
 } cache_entry;
 
-INLINE cache_entry *cache_entry_dup(const cache_entry *s) {
-	if (!s)
-		return NULL;
-	cache_entry *r;
-	r = malloc(sizeof(*r));
-	r->reply = str_dup(s->reply);
-	r->command = s->command;
-	r->callid = str_dup(s->callid);
-	return r;
-}
-INLINE void cache_entry_free(void *p) {
-	cache_entry *s = p;
-	if (!s)
-		return;
-	free(s->reply);
-	free(s->callid);
-	free(s);
-}
-struct cookie_cache {
+// Replies are kept in one refcounted allocation each, and handed out by reference. Each
+// shard files its entries into a ring of time buckets, so that expiring them only touches
+// the oldest bucket.
+struct cookie_cache_entry {
+	struct obj obj;
+	cache_entry ce;
+	str cookie, reply, callid;
+	unsigned int bucket;
+	GList link;
+	size_t size;
+};
+
+struct cookie_cache_shard {
 	mutex_t lock;
 	cond_t cond;
-	struct cookie_cache_state current, old;
-	time_t swap_time;
+	GHashTable *in_use;
+	GHashTable *cookies;
+	GQueue buckets[COOKIE_CACHE_BUCKETS];
+	time_t slot;
+	size_t size;
+};
+
+struct cookie_cache {
+	struct cookie_cache_shard shards[COOKIE_CACHE_SHARDS];
+	size_t max_shard_size;
 };
 
 void cookie_cache_init(struct cookie_cache *);
@@ -49,4 +51,13 @@ void cookie_cache_insert(struct cookie_cache *, const str *, const struct cache_
 void cookie_cache_remove(struct cookie_cache *, const str *);
 void cookie_cache_cleanup(struct cookie_cache *);
 
+// releases an entry returned by cookie_cache_lookup()
+INLINE void cache_entry_put(cache_entry *ce) {
+	if (!ce)
+		return;
+	struct cookie_cache_entry *e = (void *) ((char *) ce
+			- G_STRUCT_OFFSET(struct cookie_cache_entry, ce));
+	obj_put(e);
+}
+
 #endif
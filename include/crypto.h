@@ -53,6 +53,7 @@ struct crypto_suite {
 	session_key_cleanup_func session_key_cleanup;
 	//const char *dtls_profile_code; // unused
 	const EVP_CIPHER *aes_evp;
+	const EVP_CIPHER *aes_ctr_evp;
 	unsigned int idx; // filled in during crypto_init_main()
 	str name_str; // same as `name`
 	const EVP_CIPHER *(*aead_evp)(void);
@@ -92,6 +93,7 @@ struct crypto_context {
 	/* <from, to>? */
 
 	void *session_key_ctx[2];
+	void *session_auth_ctx; /* HMAC keyed with session_auth_key, created on first use */
 
 	unsigned int have_session_key:1;
 };
@@ -7,6 +7,8 @@
 #include "socket.h"
 #include "auxlib.h"
 #include "types.h"
+#include "timerthread.h"
+#include "poller_load.h"
 
 enum xmlrpc_format {
 	XF_SEMS = 0,
@@ -59,6 +61,8 @@ enum endpoint_learning {
 	X(redis_connect_timeout) \
 	X(redis_delete_async) \
 	X(redis_delete_async_interval) \
+	X(redis_write_threads) \
+	X(redis_write_delay) \
 	X(num_threads) \
 	X(media_num_threads) \
 	X(codec_num_threads) \
@@ -81,6 +85,8 @@ enum endpoint_learning {
 	X(amr_cn_dtx) \
 	X(kernel_player) \
 	X(kernel_player_media) \
+	X(player_cache_size) \
+	X(cookie_cache_size) \
 	X(audio_buffer_length) \
 	X(audio_buffer_delay) \
 	X(mqtt_port) \
@@ -89,7 +95,10 @@ enum endpoint_learning {
 	X(mqtt_publish_interval) \
 	X(rtcp_interval) \
 	X(cpu_affinity) \
-	X(max_recv_iters)
+	X(max_recv_iters) \
+	X(recv_batch_size) \
+	X(send_batch_size) \
+	X(poller_rebalance_interval)
 
 #define RTPE_CONFIG_UINT64_PARAMS \
 	X(bw_limit)
@@ -101,6 +110,7 @@ enum endpoint_learning {
 	X(reject_invalid_sdp) \
 	X(save_interface_ports) \
 	X(no_redis_required) \
+	X(redis_delta) \
 	X(active_switchover) \
 	X(rec_egress) \
 	X(nftables_append) \
@@ -110,6 +120,7 @@ enum endpoint_learning {
 	X(dtmf_no_log_injects) \
 	X(jb_clock_drift) \
 	X(player_cache) \
+	X(player_cache_mmap) \
 	X(poller_per_thread) \
 	X(measure_rtp)
 
@@ -171,7 +182,9 @@ enum endpoint_learning {
 
 #define RTPE_CONFIG_CHARPP_PARAMS \
 	X(http_ifs) \
-	X(https_ifs)
+	X(https_ifs) \
+	X(player_cache_preload) \
+	X(player_cache_preload_codecs)
 
 // these are not automatically included in rtpe_config due to different types
 #define RTPE_CONFIG_ENUM_PARAMS \
@@ -184,7 +197,9 @@ enum endpoint_learning {
 	X(dtls_signature) \
 	X(use_audio_player) \
 	X(mqtt_publish_scope) \
-	X(mos)
+	X(mos) \
+	X(timer_backend) \
+	X(poller_assignment)
 
 struct rtpengine_config {
 	rwlock_t		keyspaces_lock;
@@ -235,6 +250,7 @@ RTPE_CONFIG_CHARPP_PARAMS
 	enum {
 		REDIS_FORMAT_BENCODE = 0,
 		REDIS_FORMAT_JSON,
+		REDIS_FORMAT_BINARY,
 
 		__REDIS_FORMAT_MAX
 	}			redis_format;
@@ -266,6 +282,8 @@ RTPE_CONFIG_CHARPP_PARAMS
 		MOS_CQ = 0,
 		MOS_LQ,
 	}			mos;
+	enum timerthread_backend timer_backend;
+	enum poller_assignment poller_assignment;
 };
 
 
@@ -13,6 +13,7 @@
 #include "socket.h"
 #include "containers.h"
 #include "types.h"
+#include "port_pool.h"
 
 #include "xt_RTPENGINE.h"
 #include "common_stats.h"
@@ -81,14 +82,6 @@ struct logical_intf {
 	GHashTable			*rr_specs;
 	str				name_base; // if name is "foo:bar", this is "foo"
 };
-struct port_pool {
-	unsigned int			min, max;
-
-	mutex_t				free_list_lock;
-
-	GQueue				free_ports_q;		/* for getting the next free port */
-	GHashTable			* free_ports_ht;	/* for a lookup, if the port is used */
-};
 struct intf_address {
 	socktype_t			*type;
 	sockaddr_t			addr;
@@ -160,6 +153,7 @@ struct local_intf {
 	str				ice_foundation;
 
 	struct interface_stats_block	*stats;
+	unsigned int			stats_idx; /* starting with 1 - into per-thread stats shards */
 };
 struct socket_intf_list {
 	struct local_intf		*local_intf;
@@ -280,6 +274,7 @@ int get_consecutive_ports(socket_intf_list_q *out, unsigned int num_ports, unsig
 stream_fd *stream_fd_new(socket_t *fd, call_t *call, struct local_intf *lif);
 stream_fd *stream_fd_lookup(const endpoint_t *);
 void stream_fd_release(stream_fd *);
+bool stream_fd_migrate(stream_fd *, struct poller *);
 enum thread_looper_action release_closed_sockets(void);
 void append_thread_lpr_to_glob_lpr(void);
 
@@ -0,0 +1,77 @@
+#ifndef _POLLER_LOAD_H_
+#define _POLLER_LOAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "auxlib.h"
+#include "helpers.h"
+
+
+// Per-poller load accounting, one entry for each media poller. Each poller thread counts the
+// packets it handles and publishes its CPU clock, and a once-per-second updater turns these
+// into rates. New calls can then be placed on the least loaded poller instead of round-robin,
+// and calls can be moved off a poller that carries more than its share.
+
+enum poller_assignment {
+	PA_ROUND_ROBIN = 0,
+	PA_LOAD,
+};
+
+struct poller;
+
+struct poller_load {
+	struct poller			*poller;
+
+	atomic64			packets;		/* written by the poller thread only */
+	unsigned int			calls;			/* atomic, calls currently assigned */
+	unsigned int			new_calls;		/* atomic, assigned since the last update */
+	atomic64			migrations;		/* calls moved away from this poller */
+
+	atomic64			pps;			/* packets per second */
+	atomic64			cpu_ppm;		/* smoothed CPU usage, millionths of a core */
+
+	clockid_t			clock;
+	bool				have_clock;		/* atomic, set once `clock` is valid */
+	uint64_t			last_packets;		/* updater only */
+	uint64_t			last_cpu_us;		/* updater only */
+} __attribute__ ((aligned (64)));
+
+// one pass of moving calls from the busiest to the idlest poller. `from` is NULL if the
+// load is even, and only the per-call rates are sampled
+struct poller_rebalance {
+	struct poller			*from, *to;
+	uint64_t			budget_ppm;		/* how much load to move */
+	uint64_t			from_ppm, from_pps;	/* to estimate the cost of a call */
+	unsigned int			interval;		/* seconds since the last pass */
+	unsigned int			moved;
+};
+
+extern struct poller_load *rtpe_poller_load; // NULL, or one for each media poller
+extern __thread struct poller_load *poller_thread_load;
+
+
+void poller_load_init(void);
+void poller_load_free(void);
+// called by each poller thread before entering its loop
+void poller_load_thread_init(struct poller *);
+
+// picks a media poller for a new call, to be released through poller_load_release()
+struct poller *poller_load_assign(void);
+void poller_load_release(struct poller *);
+// a call has been moved from one poller to another
+void poller_load_migrated(struct poller *from, struct poller *to);
+
+enum thread_looper_action poller_load_updater(void);
+
+// whether calls can be moved between pollers at all
+bool poller_load_can_migrate(void);
+
+
+INLINE void poller_load_packets(unsigned int num) {
+	if (poller_thread_load)
+		atomic64_add_na(&poller_thread_load->packets, num);
+}
+
+
+#endif
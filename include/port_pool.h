@@ -0,0 +1,48 @@
+#ifndef _PORT_POOL_H_
+#define _PORT_POOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "auxlib.h"
+
+
+// Lock-free pool of local ports. Free ports are tracked in a bitmap (one bit per port,
+// set = free), and allocation walks a randomised ring of all ports in the range, so that
+// released ports are only reused after all others have had their turn. Each thread takes
+// a chunk of ring positions at a time to keep the shared cursor from bouncing between
+// CPUs.
+
+struct port_pool {
+	unsigned int			min, max;
+
+	unsigned int			bitmap_base;		/* port number of bit 0, 64-aligned */
+	atomic64			*bitmap;		/* set bit = free port */
+	unsigned int			free_ports;		/* atomic */
+
+	uint16_t			*ring;			/* all ports in the range, shuffled */
+	unsigned int			ring_len;
+	unsigned int			ring_pos;		/* atomic, next chunk to hand out */
+};
+
+
+bool port_pool_init(struct port_pool *, unsigned int min, unsigned int max);
+void port_pool_cleanup(struct port_pool *);
+
+// returns first port of `num` consecutive ports (even if num > 1), or 0 if none are left.
+// `contention` is incremented for each time another thread got in the way.
+unsigned int port_pool_get(struct port_pool *, unsigned int num, unsigned int *contention);
+// takes a specific port, returns false if it's already in use or out of range
+bool port_pool_reserve(struct port_pool *, unsigned int port);
+void port_pool_release(struct port_pool *, unsigned int port);
+
+INLINE unsigned int port_pool_free_count(const struct port_pool *pp) {
+	return atomic_get_na(&pp->free_ports);
+}
+INLINE unsigned int port_pool_size(const struct port_pool *pp) {
+	if (pp->max < pp->min)
+		return 0;
+	return pp->max - pp->min + 1;
+}
+
+
+#endif
@@ -86,6 +86,9 @@ extern struct redis		*rtpe_redis_notify;
 
 void redis_notify_loop(void *d);
 void redis_delete_async_loop(void *d);
+void redis_wb_launch(void);
+void redis_wb_stop(void);
+void redis_wb_free(void);
 
 
 struct redis *redis_new(const endpoint_t *, int, const char *, enum redis_role, int);
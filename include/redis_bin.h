@@ -0,0 +1,39 @@
+#ifndef _REDIS_BIN_H_
+#define _REDIS_BIN_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "bencode.h"
+#include "str.h"
+
+
+// Compact binary serialisation of the bencode tree that describes a call in Redis. The
+// document starts with REDIS_BIN_MAGIC followed by a version byte. Dictionary keys are
+// integers referring to a fixed table of known keys (optionally with a numeric suffix, as in
+// "stream-3"), numeric strings are stored as varints, and repeated strings as references to
+// their first occurrence within the same top-level entry. Anything else is stored as
+// length-prefixed raw bytes. Decoding yields a bencode tree whose strings point into the
+// input wherever possible, so the input must outlive the tree.
+
+#define REDIS_BIN_MAGIC		"RB"
+#define REDIS_BIN_VERSION	1
+#define REDIS_BIN_HDR_LEN	3
+
+
+bool redis_bin_is(const str *);
+str redis_bin_encode(bencode_item_t *root); // result must be g_free()d
+bencode_item_t *redis_bin_decode(bencode_buffer_t *, const str *);
+
+// for reassembling a document out of top-level entries encoded with redis_bin_encode_entry()
+str redis_bin_encode_entry(bencode_item_t *); // result must be g_free()d
+void redis_bin_dict_start(GString *, unsigned int num);
+bool redis_bin_dict_add(GString *, const str *key, const str *encoded);
+
+// Reassembles a call document stored as a Redis hash (see --redis-delta) out of `num` pairs
+// of top-level key and encoded value, in any of the supported formats. Returns STR_NULL on
+// error, otherwise the result must be g_free()d.
+str redis_fields_assemble(const str *fields, unsigned int num);
+
+
+#endif
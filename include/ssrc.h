@@ -18,8 +18,21 @@ enum ssrc_dir;
 
 typedef struct ssrc_entry *(*ssrc_create_func_t)(void *uptr);
 
+#define SSRC_HASH_INLINE 4
+
+struct ssrc_hash_slot {
+	uint32_t ssrc;
+	struct ssrc_entry *entry; // atomic, shares the reference from ht
+};
+
 struct ssrc_hash {
-	GHashTable *ht;
+	// The first few entries are also kept here. These slots are filled in order and
+	// never cleared or evicted, which makes it safe to search them without a lock.
+	// Their entries are pinned for the lifetime of the hash: the size limit only evicts
+	// other entries, so after SSRC changes up to SSRC_HASH_INLINE stale entries stay
+	// around, and newer SSRCs are looked up under the lock.
+	struct ssrc_hash_slot slots[SSRC_HASH_INLINE];
+	GHashTable *ht; // all entries
 	GQueue q;
 	rwlock_t lock;
 	ssrc_create_func_t create_func;
@@ -5,6 +5,7 @@
 #include "bencode.h"
 #include "control_ng.h"
 #include "graphite.h"
+#include "common_stats.h"
 
 // "gauge" style stats
 struct global_stats_gauge {
@@ -163,6 +164,50 @@ extern struct global_stats_counter rtpe_stats_intv;		// per-second, calculated o
 #define RTPE_STATS_ADD(field, num) atomic64_add_na(&rtpe_stats->field, num)
 #define RTPE_STATS_INC(field) RTPE_STATS_ADD(field, 1)
 
+// Per-packet counters are kept in per-thread shards so that threads don't all write to the
+// same cache lines, and are only added to `rtpe_stats` and the interface stats by
+// `stats_shards_fold()`, which must be called before reading those.
+struct stats_shard_intf {
+	struct interface_counter_stats_dir in, out;
+};
+struct stats_shard_counters {
+#define F(x) atomic64 x;
+#include "shard_stats_fields.inc"
+#undef F
+	struct stats_shard_intf intf[]; // indexed by `local_intf->stats_idx` - 1
+};
+struct stats_shard {
+	struct stats_shard_counters *cur; // written by the owning thread only
+	struct stats_shard_counters *folded; // values already added to the shared stats
+	unsigned int num_intfs;
+};
+
+extern __thread struct stats_shard *stats_shard;
+
+struct stats_shard *stats_shard_new(void);
+void stats_shards_fold(void);
+
+INLINE struct stats_shard *stats_shard_get(void) {
+	if (G_UNLIKELY(!stats_shard))
+		stats_shard = stats_shard_new();
+	return stats_shard;
+}
+
+#define RTPE_STATS_SHARD_ADD(field, num) atomic64_add_single(&stats_shard_get()->cur->field, num)
+#define RTPE_STATS_SHARD_INC(field) RTPE_STATS_SHARD_ADD(field, 1)
+
+// interfaces created after the shard was (i.e. in tests) go to the shared stats directly
+#define INTF_STATS_SHARD_ADD(lif, dir, field, num) \
+	do { \
+		struct local_intf *__lif = (lif); \
+		struct stats_shard *__s = stats_shard_get(); \
+		if (G_LIKELY(__lif->stats_idx && __lif->stats_idx <= __s->num_intfs)) \
+			atomic64_add_single(&__s->cur->intf[__lif->stats_idx - 1].dir.field, num); \
+		else \
+			atomic64_add_na(&__lif->stats->dir.field, num); \
+	} while (0)
+#define INTF_STATS_SHARD_INC(lif, dir, field) INTF_STATS_SHARD_ADD(lif, dir, field, 1)
+
 
 
 void statistics_update_oneway(call_t *);
@@ -173,7 +218,15 @@ void statistics_update_foreignown_inc(call_t * c);
 stats_metric_q *statistics_gather_metrics(struct interface_sampled_rate_stats *);
 void statistics_free_metrics(stats_metric_q *);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(stats_metric_q, statistics_free_metrics)
+// pre-formatted metrics, refcounted and read-only once published
+struct stats_snapshot {
+	struct obj obj;
+	GString *prom; // Prometheus exposition format
+	struct timeval created;
+};
+
 const char *statistics_ng(ng_command_ctx_t *);
+struct stats_snapshot *statistics_snapshot_get(void);
 enum thread_looper_action call_rate_stats_updater(void);
 
 /**
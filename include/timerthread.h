@@ -6,12 +6,19 @@
 
 #include "auxlib.h"
 #include "obj.h"
+#include "timerwheel.h"
+
+enum timerthread_backend {
+	TT_BACKEND_TREE = 0,
+	TT_BACKEND_WHEEL,
+};
 
 struct timerthread;
 
 struct timerthread_thread {
 	struct timerthread *parent;
-	GTree *tree; // XXX investigate other structures
+	GTree *tree; // TT_BACKEND_TREE
+	struct timer_wheel *wheel; // TT_BACKEND_WHEEL
 	mutex_t lock;
 	cond_t cond;
 	struct timeval next_wake;
@@ -23,6 +30,7 @@ struct timerthread {
 	struct timerthread_thread *threads;
 	unsigned int thread_idx;
 	void (*func)(void *);
+	enum timerthread_backend backend;
 };
 
 struct timerthread_obj {
@@ -32,13 +40,16 @@ struct timerthread_obj {
 	struct timerthread_thread *thread; // set once and then static
 	struct timeval next_check; /* protected by ->lock */
 	struct timeval last_run; /* ditto */
+	struct timer_wheel_node wheel_node; /* ditto */
 };
 
 struct timerthread_queue {
 	struct timerthread_obj tt_obj;
 	const char *type;
 	mutex_t lock;
-	GTree *entries;
+	GTree *entries; // TT_BACKEND_TREE
+	struct timerthread_queue_entry *head, *tail; // TT_BACKEND_WHEEL: sorted list
+	unsigned int num_entries; // ditto
 	void (*run_now_func)(struct timerthread_queue *, void *);
 	void (*run_later_func)(struct timerthread_queue *, void *);
 	void (*free_func)(void *);
@@ -49,10 +60,12 @@ struct timerthread_queue_entry {
 	struct timeval when;
 	unsigned int idx; // for equal timestamps
 	void *source; // opaque
+	struct timerthread_queue_entry *next, *prev; // TT_BACKEND_WHEEL
 	char __rest[0];
 };
 
 
+// backend is taken from rtpe_config.timer_backend
 void timerthread_init(struct timerthread *, unsigned int, void (*)(void *));
 void timerthread_free(struct timerthread *);
 void timerthread_launch(struct timerthread *, const char *scheduler, int prio, const char *name);
@@ -73,6 +86,12 @@ void timerthread_queue_flush_data(void *ptr);
 void timerthread_queue_push(struct timerthread_queue *, struct timerthread_queue_entry *);
 unsigned int timerthread_queue_flush(struct timerthread_queue *, void *);
 
+INLINE unsigned int timerthread_queue_len(struct timerthread_queue *ttq) {
+	if (ttq->entries)
+		return g_tree_nnodes(ttq->entries);
+	return ttq->num_entries;
+}
+
 INLINE struct timerthread_thread *timerthread_get_next(struct timerthread *tt) {
 	unsigned int idx = g_atomic_int_add(&tt->thread_idx, 1);
 	idx = idx % tt->num_threads; // XXX check perf without %
@@ -73,6 +73,13 @@ static const char *avc_encoder_init(encoder_t *enc, const str *);
 static int avc_encoder_input(encoder_t *enc, AVFrame **frame);
 static void avc_encoder_close(encoder_t *enc);
 
+static void g711_init(void);
+static void g711_def_init(struct codec_def_s *);
+static const char *g711_decoder_init(decoder_t *, const str *);
+static int g711_decoder_input(decoder_t *dec, const str *data, GQueue *out);
+static const char *g711_encoder_init(encoder_t *enc, const str *);
+static int g711_encoder_input(encoder_t *enc, AVFrame **frame);
+
 static int amr_decoder_input(decoder_t *dec, const str *data, GQueue *out);
 static void amr_encoder_got_packet(encoder_t *enc);
 static int ilbc_decoder_input(decoder_t *dec, const str *data, GQueue *out);
@@ -297,6 +304,13 @@ static const codec_type_t codec_type_avcodec = {
 	.encoder_input = avc_encoder_input,
 	.encoder_close = avc_encoder_close,
 };
+static const codec_type_t codec_type_g711 = {
+	.def_init = g711_def_init,
+	.decoder_init = g711_decoder_init,
+	.decoder_input = g711_decoder_input,
+	.encoder_init = g711_encoder_init,
+	.encoder_input = g711_encoder_input,
+};
 static const codec_type_t codec_type_libopus = {
 	.decoder_init = libopus_decoder_init,
 	.decoder_input = libopus_decoder_input,
@@ -398,7 +412,7 @@ static struct codec_def_s __codec_defs[] = {
 		.packetizer = packetizer_samplestream,
 		.bits_per_sample = 8,
 		.media_type = MT_AUDIO,
-		.codec_type = &codec_type_avcodec,
+		.codec_type = &codec_type_g711,
 		.silence_pattern = STR_CONST("\xd5"),
 		.dtx_methods = {
 			[DTX_SILENCE] = &dtx_method_silence,
@@ -415,7 +429,7 @@ static struct codec_def_s __codec_defs[] = {
 		.packetizer = packetizer_samplestream,
 		.bits_per_sample = 8,
 		.media_type = MT_AUDIO,
-		.codec_type = &codec_type_avcodec,
+		.codec_type = &codec_type_g711,
 		.silence_pattern = STR_CONST("\xff"),
 		.dtx_methods = {
 			[DTX_SILENCE] = &dtx_method_silence,
@@ -857,6 +871,321 @@ static GHashTable *codecs_ht;
 static GHashTable *codecs_ht_by_av;
 
 
+// per-thread recycling of frames and packets
+
+#define FRAME_POOL_SLOTS 8		// distinct frame layouts per thread
+#define PACKET_POOL_SLOTS 4		// distinct packet sizes per thread
+#define POOL_SPARES 32			// unused AVFrame and AVPacket structs kept per thread
+#define FRAME_POOL_GRANULE 32		// frame sizes are rounded up to this many samples
+#define PACKET_POOL_GRANULE 64		// packet sizes are rounded up to this many bytes
+#define POOL_STATS_FLUSH 256		// local events before updating the global counters
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+typedef size_t av_buffer_size_t;
+#else
+typedef int av_buffer_size_t;
+#endif
+
+struct frame_pool {
+	enum AVSampleFormat format;
+	int channels;
+	int capacity;			// samples
+	AVBufferPool *bufs;		// one buffer per plane
+	unsigned int last_used;
+};
+
+struct packet_pool {
+	int capacity;			// bytes, excluding padding
+	AVBufferPool *bufs;
+	unsigned int last_used;
+};
+
+struct codec_pools {
+	struct frame_pool frames[FRAME_POOL_SLOTS];
+	struct packet_pool packets[PACKET_POOL_SLOTS];
+	unsigned int clock;
+
+	AVFrame *spare_frames[POOL_SPARES];
+	unsigned int num_spare_frames;
+	AVPacket *spare_packets[POOL_SPARES];
+	unsigned int num_spare_packets;
+
+	unsigned int frame_hits, frame_misses;
+	unsigned int packet_hits, packet_misses;
+	unsigned int events;
+
+	unsigned int frame_buf_allocs, packet_buf_allocs;
+};
+
+struct codec_pool_stats codec_pool_stats;
+
+static __thread struct codec_pools codec_pools;
+
+
+static void __codec_pools_flush_stats(struct codec_pools *cp) {
+	atomic64_add_na(&codec_pool_stats.frame_hits, cp->frame_hits);
+	atomic64_add_na(&codec_pool_stats.frame_misses, cp->frame_misses);
+	atomic64_add_na(&codec_pool_stats.packet_hits, cp->packet_hits);
+	atomic64_add_na(&codec_pool_stats.packet_misses, cp->packet_misses);
+	cp->frame_hits = cp->frame_misses = cp->packet_hits = cp->packet_misses = 0;
+	cp->events = 0;
+}
+INLINE void __codec_pools_event(struct codec_pools *cp) {
+	if (G_UNLIKELY(++cp->events >= POOL_STATS_FLUSH))
+		__codec_pools_flush_stats(cp);
+}
+// one hit or miss per frame or packet handed out, no matter how many parts it's made of
+INLINE void __codec_pools_frame(struct codec_pools *cp, bool hit) {
+	if (hit)
+		cp->frame_hits++;
+	else
+		cp->frame_misses++;
+	__codec_pools_event(cp);
+}
+INLINE void __codec_pools_packet(struct codec_pools *cp, bool hit) {
+	if (hit)
+		cp->packet_hits++;
+	else
+		cp->packet_misses++;
+	__codec_pools_event(cp);
+}
+
+// only called when a pool is empty. The pools are only drawn from by their owning thread,
+// so this is always the owner
+static AVBufferRef *__frame_pool_buf_alloc(void *opaque, av_buffer_size_t size) {
+	codec_pools.frame_buf_allocs++;
+	return av_buffer_alloc(size);
+}
+static AVBufferRef *__packet_pool_buf_alloc(void *opaque, av_buffer_size_t size) {
+	codec_pools.packet_buf_allocs++;
+	return av_buffer_alloc(size);
+}
+
+static struct frame_pool *__frame_pool(struct codec_pools *cp, enum AVSampleFormat format, int channels,
+		int nb_samples)
+{
+	struct frame_pool *lru = &cp->frames[0];
+
+	for (unsigned int i = 0; i < FRAME_POOL_SLOTS; i++) {
+		struct frame_pool *fp = &cp->frames[i];
+		if (fp->bufs && fp->format == format && fp->channels == channels
+				&& fp->capacity >= nb_samples && fp->capacity - nb_samples < FRAME_POOL_GRANULE)
+		{
+			fp->last_used = ++cp->clock;
+			return fp;
+		}
+		if (!fp->bufs || (lru->bufs && fp->last_used < lru->last_used))
+			lru = fp;
+	}
+
+	// buffers still in use when a pool is replaced keep it alive until they're released
+	av_buffer_pool_uninit(&lru->bufs);
+
+	int capacity = (nb_samples + FRAME_POOL_GRANULE - 1) / FRAME_POOL_GRANULE * FRAME_POOL_GRANULE;
+	int plane_size;
+	if (av_samples_get_buffer_size(&plane_size, channels, capacity, format, 0) < 0)
+		return NULL;
+
+	lru->bufs = av_buffer_pool_init2(plane_size, NULL, __frame_pool_buf_alloc, NULL);
+	if (!lru->bufs)
+		return NULL;
+	lru->format = format;
+	lru->channels = channels;
+	lru->capacity = capacity;
+	lru->last_used = ++cp->clock;
+	return lru;
+}
+
+static struct packet_pool *__packet_pool(struct codec_pools *cp, int size) {
+	struct packet_pool *lru = &cp->packets[0];
+
+	for (unsigned int i = 0; i < PACKET_POOL_SLOTS; i++) {
+		struct packet_pool *pp = &cp->packets[i];
+		// don't hand out buffers much larger than needed
+		if (pp->bufs && pp->capacity >= size && pp->capacity - size < PACKET_POOL_GRANULE) {
+			pp->last_used = ++cp->clock;
+			return pp;
+		}
+		if (!pp->bufs || (lru->bufs && pp->last_used < lru->last_used))
+			lru = pp;
+	}
+
+	av_buffer_pool_uninit(&lru->bufs);
+
+	int capacity = (size + PACKET_POOL_GRANULE - 1) / PACKET_POOL_GRANULE * PACKET_POOL_GRANULE;
+	lru->bufs = av_buffer_pool_init2(capacity + AV_INPUT_BUFFER_PADDING_SIZE, NULL,
+			__packet_pool_buf_alloc, NULL);
+	if (!lru->bufs)
+		return NULL;
+	lru->capacity = capacity;
+	lru->last_used = ++cp->clock;
+	return lru;
+}
+
+
+static AVFrame *__frame_alloc(struct codec_pools *cp, bool *hit) {
+	*hit = cp->num_spare_frames > 0;
+	if (*hit)
+		return cp->spare_frames[--cp->num_spare_frames];
+	return av_frame_alloc();
+}
+
+AVFrame *codec_frame_alloc(void) {
+	struct codec_pools *cp = &codec_pools;
+	bool hit;
+	AVFrame *ret = __frame_alloc(cp, &hit);
+	__codec_pools_frame(cp, hit);
+	return ret;
+}
+
+// a hit only if neither the struct nor any of the sample buffers had to be allocated
+AVFrame *codec_frame_new(enum AVSampleFormat format, int channels, int clockrate, int nb_samples) {
+	struct codec_pools *cp = &codec_pools;
+	bool hit;
+	AVFrame *frame = __frame_alloc(cp, &hit);
+	if (!frame) {
+		__codec_pools_frame(cp, false);
+		return NULL;
+	}
+
+	frame->format = format;
+	frame->sample_rate = clockrate;
+	frame->nb_samples = nb_samples;
+	DEF_CH_LAYOUT(&frame->CH_LAYOUT, channels);
+
+	int planes = av_sample_fmt_is_planar(format) ? channels : 1;
+	struct frame_pool *fp = NULL;
+	if (planes <= AV_NUM_DATA_POINTERS && nb_samples > 0)
+		fp = __frame_pool(cp, format, channels, nb_samples);
+	if (!fp)
+		goto fallback;
+
+	unsigned int allocs = cp->frame_buf_allocs;
+	AVBufferRef *bufs[AV_NUM_DATA_POINTERS];
+	for (int i = 0; i < planes; i++) {
+		bufs[i] = av_buffer_pool_get(fp->bufs);
+		if (!bufs[i]) {
+			while (i--)
+				av_buffer_unref(&bufs[i]);
+			goto fallback;
+		}
+	}
+
+	if (av_samples_get_buffer_size(&frame->linesize[0], channels, nb_samples, format, 0) < 0)
+		abort();
+	for (int i = 0; i < planes; i++) {
+		frame->buf[i] = bufs[i];
+		frame->data[i] = bufs[i]->data;
+	}
+	frame->extended_data = frame->data;
+	__codec_pools_frame(cp, hit && cp->frame_buf_allocs == allocs);
+
+	return frame;
+
+fallback:
+	__codec_pools_frame(cp, false);
+	if (av_frame_get_buffer(frame, 0) < 0) {
+		codec_frame_free(&frame);
+		return NULL;
+	}
+	return frame;
+}
+
+void codec_frame_free(AVFrame **framep) {
+	AVFrame *frame = *framep;
+	if (!frame)
+		return;
+	*framep = NULL;
+
+	struct codec_pools *cp = &codec_pools;
+	if (cp->num_spare_frames >= POOL_SPARES) {
+		av_frame_free(&frame);
+		return;
+	}
+	// drops the sample buffers, which go back to their pool, and resets all fields
+	av_frame_unref(frame);
+	cp->spare_frames[cp->num_spare_frames++] = frame;
+}
+
+AVFrame *codec_frame_clone(const AVFrame *src) {
+	AVFrame *frame = codec_frame_alloc();
+	if (!frame)
+		return NULL;
+	if (av_frame_ref(frame, src) < 0) {
+		codec_frame_free(&frame);
+		return NULL;
+	}
+	return frame;
+}
+
+AVPacket *codec_packet_alloc(void) {
+	struct codec_pools *cp = &codec_pools;
+	bool hit = cp->num_spare_packets > 0;
+	AVPacket *ret = hit ? cp->spare_packets[--cp->num_spare_packets] : av_packet_alloc();
+	__codec_pools_packet(cp, hit);
+	return ret;
+}
+
+void codec_packet_free(AVPacket **pktp) {
+	AVPacket *pkt = *pktp;
+	if (!pkt)
+		return;
+	*pktp = NULL;
+
+	struct codec_pools *cp = &codec_pools;
+	if (cp->num_spare_packets >= POOL_SPARES) {
+		av_packet_free(&pkt);
+		return;
+	}
+	av_packet_unref(pkt);
+	cp->spare_packets[cp->num_spare_packets++] = pkt;
+}
+
+int codec_packet_new(AVPacket *pkt, int size) {
+	if (size < 0)
+		return AVERROR(EINVAL);
+
+	av_packet_unref(pkt);
+
+	struct codec_pools *cp = &codec_pools;
+	struct packet_pool *pp = __packet_pool(cp, size);
+	if (!pp)
+		goto fallback;
+
+	unsigned int allocs = cp->packet_buf_allocs;
+	AVBufferRef *buf = av_buffer_pool_get(pp->bufs);
+	if (!buf)
+		goto fallback;
+	__codec_pools_packet(cp, cp->packet_buf_allocs == allocs);
+
+	pkt->buf = buf;
+	pkt->data = buf->data;
+	pkt->size = size;
+	// recycled buffers carry old data, but the padding must be zero
+	memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	return 0;
+
+fallback:
+	__codec_pools_packet(cp, false);
+	return av_new_packet(pkt, size);
+}
+
+void codec_pools_thread_cleanup(void) {
+	struct codec_pools *cp = &codec_pools;
+
+	for (unsigned int i = 0; i < FRAME_POOL_SLOTS; i++)
+		av_buffer_pool_uninit(&cp->frames[i].bufs);
+	for (unsigned int i = 0; i < PACKET_POOL_SLOTS; i++)
+		av_buffer_pool_uninit(&cp->packets[i].bufs);
+	while (cp->num_spare_frames)
+		av_frame_free(&cp->spare_frames[--cp->num_spare_frames]);
+	while (cp->num_spare_packets)
+		av_packet_free(&cp->spare_packets[--cp->num_spare_packets]);
+
+	__codec_pools_flush_stats(cp);
+}
+
+
 
 codec_def_t *codec_find(const str *name, enum media_type type) {
 	codec_def_t *ret = g_hash_table_lookup(codecs_ht, name);
@@ -879,7 +1208,7 @@ static const char *avc_decoder_init(decoder_t *dec, const str *extra_opts) {
 	if (!codec)
 		return "codec not supported";
 
-	dec->avc.avpkt = av_packet_alloc();
+	dec->avc.avpkt = codec_packet_alloc();
 
 	dec->avc.avcctx = avcodec_alloc_context3(codec);
 	if (!dec->avc.avcctx)
@@ -1054,7 +1383,7 @@ static void avc_decoder_close(decoder_t *dec) {
 	avcodec_close(dec->avc.avcctx);
 	av_free(dec->avc.avcctx);
 #endif
-	av_packet_free(&dec->avc.avpkt);
+	codec_packet_free(&dec->avc.avpkt);
 }
 
 
@@ -1092,7 +1421,7 @@ static int avc_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
 		keep_going = 0;
 		int got_frame = 0;
 		err = "failed to alloc av frame";
-		frame = av_frame_alloc();
+		frame = codec_frame_alloc();
 		if (!frame)
 			goto err;
 
@@ -1167,17 +1496,248 @@ static int avc_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
 		}
 	} while (keep_going);
 
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 	return 0;
 
 err:
 	ilog(LOG_ERR | LOG_FLAG_LIMIT, "Error decoding media packet: %s", err);
 	if (av_ret)
 		ilog(LOG_ERR | LOG_FLAG_LIMIT, "Error returned from libav: %s", av_error(av_ret));
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 	return -1;
 }
 
+#define DECODE_CACHE_ENTRIES 8 // most recent packets
+#define DECODE_CACHE_FRAMES 8 // per packet
+#define DECODE_CACHE_FORMATS 4 // distinct output formats
+#define DECODE_CACHE_WARMUP 10 // packets decoded before the cache's decoder counts as caught up
+
+struct decode_cache_output {
+	format_t format;
+	AVFrame *frames[DECODE_CACHE_FRAMES];
+};
+
+struct decode_cache_entry {
+	bool valid;
+	unsigned long ts;
+	GString *payload;
+	uint64_t pts;
+	unsigned int num_frames;
+	AVFrame *frames[DECODE_CACHE_FRAMES]; // as decoded
+	unsigned int num_outputs;
+	struct decode_cache_output outputs[DECODE_CACHE_FORMATS];
+};
+
+struct decode_cache_s {
+	mutex_t lock;
+	decoder_t *dec;
+	struct decode_cache_entry entries[DECODE_CACHE_ENTRIES];
+	unsigned int next;
+	struct {
+		format_t format;
+		resample_t resampler;
+	} resamplers[DECODE_CACHE_FORMATS];
+	unsigned int num_resamplers;
+	bool started;
+	unsigned long last_ts; // of the most recent packet fed to `dec`
+	unsigned long hits, misses, private;
+};
+
+decode_cache_t *decode_cache_new(codec_def_t *def, int clockrate, int channels, int ptime,
+		struct rtp_codec_format *fmtp, const str *fmtp_string, const str *codec_opts)
+{
+	decoder_t *dec = decoder_new_fmtp(def, clockrate, channels, ptime, NULL, fmtp, fmtp_string,
+			codec_opts);
+	if (!dec)
+		return NULL;
+
+	decode_cache_t *c = g_new0(decode_cache_t, 1);
+	mutex_init(&c->lock);
+	c->dec = dec;
+	for (unsigned int i = 0; i < DECODE_CACHE_ENTRIES; i++)
+		c->entries[i].payload = g_string_new("");
+	return c;
+}
+
+static void __decode_cache_entry_clear(struct decode_cache_entry *e) {
+	for (unsigned int i = 0; i < e->num_frames; i++)
+		codec_frame_free(&e->frames[i]);
+	for (unsigned int j = 0; j < e->num_outputs; j++) {
+		for (unsigned int i = 0; i < e->num_frames; i++)
+			codec_frame_free(&e->outputs[j].frames[i]);
+	}
+	e->num_frames = 0;
+	e->num_outputs = 0;
+	e->valid = false;
+}
+
+void decode_cache_free(decode_cache_t *c) {
+	if (!c)
+		return;
+	ilog(LOG_DEBUG, "Shared %s decoder: %lu packets decoded, %lu served from cache, "
+			"%lu decoded privately",
+			c->dec->def->rtpname, c->misses, c->hits, c->private);
+	for (unsigned int i = 0; i < DECODE_CACHE_ENTRIES; i++) {
+		__decode_cache_entry_clear(&c->entries[i]);
+		g_string_free(c->entries[i].payload, TRUE);
+	}
+	for (unsigned int i = 0; i < c->num_resamplers; i++)
+		resample_shutdown(&c->resamplers[i].resampler);
+	decoder_close(c->dec);
+	mutex_destroy(&c->lock);
+	g_free(c);
+}
+
+bool decode_cache_warm(decode_cache_t *c) {
+	LOCK(&c->lock);
+	return c->misses >= DECODE_CACHE_WARMUP;
+}
+
+static struct decode_cache_entry *__decode_cache_lookup(decode_cache_t *c, unsigned long ts,
+		const str *data)
+{
+	for (unsigned int i = 0; i < DECODE_CACHE_ENTRIES; i++) {
+		struct decode_cache_entry *e = &c->entries[i];
+		if (!e->valid || e->ts != ts)
+			continue;
+		if (e->payload->len != data->len || memcmp(e->payload->str, data->s, data->len))
+			continue;
+		return e;
+	}
+	return NULL;
+}
+
+// decodes into the least recently used entry. returns NULL if the output doesn't fit,
+// in which case all decoded frames are left in `frames`
+static struct decode_cache_entry *__decode_cache_decode(decode_cache_t *c, decoder_t *dec,
+		const str *data, GQueue *frames)
+{
+	struct decode_cache_entry *e = &c->entries[c->next];
+	c->next = (c->next + 1) % DECODE_CACHE_ENTRIES;
+	__decode_cache_entry_clear(e);
+
+	// decode in the timeline of the requesting decoder
+	c->dec->pts = dec->pts;
+	c->dec->rtp_ts = dec->rtp_ts;
+	c->dec->event_data = dec->event_data;
+	c->dec->event_func = dec->event_func;
+	c->dec->def->codec_type->decoder_input(c->dec, data, frames);
+	c->misses++;
+	c->started = true;
+	c->last_ts = dec->rtp_ts;
+
+	if (frames->length > DECODE_CACHE_FRAMES)
+		return NULL;
+
+	AVFrame *frame;
+	while ((frame = g_queue_pop_head(frames)))
+		e->frames[e->num_frames++] = frame;
+
+	e->ts = dec->rtp_ts;
+	e->pts = dec->pts;
+	g_string_truncate(e->payload, 0);
+	g_string_append_len(e->payload, data->s, data->len);
+	e->valid = true;
+
+	return e;
+}
+
+static resample_t *__decode_cache_resampler(decode_cache_t *c, const format_t *format) {
+	for (unsigned int i = 0; i < c->num_resamplers; i++) {
+		if (format_eq(&c->resamplers[i].format, format))
+			return &c->resamplers[i].resampler;
+	}
+	if (c->num_resamplers >= DECODE_CACHE_FORMATS)
+		return NULL;
+	unsigned int i = c->num_resamplers++;
+	c->resamplers[i].format = *format;
+	return &c->resamplers[i].resampler;
+}
+
+// returns NULL if the output can't be shared
+static struct decode_cache_output *__decode_cache_output(decode_cache_t *c, struct decode_cache_entry *e,
+		const format_t *format)
+{
+	for (unsigned int j = 0; j < e->num_outputs; j++) {
+		if (format_eq(&e->outputs[j].format, format))
+			return &e->outputs[j];
+	}
+	if (e->num_outputs >= DECODE_CACHE_FORMATS)
+		return NULL;
+	resample_t *resampler = __decode_cache_resampler(c, format);
+	if (!resampler)
+		return NULL;
+
+	struct decode_cache_output *o = &e->outputs[e->num_outputs];
+	for (unsigned int i = 0; i < e->num_frames; i++) {
+		o->frames[i] = resample_frame(resampler, e->frames[i], format);
+		if (!o->frames[i]) {
+			while (i--)
+				codec_frame_free(&o->frames[i]);
+			return NULL;
+		}
+	}
+	o->format = *format;
+	e->num_outputs++;
+	return o;
+}
+
+// fills `out` with frames in the decoder's output format, unless `*resampled` is left false.
+// `*samples` is set to the number of decoded samples in that case. Returns 1 if the packet
+// must be decoded privately instead
+static int __decode_cache_input(decoder_t *dec, const str *data, GQueue *out, bool *resampled,
+		unsigned long *samples)
+{
+	decode_cache_t *c = dec->cache;
+
+	LOCK(&c->lock);
+
+	struct decode_cache_entry *e = __decode_cache_lookup(c, dec->rtp_ts, data);
+	if (e)
+		c->hits++;
+	else {
+		// A sink that has fallen behind the others by more than the cached packets
+		// must not take the shared decoder back in time, as that would break the
+		// decoder state for everybody.
+		if (c->started && (int32_t) (dec->rtp_ts - c->last_ts) <= 0) {
+			c->private++;
+			return 1;
+		}
+		e = __decode_cache_decode(c, dec, data, out);
+		if (!e)
+			return 0; // handed out as they are
+	}
+	if (e->num_frames)
+		dec->dec_out_format.format = e->frames[0]->format;
+
+	// the other decoders may have started at a different point in time
+	int64_t shift = dec->pts - e->pts;
+
+	struct decode_cache_output *o = __decode_cache_output(c, e, &dec->dest_format);
+	if (!o) {
+		// resample privately
+		for (unsigned int i = 0; i < e->num_frames; i++) {
+			AVFrame *frame = codec_frame_clone(e->frames[i]);
+			if (!frame)
+				return -1;
+			frame->pts += shift;
+			g_queue_push_tail(out, frame);
+		}
+		return 0;
+	}
+
+	for (unsigned int i = 0; i < e->num_frames; i++) {
+		AVFrame *frame = codec_frame_clone(o->frames[i]);
+		if (!frame)
+			return -1;
+		frame->pts += av_rescale(shift, frame->sample_rate, e->frames[i]->sample_rate);
+		g_queue_push_tail(out, frame);
+		*samples += e->frames[i]->nb_samples;
+	}
+	*resampled = true;
+	return 0;
+}
+
 static int __decoder_input_data(decoder_t *dec, const str *data, unsigned long ts, int *ptime,
 		int (*callback)(decoder_t *, AVFrame *, void *u1, void *u2), void *u1, void *u2)
 {
@@ -1212,18 +1772,33 @@ static int __decoder_input_data(decoder_t *dec, const str *data, unsigned long t
 	}
 	dec->rtp_ts = ts;
 
-	if (data)
-		dec->def->codec_type->decoder_input(dec, data, &frames);
-	else
+	int ret = 0;
+	bool resampled = false;
+	unsigned long samples = 0;
+
+	if (!data)
 		dec->dtx.do_dtx(dec, &frames, *ptime);
+	else if (!dec->cache
+			|| (ret = __decode_cache_input(dec, data, &frames, &resampled, &samples)) == 1)
+	{
+		dec->def->codec_type->decoder_input(dec, data, &frames);
+		ret = 0;
+	}
 
 	AVFrame *frame;
-	int ret = 0;
-	unsigned long samples = 0;
 	while ((frame = g_queue_pop_head(&frames))) {
-		samples += frame->nb_samples;
-		dec->dec_out_format.format = frame->format;
-		AVFrame *rsmp_frame = resample_frame(&dec->resampler, frame, &dec->dest_format);
+		AVFrame *rsmp_frame;
+		if (!resampled) {
+			samples += frame->nb_samples;
+			dec->dec_out_format.format = frame->format;
+		}
+		if (resampled || !resample_frame_needed(frame, &dec->dest_format)) {
+			// no need for another reference
+			rsmp_frame = frame;
+			frame = NULL;
+		}
+		else
+			rsmp_frame = resample_frame(&dec->resampler, frame, &dec->dest_format);
 		if (!rsmp_frame) {
 			ilog(LOG_ERR | LOG_FLAG_LIMIT, "Resampling failed");
 			ret = -1;
@@ -1232,7 +1807,7 @@ static int __decoder_input_data(decoder_t *dec, const str *data, unsigned long t
 			if (callback(dec, rsmp_frame, u1, u2))
 				ret = -1;
 		}
-		av_frame_free(&frame);
+		codec_frame_free(&frame);
 	}
 
 	if (ptime)
@@ -1323,6 +1898,7 @@ void codeclib_free(void) {
 	g_hash_table_destroy(codecs_ht_by_av);
 	avformat_network_deinit();
 	cc_cleanup();
+	codec_pools_thread_cleanup();
 	if (evs_lib_handle)
 		dlclose(evs_lib_handle);
 	if (cc_lib_handle)
@@ -1585,6 +2161,7 @@ void codeclib_init(int print) {
 	codecs_ht_by_av = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	cc_init();
+	g711_init();
 
 	for (int i = 0; i < G_N_ELEMENTS(__codec_defs); i++) {
 		// add to hash table
@@ -1830,7 +2407,7 @@ encoder_t *encoder_new(void) {
 	encoder_t *ret = g_slice_alloc0(sizeof(*ret));
 	format_init(&ret->requested_format);
 	format_init(&ret->actual_format);
-	ret->avpkt = av_packet_alloc();
+	ret->avpkt = codec_packet_alloc();
 	return ret;
 }
 
@@ -1997,7 +2574,7 @@ void encoder_close(encoder_t *enc) {
 }
 void encoder_free(encoder_t *enc) {
 	encoder_close(enc);
-	av_packet_free(&enc->avpkt);
+	codec_packet_free(&enc->avpkt);
 	g_slice_free1(sizeof(*enc), enc);
 }
 
@@ -2294,20 +2871,17 @@ static void libopus_decoder_close(decoder_t *dec) {
 }
 static int libopus_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
 	// get frame with buffer large enough for the max
-	AVFrame *frame = av_frame_alloc();
-	frame->nb_samples = 960;
-	frame->format = AV_SAMPLE_FMT_S16;
-	frame->sample_rate = dec->in_format.clockrate;
-	DEF_CH_LAYOUT(&frame->CH_LAYOUT, dec->in_format.channels);
-	frame->pts = dec->pts;
-	if (av_frame_get_buffer(frame, 0) < 0)
+	AVFrame *frame = codec_frame_new(AV_SAMPLE_FMT_S16, dec->in_format.channels,
+			dec->in_format.clockrate, 960);
+	if (!frame)
 		abort();
+	frame->pts = dec->pts;
 
 	int ret = opus_decode(dec->opus, (unsigned char *) data->s, data->len,
 			(int16_t *) frame->extended_data[0], frame->nb_samples, 0);
 	if (ret < 0) {
 		ilog(LOG_ERR | LOG_FLAG_LIMIT, "Error decoding Opus packet: %s", opus_strerror(ret));
-		av_frame_free(&frame);
+		codec_frame_free(&frame);
 		return -1;
 	}
 
@@ -2444,7 +3018,7 @@ static int libopus_encoder_input(encoder_t *enc, AVFrame **frame) {
 		return 0;
 
 	// max length of Opus packet:
-	av_new_packet(enc->avpkt, MAX_OPUS_FRAME_SIZE * MAX_OPUS_FRAMES_PER_PACKET + MAX_OPUS_HEADER_SIZE);
+	codec_packet_new(enc->avpkt, MAX_OPUS_FRAME_SIZE * MAX_OPUS_FRAMES_PER_PACKET + MAX_OPUS_HEADER_SIZE);
 
 	int ret = opus_encode(enc->opus, (int16_t *) (*frame)->extended_data[0], (*frame)->nb_samples,
 			enc->avpkt->data, enc->avpkt->size);
@@ -3399,15 +3973,10 @@ static int generic_silence_dtx(decoder_t *dec, GQueue *out, int ptime) {
 	ilog(LOG_DEBUG, "pushing %i silence samples into %s decoder", num_samples, dec->def->rtpname);
 
 	// create dummy frame, fill with silence, pretend it was returned from the decoder
-	AVFrame *frame = av_frame_alloc();
-	frame->nb_samples = num_samples;
-	frame->format = dec->dec_out_format.format;
-	frame->sample_rate = dec->dec_out_format.clockrate;
-	DEF_CH_LAYOUT(&frame->CH_LAYOUT, dec->dec_out_format.channels);
-	if (av_frame_get_buffer(frame, 0) < 0) {
-		av_frame_free(&frame);
+	AVFrame *frame = codec_frame_new(dec->dec_out_format.format, dec->dec_out_format.channels,
+			dec->dec_out_format.clockrate, num_samples);
+	if (!frame)
 		return -1;
-	}
 
 	memset(frame->extended_data[0], 0, frame->linesize[0]);
 
@@ -3449,6 +4018,205 @@ static void generic_cn_dtx_cleanup(decoder_t *dec) {
 
 
 
+// G.711 A-law and µ-law. Output is identical to libavcodec's PCM_ALAW and PCM_MULAW codecs, which
+// place the quantisation boundaries halfway between the adjacent output levels.
+
+static int16_t g711_alaw_dec[256];
+static int16_t g711_ulaw_dec[256];
+static unsigned char g711_alaw2ulaw[256];
+static unsigned char g711_ulaw2alaw[256];
+
+static int g711_alaw_linear(unsigned char a) {
+	a ^= 0x55;
+	int seg = (a & 0x70) >> 4;
+	int t = (a & 0xf) * 2 + 1;
+	if (seg)
+		t = (t + 32) << (seg + 2);
+	else
+		t <<= 3;
+	return (a & 0x80) ? t : -t;
+}
+static int g711_ulaw_linear(unsigned char u) {
+	u = ~u;
+	int t = (((u & 0xf) << 3) + 0x84) << ((u & 0x70) >> 4);
+	return (u & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+// 14-bit magnitude, with negative values rounded away from zero
+INLINE unsigned int g711_magnitude(int16_t s) {
+	unsigned int m = s < 0 ? (3 - s) >> 2 : s >> 2;
+	return MIN(m, 8191);
+}
+// with the boundaries being above the start of each segment, values that are just past the start
+// still belong to the previous segment
+INLINE bool g711_segment_start(unsigned int m, unsigned int top) {
+	return ((m - (1u << top)) << 7) < (1u << top);
+}
+static unsigned char g711_alaw_code(int16_t s) {
+	unsigned int m = g711_magnitude(s);
+	unsigned int code;
+	if (m < 128)
+		code = m >> 2; // first two segments are linear
+	else {
+		unsigned int top = 31 - __builtin_clz(m);
+		code = ((top - 5) << 4) | ((m >> (top - 4)) & 0xf);
+		if (g711_segment_start(m, top))
+			code--;
+	}
+	return code ^ (s < 0 ? 0x55 : 0xd5);
+}
+static unsigned char g711_ulaw_code(int16_t s) {
+	unsigned int m = MIN(g711_magnitude(s) + 33, 8191);
+	unsigned int top = 31 - __builtin_clz(m);
+	unsigned int code = ((top - 5) << 4) | ((m >> (top - 4)) & 0xf);
+	if (top > 5 && g711_segment_start(m, top))
+		code--;
+	return code ^ (s < 0 ? 0x7f : 0xff);
+}
+
+void g711_alaw_enc_c(unsigned char *restrict dst, const int16_t *restrict src, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++)
+		dst[i] = g711_alaw_code(src[i]);
+}
+void g711_ulaw_enc_c(unsigned char *restrict dst, const int16_t *restrict src, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++)
+		dst[i] = g711_ulaw_code(src[i]);
+}
+
+#if defined(__x86_64__) && !defined(ASAN_BUILD) && HAS_ATTR(ifunc) && defined(__GLIBC__)
+static g711_enc_fn_t *resolve_g711_alaw_enc(void) {
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2))
+		return g711_alaw_enc_avx2;
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2))
+		return g711_alaw_enc_sse2;
+	return g711_alaw_enc_c;
+}
+static g711_enc_fn_t *resolve_g711_ulaw_enc(void) {
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2))
+		return g711_ulaw_enc_avx2;
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2))
+		return g711_ulaw_enc_sse2;
+	return g711_ulaw_enc_c;
+}
+static g711_enc_fn_t g711_alaw_enc __attribute__ ((ifunc ("resolve_g711_alaw_enc")));
+static g711_enc_fn_t g711_ulaw_enc __attribute__ ((ifunc ("resolve_g711_ulaw_enc")));
+#else
+#define g711_alaw_enc g711_alaw_enc_c
+#define g711_ulaw_enc g711_ulaw_enc_c
+#endif
+
+static void g711_init(void) {
+	for (unsigned int i = 0; i < 256; i++) {
+		g711_alaw_dec[i] = g711_alaw_linear(i);
+		g711_ulaw_dec[i] = g711_ulaw_linear(i);
+	}
+	// same as decoding and encoding again
+	for (unsigned int i = 0; i < 256; i++) {
+		g711_alaw2ulaw[i] = g711_ulaw_code(g711_alaw_dec[i]);
+		g711_ulaw2alaw[i] = g711_alaw_code(g711_ulaw_dec[i]);
+	}
+}
+
+void g711_alaw_encode(unsigned char *dst, const int16_t *src, unsigned int num) {
+	g711_alaw_enc(dst, src, num);
+}
+void g711_ulaw_encode(unsigned char *dst, const int16_t *src, unsigned int num) {
+	g711_ulaw_enc(dst, src, num);
+}
+void g711_alaw_decode(int16_t *dst, const unsigned char *src, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++)
+		dst[i] = g711_alaw_dec[src[i]];
+}
+void g711_ulaw_decode(int16_t *dst, const unsigned char *src, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++)
+		dst[i] = g711_ulaw_dec[src[i]];
+}
+
+static void g711_alaw2ulaw_xlate(unsigned char *dst, const unsigned char *src, unsigned int len) {
+	for (unsigned int i = 0; i < len; i++)
+		dst[i] = g711_alaw2ulaw[src[i]];
+}
+static void g711_ulaw2alaw_xlate(unsigned char *dst, const unsigned char *src, unsigned int len) {
+	for (unsigned int i = 0; i < len; i++)
+		dst[i] = g711_ulaw2alaw[src[i]];
+}
+
+codec_xlate_f *codec_xlate(codec_def_t *src, codec_def_t *dst) {
+	if (!src || !dst)
+		return NULL;
+	if (src->avcodec_id == AV_CODEC_ID_PCM_ALAW && dst->avcodec_id == AV_CODEC_ID_PCM_MULAW)
+		return g711_alaw2ulaw_xlate;
+	if (src->avcodec_id == AV_CODEC_ID_PCM_MULAW && dst->avcodec_id == AV_CODEC_ID_PCM_ALAW)
+		return g711_ulaw2alaw_xlate;
+	return NULL;
+}
+
+static void g711_def_init(struct codec_def_s *def) {
+	def->support_encoding = 1;
+	def->support_decoding = 1;
+}
+
+static const char *g711_decoder_init(decoder_t *dec, const str *extra_opts) {
+	if (dec->in_format.channels <= 0)
+		return "invalid number of channels";
+	return NULL;
+}
+
+static int g711_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
+	unsigned int channels = dec->in_format.channels;
+	unsigned int samples = data->len / channels;
+	if (!samples)
+		return 0;
+
+	AVFrame *frame = codec_frame_new(AV_SAMPLE_FMT_S16, channels, dec->in_format.clockrate, samples);
+	if (!frame)
+		abort();
+	frame->pts = dec->pts;
+
+	if (dec->def->avcodec_id == AV_CODEC_ID_PCM_ALAW)
+		g711_alaw_decode((void *) frame->extended_data[0], (void *) data->s, samples * channels);
+	else
+		g711_ulaw_decode((void *) frame->extended_data[0], (void *) data->s, samples * channels);
+
+	g_queue_push_tail(out, frame);
+
+	return 0;
+}
+
+static const char *g711_encoder_init(encoder_t *enc, const str *extra_opts) {
+	if (enc->requested_format.channels <= 0)
+		return "invalid number of channels";
+
+	enc->actual_format = enc->requested_format;
+	enc->actual_format.format = AV_SAMPLE_FMT_S16;
+	enc->samples_per_frame = enc->actual_format.clockrate * enc->ptime / 1000;
+	enc->samples_per_packet = enc->samples_per_frame;
+
+	return NULL;
+}
+
+static int g711_encoder_input(encoder_t *enc, AVFrame **frame) {
+	if (!*frame)
+		return 0;
+
+	unsigned int len = (*frame)->nb_samples * enc->actual_format.channels;
+	if (codec_packet_new(enc->avpkt, len) < 0)
+		return -1;
+
+	if (enc->def->avcodec_id == AV_CODEC_ID_PCM_ALAW)
+		g711_alaw_encode(enc->avpkt->data, (void *) (*frame)->extended_data[0], len);
+	else
+		g711_ulaw_encode(enc->avpkt->data, (void *) (*frame)->extended_data[0], len);
+
+	enc->avpkt->pts = (*frame)->pts;
+	enc->avpkt->duration = (*frame)->nb_samples;
+
+	return 0;
+}
+
+
+
+
 #ifdef HAVE_BCG729
 static void bcg729_def_init(struct codec_def_s *def) {
 	// test init
@@ -3481,14 +4249,11 @@ static int bcg729_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
 		inp_frame.len = frame_len;
 		str_shift(&input, frame_len);
 
-		AVFrame *frame = av_frame_alloc();
-		frame->nb_samples = 80;
-		frame->format = AV_SAMPLE_FMT_S16;
-		frame->sample_rate = dec->in_format.clockrate; // 8000
-		DEF_CH_LAYOUT(&frame->CH_LAYOUT, dec->in_format.channels);
-		frame->pts = pts;
-		if (av_frame_get_buffer(frame, 0) < 0)
+		AVFrame *frame = codec_frame_new(AV_SAMPLE_FMT_S16, dec->in_format.channels,
+				dec->in_format.clockrate /* 8000 */, 80);
+		if (!frame)
 			abort();
+		frame->pts = pts;
 
 		pts += frame->nb_samples;
 
@@ -3531,7 +4296,7 @@ static int bcg729_encoder_input(encoder_t *enc, AVFrame **frame) {
 		return -1;
 	}
 
-	av_new_packet(enc->avpkt, 10);
+	codec_packet_new(enc->avpkt, 10);
 	unsigned char len = 0;
 
 	bcg729Encoder(enc->bcg729, (void *) (*frame)->extended_data[0], enc->avpkt->data, &len);
@@ -3611,14 +4376,10 @@ static AVFrame *dtmf_frame_int16_t_mono(unsigned long frame_ts, unsigned long nu
 {
 	// synthesise PCM
 	// first get our frame and figure out how many samples we need, and the start offset
-	AVFrame *frame = av_frame_alloc();
-	frame->nb_samples = num_samples;
-	frame->format = AV_SAMPLE_FMT_S16;
-	frame->sample_rate = sample_rate;
-	frame->CH_LAYOUT = (CH_LAYOUT_T) MONO_LAYOUT;
-	frame->pts = frame_ts;
-	if (av_frame_get_buffer(frame, 0) < 0)
+	AVFrame *frame = codec_frame_new(AV_SAMPLE_FMT_S16, 1, sample_rate, num_samples);
+	if (!frame)
 		abort();
+	frame->pts = frame_ts;
 
 	// fill samples
 	dtmf_samples_int16_t_mono(frame->extended_data[0], frame_ts, frame->nb_samples, event,
@@ -4553,7 +5314,7 @@ static int evs_encoder_input(encoder_t *enc, AVFrame **frame) {
 		evs_amr_enc_in(enc->evs.ctx, (void *) (*frame)->extended_data[0], (*frame)->nb_samples);
 
 	// max output: 320 bytes, plus some overhead
-	av_new_packet(enc->avpkt, 340);
+	codec_packet_new(enc->avpkt, 340);
 
 	unsigned char *out = enc->avpkt->data;
 	unsigned char *cmr = NULL;
@@ -4775,14 +5536,11 @@ static int evs_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
 		// process frame if we have one; we don't have one if
 		// this is the first iteration and this is not a compact frame
 		if (mode != -1) {
-			AVFrame *frame = av_frame_alloc();
-			frame->nb_samples = n_samples;
-			frame->format = AV_SAMPLE_FMT_S16;
-			frame->sample_rate = dec->in_format.clockrate; // 48000
-			DEF_CH_LAYOUT(&frame->CH_LAYOUT, dec->in_format.channels);
-			frame->pts = pts;
-			if (av_frame_get_buffer(frame, 0) < 0)
+			AVFrame *frame = codec_frame_new(AV_SAMPLE_FMT_S16, dec->in_format.channels,
+					dec->in_format.clockrate /* 48000 */, n_samples);
+			if (!frame)
 				abort();
+			frame->pts = pts;
 
 			evs_dec_in(dec->evs, frame_data.s, bits, is_amr, mode, q_bit, 0, 0);
 
@@ -4997,8 +5755,8 @@ static void __codec_cc_free(codec_cc_t *c) {
 		c->async_callback(NULL, j->async_cb_obj);
 		__cc_async_job_free(j);
 	}
-	av_packet_free(&c->avpkt);
-	av_packet_free(&c->avpkt_async);
+	codec_packet_free(&c->avpkt);
+	codec_packet_free(&c->avpkt_async);
 	g_slice_free1(sizeof(*c), c);
 }
 
@@ -5261,7 +6019,7 @@ static codec_cc_t *codec_cc_new_sync(codec_def_t *src, format_t *src_format, cod
 		ret->clear = cc_float2opus_clear;
 		ret->clear_arg = ret->pcma2opus.enc;
 		ret->pcma2opus.runner = pcma2opus_runner;
-		ret->avpkt = av_packet_alloc();
+		ret->avpkt = codec_packet_alloc();
 		ret->run = cc_pcma2opus_run;
 
 		return ret;
@@ -5289,7 +6047,7 @@ static codec_cc_t *codec_cc_new_sync(codec_def_t *src, format_t *src_format, cod
 		ret->clear = cc_float2opus_clear;
 		ret->clear_arg = ret->pcmu2opus.enc;
 		ret->pcmu2opus.runner = pcmu2opus_runner;
-		ret->avpkt = av_packet_alloc();
+		ret->avpkt = codec_packet_alloc();
 		ret->run = cc_pcmu2opus_run;
 
 		return ret;
@@ -5312,7 +6070,7 @@ static codec_cc_t *codec_cc_new_sync(codec_def_t *src, format_t *src_format, cod
 		ret->clear = cc_opus2float_clear;
 		ret->clear_arg = ret->opus2pcmu.dec;
 		ret->opus2pcmu.runner = opus2pcmu_runner;
-		ret->avpkt = av_packet_alloc();
+		ret->avpkt = codec_packet_alloc();
 		ret->run = cc_opus2pcmu_run;
 
 		return ret;
@@ -5335,7 +6093,7 @@ static codec_cc_t *codec_cc_new_sync(codec_def_t *src, format_t *src_format, cod
 		ret->clear = cc_opus2float_clear;
 		ret->clear_arg = ret->opus2pcma.dec;
 		ret->opus2pcma.runner = opus2pcma_runner;
-		ret->avpkt = av_packet_alloc();
+		ret->avpkt = codec_packet_alloc();
 		ret->run = cc_opus2pcma_run;
 
 		return ret;
@@ -5374,7 +6132,7 @@ static codec_cc_t *codec_cc_new_async(codec_def_t *src, format_t *src_format, co
 		ret->clear_arg = ret->pcma2opus.enc;
 		ret->pcma2opus_async.runner = pcma2opus_async_runner;
 		ret->run = cc_pcma2opus_run_async;
-		ret->avpkt_async = av_packet_alloc();
+		ret->avpkt_async = codec_packet_alloc();
 		av_new_packet(ret->avpkt_async,
 				MAX_OPUS_FRAME_SIZE * MAX_OPUS_FRAMES_PER_PACKET + MAX_OPUS_HEADER_SIZE);
 		mutex_init(&ret->async_lock);
@@ -5408,7 +6166,7 @@ static codec_cc_t *codec_cc_new_async(codec_def_t *src, format_t *src_format, co
 		ret->clear_arg = ret->pcmu2opus.enc;
 		ret->pcmu2opus_async.runner = pcmu2opus_async_runner;
 		ret->run = cc_pcmu2opus_run_async;
-		ret->avpkt_async = av_packet_alloc();
+		ret->avpkt_async = codec_packet_alloc();
 		av_new_packet(ret->avpkt_async,
 				MAX_OPUS_FRAME_SIZE * MAX_OPUS_FRAMES_PER_PACKET + MAX_OPUS_HEADER_SIZE);
 		mutex_init(&ret->async_lock);
@@ -5437,7 +6195,7 @@ static codec_cc_t *codec_cc_new_async(codec_def_t *src, format_t *src_format, co
 		ret->clear_arg = ret->opus2pcmu.dec;
 		ret->opus2pcmu_async.runner = opus2pcmu_async_runner;
 		ret->run = cc_opus2pcmu_run_async;
-		ret->avpkt_async = av_packet_alloc();
+		ret->avpkt_async = codec_packet_alloc();
 		av_new_packet(ret->avpkt_async, 960);
 		mutex_init(&ret->async_lock);
 		t_queue_init(&ret->async_jobs);
@@ -5465,7 +6223,7 @@ static codec_cc_t *codec_cc_new_async(codec_def_t *src, format_t *src_format, co
 		ret->clear_arg = ret->opus2pcma.dec;
 		ret->opus2pcma_async.runner = opus2pcma_async_runner;
 		ret->run = cc_opus2pcma_run_async;
-		ret->avpkt_async = av_packet_alloc();
+		ret->avpkt_async = codec_packet_alloc();
 		av_new_packet(ret->avpkt_async, 960);
 		mutex_init(&ret->async_lock);
 		t_queue_init(&ret->async_jobs);
@@ -5521,7 +6279,7 @@ void codec_cc_free(codec_cc_t **ccp) {
 AVPacket *codec_cc_input_data(codec_cc_t *c, const str *data, unsigned long ts, void *x, void *y, void *z) {
 #ifdef HAVE_CODEC_CHAIN
 	if (c->avpkt)
-		av_new_packet(c->avpkt, MAX_OPUS_FRAME_SIZE * MAX_OPUS_FRAMES_PER_PACKET + MAX_OPUS_HEADER_SIZE);
+		codec_packet_new(c->avpkt, MAX_OPUS_FRAME_SIZE * MAX_OPUS_FRAMES_PER_PACKET + MAX_OPUS_HEADER_SIZE);
 	void *async_cb_obj = NULL;
 	if (c->async_init)
 		async_cb_obj = c->async_init(x, y, z);
@@ -96,6 +96,7 @@ typedef union codec_options_u codec_options_t;
 typedef struct encoder_callback_s encoder_callback_t;
 typedef struct dtx_method_s dtx_method_t;
 typedef struct codec_cc_s codec_cc_t;
+typedef struct decode_cache_s decode_cache_t;
 
 typedef int packetizer_f(AVPacket *, GString *, str *, encoder_t *);
 typedef void format_init_f(struct rtp_payload_type *);
@@ -305,6 +306,8 @@ struct decoder_s {
 	uint64_t pts;
 	int ptime;
 
+	decode_cache_t *cache; // not owned
+
 	int (*event_func)(enum codec_event event, void *ptr, void *event_data);
 	void *event_data;
 };
@@ -404,6 +407,22 @@ int decoder_set_cn_dtx(decoder_t *dec, const str *);
 int decoder_dtx(decoder_t *dec, unsigned long ts, int ptime,
 		int (*callback)(decoder_t *, AVFrame *, void *u1, void *u2), void *u1, void *u2);
 
+// Lets decoders with identical input share the work. A decoder attached to a cache hands its
+// packets to the cache's own decoder, which decodes each packet only once. The decoded frames
+// are kept for the other decoders, resampled once for each distinct output format, and handed
+// out as references. DTX and PLC still run through each decoder's own context, and so do
+// packets older than the last one decoded by the cache's decoder, which can't be fed to it
+// without breaking its state.
+decode_cache_t *decode_cache_new(codec_def_t *def, int clockrate, int channels, int ptime,
+		struct rtp_codec_format *fmtp, const str *fmtp_string, const str *codec_opts);
+void decode_cache_free(decode_cache_t *);
+// true once the cache's decoder has seen enough packets to have caught up with the state of
+// the stream, so that a decoder that has been running on its own can switch over
+bool decode_cache_warm(decode_cache_t *);
+INLINE void decoder_set_cache(decoder_t *dec, decode_cache_t *cache) {
+	dec->cache = cache;
+}
+
 
 encoder_t *encoder_new(void);
 int encoder_config(encoder_t *enc, codec_def_t *def, int bitrate, int ptime,
@@ -436,6 +455,28 @@ void frame_fill_tone_samples(enum AVSampleFormat fmt, void *samples, unsigned in
 void frame_fill_dtmf_samples(enum AVSampleFormat fmt, void *samples, unsigned int offset, unsigned int num,
 		unsigned int event, unsigned int volume, unsigned int sample_rate, unsigned int channels);
 
+void g711_alaw_encode(unsigned char *dst, const int16_t *src, unsigned int num);
+void g711_ulaw_encode(unsigned char *dst, const int16_t *src, unsigned int num);
+void g711_alaw_decode(int16_t *dst, const unsigned char *src, unsigned int num);
+void g711_ulaw_decode(int16_t *dst, const unsigned char *src, unsigned int num);
+
+// encoder kernels behind g711_*_encode(), for testing
+typedef void g711_enc_fn_t(unsigned char *restrict dst, const int16_t *restrict src, unsigned int num);
+g711_enc_fn_t g711_alaw_enc_c;
+g711_enc_fn_t g711_ulaw_enc_c;
+#if defined(__x86_64__)
+// g711_x64_sse2.S
+g711_enc_fn_t g711_alaw_enc_sse2;
+g711_enc_fn_t g711_ulaw_enc_sse2;
+// g711_x64_avx2.S
+g711_enc_fn_t g711_alaw_enc_avx2;
+g711_enc_fn_t g711_ulaw_enc_avx2;
+#endif
+
+typedef void codec_xlate_f(unsigned char *dst, const unsigned char *src, unsigned int len);
+// converts payloads directly from one codec to the other, or NULL if not supported
+codec_xlate_f *codec_xlate(codec_def_t *src, codec_def_t *dst);
+
 
 #ifdef HAVE_CODEC_CHAIN
 
@@ -463,6 +504,26 @@ AVPacket *codec_cc_input_data(codec_cc_t *c, const str *data, unsigned long ts,
 #include "auxlib.h"
 
 
+// Per-thread recycling of frames and packets. Sample buffers of frames from codec_frame_new()
+// and packet data from codec_packet_new() come from pools keyed by their layout and go back
+// to them when the last reference is dropped, no matter how or in which thread. The AVFrame
+// and AVPacket structs themselves are only kept if released through codec_*_free().
+struct codec_pool_stats {
+	atomic64 frame_hits, frame_misses;
+	atomic64 packet_hits, packet_misses;
+};
+extern struct codec_pool_stats codec_pool_stats;
+
+AVFrame *codec_frame_alloc(void); // without buffers
+AVFrame *codec_frame_new(enum AVSampleFormat, int channels, int clockrate, int nb_samples);
+AVFrame *codec_frame_clone(const AVFrame *);
+void codec_frame_free(AVFrame **);
+AVPacket *codec_packet_alloc(void);
+void codec_packet_free(AVPacket **);
+int codec_packet_new(AVPacket *, int size); // replaces av_new_packet()
+void codec_pools_thread_cleanup(void);
+
+
 // `ps` must be zero allocated
 INLINE void packet_sequencer_init(packet_sequencer_t *ps, GDestroyNotify n) {
 	if (ps->packets)
@@ -519,6 +580,9 @@ INLINE void codeclib_init(int print) {
 INLINE void codeclib_free(void) {
 	;
 }
+INLINE void codec_pools_thread_cleanup(void) {
+	;
+}
 
 INLINE codec_def_t *codec_find(const str *name, enum media_type type) {
 	return NULL;
@@ -0,0 +1,194 @@
+#include "jobsched.h"
+#include <glib.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/time.h>
+
+
+// how long an idle worker sleeps before looking for something to steal again
+#define IDLE_WAIT_US 10000
+
+const unsigned int jobsched_latency_bounds[JOBSCHED_LATENCY_BUCKETS] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, UINT_MAX,
+};
+
+
+static int64_t __now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+void jobsched_init(struct jobsched *s, unsigned int num_workers) {
+	s->num_workers = num_workers;
+	s->workers = g_new0(struct jobsched_worker, num_workers);
+	s->next_worker = 0;
+	s->shutdown = false;
+
+	for (unsigned int i = 0; i < num_workers; i++) {
+		mutex_init(&s->workers[i].lock);
+		cond_init(&s->workers[i].cond);
+		g_queue_init(&s->workers[i].queue);
+	}
+}
+
+void jobsched_free(struct jobsched *s) {
+	for (unsigned int i = 0; i < s->num_workers; i++) {
+		mutex_destroy(&s->workers[i].lock);
+		cond_destroy(&s->workers[i].cond);
+	}
+	g_free(s->workers);
+	s->workers = NULL;
+	s->num_workers = 0;
+}
+
+
+// worker is locked
+static void __push(struct jobsched_worker *w, struct jobsched_job *job) {
+	job->link.data = job;
+	g_queue_push_tail_link(&w->queue, &job->link);
+
+	unsigned int depth = w->depth + 1;
+	atomic_set_na(&w->depth, depth);
+	if (depth > atomic_get_na(&w->max_depth))
+		atomic_set_na(&w->max_depth, depth);
+}
+
+// worker is locked
+static struct jobsched_job *__pop_head(struct jobsched_worker *w) {
+	GList *l = g_queue_pop_head_link(&w->queue);
+	if (!l)
+		return NULL;
+	atomic_set_na(&w->depth, w->depth - 1);
+	return l->data;
+}
+
+// worker is locked
+static struct jobsched_job *__pop_tail(struct jobsched_worker *w) {
+	GList *l = g_queue_pop_tail_link(&w->queue);
+	if (!l)
+		return NULL;
+	atomic_set_na(&w->depth, w->depth - 1);
+	return l->data;
+}
+
+
+void jobsched_submit(struct jobsched *s, struct jobsched_job *job) {
+	unsigned int idx = job->affinity ? atomic_get_na(job->affinity) : 0;
+	if (!idx || idx > s->num_workers)
+		idx = __atomic_fetch_add(&s->next_worker, 1, __ATOMIC_RELAXED) % s->num_workers + 1;
+	struct jobsched_worker *w = &s->workers[idx - 1];
+
+	job->queued = __now_us();
+
+	mutex_lock(&w->lock);
+	__push(w, job);
+	bool sleeping = w->sleeping;
+	if (sleeping)
+		cond_signal(&w->cond);
+	mutex_unlock(&w->lock);
+
+	if (sleeping || s->num_workers < 2)
+		return;
+
+	// owner is busy: wake up an idle worker so it can steal the job. a worker that's just
+	// about to go to sleep may be missed, in which case the owner gets to it eventually
+	for (unsigned int i = 1; i < s->num_workers; i++) {
+		struct jobsched_worker *o = &s->workers[(idx - 1 + i) % s->num_workers];
+		if (!__atomic_load_n(&o->sleeping, __ATOMIC_RELAXED))
+			continue;
+		mutex_lock(&o->lock);
+		sleeping = o->sleeping;
+		if (sleeping)
+			cond_signal(&o->cond);
+		mutex_unlock(&o->lock);
+		if (sleeping)
+			break;
+	}
+}
+
+
+static struct jobsched_job *__steal(struct jobsched *s, unsigned int idx) {
+	while (true) {
+		struct jobsched_worker *victim = NULL;
+		unsigned int max = 0;
+
+		for (unsigned int i = 1; i < s->num_workers; i++) {
+			struct jobsched_worker *o = &s->workers[(idx + i) % s->num_workers];
+			unsigned int depth = jobsched_depth(o);
+			if (depth > max) {
+				max = depth;
+				victim = o;
+			}
+		}
+		if (!victim)
+			return NULL;
+
+		mutex_lock(&victim->lock);
+		struct jobsched_job *job = __pop_tail(victim);
+		mutex_unlock(&victim->lock);
+		if (job)
+			return job;
+		// raced with the owner, look again
+	}
+}
+
+static void __run(struct jobsched_worker *w, unsigned int idx, struct jobsched_job *job) {
+	int64_t latency = __now_us() - job->queued;
+	if (latency < 0)
+		latency = 0;
+	unsigned int b = 0;
+	while (b < JOBSCHED_LATENCY_BUCKETS - 1 && latency > jobsched_latency_bounds[b])
+		b++;
+	atomic64_inc_na(&w->latency[b]);
+	atomic64_add_na(&w->latency_sum, latency);
+	atomic64_inc_na(&w->jobs);
+
+	if (job->affinity)
+		atomic_set_na(job->affinity, idx + 1);
+
+	job->func(job);
+}
+
+void jobsched_worker(struct jobsched *s, unsigned int idx) {
+	struct jobsched_worker *w = &s->workers[idx];
+
+	while (!__atomic_load_n(&s->shutdown, __ATOMIC_ACQUIRE)) {
+		mutex_lock(&w->lock);
+		struct jobsched_job *job = __pop_head(w);
+		mutex_unlock(&w->lock);
+
+		if (!job) {
+			job = __steal(s, idx);
+			if (job)
+				atomic64_inc_na(&w->steals);
+		}
+
+		if (job) {
+			__run(w, idx, job);
+			continue;
+		}
+
+		mutex_lock(&w->lock);
+		if (!w->queue.length && !__atomic_load_n(&s->shutdown, __ATOMIC_ACQUIRE)) {
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			timeval_add_usec(&tv, IDLE_WAIT_US);
+			__atomic_store_n(&w->sleeping, true, __ATOMIC_RELAXED);
+			cond_timedwait(&w->cond, &w->lock, &tv);
+			__atomic_store_n(&w->sleeping, false, __ATOMIC_RELAXED);
+		}
+		mutex_unlock(&w->lock);
+	}
+}
+
+void jobsched_shutdown(struct jobsched *s) {
+	__atomic_store_n(&s->shutdown, true, __ATOMIC_RELEASE);
+	for (unsigned int i = 0; i < s->num_workers; i++) {
+		struct jobsched_worker *w = &s->workers[i];
+		mutex_lock(&w->lock);
+		cond_signal(&w->cond);
+		mutex_unlock(&w->lock);
+	}
+}
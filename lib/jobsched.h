@@ -0,0 +1,74 @@
+#ifndef _JOBSCHED_H_
+#define _JOBSCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glib.h>
+#include "auxlib.h"
+
+
+// Work-stealing job scheduler. Each worker owns a queue of jobs, and jobs are placed on
+// the queue of the worker that last ran a job of the same affinity unit. A worker takes
+// jobs from the front of its own queue, and once that's empty, steals from the back of
+// the longest queue of another worker. Jobs are intrusive and never allocated by the
+// scheduler.
+//
+// The scheduler doesn't order jobs of the same unit relative to each other. To keep a
+// unit's jobs in order, the user must have no more than one job per unit queued or
+// running at any time, and let that job work off the unit's own backlog.
+
+#define JOBSCHED_LATENCY_BUCKETS	10
+
+
+struct jobsched_job;
+typedef void jobsched_func(struct jobsched_job *);
+
+struct jobsched_job {
+	GList link;			// in the worker's queue, data points to the job
+	jobsched_func *func;
+	unsigned int *affinity;		// 1 + index of the last worker, owned by the user, or NULL
+	int64_t queued;			// us
+};
+
+struct jobsched_worker {
+	mutex_t lock;
+	cond_t cond;
+	GQueue queue;
+	unsigned int depth;		// atomic for reading
+	bool sleeping;
+
+	atomic64 jobs;
+	atomic64 steals;		// jobs taken from other workers
+	unsigned int max_depth;		// atomic
+	atomic64 latency[JOBSCHED_LATENCY_BUCKETS];
+	atomic64 latency_sum;		// us
+} __attribute__ ((aligned (64)));
+
+struct jobsched {
+	unsigned int num_workers;
+	struct jobsched_worker *workers;
+	unsigned int next_worker;	// atomic, round-robin for new units
+	bool shutdown;
+};
+
+// upper bounds of the latency buckets in microseconds, the last one is unbounded
+extern const unsigned int jobsched_latency_bounds[JOBSCHED_LATENCY_BUCKETS];
+
+
+void jobsched_init(struct jobsched *, unsigned int num_workers);
+// only once all workers have returned
+void jobsched_free(struct jobsched *);
+
+// `job` must remain valid until its function has been called
+void jobsched_submit(struct jobsched *, struct jobsched_job *job);
+
+// runs jobs as worker number `idx` until jobsched_shutdown() is called
+void jobsched_worker(struct jobsched *, unsigned int idx);
+void jobsched_shutdown(struct jobsched *);
+
+INLINE unsigned int jobsched_depth(struct jobsched_worker *w) {
+	return atomic_get_na(&w->depth);
+}
+
+
+#endif
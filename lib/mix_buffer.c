@@ -14,12 +14,19 @@ typedef void mix_in_fn_t(void *restrict dst, const void *restrict src, unsigned
 struct mix_buffer_impl {
 	unsigned int sample_size;
 	mix_in_fn_t *mix_in;
+	void (*mix_n)(void *dst, const void *const *srcs, unsigned int num, unsigned int samples);
 };
 
 typedef struct {
 	struct ssrc_entry h; // must be first
 	unsigned int write_pos;
 	unsigned int loops;
+
+	// audio written behind the write head, kept in its own buffer (same layout as the
+	// main buffer) until it's mixed in when read
+	char *stage;
+	unsigned int stage_pos;
+	unsigned int stage_len; // in samples
 } mix_buffer_ssrc_source;
 
 
@@ -53,6 +60,32 @@ static void s16_mix_in_c(void *restrict dst, const void *restrict src, unsigned
 }
 
 
+static void s16_mix_n_range(void *dst, const void *const *srcs, unsigned int num,
+		unsigned int from, unsigned int to, void *const *minus)
+{
+	int16_t *d = dst;
+
+	for (unsigned int i = from; i < to; i++) {
+		int32_t sum = 0;
+		for (unsigned int j = 0; j < num; j++)
+			sum += ((const int16_t *) srcs[j])[i];
+		// before `dst`, which may be a source
+		for (unsigned int j = 0; minus && j < num; j++) {
+			int32_t mm = sum - ((const int16_t *) srcs[j])[i];
+			((int16_t *) minus[j])[i] = CLAMP(mm, INT16_MIN, INT16_MAX);
+		}
+		d[i] = CLAMP(sum, INT16_MIN, INT16_MAX);
+	}
+}
+
+unsigned int s16_mix_n_c(void *dst, const void *const *srcs, unsigned int num, unsigned int samples,
+		void *const *minus)
+{
+	s16_mix_n_range(dst, srcs, num, 0, samples, minus);
+	return samples;
+}
+
+
 #if defined(__x86_64__) && !defined(ASAN_BUILD) && HAS_ATTR(ifunc) && defined(__GLIBC__)
 static mix_in_fn_t *resolve_s16_mix_in(void) {
 	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX512BW))
@@ -64,14 +97,39 @@ static mix_in_fn_t *resolve_s16_mix_in(void) {
 	return s16_mix_in_c;
 }
 static mix_in_fn_t s16_mix_in __attribute__ ((ifunc ("resolve_s16_mix_in")));
+
+static mix_n_fn_t *resolve_s16_mix_n(void) {
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2))
+		return s16_mix_n_avx2;
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2))
+		return s16_mix_n_sse2;
+	return s16_mix_n_c;
+}
+static mix_n_fn_t s16_mix_n __attribute__ ((ifunc ("resolve_s16_mix_n")));
 #else
 #define s16_mix_in s16_mix_in_c
+#define s16_mix_n s16_mix_n_c
 #endif
 
 
+// the SIMD versions leave a remainder of samples
+void mix_s16_n(int16_t *dst, const int16_t *const *srcs, unsigned int num, unsigned int samples,
+		int16_t *const *minus)
+{
+	unsigned int done = s16_mix_n(dst, (const void *const *) srcs, num, samples, (void *const *) minus);
+	if (done < samples)
+		s16_mix_n_range(dst, (const void *const *) srcs, num, done, samples, (void *const *) minus);
+}
+
+static void s16_mix_n_impl(void *dst, const void *const *srcs, unsigned int num, unsigned int samples) {
+	mix_s16_n(dst, (const int16_t *const *) srcs, num, samples, NULL);
+}
+
+
 const struct mix_buffer_impl impl_s16_c = {
 	.sample_size = sizeof(int16_t),
 	.mix_in = s16_mix_in,
+	.mix_n = s16_mix_n_impl,
 };
 
 
@@ -101,6 +159,103 @@ static void fill_up_to(struct mix_buffer *mb, unsigned int up_to) {
 }
 
 
+// must be locked already
+static void mix_buffer_unstage(struct mix_buffer *mb, mix_buffer_ssrc_source *src) {
+	if (!src->stage_len)
+		return;
+	g_queue_remove(&mb->staged, src);
+	src->stage_len = 0;
+	obj_put(&src->h);
+}
+
+
+// mixes staged audio from all sources into the next `samples` to be read, in one pass for
+// each range covered by the same set of sources, and drops what's been consumed
+// must be locked already, with the buffer filled up to `samples`
+static void mix_buffer_mix_staged(struct mix_buffer *mb, unsigned int samples) {
+	if (!mb->staged.length)
+		return;
+
+	unsigned int num = mb->staged.length;
+	mix_buffer_ssrc_source **srcs = g_alloca(sizeof(*srcs) * num);
+	unsigned int *starts = g_alloca(sizeof(*starts) * num); // relative to read pos
+	unsigned int *ends = g_alloca(sizeof(*ends) * num);
+	unsigned int *cuts = g_alloca(sizeof(*cuts) * (num * 2 + 3));
+	unsigned int num_cuts = 0;
+	unsigned int n = 0;
+
+	cuts[num_cuts++] = 0;
+	cuts[num_cuts++] = samples;
+	if (mb->read_pos + samples > mb->size)
+		cuts[num_cuts++] = mb->size - mb->read_pos; // wrap-around
+
+	for (GList *l = mb->staged.head; l; ) {
+		mix_buffer_ssrc_source *src = l->data;
+		l = l->next;
+		unsigned int start = (src->stage_pos + mb->size - mb->read_pos) % mb->size;
+		if (start >= mb->fill) {
+			// staged audio is always within the filled part of the buffer, so this
+			// has (at least partly) been read out already: drop what's too late
+			unsigned int behind = mb->size - start;
+			if (behind >= src->stage_len) {
+				mix_buffer_unstage(mb, src);
+				continue;
+			}
+			src->stage_pos = mb->read_pos;
+			src->stage_len -= behind;
+			start = 0;
+		}
+		if (start >= samples)
+			continue;
+		srcs[n] = src;
+		starts[n] = start;
+		ends[n] = MIN(start + src->stage_len, samples);
+		cuts[num_cuts++] = starts[n];
+		cuts[num_cuts++] = ends[n];
+		n++;
+	}
+
+	// sort cut points. there's usually only a few of them
+	for (unsigned int i = 1; i < num_cuts; i++) {
+		unsigned int c = cuts[i];
+		unsigned int j = i;
+		for (; j > 0 && cuts[j - 1] > c; j--)
+			cuts[j] = cuts[j - 1];
+		cuts[j] = c;
+	}
+
+	const void **ins = g_alloca(sizeof(*ins) * (n + 1));
+
+	for (unsigned int i = 0; i + 1 < num_cuts; i++) {
+		unsigned int from = cuts[i], to = cuts[i + 1];
+		if (from == to)
+			continue;
+		unsigned int pos = (mb->read_pos + from) % mb->size;
+		char *dst = mb->buf.c + pos * mb->sample_size_channels;
+		unsigned int k = 0;
+		ins[k++] = dst;
+		for (unsigned int j = 0; j < n; j++) {
+			if (starts[j] <= from && ends[j] >= to)
+				ins[k++] = srcs[j]->stage + pos * mb->sample_size_channels;
+		}
+		if (k > 1)
+			mb->impl->mix_n(dst, ins, k, (to - from) * mb->channels);
+	}
+
+	// drop what's been consumed
+	for (unsigned int j = 0; j < n; j++) {
+		mix_buffer_ssrc_source *src = srcs[j];
+		unsigned int used = ends[j] - starts[j];
+		if (used == src->stage_len) {
+			mix_buffer_unstage(mb, src);
+			continue;
+		}
+		src->stage_pos = (src->stage_pos + used) % mb->size;
+		src->stage_len -= used;
+	}
+}
+
+
 void *mix_buffer_read_fast(struct mix_buffer *mb, unsigned int samples, unsigned int *size) {
 	LOCK(&mb->lock);
 
@@ -110,6 +265,7 @@ void *mix_buffer_read_fast(struct mix_buffer *mb, unsigned int samples, unsigned
 	}
 
 	fill_up_to(mb, samples);
+	mix_buffer_mix_staged(mb, samples);
 
 	*size = samples * mb->sample_size_channels;
 
@@ -129,6 +285,10 @@ void *mix_buffer_read_fast(struct mix_buffer *mb, unsigned int samples, unsigned
 void mix_buffer_read_slow(struct mix_buffer *mb, void *outbuf, unsigned int samples) {
 	LOCK(&mb->lock);
 
+	// audio may have been staged since mix_buffer_read_fast() released the lock
+	fill_up_to(mb, samples);
+	mix_buffer_mix_staged(mb, samples);
+
 	unsigned int tail_part = mb->size - mb->read_pos;
 	memcpy(outbuf, mb->buf.c + mb->read_pos * mb->sample_size_channels, tail_part * mb->sample_size_channels);
 	mb->fill -= samples;
@@ -181,6 +341,43 @@ static bool mix_buffer_write_fast(struct mix_buffer *mb, mix_buffer_ssrc_source
 }
 
 
+// copies audio written behind the write head into the source's own buffer, at its current
+// write position, to be mixed in when read
+// must be locked already
+static void mix_buffer_stage(struct mix_buffer *mb, mix_buffer_ssrc_source *src,
+		const void *buf, unsigned int samples)
+{
+	if (!samples)
+		return;
+
+	if (src->stage_len && (src->stage_pos + src->stage_len) % mb->size != src->write_pos) {
+		// doesn't continue what's there already: mix that in now
+		unsigned int pos = src->stage_pos;
+		unsigned int len = src->stage_len;
+		if (pos + len > mb->size) {
+			unsigned int tail_part = mb->size - pos;
+			mb->impl->mix_in(mb->buf.c + pos * mb->sample_size_channels,
+					src->stage + pos * mb->sample_size_channels, tail_part * mb->channels);
+			pos = 0;
+			len -= tail_part;
+		}
+		mb->impl->mix_in(mb->buf.c + pos * mb->sample_size_channels,
+				src->stage + pos * mb->sample_size_channels, len * mb->channels);
+		mix_buffer_unstage(mb, src);
+	}
+
+	if (!src->stage)
+		src->stage = g_malloc(mb->size * mb->sample_size_channels);
+	if (!src->stage_len) {
+		src->stage_pos = src->write_pos;
+		g_queue_push_tail(&mb->staged, obj_get(&src->h));
+	}
+
+	memcpy(src->stage + src->write_pos * mb->sample_size_channels, buf, samples * mb->sample_size_channels);
+	src->stage_len += samples;
+}
+
+
 // write before the write-head with mixing-in
 // must be locked already
 static bool mix_buffer_write_slow(struct mix_buffer *mb, mix_buffer_ssrc_source *src,
@@ -193,8 +390,7 @@ static bool mix_buffer_write_slow(struct mix_buffer *mb, mix_buffer_ssrc_source
 		unsigned int tail_part = mb->size - src->write_pos;
 		if (tail_part > samples)
 			tail_part = samples;
-		mb->impl->mix_in(mb->buf.c + src->write_pos * mb->sample_size_channels, buf,
-				tail_part * mb->channels);
+		mix_buffer_stage(mb, src, buf, tail_part);
 		samples -= tail_part;
 		buf = ((const char *) buf) + tail_part * mb->sample_size_channels;
 		src->write_pos += tail_part;
@@ -211,7 +407,7 @@ static bool mix_buffer_write_slow(struct mix_buffer *mb, mix_buffer_ssrc_source
 	unsigned int mix_part = mb->head_write_pos - src->write_pos;
 	if (mix_part > samples)
 		mix_part = samples;
-	mb->impl->mix_in(mb->buf.c + src->write_pos * mb->sample_size_channels, buf, mix_part * mb->channels);
+	mix_buffer_stage(mb, src, buf, mix_part);
 	samples -= mix_part;
 	src->write_pos += mix_part;
 	buf = ((const char *) buf) + mix_part * mb->sample_size_channels;
@@ -308,9 +504,14 @@ bool mix_buffer_write_delay(struct mix_buffer *mb, uint32_t ssrc, const void *bu
 }
 
 
+static void mix_buffer_ssrc_free(void *p) {
+	mix_buffer_ssrc_source *src = p;
+	g_free(src->stage);
+}
+
 static struct ssrc_entry *mix_buffer_ssrc_new(void *p) {
 	struct mix_buffer *mb = p;
-	mix_buffer_ssrc_source *src = obj_alloc0("mix_buffer_ssrc", sizeof(*src), NULL);
+	mix_buffer_ssrc_source *src = obj_alloc0("mix_buffer_ssrc", sizeof(*src), mix_buffer_ssrc_free);
 	mix_buffer_src_init_pos(mb, src);
 	return &src->h;
 }
@@ -347,6 +548,9 @@ bool mix_buffer_init_active(struct mix_buffer *mb, enum AVSampleFormat fmt, unsi
 
 
 void mix_buffer_destroy(struct mix_buffer *mb) {
+	mix_buffer_ssrc_source *src;
+	while ((src = g_queue_pop_head(&mb->staged)))
+		obj_put(&src->h);
 	g_free(mb->buf.v);
 	free_ssrc_hash(&mb->ssrc_hash);
 	mutex_destroy(&mb->lock);
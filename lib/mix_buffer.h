@@ -26,6 +26,10 @@ struct ssrc_hash;
  * the leading edge advanced, while other later sources writing into the
  * buffer mixed into the existing buffered audio at their respective write
  * positions.
+
+ * Audio from these later sources is first kept aside per source and only
+ * mixed in when read, so that any number of sources are summed up in one
+ * pass and saturated just once.
  */
 struct mix_buffer {
 	mutex_t lock;
@@ -56,6 +60,7 @@ struct mix_buffer {
 	const struct mix_buffer_impl *impl;
 	unsigned int sample_size_channels; // = sample_size * channels
 	struct ssrc_hash *ssrc_hash;
+	GQueue staged; // sources with audio waiting to be mixed in
 };
 
 
@@ -78,5 +83,27 @@ INLINE bool mix_buffer_write(struct mix_buffer *mb, uint32_t ssrc, const void *b
 	return mix_buffer_write_delay(mb, ssrc, buf, samples, NULL, NULL);
 }
 
+// Sums up `num` sources into `dst`, saturating only the final result. If `minus` is given, it
+// must hold `num` output buffers, each of which receives the mix of all sources except the
+// respective one. `dst` may be the same as the first source, with or without `minus`, but no
+// output may otherwise overlap a source. `samples` counts all channels.
+void mix_s16_n(int16_t *dst, const int16_t *const *srcs, unsigned int num, unsigned int samples,
+		int16_t *const *minus);
+
+// kernels behind mix_s16_n(), for testing. The SIMD versions only handle multiples of their
+// vector size and return how many samples were done
+typedef unsigned int mix_n_fn_t(void *dst, const void *const *srcs, unsigned int num, unsigned int samples,
+		void *const *minus);
+
+mix_n_fn_t s16_mix_n_c;
+
+#if defined(__x86_64__)
+// mix_n_x64_sse2.S
+mix_n_fn_t s16_mix_n_sse2;
+
+// mix_n_x64_avx2.S
+mix_n_fn_t s16_mix_n_avx2;
+#endif
+
 
 #endif
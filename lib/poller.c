@@ -300,14 +300,11 @@ void poller_error(struct poller *p, void *fdp) {
 	it->blocked = 1;
 }
 
-#ifdef HAVE_LIBURING
-
 static unsigned int __uring_thread_loop_dummy(void) { return 0; }
 
+// also used for flushing batched sends (see uring_sendmsg_batch_init)
 __thread unsigned int (*uring_thread_loop)(void) = __uring_thread_loop_dummy;
 
-#endif
-
 bool poller_isblocked(struct poller *p, void *fdp) {
 	int fd = GPOINTER_TO_INT(fdp);
 	int ret;
@@ -16,24 +16,31 @@
 
 
 
-AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to_format) {
-	const char *err;
-	int errcode = 0;
-
+// if false, the frame can be used as it is and resample_frame() would just return a new reference
+bool resample_frame_needed(AVFrame *frame, const format_t *to_format) {
 	CH_LAYOUT_T to_channel_layout;
 	DEF_CH_LAYOUT(&to_channel_layout, to_format->channels);
 	fix_frame_channel_layout(frame);
 
 	if (frame->format != to_format->format)
-		goto resample;
+		return true;
 	if (frame->sample_rate != to_format->clockrate)
-		goto resample;
+		return true;
 	if (!CH_LAYOUT_EQ(frame->CH_LAYOUT, to_channel_layout))
-		goto resample;
+		return true;
+	return false;
+}
 
-	return av_frame_clone(frame);
 
-resample:
+AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to_format) {
+	const char *err;
+	int errcode = 0;
+
+	if (!resample_frame_needed(frame, to_format))
+		return codec_frame_clone(frame);
+
+	CH_LAYOUT_T to_channel_layout;
+	DEF_CH_LAYOUT(&to_channel_layout, to_format->channels);
 
 	if (G_UNLIKELY(!resample->swresample)) {
 		SWR_ALLOC_SET_OPTS(&resample->swresample,
@@ -63,19 +70,14 @@ resample:
 			+ frame->nb_samples,
 				to_format->clockrate, frame->sample_rate, AV_ROUND_UP);
 
-	AVFrame *swr_frame = av_frame_alloc();
+	AVFrame *swr_frame = codec_frame_new(to_format->format, to_format->channels, to_format->clockrate,
+			dst_samples);
 
 	err = "failed to alloc resampling frame";
 	if (!swr_frame)
 		goto err;
 	av_frame_copy_props(swr_frame, frame);
-	swr_frame->format = to_format->format;
-	swr_frame->CH_LAYOUT = to_channel_layout;
-	swr_frame->nb_samples = dst_samples;
 	swr_frame->sample_rate = to_format->clockrate;
-	err = "failed to get resample buffers";
-	if ((errcode = av_frame_get_buffer(swr_frame, 0)) < 0)
-		goto err;
 
 	int ret_samples = swr_convert(resample->swresample, swr_frame->extended_data,
 				dst_samples,
@@ -7,6 +7,7 @@
 
 
 AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to_format);
+bool resample_frame_needed(AVFrame *frame, const format_t *to_format);
 void resample_shutdown(resample_t *resample);
 
 
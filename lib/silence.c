@@ -0,0 +1,71 @@
+#include "silence.h"
+#include <stdbool.h>
+#include "codeclib.h"
+
+
+#define silence_blocks_c(name, type, thres_type) \
+void silence_blocks_ ## name ## _c(uint8_t *out, const type *s, unsigned int blocks, \
+		thres_type thres) \
+{ \
+	for (unsigned int b = 0; b < blocks; b++, s += SILENCE_BLOCK) { \
+		bool silent = true; \
+		for (unsigned int i = 0; i < SILENCE_BLOCK; i++) \
+			silent &= (s[i] <= thres && s[i] >= -thres); \
+		out[b] = silent; \
+	} \
+}
+
+silence_blocks_c(s16, int16_t, int)
+silence_blocks_c(s32, int32_t, int)
+silence_blocks_c(flt, float, float)
+silence_blocks_c(dbl, double, double)
+
+
+#if defined(__x86_64__) && !defined(ASAN_BUILD) && HAS_ATTR(ifunc) && defined(__GLIBC__)
+#define silence_blocks_resolve(name) \
+static silence_blocks_ ## name ## _fn *resolve_silence_blocks_ ## name(void) { \
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2)) \
+		return silence_blocks_ ## name ## _avx2; \
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2)) \
+		return silence_blocks_ ## name ## _sse2; \
+	return silence_blocks_ ## name ## _c; \
+} \
+static silence_blocks_ ## name ## _fn silence_blocks_ ## name \
+	__attribute__ ((ifunc ("resolve_silence_blocks_" #name)));
+
+silence_blocks_resolve(s16)
+silence_blocks_resolve(s32)
+silence_blocks_resolve(flt)
+silence_blocks_resolve(dbl)
+#else
+#define silence_blocks_s16 silence_blocks_s16_c
+#define silence_blocks_s32 silence_blocks_s32_c
+#define silence_blocks_flt silence_blocks_flt_c
+#define silence_blocks_dbl silence_blocks_dbl_c
+#endif
+
+
+#define silence_scan(name, type, thres_type) \
+unsigned int silence_scan_ ## name(uint8_t *out, const type *s, unsigned int num, thres_type thres) { \
+	unsigned int blocks = num / SILENCE_BLOCK; \
+	silence_blocks_ ## name(out, s, blocks, thres); \
+ \
+	unsigned int rem = num % SILENCE_BLOCK; \
+	if (rem) { \
+		s += blocks * SILENCE_BLOCK; \
+		bool silent = true; \
+		for (unsigned int i = 0; i < rem; i++) \
+			silent &= (s[i] <= thres && s[i] >= -thres); \
+		out[blocks++] = silent; \
+	} \
+ \
+	unsigned int count = 0; \
+	for (unsigned int b = 0; b < blocks; b++) \
+		count += out[b]; \
+	return count; \
+}
+
+silence_scan(s16, int16_t, int16_t)
+silence_scan(s32, int32_t, int32_t)
+silence_scan(flt, float, float)
+silence_scan(dbl, double, double)
@@ -0,0 +1,52 @@
+#ifndef _SILENCE_H_
+#define _SILENCE_H_
+
+#include <stdint.h>
+#include "auxlib.h"
+
+
+// Silence detection works on blocks of this many samples. A block is silent if all of its
+// samples are within -thres..thres.
+#define SILENCE_BLOCK 16
+
+
+// Scans `num` samples and sets one flag in `out` for each block, with a trailing partial
+// block counted as a block of its own. `out` must have room for silence_blocks(num) flags.
+// Returns the number of silent blocks.
+unsigned int silence_scan_s16(uint8_t *out, const int16_t *, unsigned int num, int16_t thres);
+unsigned int silence_scan_s32(uint8_t *out, const int32_t *, unsigned int num, int32_t thres);
+unsigned int silence_scan_flt(uint8_t *out, const float *, unsigned int num, float thres);
+unsigned int silence_scan_dbl(uint8_t *out, const double *, unsigned int num, double thres);
+
+INLINE unsigned int silence_blocks(unsigned int num) {
+	return (num + SILENCE_BLOCK - 1) / SILENCE_BLOCK;
+}
+
+
+// block kernels behind silence_scan_*(), for testing. These only handle whole blocks
+typedef void silence_blocks_s16_fn(uint8_t *out, const int16_t *, unsigned int blocks, int thres);
+typedef void silence_blocks_s32_fn(uint8_t *out, const int32_t *, unsigned int blocks, int thres);
+typedef void silence_blocks_flt_fn(uint8_t *out, const float *, unsigned int blocks, float thres);
+typedef void silence_blocks_dbl_fn(uint8_t *out, const double *, unsigned int blocks, double thres);
+
+silence_blocks_s16_fn silence_blocks_s16_c;
+silence_blocks_s32_fn silence_blocks_s32_c;
+silence_blocks_flt_fn silence_blocks_flt_c;
+silence_blocks_dbl_fn silence_blocks_dbl_c;
+
+#if defined(__x86_64__)
+// silence_x64_sse2.S
+silence_blocks_s16_fn silence_blocks_s16_sse2;
+silence_blocks_s32_fn silence_blocks_s32_sse2;
+silence_blocks_flt_fn silence_blocks_flt_sse2;
+silence_blocks_dbl_fn silence_blocks_dbl_sse2;
+
+// silence_x64_avx2.S
+silence_blocks_s16_fn silence_blocks_s16_avx2;
+silence_blocks_s32_fn silence_blocks_s32_avx2;
+silence_blocks_flt_fn silence_blocks_flt_avx2;
+silence_blocks_dbl_fn silence_blocks_dbl_avx2;
+#endif
+
+
+#endif
@@ -40,6 +40,8 @@ static ssize_t __ip_recvfrom(socket_t *s, void *buf, size_t len, endpoint_t *ep)
 static ssize_t __ip_recvfrom_ts(socket_t *s, void *buf, size_t len, endpoint_t *ep, struct timeval *);
 static ssize_t __ip4_recvfrom_to(socket_t *s, void *buf, size_t len, endpoint_t *ep, sockaddr_t *to);
 static ssize_t __ip6_recvfrom_to(socket_t *s, void *buf, size_t len, endpoint_t *ep, sockaddr_t *to);
+static int __ip_recvmmsg_ts(socket_t *s, void **bufs, size_t len, unsigned int num, size_t *lens,
+		endpoint_t *eps, struct timeval *tvs);
 static ssize_t __ip_sendmsg(socket_t *s, struct msghdr *mh, const endpoint_t *ep);
 static ssize_t __ip_sendto(socket_t *s, const void *buf, size_t len, const endpoint_t *ep);
 static int __ip4_tos(socket_t *, unsigned int);
@@ -92,6 +94,7 @@ static struct socket_family __socket_families[__SF_LAST] = {
 		.recvfrom		= __ip_recvfrom,
 		.recvfrom_ts		= __ip_recvfrom_ts,
 		.recvfrom_to		= __ip4_recvfrom_to,
+		.recvmmsg_ts		= __ip_recvmmsg_ts,
 		.sendmsg		= __ip_sendmsg,
 		.sendto			= __ip_sendto,
 		.tos			= __ip4_tos,
@@ -127,6 +130,7 @@ static struct socket_family __socket_families[__SF_LAST] = {
 		.recvfrom		= __ip_recvfrom,
 		.recvfrom_ts		= __ip_recvfrom_ts,
 		.recvfrom_to		= __ip6_recvfrom_to,
+		.recvmmsg_ts		= __ip_recvmmsg_ts,
 		.sendmsg		= __ip_sendmsg,
 		.sendto			= __ip_sendto,
 		.tos			= __ip6_tos,
@@ -370,6 +374,55 @@ static ssize_t __ip4_recvfrom_to(socket_t *s, void *buf, size_t len, endpoint_t
 static ssize_t __ip6_recvfrom_to(socket_t *s, void *buf, size_t len, endpoint_t *ep, sockaddr_t *to) {
 	return __ip_recvfrom_options(s, buf, len, ep, NULL, to, __ip6_pktinfo_parse);
 }
+// receives up to `num` datagrams with a single system call. each buffer must be at least `len` bytes.
+// returns the number of datagrams received, or -1 with errno set
+static int __ip_recvmmsg_ts(socket_t *s, void **bufs, size_t len, unsigned int num, size_t *lens,
+		endpoint_t *eps, struct timeval *tvs)
+{
+	struct mmsghdr mm[MAX_SOCKET_BATCH];
+	struct sockaddr_storage sin[MAX_SOCKET_BATCH];
+	struct iovec iov[MAX_SOCKET_BATCH];
+	char ctrl[MAX_SOCKET_BATCH][64];
+
+	if (num > MAX_SOCKET_BATCH)
+		num = MAX_SOCKET_BATCH;
+
+	for (unsigned int i = 0; i < num; i++) {
+		iov[i] = (struct iovec) {
+			.iov_base = bufs[i],
+			.iov_len = len,
+		};
+		mm[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_name = &sin[i],
+				.msg_namelen = s->family->sockaddr_size,
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+				.msg_control = ctrl[i],
+				.msg_controllen = sizeof(ctrl[i]),
+			},
+		};
+	}
+
+	int ret = recvmmsg(s->fd, mm, num, 0, NULL);
+	if (ret <= 0)
+		return ret;
+
+	bool (*parse)(struct cmsghdr *, sockaddr_t *) = NULL;
+
+	for (int i = 0; i < ret; i++) {
+		struct msghdr *msg = &mm[i].msg_hdr;
+		struct timeval *tv = &tvs[i];
+		sockaddr_t *to = NULL;
+
+		lens[i] = mm[i].msg_len;
+		s->family->sockaddr2endpoint(&eps[i], &sin[i]);
+
+		socket_recvfrom_parse_cmsg(&tv, &to, parse, msg, CMSG_FIRSTHDR(msg), CMSG_NXTHDR(msg, cm));
+	}
+
+	return ret;
+}
 static ssize_t __ip_sendmsg(socket_t *s, struct msghdr *mh, const endpoint_t *ep) {
 	struct sockaddr_storage sin;
 
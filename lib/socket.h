@@ -43,6 +43,7 @@ TYPED_GQUEUE(socket, socket_t)
 
 
 #define MAX_PACKET_HEADER_LEN 48 // 40 bytes IPv6 + 8 bytes UDP
+#define MAX_SOCKET_BATCH 64 // upper limit for recvmmsg/sendmmsg
 
 
 
@@ -79,6 +80,8 @@ struct socket_family {
 	ssize_t				(*recvfrom)(socket_t *, void *, size_t, endpoint_t *);
 	ssize_t				(*recvfrom_ts)(socket_t *, void *, size_t, endpoint_t *, struct timeval *);
 	ssize_t				(*recvfrom_to)(socket_t *, void *, size_t, endpoint_t *, sockaddr_t *);
+	int				(*recvmmsg_ts)(socket_t *, void **, size_t, unsigned int, size_t *,
+						endpoint_t *, struct timeval *);
 	ssize_t				(*sendmsg)(socket_t *, struct msghdr *, const endpoint_t *);
 	ssize_t				(*sendto)(socket_t *, const void *, size_t, const endpoint_t *);
 	int				(*tos)(socket_t *, unsigned int);
@@ -195,6 +198,7 @@ INLINE int is_addr_unspecified(const sockaddr_t *a) {
 #define socket_recvfrom(s,a...) (s)->family->recvfrom((s), a)
 #define socket_recvfrom_ts(s,a...) (s)->family->recvfrom_ts((s), a)
 #define socket_recvfrom_to(s,a...) (s)->family->recvfrom_to((s), a)
+#define socket_recvmmsg_ts(s,a...) (s)->family->recvmmsg_ts((s), a)
 #define socket_sendmsg(s,a...) (s)->family->sendmsg((s), a)
 #define socket_sendto(s,a...) (s)->family->sendto((s), a)
 #define socket_error(s) (s)->family->error((s))
@@ -0,0 +1,218 @@
+#include "timerwheel.h"
+#include <string.h>
+#include <glib.h>
+
+
+#define SLOT_MASK ((uint64_t) TIMER_WHEEL_SLOTS - 1)
+
+
+INLINE uint64_t __tick(uint64_t us) {
+	return us >> TIMER_WHEEL_TICK_BITS;
+}
+INLINE uint64_t __tv_us(const struct timeval *tv) {
+	return (uint64_t) tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+INLINE void __bit_set(struct timer_wheel *w, unsigned int slot) {
+	w->bitmap[slot / 64] |= 1ULL << (slot % 64);
+}
+INLINE void __bit_clear(struct timer_wheel *w, unsigned int slot) {
+	w->bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+// first set bit at index >= `from` within the given level, or -1
+static int __bitmap_next(const uint64_t *bm, unsigned int from) {
+	if (from >= TIMER_WHEEL_SLOTS)
+		return -1;
+	unsigned int word = from / 64;
+	uint64_t bits = bm[word] & (~0ULL << (from % 64));
+	while (true) {
+		if (bits)
+			return word * 64 + __builtin_ctzll(bits);
+		if (++word >= TIMER_WHEEL_SLOTS / 64)
+			return -1;
+		bits = bm[word];
+	}
+}
+
+
+void timer_wheel_init(struct timer_wheel *w, const struct timeval *now) {
+	memset(w->bitmap, 0, sizeof(w->bitmap));
+	for (unsigned int i = 0; i <= TIMER_WHEEL_OVERFLOW; i++)
+		w->slots[i].next = w->slots[i].prev = &w->slots[i];
+	w->base = __tick(__tv_us(now));
+	w->count = 0;
+}
+
+
+// Level 0 holds the ticks of the current block of TIMER_WHEEL_SLOTS ticks, anything due
+// at or before `base` goes into the base slot. Level N holds the later slots of the current
+// level N+1 block. This keeps all levels in time order relative to each other.
+static unsigned int __slot_for(const struct timer_wheel *w, uint64_t tick) {
+	if (tick <= w->base)
+		return w->base & SLOT_MASK;
+	for (unsigned int l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+		unsigned int shift = TIMER_WHEEL_SLOT_BITS * (l + 1);
+		if ((tick >> shift) == (w->base >> shift))
+			return l * TIMER_WHEEL_SLOTS
+				+ ((tick >> (TIMER_WHEEL_SLOT_BITS * l)) & SLOT_MASK);
+	}
+	return TIMER_WHEEL_OVERFLOW;
+}
+
+static void __link(struct timer_wheel *w, struct timer_wheel_node *n) {
+	unsigned int slot = __slot_for(w, __tick(n->expires));
+	struct timer_wheel_node *head = &w->slots[slot];
+	n->slot = slot;
+	n->next = head;
+	n->prev = head->prev;
+	head->prev->next = n;
+	head->prev = n;
+	if (slot < TIMER_WHEEL_OVERFLOW)
+		__bit_set(w, slot);
+}
+
+static void __unlink(struct timer_wheel *w, struct timer_wheel_node *n) {
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+	struct timer_wheel_node *head = &w->slots[n->slot];
+	if (head->next == head && n->slot < TIMER_WHEEL_OVERFLOW)
+		__bit_clear(w, n->slot);
+	n->next = n->prev = NULL;
+}
+
+void timer_wheel_add(struct timer_wheel *w, struct timer_wheel_node *n, const struct timeval *tv) {
+	n->expires = __tv_us(tv);
+	__link(w, n);
+	w->count++;
+}
+
+bool timer_wheel_del(struct timer_wheel *w, struct timer_wheel_node *n) {
+	if (!n->next)
+		return false;
+	__unlink(w, n);
+	w->count--;
+	return true;
+}
+
+// moves all nodes from one slot into their new slots relative to the current base
+static void __relink_slot(struct timer_wheel *w, unsigned int slot) {
+	struct timer_wheel_node *head = &w->slots[slot];
+	if (head->next == head)
+		return;
+
+	struct timer_wheel_node list = { .next = head->next, .prev = head->prev };
+	list.next->prev = &list;
+	list.prev->next = &list;
+	head->next = head->prev = head;
+	if (slot < TIMER_WHEEL_OVERFLOW)
+		__bit_clear(w, slot);
+
+	while (list.next != &list) {
+		struct timer_wheel_node *n = list.next;
+		list.next = n->next;
+		n->next->prev = &list;
+		__link(w, n);
+	}
+}
+
+// base has just been moved onto a block boundary: pull down the slots that now
+// belong to the current block, highest level first
+static void __cascade(struct timer_wheel *w) {
+	unsigned int top = 0;
+	while (top < TIMER_WHEEL_LEVELS
+			&& !(w->base & ((1ULL << (TIMER_WHEEL_SLOT_BITS * (top + 1))) - 1)))
+		top++;
+
+	if (top == TIMER_WHEEL_LEVELS) {
+		__relink_slot(w, TIMER_WHEEL_OVERFLOW);
+		top = TIMER_WHEEL_LEVELS - 1;
+	}
+	for (unsigned int l = top; l >= 1; l--)
+		__relink_slot(w, l * TIMER_WHEEL_SLOTS
+				+ ((w->base >> (TIMER_WHEEL_SLOT_BITS * l)) & SLOT_MASK));
+}
+
+// earliest tick at which something needs to happen: either an occupied level 0
+// slot or the start of an occupied slot on a higher level
+static uint64_t __next_tick(const struct timer_wheel *w) {
+	for (unsigned int l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+		unsigned int shift = TIMER_WHEEL_SLOT_BITS * l;
+		unsigned int idx = (w->base >> shift) & SLOT_MASK;
+		int s = __bitmap_next(&w->bitmap[l * TIMER_WHEEL_SLOTS / 64], l ? idx + 1 : idx);
+		if (s < 0)
+			continue;
+		unsigned int block_shift = shift + TIMER_WHEEL_SLOT_BITS;
+		return ((w->base >> block_shift) << block_shift) | ((uint64_t) s << shift);
+	}
+	unsigned int top_shift = TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS;
+	return ((w->base >> top_shift) + 1) << top_shift;
+}
+
+// moves base forward, but never past an occupied slot
+static void __advance(struct timer_wheel *w, uint64_t target) {
+	if (!w->count) {
+		if (target > w->base)
+			w->base = target;
+		return;
+	}
+
+	while (w->base < target) {
+		uint64_t next = __next_tick(w);
+		if (next <= w->base)
+			return;
+		if (next > target) {
+			w->base = target;
+			return;
+		}
+		w->base = next;
+		if (!(next & SLOT_MASK))
+			__cascade(w);
+	}
+}
+
+static struct timer_wheel_node *__slot_min(struct timer_wheel *w, unsigned int slot) {
+	struct timer_wheel_node *head = &w->slots[slot];
+	struct timer_wheel_node *ret = NULL;
+	for (struct timer_wheel_node *n = head->next; n != head; n = n->next) {
+		if (!ret || n->expires < ret->expires)
+			ret = n;
+	}
+	return ret;
+}
+
+struct timer_wheel_node *timer_wheel_first(struct timer_wheel *w, const struct timeval *now) {
+	// always advance, so that an idle wheel doesn't lag behind
+	__advance(w, __tick(__tv_us(now)));
+	if (!w->count)
+		return NULL;
+
+	int s = __bitmap_next(w->bitmap, w->base & SLOT_MASK);
+	if (s >= 0)
+		return w->slots[s].next;
+
+	// nothing in the current block. higher level slots are not sorted, so find the
+	// earliest one. this only happens when there's nothing to do for a while
+	for (unsigned int l = 1; l < TIMER_WHEEL_LEVELS; l++) {
+		unsigned int idx = (w->base >> (TIMER_WHEEL_SLOT_BITS * l)) & SLOT_MASK;
+		s = __bitmap_next(&w->bitmap[l * TIMER_WHEEL_SLOTS / 64], idx + 1);
+		if (s >= 0)
+			return __slot_min(w, l * TIMER_WHEEL_SLOTS + s);
+	}
+
+	return __slot_min(w, TIMER_WHEEL_OVERFLOW);
+}
+
+struct timer_wheel_node *timer_wheel_steal(struct timer_wheel *w) {
+	if (!w->count)
+		return NULL;
+	for (unsigned int i = 0; i <= TIMER_WHEEL_OVERFLOW; i++) {
+		struct timer_wheel_node *head = &w->slots[i];
+		if (head->next == head)
+			continue;
+		struct timer_wheel_node *n = head->next;
+		timer_wheel_del(w, n);
+		return n;
+	}
+	return NULL;
+}
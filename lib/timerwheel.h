@@ -0,0 +1,51 @@
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include "compat.h"
+
+
+// Hierarchical hashed timing wheel with intrusive nodes. Scheduling and descheduling
+// are O(1) and don't allocate. Level 0 has a resolution of one tick (1 << TIMER_WHEEL_TICK_BITS
+// microseconds), each higher level covers TIMER_WHEEL_SLOTS slots of the level below.
+// Anything beyond the top level is kept in an overflow list. Not thread safe, the user
+// must provide locking.
+
+#define TIMER_WHEEL_TICK_BITS		5 // 32 us
+#define TIMER_WHEEL_SLOT_BITS		8
+#define TIMER_WHEEL_SLOTS		(1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS		4
+#define TIMER_WHEEL_OVERFLOW		(TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+
+
+struct timer_wheel_node {
+	struct timer_wheel_node *next, *prev; // NULL if not scheduled
+	uint64_t expires; // microseconds
+	unsigned int slot;
+};
+
+struct timer_wheel {
+	uint64_t base; // current tick, never ahead of anything in the base slot
+	unsigned int count;
+	uint64_t bitmap[TIMER_WHEEL_OVERFLOW / 64]; // occupied slots
+	struct timer_wheel_node slots[TIMER_WHEEL_OVERFLOW + 1]; // list heads
+};
+
+
+void timer_wheel_init(struct timer_wheel *, const struct timeval *now);
+void timer_wheel_add(struct timer_wheel *, struct timer_wheel_node *, const struct timeval *);
+bool timer_wheel_del(struct timer_wheel *, struct timer_wheel_node *);
+// returns a node from the earliest occupied slot, without removing it. all nodes
+// in that slot expire within one tick of each other
+struct timer_wheel_node *timer_wheel_first(struct timer_wheel *, const struct timeval *now);
+// removes and returns an arbitrary node, for cleanup
+struct timer_wheel_node *timer_wheel_steal(struct timer_wheel *);
+
+INLINE bool timer_wheel_node_scheduled(const struct timer_wheel_node *n) {
+	return n->next != NULL;
+}
+
+
+#endif
@@ -2,6 +2,7 @@
 #include <errno.h>
 #include <string.h>
 #include <poll.h>
+#include <netinet/udp.h>
 #include "log.h"
 #include "loglib.h"
 #include "socket.h"
@@ -14,7 +15,11 @@
 #define BUFFERS_COUNT 1024		// number of buffers allocated in one pool, should be 2^n
 #define BUFFER_POOLS 8			// number of pools to keep alive
 
+#define BUFFER_RING_ENTRIES (BUFFERS_COUNT * BUFFER_POOLS)
+#define FIXED_FILES 16384		// registered file slots per io_uring
+
 static_assert(BUFFERS_COUNT * BUFFER_POOLS < (1<<16), "too many buffers (>= 2^16)");
+static_assert((BUFFER_RING_ENTRIES & (BUFFER_RING_ENTRIES - 1)) == 0, "buffer ring size must be 2^n");
 
 struct uring_buffer {
 	void *buf;
@@ -30,6 +35,15 @@ struct poller {
 	struct bufferpool *bufferpool;
 	struct uring_buffer *buffers[BUFFER_POOLS];
 	GArray *blocked;
+
+	// everything below is only used by the poller thread itself
+	bool set_up;
+	struct io_uring_buf_ring *buf_ring; // NULL if buffers are provided through SQEs
+	GQueue starved; // uring_poll_recv waiting for buffers to become available
+	GPtrArray *recvs; // uring_poll_recv by fd
+	GArray *fixed; // registered file slot + 1 by fd, or zero
+	unsigned int *fixed_free; // stack of unused slots, NULL if not supported
+	unsigned int fixed_free_num;
 };
 
 struct poller_req {
@@ -60,12 +74,315 @@ static ssize_t __socket_sendmsg(socket_t *s, struct msghdr *m, const endpoint_t
 __thread __typeof(__socket_sendmsg) (*uring_sendmsg) = __socket_sendmsg;
 
 
+// Egress batching: packets handed to uring_sendmsg() are collected per thread and sent
+// out together when the thread finishes its current poll iteration or timer run
+// (uring_thread_loop), or when the batch is full. Runs of packets to the same
+// destination with equal sizes are sent as a single UDP GSO message, everything else
+// through sendmmsg() (or individual SQEs with io_uring).
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#define UDP_GSO_MAX_BYTES 65000
+
+struct send_batch_entry {
+	int fd;
+	struct msghdr *msg;
+	struct uring_req *req;
+};
+
+struct gso_send_req {
+	struct uring_req req; // must be first
+	int fd;
+	struct msghdr msg;
+	struct iovec iov[MAX_SOCKET_BATCH];
+	char ctrl[CMSG_SPACE(sizeof(uint16_t))];
+	unsigned int num;
+	struct send_batch_entry ents[MAX_SOCKET_BATCH];
+};
+
+static __thread struct send_batch_entry send_batch[MAX_SOCKET_BATCH];
+static __thread unsigned int send_batch_num;
+static __thread unsigned int send_batch_max;
+static __thread bool send_batch_no_gso;
+static __thread bool send_batch_uring;
+#ifdef HAVE_LIBURING
+static void __uring_send_batch_gso(struct gso_send_req *);
+static void __uring_send_batch_many(struct send_batch_entry **, unsigned int);
+#endif
+
+
+static void send_batch_single(struct send_batch_entry *e) {
+	ssize_t ret = sendmsg(e->fd, e->msg, 0);
+	e->req->handler(e->req, ret < 0 ? -errno : ret, 0);
+}
+
+static void gso_send_req_done(struct uring_req *r, int32_t res, uint32_t flags) {
+	struct gso_send_req *g = (__typeof__(g)) r;
+
+	if (res == -EIO || res == -EINVAL || res == -ENOPROTOOPT || res == -EOPNOTSUPP) {
+		// no GSO support on this socket or device: fall back to sending individually
+		if (!send_batch_no_gso)
+			ilog(LOG_INFO, "UDP GSO not supported (%s), sending batched packets individually",
+					strerror(-res));
+		send_batch_no_gso = true;
+		for (unsigned int i = 0; i < g->num; i++)
+			send_batch_single(&g->ents[i]);
+	}
+	else {
+		for (unsigned int i = 0; i < g->num; i++)
+			g->ents[i].req->handler(g->ents[i].req, res, flags);
+	}
+
+	uring_req_free(r);
+}
+
+static bool send_batch_gso_capable(const struct msghdr *m) {
+	return m->msg_iovlen == 1 && m->msg_controllen == 0 && m->msg_iov[0].iov_len > 0;
+}
+
+// returns the number of leading entries that can be sent as one GSO message
+static unsigned int send_batch_gso_run(struct send_batch_entry **e, unsigned int num) {
+	if (send_batch_no_gso || num < 2)
+		return 0;
+
+	const struct msghdr *first = e[0]->msg;
+	if (!send_batch_gso_capable(first))
+		return 0;
+
+	size_t seg = first->msg_iov[0].iov_len;
+	size_t total = seg;
+	unsigned int i;
+
+	for (i = 1; i < num; i++) {
+		const struct msghdr *m = e[i]->msg;
+		if (!send_batch_gso_capable(m))
+			break;
+		if (m->msg_namelen != first->msg_namelen
+				|| memcmp(m->msg_name, first->msg_name, m->msg_namelen))
+			break;
+		size_t len = m->msg_iov[0].iov_len;
+		if (len > seg || total + len > UDP_GSO_MAX_BYTES)
+			break;
+		total += len;
+		if (len < seg) {
+			// a shorter segment can only be the last one
+			i++;
+			break;
+		}
+	}
+
+	return i;
+}
+
+static struct gso_send_req *gso_send_req_new(struct send_batch_entry **e, unsigned int num) {
+	struct gso_send_req *g = uring_alloc_req(sizeof(*g), gso_send_req_done);
+	uint16_t seg = e[0]->msg->msg_iov[0].iov_len;
+
+	g->fd = e[0]->fd;
+	g->num = num;
+	for (unsigned int i = 0; i < num; i++) {
+		g->ents[i] = *e[i];
+		g->iov[i] = e[i]->msg->msg_iov[0];
+	}
+	g->msg = (__typeof(g->msg)) {
+		.msg_name = e[0]->msg->msg_name,
+		.msg_namelen = e[0]->msg->msg_namelen,
+		.msg_iov = g->iov,
+		.msg_iovlen = num,
+		.msg_control = g->ctrl,
+		.msg_controllen = sizeof(g->ctrl),
+	};
+
+	struct cmsghdr *cm = CMSG_FIRSTHDR(&g->msg);
+	cm->cmsg_level = SOL_UDP;
+	cm->cmsg_type = UDP_SEGMENT;
+	cm->cmsg_len = CMSG_LEN(sizeof(seg));
+	memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+
+	return g;
+}
+
+static void __socket_send_batch_gso(struct gso_send_req *g) {
+	ssize_t ret = sendmsg(g->fd, &g->msg, 0);
+	g->req.handler(&g->req, ret < 0 ? -errno : ret, 0);
+}
+
+static void __socket_send_batch_many(struct send_batch_entry **e, unsigned int num) {
+	struct mmsghdr mm[MAX_SOCKET_BATCH];
+
+	for (unsigned int i = 0; i < num; i++)
+		mm[i] = (struct mmsghdr) { .msg_hdr = *e[i]->msg };
+
+	unsigned int i = 0;
+	while (i < num) {
+		int ret = sendmmsg(e[i]->fd, &mm[i], num - i, 0);
+		if (ret <= 0) {
+			if (ret < 0 && errno == EINTR)
+				continue;
+			// first message failed: drop it and carry on with the rest
+			e[i]->req->handler(e[i]->req, ret < 0 ? -errno : 0, 0);
+			i++;
+			continue;
+		}
+		for (int j = 0; j < ret; j++, i++)
+			e[i]->req->handler(e[i]->req, mm[i].msg_len, 0);
+	}
+}
+
+// all entries are for the same fd and are sent in order
+static void send_batch_fd(struct send_batch_entry **e, unsigned int num) {
+	unsigned int i = 0;
+
+	while (i < num) {
+		unsigned int run = send_batch_gso_run(&e[i], num - i);
+		if (run >= 2) {
+			struct gso_send_req *g = gso_send_req_new(&e[i], run);
+#ifdef HAVE_LIBURING
+			if (send_batch_uring)
+				__uring_send_batch_gso(g);
+			else
+#endif
+				__socket_send_batch_gso(g);
+			i += run;
+			continue;
+		}
+
+		// collect everything up to the next GSO-capable run
+		unsigned int j = i + 1;
+		while (j < num && send_batch_gso_run(&e[j], num - j) < 2)
+			j++;
+#ifdef HAVE_LIBURING
+		if (send_batch_uring)
+			__uring_send_batch_many(&e[i], j - i);
+		else
+#endif
+			__socket_send_batch_many(&e[i], j - i);
+		i = j;
+	}
+}
+
+static void send_batch_flush(void) {
+	unsigned int num = send_batch_num;
+	if (!num)
+		return;
+
+	// completion handlers may queue up new packets, so work from a copy
+	struct send_batch_entry batch[MAX_SOCKET_BATCH];
+	memcpy(batch, send_batch, sizeof(*batch) * num);
+	send_batch_num = 0;
+
+	bool done[MAX_SOCKET_BATCH] = {0};
+
+	for (unsigned int i = 0; i < num; i++) {
+		if (done[i])
+			continue;
+
+		// group by socket, keeping the order of packets
+		struct send_batch_entry *grp[MAX_SOCKET_BATCH];
+		unsigned int grp_num = 0;
+		for (unsigned int j = i; j < num; j++) {
+			if (done[j] || batch[j].fd != batch[i].fd)
+				continue;
+			grp[grp_num++] = &batch[j];
+			done[j] = true;
+		}
+
+		send_batch_fd(grp, grp_num);
+	}
+}
+
+static ssize_t __batch_sendmsg(socket_t *s, struct msghdr *m, const endpoint_t *e,
+		struct sockaddr_storage *ss, struct uring_req *r)
+{
+	s->family->endpoint2sockaddr(ss, e);
+	m->msg_name = ss;
+	m->msg_namelen = s->family->sockaddr_size;
+
+	send_batch[send_batch_num++] = (struct send_batch_entry) {
+		.fd = s->fd,
+		.msg = m,
+		.req = r,
+	};
+
+	if (send_batch_num >= send_batch_max)
+		send_batch_flush();
+
+	return 0;
+}
+
+static unsigned int __batch_thread_loop(void) {
+	send_batch_flush();
+	return 0;
+}
+
+// must be called after uring_thread_init() if io_uring is used
+void uring_sendmsg_batch_init(unsigned int max) {
+	if (max <= 1)
+		return;
+	send_batch_max = MIN(max, MAX_SOCKET_BATCH);
+#ifdef HAVE_LIBURING
+	send_batch_uring = uring_sendmsg != __socket_sendmsg;
+#endif
+	uring_sendmsg = __batch_sendmsg;
+	if (!send_batch_uring)
+		uring_thread_loop = __batch_thread_loop;
+}
+
+
 #ifdef HAVE_LIBURING
 
 #include <liburing.h>
 
 
 static __thread struct io_uring rtpe_uring;
+static __thread struct poller *rtpe_uring_poller; // owned by this thread, if any
+
+
+// registered file slot of the fd in this thread's io_uring, or -1
+static int uring_fixed_slot(struct poller *p, int fd) {
+	if (!p || !p->fixed_free || fd < 0 || fd >= p->fixed->len)
+		return -1;
+	return (int) g_array_index(p->fixed, unsigned int, fd) - 1;
+}
+
+// registers the fd in this thread's file table, returns the slot or -1
+static int uring_fixed_add(struct poller *p, int fd) {
+	int slot = uring_fixed_slot(p, fd);
+	if (slot >= 0)
+		return slot;
+	if (!p->fixed_free || !p->fixed_free_num)
+		return -1;
+
+	slot = p->fixed_free[--p->fixed_free_num];
+	if (io_uring_register_files_update(&rtpe_uring, slot, &fd, 1) != 1) {
+		p->fixed_free_num++;
+		return -1;
+	}
+	if (p->fixed->len <= fd)
+		g_array_set_size(p->fixed, fd + 1);
+	g_array_index(p->fixed, unsigned int, fd) = slot + 1;
+	return slot;
+}
+static void uring_fixed_del(struct poller *p, int fd) {
+	int slot = uring_fixed_slot(p, fd);
+	if (slot < 0)
+		return;
+	int none = -1;
+	io_uring_register_files_update(&rtpe_uring, slot, &none, 1);
+	g_array_index(p->fixed, unsigned int, fd) = 0;
+	p->fixed_free[p->fixed_free_num++] = slot;
+}
+
+static void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *m) {
+	int slot = uring_fixed_slot(rtpe_uring_poller, fd);
+	if (slot < 0)
+		io_uring_prep_sendmsg(sqe, fd, m, 0);
+	else {
+		io_uring_prep_sendmsg(sqe, slot, m, 0);
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+}
 
 
 static ssize_t __uring_sendmsg(socket_t *s, struct msghdr *m, const endpoint_t *e,
@@ -77,12 +394,30 @@ static ssize_t __uring_sendmsg(socket_t *s, struct msghdr *m, const endpoint_t *
 	m->msg_name = ss;
 	m->msg_namelen = s->family->sockaddr_size;
 	io_uring_sqe_set_data(sqe, r);
-	io_uring_prep_sendmsg(sqe, s->fd, m, 0);
+	uring_prep_sendmsg(sqe, s->fd, m);
 
 	return 0;
 }
 
+static void __uring_send_batch_gso(struct gso_send_req *g) {
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&rtpe_uring);
+	assert(sqe != NULL);
+	io_uring_sqe_set_data(sqe, &g->req);
+	uring_prep_sendmsg(sqe, g->fd, &g->msg);
+}
+
+static void __uring_send_batch_many(struct send_batch_entry **e, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&rtpe_uring);
+		assert(sqe != NULL);
+		io_uring_sqe_set_data(sqe, e[i]->req);
+		uring_prep_sendmsg(sqe, e[i]->fd, e[i]->msg);
+	}
+}
+
 static unsigned int __uring_thread_loop(void) {
+	send_batch_flush();
+
 	io_uring_submit_and_get_events(&rtpe_uring);
 
 	struct io_uring_cqe *cqe;
@@ -143,6 +478,9 @@ struct poller *uring_poller_new(void) {
 	nonblock(ret->waker_fds[1]);
 	ret->evs = g_ptr_array_new();
 	ret->blocked = g_array_new(false, true, sizeof(char));
+	ret->recvs = g_ptr_array_new();
+	ret->fixed = g_array_new(false, true, sizeof(unsigned int));
+	g_queue_init(&ret->starved);
 
 	ret->bufferpool = bufferpool_new(g_malloc, g_free, BUFFER_SIZE * BUFFERS_COUNT);
 	for (int i = 0; i < BUFFER_POOLS; i++) {
@@ -164,6 +502,10 @@ void uring_poller_free(struct poller **pp) {
 	close((*pp)->waker_fds[1]);
 	g_ptr_array_free((*pp)->evs, true);
 	g_array_free((*pp)->blocked, true);
+	g_ptr_array_free((*pp)->recvs, true);
+	g_array_free((*pp)->fixed, true);
+	g_free((*pp)->fixed_free);
+	free((*pp)->buf_ring);
 	for (int i = 0; i < BUFFER_POOLS; i++) {
 		bufferpool_release((*pp)->buffers[i]->buf);
 		g_free((*pp)->buffers[i]);
@@ -322,6 +664,7 @@ struct uring_poll_removed {
 static void uring_poll_removed(struct uring_req *req, int32_t res, uint32_t flags) {
 	struct uring_poll_removed *rreq = (__typeof(rreq)) req;
 	//ilog(LOG_INFO, "poll removed fd %i with cb %p/%p", rreq->fd, rreq->callback, rreq->arg);
+	uring_fixed_del(rreq->poller, rreq->fd);
 	if (rreq->callback)
 		rreq->callback(rreq->arg);
 	else
@@ -371,6 +714,7 @@ struct uring_poll_recv {
 	struct iovec iov;
 	struct poller *poller;
 	bool closed:1;
+	bool deleted:1;
 };
 INLINE void uring_recvmsg_parse_cmsg(struct timeval *tv,
 		sockaddr_t *to, bool (*parse)(struct cmsghdr *, sockaddr_t *),
@@ -380,6 +724,23 @@ INLINE void uring_recvmsg_parse_cmsg(struct timeval *tv,
 			io_uring_recvmsg_cmsg_firsthdr(out, mh),
 			io_uring_recvmsg_cmsg_nexthdr(out, mh, cm));
 }
+static void uring_recv_arm(struct poller *p, struct uring_poll_recv *rreq);
+
+static void uring_poll_recv_finish(struct uring_poll_recv *rreq) {
+	struct poller *p = rreq->poller;
+
+	if (!rreq->closed)
+		rreq->it.closed(rreq->it.fd, rreq->it.obj);
+	rreq->closed = true;
+
+	//ilog(LOG_INFO, "last uring recv event for fd %i for %p (%i)", rreq->it.fd, rreq->it.obj, rreq->it.obj->ref);
+	if (rreq->it.obj)
+		obj_put_o(rreq->it.obj);
+	if (p->recvs->len > rreq->it.fd && p->recvs->pdata[rreq->it.fd] == rreq)
+		p->recvs->pdata[rreq->it.fd] = NULL;
+	uring_req_free(&rreq->req);
+}
+
 static void uring_poll_recv(struct uring_req *req, int32_t res, uint32_t flags) {
 	struct uring_poll_recv *rreq =  (__typeof(rreq)) req;
 	struct poller *p = rreq->poller;
@@ -387,6 +748,14 @@ static void uring_poll_recv(struct uring_req *req, int32_t res, uint32_t flags)
 
 	//ilog(LOG_INFO, "uring recvmsg event %i %i %i", rreq->it.fd, res, flags);
 
+	if (res == -ENOBUFS && !rreq->deleted) {
+		// all buffers are still in use. this terminates the multishot receive, so
+		// park it until buffers are returned to us, instead of closing the socket
+		ilog(LOG_WARNING | LOG_FLAG_LIMIT, "io_uring receive buffers exhausted");
+		g_queue_push_tail(&p->starved, rreq);
+		return;
+	}
+
 	if (res < 0) {
 		if (res != -ECANCELED)
 			ilog(LOG_WARNING | LOG_FLAG_LIMIT, "io_uring recvmsg error on fd %i: %s",
@@ -415,20 +784,48 @@ static void uring_poll_recv(struct uring_req *req, int32_t res, uint32_t flags)
 	}
 
 	if (!(flags & IORING_CQE_F_MORE))
-		closed = true;
-
-	if (closed) {
+		uring_poll_recv_finish(rreq);
+	else if (closed) {
 		if (!rreq->closed)
 			rreq->it.closed(rreq->it.fd, rreq->it.obj);
 		rreq->closed = true;
 	}
+}
 
-	if (!(flags & IORING_CQE_F_MORE)) {
-		//ilog(LOG_INFO, "last uring recv event for fd %i for %p (%i)", rreq->it.fd, rreq->it.obj, rreq->it.obj->ref);
-		if (rreq->it.obj)
-			obj_put_o(rreq->it.obj);
-		uring_req_free(&rreq->req);
+// runs in the poller's own thread, as the buffer ring and the file table belong to the
+// thread's io_uring. either is optional and we fall back to the older mechanisms
+static void uring_poller_setup(struct poller *p) {
+	p->set_up = true;
+	rtpe_uring_poller = p;
+
+	void *br = NULL;
+	if (posix_memalign(&br, sysconf(_SC_PAGESIZE), sizeof(struct io_uring_buf) * BUFFER_RING_ENTRIES) == 0) {
+		struct io_uring_buf_reg reg = {
+			.ring_addr = (uintptr_t) br,
+			.ring_entries = BUFFER_RING_ENTRIES,
+			.bgid = 0,
+		};
+		int ret = io_uring_register_buf_ring(&rtpe_uring, &reg, 0);
+		if (ret == 0) {
+			io_uring_buf_ring_init(br);
+			p->buf_ring = br;
+		}
+		else {
+			ilog(LOG_INFO, "io_uring buffer ring not available (%s), providing buffers "
+					"through submissions", strerror(-ret));
+			free(br);
+		}
+	}
+
+	int ret = io_uring_register_files_sparse(&rtpe_uring, FIXED_FILES);
+	if (ret == 0) {
+		p->fixed_free = g_new(unsigned int, FIXED_FILES);
+		for (unsigned int i = 0; i < FIXED_FILES; i++)
+			p->fixed_free[i] = FIXED_FILES - 1 - i;
+		p->fixed_free_num = FIXED_FILES;
 	}
+	else
+		ilog(LOG_INFO, "io_uring registered files not available (%s)", strerror(-ret));
 }
 
 static void uring_poller_do_add(struct poller *p, struct poller_req *preq) {
@@ -467,6 +864,13 @@ static void uring_poller_do_error(struct poller *p, struct poller_req *preq) {
 }
 static void uring_poller_do_del(struct poller *p, struct poller_req *preq) {
 	//ilog(LOG_INFO, "del fd %i on %p", preq->fd, p);
+	if (p->recvs->len > preq->fd && p->recvs->pdata[preq->fd]) {
+		struct uring_poll_recv *recv = p->recvs->pdata[preq->fd];
+		recv->deleted = true;
+		// nothing to cancel if it's waiting for buffers
+		if (g_queue_remove(&p->starved, recv))
+			uring_poll_recv_finish(recv);
+	}
 	struct uring_poll_removed *rreq
 		= uring_alloc_req(sizeof(*rreq), uring_poll_removed);
 	rreq->fd = preq->fd;
@@ -479,18 +883,27 @@ static void uring_poller_do_del(struct poller *p, struct poller_req *preq) {
 }
 static void uring_poller_do_buffers(struct poller *p, struct poller_req *preq) {
 	//ilog(LOG_INFO, "XXXXXXXXX adding buffers %p %u", p, preq->num);
-	struct io_uring_sqe *sqe = io_uring_get_sqe(&rtpe_uring);
-	io_uring_prep_provide_buffers(sqe, preq->buf, BUFFER_SIZE, BUFFERS_COUNT, 0,
-			preq->num * BUFFERS_COUNT);
-	struct uring_req *breq = uring_alloc_buffer_req(sizeof(*breq));
-	io_uring_sqe_set_data(sqe, breq); // XXX no content? not needed?
+	if (p->buf_ring) {
+		// shared with the kernel, no submission needed
+		int mask = io_uring_buf_ring_mask(BUFFER_RING_ENTRIES);
+		for (unsigned int i = 0; i < BUFFERS_COUNT; i++)
+			io_uring_buf_ring_add(p->buf_ring, preq->buf + BUFFER_SIZE * i, BUFFER_SIZE,
+					preq->num * BUFFERS_COUNT + i, mask, i);
+		io_uring_buf_ring_advance(p->buf_ring, BUFFERS_COUNT);
+	}
+	else {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&rtpe_uring);
+		io_uring_prep_provide_buffers(sqe, preq->buf, BUFFER_SIZE, BUFFERS_COUNT, 0,
+				preq->num * BUFFERS_COUNT);
+		struct uring_req *breq = uring_alloc_buffer_req(sizeof(*breq));
+		io_uring_sqe_set_data(sqe, breq); // XXX no content? not needed?
+	}
+
+	while (p->starved.length)
+		uring_recv_arm(p, g_queue_pop_head(&p->starved));
 }
-static void uring_poller_do_recv(struct poller *p, struct poller_req *preq) {
-	//ilog(LOG_INFO, "adding recv fd %i on %p for %p", preq->it.fd, p, preq->it.obj);
-	struct uring_poll_recv *rreq
-		= uring_alloc_req(sizeof(*rreq), uring_poll_recv);
-	rreq->it = preq->it;
-	rreq->poller = p;
+// armed once, then delivers datagrams until cancelled or out of buffers
+static void uring_recv_arm(struct poller *p, struct uring_poll_recv *rreq) {
 	struct io_uring_sqe *sqe = io_uring_get_sqe(&rtpe_uring);
 	rreq->iov = (__typeof(rreq->iov)) {
 		.iov_len = MAX_RTP_PACKET_SIZE,
@@ -501,16 +914,31 @@ static void uring_poller_do_recv(struct poller *p, struct poller_req *preq) {
 		.msg_namelen = sizeof(struct sockaddr_storage),
 		.msg_controllen = 64,
 	};
-	io_uring_prep_recvmsg_multishot(sqe, rreq->it.fd, &rreq->msg, 0);
+	int slot = uring_fixed_add(p, rreq->it.fd);
+	io_uring_prep_recvmsg_multishot(sqe, slot >= 0 ? slot : rreq->it.fd, &rreq->msg, 0);
 	sqe->ioprio |= IORING_RECVSEND_POLL_FIRST;
-	io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+	io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT | (slot >= 0 ? IOSQE_FIXED_FILE : 0));
 	sqe->buf_group = 0;
 	io_uring_sqe_set_data(sqe, rreq);
 }
+static void uring_poller_do_recv(struct poller *p, struct poller_req *preq) {
+	//ilog(LOG_INFO, "adding recv fd %i on %p for %p", preq->it.fd, p, preq->it.obj);
+	struct uring_poll_recv *rreq
+		= uring_alloc_req(sizeof(*rreq), uring_poll_recv);
+	rreq->it = preq->it;
+	rreq->poller = p;
+	if (p->recvs->len <= rreq->it.fd)
+		g_ptr_array_set_size(p->recvs, rreq->it.fd + 1);
+	p->recvs->pdata[rreq->it.fd] = rreq;
+	uring_recv_arm(p, rreq);
+}
 
 static void uring_poller_do_reqs(struct poller *p) {
 	LOCK(&p->lock);
 
+	if (!p->set_up)
+		uring_poller_setup(p);
+
 	while (p->reqs.length) {
 		struct poller_req *preq = g_queue_pop_head(&p->reqs);
 
@@ -573,6 +1001,12 @@ void uring_poller_poll(struct poller *p) {
 }
 
 void uring_poller_clear(struct poller *p) {
+	while (p->starved.length) {
+		struct uring_poll_recv *rreq = g_queue_pop_head(&p->starved);
+		rreq->closed = true;
+		uring_poll_recv_finish(rreq);
+	}
+
 	struct uring_req *req = uring_alloc_buffer_req(sizeof(*req));
 	struct io_uring_sqe *sqe = io_uring_get_sqe(&rtpe_uring);
 	io_uring_prep_cancel(sqe, 0, IORING_ASYNC_CANCEL_ANY);
@@ -14,6 +14,8 @@ struct uring_req {
 extern __thread ssize_t (*uring_sendmsg)(socket_t *, struct msghdr *, const endpoint_t *,
 		struct sockaddr_storage *, struct uring_req *);
 
+void uring_sendmsg_batch_init(unsigned int);
+
 INLINE void uring_req_buffer_free(struct uring_req *r, int32_t res, uint32_t flags) {
 	g_free(r);
 }
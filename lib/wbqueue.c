@@ -0,0 +1,226 @@
+#include "wbqueue.h"
+#include <sys/time.h>
+
+
+struct wbqueue_entry {
+	void *obj;
+	struct timeval queued;
+};
+
+
+void wbqueue_init(struct wbqueue *q, long long delay_us, const struct wbqueue_ops *ops) {
+	q->ops = ops;
+	q->delay_us = delay_us;
+	mutex_init(&q->lock);
+	cond_init(&q->cond);
+	g_queue_init(&q->queue);
+	q->queued = g_hash_table_new(g_direct_hash, g_direct_equal);
+	q->busy = g_hash_table_new(g_direct_hash, g_direct_equal);
+	q->flush = false;
+	q->stopped = false;
+}
+
+void wbqueue_free(struct wbqueue *q) {
+	struct wbqueue_entry *e;
+	while ((e = g_queue_pop_head(&q->queue))) {
+		q->ops->put(e->obj);
+		g_slice_free1(sizeof(*e), e);
+	}
+	g_hash_table_destroy(q->queued);
+	g_hash_table_destroy(q->busy);
+	q->queued = q->busy = NULL;
+	mutex_destroy(&q->lock);
+	cond_destroy(&q->cond);
+}
+
+
+// queue is locked
+static void __length(struct wbqueue *q) {
+	if (q->ops->length)
+		q->ops->length(q->queue.length);
+}
+
+// queue is locked
+static void __remove(struct wbqueue *q, GList *l) {
+	struct wbqueue_entry *e = l->data;
+	g_hash_table_remove(q->queued, e->obj);
+	g_queue_delete_link(&q->queue, l);
+	g_slice_free1(sizeof(*e), e);
+}
+
+static void __put_all(struct wbqueue *q, GQueue *objs) {
+	void *obj;
+	while ((obj = g_queue_pop_head(objs)))
+		q->ops->put(obj);
+}
+
+
+void wbqueue_push(struct wbqueue *q, void *obj) {
+	LOCK(&q->lock);
+
+	if (q->ops->skip && q->ops->skip(obj))
+		return;
+	if (g_hash_table_contains(q->queued, obj))
+		return;
+
+	struct wbqueue_entry *e = g_slice_alloc(sizeof(*e));
+	q->ops->get(obj);
+	e->obj = obj;
+	gettimeofday(&e->queued, NULL);
+	g_queue_push_tail(&q->queue, e);
+	g_hash_table_insert(q->queued, obj, q->queue.tail);
+	__length(q);
+
+	cond_broadcast(&q->cond);
+}
+
+void wbqueue_cancel(struct wbqueue *q, void *obj) {
+	void *put = NULL;
+
+	mutex_lock(&q->lock);
+
+	GList *l = g_hash_table_lookup(q->queued, obj);
+	if (l) {
+		struct wbqueue_entry *e = l->data;
+		put = e->obj;
+		__remove(q, l);
+		__length(q);
+	}
+
+	while (g_hash_table_contains(q->busy, obj))
+		cond_wait(&q->cond, &q->lock);
+
+	mutex_unlock(&q->lock);
+
+	if (put)
+		q->ops->put(put);
+}
+
+
+// queue is locked. Entries that are to be skipped are removed and their references moved
+// to `drop`. Returns 0 with `next` set to when the oldest remaining entry becomes due
+// (zero if there's nothing to wait for).
+static unsigned int __take(struct wbqueue *q, void **batch, unsigned int max, struct timeval *next,
+		GQueue *drop)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	unsigned int num = 0;
+
+	ZERO(*next);
+
+	if (q->stopped)
+		return 0;
+
+	GList *l = q->queue.head;
+	while (l && num < max) {
+		GList *lnext = l->next;
+		struct wbqueue_entry *e = l->data;
+
+		if (q->ops->skip && q->ops->skip(e->obj)) {
+			g_queue_push_tail(drop, e->obj);
+			__remove(q, l);
+		}
+		else if (!q->flush && timeval_diff(&now, &e->queued) < q->delay_us) {
+			if (!num) {
+				*next = e->queued;
+				timeval_add_usec(next, q->delay_us);
+			}
+			break;
+		}
+		else if (!g_hash_table_contains(q->busy, e->obj)) {
+			g_hash_table_add(q->busy, e->obj);
+			batch[num++] = e->obj;
+			__remove(q, l);
+		}
+
+		l = lnext;
+	}
+
+	if (num || drop->length)
+		__length(q);
+
+	return num;
+}
+
+unsigned int wbqueue_take(struct wbqueue *q, void **batch, unsigned int max) {
+	GQueue drop = G_QUEUE_INIT;
+	struct timeval next;
+
+	mutex_lock(&q->lock);
+	unsigned int num = __take(q, batch, max, &next, &drop);
+	mutex_unlock(&q->lock);
+
+	__put_all(q, &drop);
+
+	return num;
+}
+
+unsigned int wbqueue_next(struct wbqueue *q, void **batch, unsigned int max) {
+	GQueue drop = G_QUEUE_INIT;
+	unsigned int num;
+
+	mutex_lock(&q->lock);
+
+	while (true) {
+		struct timeval next;
+		num = __take(q, batch, max, &next, &drop);
+
+		if (drop.length) {
+			mutex_unlock(&q->lock);
+			__put_all(q, &drop);
+			mutex_lock(&q->lock);
+		}
+
+		if (num)
+			break;
+		// keep going until everything has been written out, see wbqueue_stop()
+		if (q->flush && (!q->queue.length || q->stopped))
+			break;
+		if (next.tv_sec)
+			cond_timedwait(&q->cond, &q->lock, &next);
+		else
+			cond_wait(&q->cond, &q->lock);
+	}
+
+	mutex_unlock(&q->lock);
+
+	return num;
+}
+
+void wbqueue_done(struct wbqueue *q, void **batch, unsigned int num) {
+	mutex_lock(&q->lock);
+	for (unsigned int i = 0; i < num; i++)
+		g_hash_table_remove(q->busy, batch[i]);
+	cond_broadcast(&q->cond);
+	mutex_unlock(&q->lock);
+
+	for (unsigned int i = 0; i < num; i++)
+		q->ops->put(batch[i]);
+}
+
+
+unsigned int wbqueue_stop(struct wbqueue *q, long long timeout_us) {
+	struct timeval until;
+	gettimeofday(&until, NULL);
+	timeval_add_usec(&until, timeout_us);
+
+	LOCK(&q->lock);
+
+	q->flush = true;
+	cond_broadcast(&q->cond);
+
+	while (q->queue.length || g_hash_table_size(q->busy)) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		if (timeval_cmp(&now, &until) >= 0) {
+			q->stopped = true;
+			cond_broadcast(&q->cond);
+			return q->queue.length + g_hash_table_size(q->busy);
+		}
+		cond_timedwait(&q->cond, &q->lock, &until);
+	}
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef _WBQUEUE_H_
+#define _WBQUEUE_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include "auxlib.h"
+
+
+// Write-behind queue. Objects marked for writing are queued oldest first, at most once
+// each, so that further updates of an object that is still queued are coalesced into the
+// pending write. Workers take entries in batches once they've aged past the delay. An
+// object that has been taken is busy until the worker reports it done, and isn't handed
+// out again in the meantime, so that two workers never write the same object out of order.
+//
+// The queue holds a reference to each queued object, which is handed over to the worker
+// that takes it, and released by wbqueue_done().
+
+struct wbqueue_ops {
+	void (*get)(void *);			// takes a reference
+	void (*put)(void *);			// releases a reference
+	bool (*skip)(void *);			// object must not be written (any more), optional
+	void (*length)(unsigned int);		// queue length has changed, optional
+};
+
+struct wbqueue {
+	const struct wbqueue_ops *ops;
+	long long delay_us;
+	mutex_t lock;
+	cond_t cond;
+	GQueue queue;
+	GHashTable *queued;			// object -> link in `queue`
+	GHashTable *busy;			// objects taken by a worker
+	bool flush;				// ignore the delay and stop once empty
+	bool stopped;				// given up on flushing the queue
+};
+
+
+void wbqueue_init(struct wbqueue *, long long delay_us, const struct wbqueue_ops *);
+// only once all workers have returned
+void wbqueue_free(struct wbqueue *);
+
+// the `skip` callback is called with the queue locked. An object that is to be skipped is
+// neither queued nor handed out to a worker
+void wbqueue_push(struct wbqueue *, void *);
+// drops a pending write and waits for one in progress
+void wbqueue_cancel(struct wbqueue *, void *);
+
+// non-blocking, returns the number of objects taken
+unsigned int wbqueue_take(struct wbqueue *, void **batch, unsigned int max);
+// blocks until there's something to write. Returns 0 once the worker should stop
+unsigned int wbqueue_next(struct wbqueue *, void **batch, unsigned int max);
+void wbqueue_done(struct wbqueue *, void **batch, unsigned int num);
+
+// lets the workers write out everything that is still queued without delay, and waits for
+// them to do so, but no longer than the timeout. Returns the number of objects not written
+unsigned int wbqueue_stop(struct wbqueue *, long long timeout_us);
+
+
+#endif
@@ -16,6 +16,7 @@
 #include "ssllib.h"
 #include "obj.h"
 #include "fix_frame_channel_layout.h"
+#include "jobsched.h"
 
 
 
@@ -51,6 +52,13 @@ struct stream {
 	uint fixture_idx;
 	long long encoding_start;
 
+	// scheduler mode
+	struct jobsched_job job;
+	unsigned int sched_worker; // affinity
+	uint sched_pending; // frames due, locked by `lock`
+	bool sched_queued;
+	long long sched_start;
+
 	uint dump_count;
 	AVFormatContext *fmtctx;
 	AVStream *avst;
@@ -73,6 +81,7 @@ struct stats_sample {
 struct worker {
 	pthread_t thr;
 	pid_t pid;
+	uint idx;
 
 	bool blocked; // not locked, not critical. set by worker, cleared by output
 
@@ -168,6 +177,7 @@ static int measure_time = 500;
 static int repeats = 1;
 static gboolean cpu_freq;
 static int freq_granularity = 50;
+static gboolean use_scheduler;
 
 
 #define BLOCKED_COLOR 1
@@ -181,6 +191,8 @@ static uint num_cpus;
 static struct stats_sample *cpu_stats;
 
 static struct poller *rtpe_poller;
+static pthread_t poller_thread;
+static struct jobsched sched;
 
 static codec_def_t *decoder_def;
 static codec_def_t *encoder_def;
@@ -205,6 +217,7 @@ static mutex_t curses_lock = MUTEX_STATIC_INIT;
 static WINDOW *popup;
 
 static long long ptime = 20000; // us TODO: support different ptimes
+static const uint64_t max_iters = 10; // hard upper limit for timer iterations
 
 static mutex_t delay_stats_lock = MUTEX_STATIC_INIT;
 static struct delay_stats delay_stats;
@@ -316,25 +329,72 @@ static int got_frame(decoder_t *decoder, AVFrame *frame, void *p1, void *b) {
 }
 
 
-static void *worker(void *p) {
+static void worker_init(struct worker *w) {
 	thread_cancel_disable();
-	worker_self = p;
+	worker_self = w;
 	worker_self->pid = gettid();
 	{
 		LOCK(&other_threads_lock);
 		g_hash_table_insert(worker_threads, GINT_TO_POINTER(worker_self->pid), NULL);
 	}
+}
+
+static void *worker(void *p) {
+	worker_init(p);
+	poller_loop(rtpe_poller);
+	return NULL;
+}
+
+static void *sched_worker(void *p) {
+	worker_init(p);
+	jobsched_worker(&sched, worker_self->idx);
+	return NULL;
+}
+
+// in scheduler mode, the poller only runs the timers and hands the work to the workers
+static void *sched_poller(void *p) {
+	thread_cancel_disable();
 	poller_loop(rtpe_poller);
 	return NULL;
 }
 
+static void worker_comput(long long start) {
+	long long end = now_us();
+
+	LOCK(&worker_self->comput_lock);
+	worker_self->comput += end - start;
+}
+
+// stream is locked
+static void stream_frame(struct stream *s, long long start) {
+	s->encoding_start = start;
+
+	AVPacket *data = s->in_params.fixture->pdata[s->fixture_idx++];
+	if (s->fixture_idx >= s->in_params.fixture->len)
+		s->fixture_idx = 0;
+
+	str frame;
+	frame = STR_LEN(data->data, data->size);
+
+	if (!s->chain)
+		decoder_input_data(s->decoder, &frame, s->input_ts, got_frame, s, NULL);
+	else {
+		AVPacket *pkt = codec_cc_input_data(s->chain, &frame, s->input_ts, s, NULL, NULL);
+		if (pkt)
+			got_packet_pkt(s, pkt);
+		else
+			mutex_lock(&s->lock); // was unlocked by async_init
+	}
+
+	s->input_ts += data->duration;
+}
+
 static void readable(int fd, void *o) {
 	struct stream *s = o;
 	obj_hold(s);
 
 	long long start = now_us();
 
-	static const uint64_t max_iters = 10; // hard upper limit for iterations
 	uint64_t total_iters = 0;
 
 	while (true) {
@@ -357,38 +417,66 @@ static void readable(int fd, void *o) {
 
 		while (exp) {
 			LOCK(&s->lock);
+			stream_frame(s, start);
+			exp--;
+		}
+	}
 
-			s->encoding_start = start;
+	obj_put(s);
 
-			AVPacket *data = s->in_params.fixture->pdata[s->fixture_idx++];
-			if (s->fixture_idx >= s->in_params.fixture->len)
-				s->fixture_idx = 0;
+	worker_comput(start);
+}
 
-			str frame;
-			frame = STR_LEN(data->data, data->size);
+static void stream_job(struct jobsched_job *j) {
+	struct stream *s = (void *) ((char *) j - G_STRUCT_OFFSET(struct stream, job));
 
-			if (!s->chain)
-				decoder_input_data(s->decoder, &frame, s->input_ts, got_frame, s, NULL);
-			else {
-				AVPacket *pkt = codec_cc_input_data(s->chain, &frame, s->input_ts, s, NULL, NULL);
-				if (pkt)
-					got_packet_pkt(s, pkt);
-				else
-					mutex_lock(&s->lock); // was unlocked by async_init
-			}
+	long long start = now_us();
 
-			s->input_ts += data->duration;
+	{
+		LOCK(&s->lock);
 
-			exp--;
+		// more than one frame due means we've fallen behind the timer
+		if (s->sched_pending >= 2)
+			worker_self->blocked = true;
+
+		while (s->sched_pending) {
+			s->sched_pending--;
+			stream_frame(s, s->sched_start);
 		}
+
+		s->sched_queued = false;
 	}
 
 	obj_put(s);
 
-	long long end = now_us();
+	worker_comput(start);
+}
 
-	LOCK(&worker_self->comput_lock);
-	worker_self->comput += end - start;
+static void readable_sched(int fd, void *o) {
+	struct stream *s = o;
+
+	uint64_t exp;
+	ssize_t ret = read(fd, &exp, sizeof(exp));
+	if (ret != sizeof(exp)) {
+		if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		abort();
+	}
+	if (exp > max_iters)
+		exp = max_iters;
+
+	LOCK(&s->lock);
+
+	if (!s->sched_pending)
+		s->sched_start = now_us();
+	s->sched_pending += exp;
+
+	// no more than one job per stream, which works off all frames due
+	if (s->sched_queued)
+		return;
+	s->sched_queued = true;
+	obj_hold(s);
+	jobsched_submit(&sched, &s->job);
 }
 
 static void closed(int fd, void *o) {
@@ -402,9 +490,9 @@ static void new_threads(uint num) {
 
 		mutex_init(&w->comput_lock);
 
-		w->thr = thread_new("worker", worker, w);
-
 		LOCK(&workers_lock);
+		w->idx = workers.length;
+		w->thr = thread_new("worker", use_scheduler ? sched_worker : worker, w);
 		g_queue_push_tail(&workers, w);
 	}
 }
@@ -484,6 +572,8 @@ static void new_stream_params(
 	s->out_params = *outprm;
 	s->fixture_idx = ssl_random() % s->in_params.fixture->len;
 	mutex_init(&s->lock);
+	s->job.func = stream_job;
+	s->job.affinity = &s->sched_worker;
 	s->type = g_strdup_printf("%s -> %s", inprm->name, outprm->name);
 
 	// create decoder and encoder
@@ -536,7 +626,7 @@ static void new_stream_params(
 	struct poller_item pi = {
 		.fd = s->timer_fd,
 		.obj = &s->obj,
-		.readable = readable,
+		.readable = use_scheduler ? readable_sched : readable,
 		.closed = closed,
 	};
 
@@ -865,19 +955,23 @@ static void *do_input(void *p) {
 				return NULL;
 
 			case ']':
-				new_threads(1);
+				if (!use_scheduler) // fixed number of workers
+					new_threads(1);
 				break;
 
 			case '[':
-				kill_threads(1);
+				if (!use_scheduler) // fixed number of workers
+					kill_threads(1);
 				break;
 
 			case '}':
-				new_threads(10);
+				if (!use_scheduler) // fixed number of workers
+					new_threads(10);
 				break;
 
 			case '{':
-				kill_threads(10);
+				if (!use_scheduler) // fixed number of workers
+					kill_threads(10);
 				break;
 
 			case 'q':
@@ -1681,6 +1775,12 @@ static void options(int *argc, char ***argv) {
 			.description = "Granularity in ms for measuring CPU frequencies",
 			.arg_description = "INT",
 		},
+		{
+			.long_name = "scheduler",
+			.arg = G_OPTION_ARG_NONE,
+			.arg_data = &use_scheduler,
+			.description = "Run streams through the work-stealing job scheduler",
+		},
 		{ NULL, }
 	};
 
@@ -1810,6 +1910,31 @@ static void *cpu_freq_monitor(void *p) {
 }
 
 
+// prints and resets the per-worker scheduler stats
+static void sched_stats_print(void) {
+	for (unsigned int i = 0; i < sched.num_workers; i++) {
+		struct jobsched_worker *w = &sched.workers[i];
+
+		uint64_t jobs = atomic64_get_set(&w->jobs, 0);
+		uint64_t latency_sum = atomic64_get_set(&w->latency_sum, 0);
+		printf("          worker %u: " UINT64F " jobs, " UINT64F " stolen, max queue %u, "
+				"avg latency " UINT64F " us\n",
+				i, jobs, atomic64_get_set(&w->steals, 0),
+				__atomic_exchange_n(&w->max_depth, jobsched_depth(w), __ATOMIC_RELAXED),
+				jobs ? latency_sum / jobs : 0);
+
+		printf("            latency:");
+		for (unsigned int b = 0; b < JOBSCHED_LATENCY_BUCKETS; b++) {
+			uint64_t num = atomic64_get_set(&w->latency[b], 0);
+			if (jobsched_latency_bounds[b] == UINT_MAX)
+				printf(" >%u us: " UINT64F "\n", jobsched_latency_bounds[b - 1], num);
+			else
+				printf(" <=%u: " UINT64F ",", jobsched_latency_bounds[b], num);
+		}
+	}
+}
+
+
 static void max_cpu_test(void) {
 	int max_cpu_scaled = max_cpu * 100000;
 
@@ -1868,6 +1993,9 @@ static void max_cpu_test(void) {
 						: "unidirectional streams",
 						workers.length);
 
+				if (use_scheduler)
+					sched_stats_print();
+
 				if (cpu_freq) {
 					// retrieve stats and reset
 					struct freq_stats stats;
@@ -1945,11 +2073,21 @@ int main(int argc, char **argv) {
 	if (bidirectional)
 		load_fixture(&out_params);
 
+	if (use_scheduler) {
+		jobsched_init(&sched, init_threads);
+		poller_thread = thread_new("poller", sched_poller, NULL);
+	}
+
 	if (max_cpu)
 		max_cpu_test();
 	else
 		interactive();
 
+	if (use_scheduler) {
+		pthread_cancel(poller_thread);
+		pthread_join(poller_thread, NULL);
+		jobsched_shutdown(&sched);
+	}
 	kill_threads(workers.length);
 	del_streams_raw(streams->len);
 	g_ptr_array_free(streams, TRUE);
@@ -1964,5 +2102,11 @@ int main(int argc, char **argv) {
 
 	endwin();
 
+	if (use_scheduler && !max_cpu) {
+		printf("Scheduler stats:\n");
+		sched_stats_print();
+	}
+	jobsched_free(&sched);
+
 	return 0;
 }
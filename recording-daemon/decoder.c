@@ -183,15 +183,15 @@ no_recording:
 		int linesize = av_get_bytes_per_sample(dec_frame->format) * dec_frame->nb_samples;
 		dbg("Writing %u bytes PCM to TLS", linesize);
 		streambuf_write(ssrc->tls_fwd_stream, (char *) dec_frame->extended_data[0], linesize);
-		av_frame_free(&dec_frame);
+		codec_frame_free(&dec_frame);
 
 	}
 
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 	return 0;
 
 err:
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 	return -1;
 }
 
@@ -8,6 +8,7 @@
 #include "main.h"
 #include "garbage.h"
 #include "db.h"
+#include "codeclib.h"
 
 
 static int epoll_fd = -1;
@@ -36,6 +37,7 @@ void epoll_del(int fd) {
 static void poller_thread_end(void *ptr) {
 	mysql_thread_end();
 	db_thread_end();
+	codec_pools_thread_cleanup();
 }
 
 
@@ -375,7 +375,7 @@ int mix_add(mix_t *mix, AVFrame *frame, unsigned int idx, void *ptr, output_t *o
 	if (next_pts > mix->in_pts[idx])
 		mix->in_pts[idx] = next_pts;
 
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 
 	mix_silence_fill(mix);
 
@@ -393,7 +393,7 @@ int mix_add(mix_t *mix, AVFrame *frame, unsigned int idx, void *ptr, output_t *o
 		ret = output_add(output, frame);
 
 		av_frame_unref(mix->sink_frame);
-		av_frame_free(&frame);
+		codec_frame_free(&frame);
 
 		if (ret)
 			return -1;
@@ -403,6 +403,6 @@ int mix_add(mix_t *mix, AVFrame *frame, unsigned int idx, void *ptr, output_t *o
 
 err:
 	ilog(LOG_ERR, "Failed to add frame to mixer: %s", err);
-	av_frame_free(&frame);
+	codec_frame_free(&frame);
 	return -1;
 }
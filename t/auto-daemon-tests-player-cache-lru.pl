@@ -0,0 +1,252 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use NGCP::Rtpengine::Test;
+use NGCP::Rtpengine::AutoTest;
+use Test::More;
+use File::Temp;
+use Time::HiRes;
+
+
+# player cache limited to 1 MB, with cached media moved into a mapping once decoded
+
+autotest_start(qw(--config-file=none -t -1 -i 203.0.113.1 -i 2001:db8:4321::1
+			-n 2223 -c 12345 -f -L 7 -E -u 2222 --player-cache --player-cache-size=1
+			--player-cache-mmap))
+		or die;
+
+# second control connection, for requests to calls other than the current one
+my $ctl = NGCP::Rtpengine->new($ENV{RTPENGINE_HOST} // '127.0.0.1', $ENV{RTPENGINE_PORT} // 2223);
+
+
+
+# 12 seconds of a 400 Hz tone. once cached, this takes up a bit over 40% of the limit
+
+sub wav {
+	my ($secs) = @_;
+	my $data = pack('s<*', map { int(8000 * sin($_ * 2 * 3.14159265 * 400 / 8000)) }
+			0 .. 8000 * $secs - 1);
+	return 'RIFF' . pack('V', 36 + length($data)) . 'WAVE'
+		. 'fmt ' . pack('VvvVVvv', 16, 1, 1, 8000, 16000, 2, 16)
+		. 'data' . pack('V', length($data)) . $data;
+}
+
+my $dir = File::Temp->newdir();
+my %files;
+for my $f (qw(A B C)) {
+	$files{$f} = "$dir/$f.wav";
+	open(my $fh, '>', $files{$f}) or die;
+	binmode($fh);
+	print $fh wav(12);
+	close($fh);
+}
+
+
+sub cache_stats {
+	my $stats = rtpe_req('statistics', 'player cache statistics')->{statistics}{currentstatistics};
+	return ($stats->{playercacheentries}, $stats->{playercachesize});
+}
+
+# decoding runs in the background: wait until the size has stopped changing
+sub cache_settled {
+	my (undef, $last) = cache_stats();
+	for (1 .. 50) {
+		Time::HiRes::usleep(200000);
+		my ($entries, $size) = cache_stats();
+		return ($entries, $size) if $size == $last;
+		$last = $size;
+	}
+	die 'player cache size not settling';
+}
+
+my $port = 3000;
+
+# starts playing a file in a new call
+sub play {
+	my ($name, $file) = @_;
+
+	$port += 2;
+	new_call([ '198.51.100.1', $port ]);
+
+	offer($name, { ICE => 'remove', replace => ['origin'] }, <<SDP);
+v=0
+o=- 1545997027 1 IN IP4 198.51.100.1
+s=tester
+t=0 0
+m=audio $port RTP/AVP 8
+c=IN IP4 198.51.100.1
+a=sendrecv
+----------------------------------
+v=0
+o=- 1545997027 1 IN IP4 203.0.113.1
+s=tester
+t=0 0
+m=audio PORT RTP/AVP 8
+c=IN IP4 203.0.113.1
+a=rtpmap:8 PCMA/8000
+a=sendrecv
+a=rtcp:PORT
+SDP
+
+	my $resp = rtpe_req('play media', $name, { 'from-tag' => ft(), file => $files{$file} });
+	is $resp->{duration}, 12000, "$name - media duration";
+}
+
+sub stop {
+	my ($name) = @_;
+	rtpe_req('stop media', $name, { 'from-tag' => ft() });
+}
+
+
+
+my ($entries, $size, $one);
+
+
+# first entry, kept after use
+
+play('cache A', 'A');
+($entries, $one) = cache_settled();
+is $entries, 1, 'one entry';
+ok $one > 300000 && $one < 600000, 'size of one entry';
+stop('cache A');
+($entries, $size) = cache_stats();
+is $entries, 1, 'entry kept after use';
+is $size, $one, 'size unchanged';
+
+
+# second entry, both fit
+
+play('cache B', 'B');
+($entries, $size) = cache_settled();
+is $entries, 2, 'two entries';
+is $size, 2 * $one, 'size of two entries';
+stop('cache B');
+
+
+# B is played again, which is a cache hit, and stays in use until further down
+
+play('cache B in use', 'B');
+($entries, $size) = cache_stats();
+is $entries, 2, 'B cached';
+my ($cid_b, $ft_b) = (cid(), ft());
+
+
+# using A makes it more recent than B
+
+play('cache A again', 'A');
+($entries, $size) = cache_stats();
+is $entries, 2, 'A cached';
+stop('cache A again');
+($entries, $size) = cache_stats();
+is $entries, 2, 'nothing evicted under the limit';
+
+
+# a third entry goes over the limit. nothing is dropped while it's being played
+
+play('cache C', 'C');
+($entries, $size) = cache_settled();
+is $entries, 3, 'three entries';
+is $size, 3 * $one, 'over the limit';
+
+# once C is released, the least recently used entry not in use goes. that's A, as B
+# is older but still being played
+
+stop('cache C');
+($entries, $size) = cache_stats();
+is $entries, 2, 'one entry evicted';
+is $size, 2 * $one, 'back under the limit';
+
+play('cache C again', 'C');
+($entries, $size) = cache_stats();
+is $entries, 2, 'C still cached';
+stop('cache C again');
+
+
+# releasing B doesn't evict anything, as the cache is within its limit
+
+my $resp = $ctl->req({ command => 'stop media', 'call-id' => $cid_b, 'from-tag' => $ft_b });
+is $resp->{result}, 'ok', 'cache B in use - stop media status';
+($entries, $size) = cache_stats();
+is $entries, 2, 'nothing evicted when released under the limit';
+
+
+# A comes back as a new entry. releasing it evicts B, which was last used before C
+
+play('cache A evicted', 'A');
+($entries, $size) = cache_stats();
+is $entries, 3, 'A is a new entry';
+($entries, $size) = cache_settled();
+is $size, 3 * $one, 'over the limit again';
+stop('cache A evicted');
+($entries, $size) = cache_stats();
+is $entries, 2, 'one entry evicted';
+is $size, 2 * $one, 'back under the limit';
+
+play('cache B evicted', 'B');
+($entries, $size) = cache_stats();
+is $entries, 3, 'B is a new entry';
+cache_settled();
+stop('cache B evicted');
+
+play('cache A kept', 'A');
+($entries, $size) = cache_stats();
+is $entries, 2, 'A still cached, C evicted instead';
+stop('cache A kept');
+
+
+
+
+# playback from a mapped entry: the first player reads packets while they're being decoded,
+# the second one from the finished mapping
+
+my $wav_file = wav(0.1);
+my ($sock_a, $seq, $ts, $ssrc, @first);
+
+for my $n (1, 2) {
+	$port += 2;
+	($sock_a) = new_call([ '198.51.100.1', $port ]);
+
+	offer("mapped playback $n", { ICE => 'remove', replace => ['origin'] }, <<SDP);
+v=0
+o=- 1545997027 1 IN IP4 198.51.100.1
+s=tester
+t=0 0
+m=audio $port RTP/AVP 8
+c=IN IP4 198.51.100.1
+a=sendrecv
+----------------------------------
+v=0
+o=- 1545997027 1 IN IP4 203.0.113.1
+s=tester
+t=0 0
+m=audio PORT RTP/AVP 8
+c=IN IP4 203.0.113.1
+a=rtpmap:8 PCMA/8000
+a=sendrecv
+a=rtcp:PORT
+SDP
+
+	$resp = rtpe_req('play media', "mapped playback $n", { 'from-tag' => ft(), blob => $wav_file });
+	is $resp->{duration}, 100, "mapped playback $n - media duration";
+
+	my ($pl, @pkts);
+	(undef, $seq, $ts, $ssrc, $pl) = rcv($sock_a, -1, rtpmre(8 | 0x80, -1, -1, -1, '(.{160})'));
+	push(@pkts, $pl);
+	for my $i (1 .. 4) {
+		(undef, $pl) = rcv($sock_a, -1, rtpmre(8, $seq + $i, $ts + 160 * $i, $ssrc, '(.{160})'));
+		push(@pkts, $pl);
+	}
+
+	if ($n == 1) {
+		@first = @pkts;
+		cache_settled();
+	}
+	else {
+		is_deeply \@pkts, \@first, 'same media from the mapping';
+	}
+}
+
+
+
+done_testing();
@@ -19,7 +19,7 @@ my ($sock_a, $sock_b, $sock_c, $sock_d, $port_a, $port_b, $port_c, $ssrc_a, $ssr
 	$sock_ax, $sock_bx, $port_ax, $port_bx, $port_d, $sock_e, $port_e, $sock_cx, $port_cx,
 	$srtp_ctx_a, $srtp_ctx_b, $srtp_ctx_a_rev, $srtp_ctx_b_rev, $ufrag_a, $ufrag_b,
 	@ret1, @ret2, @ret3, @ret4, $srtp_key_a, $srtp_key_b, $ts, $seq, $tag_medias, $media_labels,
-	$ftr, $ttr, $fts, $ttr2);
+	$ftr, $ttr, $fts, $ttr2, $sock_ar, $sock_br, $sock_cr, $port_ar, $port_br, $port_cr);
 
 
 
@@ -3089,10 +3089,11 @@ srtp_rcv($sock_c, $port_c, rtpm(0, 4001, 7160, $ssrc_b, "\x00" x 160), $srtp_ctx
 
 
 
-($sock_a, $sock_b, $sock_c) =
-	new_call([qw(198.51.100.14 6018)], [qw(198.51.100.14 6020)], [qw(198.51.100.14 6022)]);
+($sock_a, $sock_b, $sock_c, $sock_ar, $sock_br, $sock_cr) =
+	new_call([qw(198.51.100.14 6018)], [qw(198.51.100.14 6020)], [qw(198.51.100.14 6022)],
+		[qw(198.51.100.14 6019)], [qw(198.51.100.14 6021)], [qw(198.51.100.14 6023)]);
 
-($port_a) = offer('SRTP call RTP sub',
+($port_a, $port_ar) = offer('SRTP call RTP sub',
 	{ }, <<SDP);
 v=0
 o=- 1545997027 1 IN IP4 198.51.100.1
@@ -3129,7 +3130,7 @@ a=fingerprint:sha-256 FINGERPRINT256
 a=tls-id:TLS_ID
 SDP
 
-($port_b) = answer('SRTP call RTP sub',
+($port_b, $port_br) = answer('SRTP call RTP sub',
 	{ }, <<SDP);
 v=0
 o=- 1545997027 1 IN IP4 198.51.100.1
@@ -3168,7 +3169,7 @@ srtp_snd($sock_b, $port_a, rtp(0, 2000, 4000, 0x3456, "\x00" x 160), $srtp_ctx_b
 srtp_snd($sock_a, $port_b, rtp(0, 4000, 7000, 0x6543, "\x00" x 160), $srtp_ctx_a);
 ($ssrc_b) = srtp_rcv($sock_b, $port_a, rtpm(0, 4000, 7000, -1, "\x00" x 160), $srtp_ctx_a);
 
-($ftr, $ttr, undef, undef, undef, $port_c) = subscribe_request('SRTP call RTP sub',
+($ftr, $ttr, undef, undef, undef, $port_c, $port_cr) = subscribe_request('SRTP call RTP sub',
 	{ 'from-tag' => ft(), 'transport-protocol' => 'RTP/AVP', }, <<SDP);
 v=0
 o=- 1545997027 1 IN IP4 198.51.100.1
@@ -3201,6 +3202,19 @@ srtp_snd($sock_a, $port_b, rtp(0, 4001, 7160, 0x6543, "\x00" x 160), $srtp_ctx_a
 srtp_rcv($sock_b, $port_a, rtpm(0, 4001, 7160, $ssrc_b, "\x00" x 160), $srtp_ctx_a);
 rcv($sock_c, $port_c, rtpm(0, 4001, 7160, $ssrc_b, "\x00" x 160));
 
+# same for RTCP: as received to the pass-through sink, decrypted to the other one
+{
+	my ($key, $salt) = NGCP::Rtpclient::SRTP::decode_inline_base64($srtp_ctx_a->{key}, $srtp_ctx_a->{cs});
+	my ($skey, $sauth, $ssalt) = NGCP::Rtpclient::SRTP::gen_rtcp_session_keys($key, $salt);
+	my $sr_body = pack('NNNNN', 0xe1234567, 0x89abcdef, 7160, 2, 320);
+	my $sr = pack('CCnN', 0x80, 200, 6, 0x6543) . $sr_body;
+	my ($srtcp) = NGCP::Rtpclient::SRTP::encrypt_rtcp($srtp_ctx_a->{cs}, $skey, $ssalt, $sauth,
+		1, '', 0, 0, $sr);
+	snd($sock_ar, $port_br, $srtcp);
+	rcv($sock_br, $port_ar, qr/^\Q$srtcp\E$/s);
+	rcv($sock_cr, $port_cr, qr/^\x80\xc8\x00\x06.{4}\Q$sr_body\E$/s);
+}
+
 
 
 
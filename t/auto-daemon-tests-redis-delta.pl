@@ -0,0 +1,281 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use NGCP::Rtpengine::Test;
+use NGCP::Rtpengine::AutoTest;
+use Test::More;
+use Socket qw(AF_INET SOCK_STREAM sockaddr_in pack_sockaddr_in inet_aton);
+use Bencode;
+
+
+# fake Redis listener
+my $redis_listener;
+socket($redis_listener, AF_INET, SOCK_STREAM, 0) or die;
+bind($redis_listener, sockaddr_in(6379, inet_aton('203.0.113.42'))) or die;
+listen($redis_listener, 10) or die;
+
+my $redis_fd;
+my $redis_buf = '';
+
+
+sub redis_fill {
+	alarm(1);
+	my $ret = sysread($redis_fd, $redis_buf, 65535, length($redis_buf));
+	alarm(0);
+	$ret or die;
+}
+sub redis_read {
+	my ($len) = @_;
+	redis_fill() while length($redis_buf) < $len;
+	return substr($redis_buf, 0, $len, '');
+}
+sub redis_line {
+	redis_fill() while $redis_buf !~ /\r\n/;
+	$redis_buf =~ s/^(.*?)\r\n//s or die;
+	return $1;
+}
+# reads one command and returns its arguments
+sub redis_cmd {
+	my $n = redis_line();
+	$n =~ /^\*(\d+)$/ or die "unexpected Redis input '$n'";
+	my @args;
+	for (1 .. $1) {
+		my $len = redis_line();
+		$len =~ /^\$(\d+)$/ or die "unexpected Redis input '$len'";
+		push(@args, redis_read($1));
+		redis_read(2) eq "\r\n" or die;
+	}
+	return \@args;
+}
+sub redis_io {
+	my ($i, $o, $n) = @_;
+	is_deeply(redis_cmd(), $i, $n);
+	send($redis_fd, $o, 0) or die;
+}
+
+
+$NGCP::Rtpengine::AutoTest::launch_cb = sub {
+	# accept Redis connection and read preamble
+
+	accept($redis_fd, $redis_listener) or die;
+
+	redis_io([qw(AUTH auth)],		"+OK\r\n",			"AUTH");
+	redis_io([qw(SELECT 2)],		"+OK\r\n",			"SELECT 1");
+	redis_io([qw(INFO)],			"\$13\r\nrole:master\r\n\r\n",	"INFO");
+	redis_io([qw(TYPE calls)],		"+none\r\n",			"TYPE");
+
+	redis_io([qw(PING)],			"+PONG\r\n",			"PING");
+	redis_io([qw(SCAN 0 COUNT 256)],	"*2\r\n\$1\r\n0\r\n*0\r\n",	"SCAN");
+};
+
+
+autotest_start(qw(--config-file=none -t -1 -i 203.0.113.1 -i 2001:db8:4321::1
+			-n 2223 -f -L 7 -E --redis=auth@203.0.113.42:6379/2 --redis-delta))
+		or die;
+
+
+
+# what the fake Redis holds for the current call: field -> value, without the version
+my %stored;
+# version of the last write, and whether its transaction failed
+my ($version, $failed) = (0, 0);
+# reply to the next EXEC: 'ok', 'nil' for an aborted transaction, 'error' for a failed
+# command within it, or 'execabort'
+my $exec_reply = 'ok';
+# what the last write looked like
+my %last;
+
+$NGCP::Rtpengine::req_cb = sub {
+	redis_io([qw(PING)], "+PONG\r\n", "req PING");
+
+	%last = (full => 0, set => {}, dels => []);
+
+	my $cmd = redis_cmd();
+
+	if ($cmd->[0] eq 'EXPIRE') {
+		# nothing changed
+		is_deeply($cmd, ['EXPIRE', cid(), '86400'], 'EXPIRE only');
+		send($redis_fd, ":1\r\n", 0) or die;
+		return;
+	}
+
+	is_deeply($cmd, ['MULTI'], 'MULTI');
+	my @queued;
+	while (1) {
+		$cmd = redis_cmd();
+		last if $cmd->[0] eq 'EXEC';
+		push(@queued, $cmd);
+	}
+	is_deeply($queued[-1], ['EXPIRE', cid(), '86400'], 'EXPIRE last in transaction');
+
+	my @replies;
+	for my $q (@queued) {
+		my ($c, $key, @args) = @$q;
+		is($key, cid(), "$c key");
+		if ($c eq 'DEL') {
+			ok(!@args, 'DEL of the whole call');
+			$last{full} = 1;
+			push(@replies, ":1\r\n");
+		}
+		elsif ($c eq 'HDEL') {
+			ok(!$last{full}, 'no HDEL in a full rewrite');
+			push(@{$last{dels}}, @args);
+			push(@replies, ':' . scalar(@args) . "\r\n");
+		}
+		elsif ($c eq 'HSET') {
+			ok(@args % 2 == 0, 'HSET field/value pairs');
+			my %set = @args;
+			$last{version} = delete($set{version});
+			$last{set} = \%set;
+			push(@replies, $exec_reply eq 'error'
+					? "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n"
+					: ':' . scalar(keys(%set)) . "\r\n");
+		}
+		elsif ($c eq 'EXPIRE') {
+			push(@replies, ":1\r\n");
+		}
+		else {
+			fail("unexpected command '$c' in transaction");
+		}
+	}
+
+	# the version goes up with every transaction, and the call is rewritten in full
+	# every REDIS_DELTA_FULL_EVERY versions and after a failed transaction
+	is($last{version}, $version + 1, 'version incremented');
+	is($last{full}, ($failed || $version % 64 == 0) ? 1 : 0, 'full rewrite when expected');
+
+	if ($last{full}) {
+		ok(exists($last{set}{json}), 'call object in full rewrite');
+	}
+	else {
+		# only what has changed is sent
+		for my $k (keys(%{$last{set}})) {
+			isnt($last{set}{$k}, $stored{$k}, "changed field '$k'");
+		}
+		for my $k (@{$last{dels}}) {
+			ok(exists($stored{$k}), "deleted field '$k' was stored");
+		}
+	}
+
+	my $pipeline = "+OK\r\n" . ("+QUEUED\r\n" x scalar(@queued));
+	if ($exec_reply eq 'nil') {
+		$pipeline .= "*-1\r\n";
+	}
+	elsif ($exec_reply eq 'execabort') {
+		$pipeline .= "-EXECABORT Transaction discarded because of previous errors.\r\n";
+	}
+	else {
+		$pipeline .= '*' . scalar(@replies) . "\r\n" . join('', @replies);
+	}
+	send($redis_fd, $pipeline, 0) or die;
+
+	$version = $last{version};
+	$failed = $exec_reply ne 'ok';
+	$exec_reply = 'ok';
+	return if $failed;
+
+	%stored = () if $last{full};
+	delete @stored{@{$last{dels}}};
+	%stored = (%stored, %{$last{set}});
+};
+
+
+
+# the remote port alternates between re-invites, so that there's always something to write
+my $port = 3000;
+
+sub reinvite {
+	my ($name) = @_;
+	$port = $port == 3000 ? 3002 : 3000;
+	rtpe_req('offer', $name, { 'from-tag' => ft(), sdp => <<SDP });
+v=0
+o=- 1545997027 1 IN IP4 198.51.100.1
+s=tester
+t=0 0
+m=audio $port RTP/AVP 0
+c=IN IP4 198.51.100.1
+a=sendrecv
+SDP
+}
+
+
+
+new_call;
+
+rtpe_req('offer', 'initial', { 'from-tag' => ft(), sdp => <<SDP });
+v=0
+o=- 1545997027 1 IN IP4 198.51.100.1
+s=tester
+t=0 0
+m=audio 3000 RTP/AVP 0
+c=IN IP4 198.51.100.1
+a=sendrecv
+SDP
+
+is($version, 1, 'first version');
+ok($last{full}, 'first write in full');
+for my $k (qw(json tag-0 media-0 map-0 sfd-0 stream-0)) {
+	ok(exists($stored{$k}), "field '$k' stored");
+}
+my $json = Bencode::bdecode($stored{json}, 1);
+is($json->{num_tags}, '2', 'call object stored');
+
+rtpe_req('answer', 'answer', { 'from-tag' => ft(), 'to-tag' => tt(), sdp => <<SDP });
+v=0
+o=- 1545997027 1 IN IP4 198.51.100.3
+s=tester
+t=0 0
+m=audio 4000 RTP/AVP 0
+c=IN IP4 198.51.100.3
+a=sendrecv
+SDP
+
+is($version, 2, 'second version');
+ok(!$last{full}, 'delta write');
+ok(scalar(keys(%{$last{set}})) < scalar(keys(%stored)), 'not everything written');
+
+
+# deltas until the full rewrite is due
+
+for (1 .. 100) {
+	last if $version == 64;
+	reinvite('delta');
+	ok(!$last{full}, "delta write $version");
+}
+is($version, 64, 'last delta version');
+
+reinvite('periodic full rewrite');
+is($version, 65, 'version after full rewrite');
+ok($last{full}, 'periodic full rewrite');
+
+reinvite('delta after full rewrite');
+ok(!$last{full}, 'delta after periodic full rewrite');
+
+
+# failed transactions
+
+for my $reply (qw(nil error execabort)) {
+	$exec_reply = $reply;
+	reinvite("EXEC reply $reply");
+	ok(!$last{full}, "delta write with EXEC reply $reply");
+	reinvite("after EXEC reply $reply");
+	ok($last{full}, "full rewrite after EXEC reply $reply");
+	reinvite("delta after EXEC reply $reply");
+	ok(!$last{full}, "delta write after EXEC reply $reply");
+}
+
+# a failed full rewrite is retried in full as well
+$exec_reply = 'nil';
+reinvite('failed delta');
+ok(!$last{full}, 'failed delta write');
+$exec_reply = 'nil';
+reinvite('failed full rewrite');
+ok($last{full}, 'failed full rewrite');
+reinvite('full rewrite retried');
+ok($last{full}, 'full rewrite retried');
+reinvite('delta after retried full rewrite');
+ok(!$last{full}, 'delta after retried full rewrite');
+
+
+done_testing();
@@ -49,7 +49,8 @@ $NGCP::Rtpengine::AutoTest::launch_cb = sub {
 	redis_io("*2\r\n\$4\r\nTYPE\r\n\$5\r\ncalls\r\n",	"+none\r\n",			"TYPE");
 
 	redis_io("*1\r\n\$4\r\nPING\r\n",			"+PONG\r\n",			"PING");
-	redis_io("*2\r\n\$4\r\nKEYS\r\n\$1\r\n*\r\n",		"*0\r\n",			"KEYS");
+	redis_io("*4\r\n\$4\r\nSCAN\r\n\$1\r\n0\r\n\$5\r\nCOUNT\r\n\$3\r\n256\r\n",
+								"*2\r\n\$1\r\n0\r\n*0\r\n",		"SCAN");
 };
 
 
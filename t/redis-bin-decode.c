@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <glib.h>
+
+#include "redis_bin.h"
+#include "bencode.h"
+
+
+// Reads a call document in the binary Redis format from stdin and prints it as bencode. Used
+// by auto-daemon-tests-redis-binary.pl to compare what the daemon stores against the same
+// expectations as for the bencode format.
+int main(void) {
+	GString *in = g_string_new("");
+	char buf[4096];
+	size_t len;
+
+	while ((len = fread(buf, 1, sizeof(buf), stdin)) > 0)
+		g_string_append_len(in, buf, len);
+
+	bencode_buffer_t bbuf;
+	if (bencode_buffer_init(&bbuf))
+		return 1;
+
+	str s = STR_LEN(in->str, in->len);
+	bencode_item_t *root = redis_bin_decode(&bbuf, &s);
+	if (!root) {
+		fprintf(stderr, "Failed to decode %zu bytes\n", in->len);
+		return 1;
+	}
+
+	str out = bencode_collapse_str(root);
+	fwrite(out.s, 1, out.len, stdout);
+
+	bencode_buffer_free(&bbuf);
+	g_string_free(in, TRUE);
+	return 0;
+}
@@ -0,0 +1,175 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "codeclib.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+struct rtpengine_config initial_rtpe_config;
+
+
+static struct codec_pool_stats last;
+
+// starts over with empty pools, and returns the counts since the last call
+static void pools_reset(int64_t *fh, int64_t *fm, int64_t *ph, int64_t *pm) {
+	codec_pools_thread_cleanup();
+
+	int64_t v;
+	v = atomic64_get_na(&codec_pool_stats.frame_hits);
+	*fh = v - atomic64_get_na(&last.frame_hits);
+	atomic64_set_na(&last.frame_hits, v);
+	v = atomic64_get_na(&codec_pool_stats.frame_misses);
+	*fm = v - atomic64_get_na(&last.frame_misses);
+	atomic64_set_na(&last.frame_misses, v);
+	v = atomic64_get_na(&codec_pool_stats.packet_hits);
+	*ph = v - atomic64_get_na(&last.packet_hits);
+	atomic64_set_na(&last.packet_hits, v);
+	v = atomic64_get_na(&codec_pool_stats.packet_misses);
+	*pm = v - atomic64_get_na(&last.packet_misses);
+	atomic64_set_na(&last.packet_misses, v);
+}
+
+static void check_counts(int64_t frame_hits, int64_t frame_misses, int64_t packet_hits,
+		int64_t packet_misses)
+{
+	int64_t fh, fm, ph, pm;
+	pools_reset(&fh, &fm, &ph, &pm);
+	assert(fh == frame_hits);
+	assert(fm == frame_misses);
+	assert(ph == packet_hits);
+	assert(pm == packet_misses);
+}
+
+static void check_frame(AVFrame *f, enum AVSampleFormat format, int channels, int nb_samples) {
+	assert(f != NULL);
+	assert(f->format == format);
+	assert(f->nb_samples == nb_samples);
+	int planes = av_sample_fmt_is_planar(format) ? channels : 1;
+	int bytes = nb_samples * av_get_bytes_per_sample(format) * (planes == 1 ? channels : 1);
+	for (int i = 0; i < planes; i++) {
+		assert(f->buf[i] != NULL);
+		assert(f->extended_data[i] == f->data[i]);
+		assert(f->buf[i]->size >= bytes);
+		// must be writable throughout
+		memset(f->data[i], 0x55, bytes);
+	}
+}
+
+
+// a frame counts once, not once for the struct and once more for its buffer
+static void test_frame_reuse(void) {
+	printf("testing frame reuse\n");
+
+	AVFrame *f = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 160);
+	check_frame(f, AV_SAMPLE_FMT_S16, 1, 160);
+	uint8_t *data = f->data[0];
+	codec_frame_free(&f);
+	assert(f == NULL);
+
+	f = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 160);
+	check_frame(f, AV_SAMPLE_FMT_S16, 1, 160);
+	assert(f->data[0] == data);
+	codec_frame_free(&f);
+
+	// slightly smaller frames share the pool
+	f = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 150);
+	check_frame(f, AV_SAMPLE_FMT_S16, 1, 150);
+	assert(f->data[0] == data);
+	codec_frame_free(&f);
+
+	check_counts(2, 1, 0, 0);
+}
+
+// planar frames need a buffer per channel, but still count once
+static void test_frame_planar(void) {
+	printf("testing planar frames\n");
+
+	AVFrame *f = codec_frame_new(AV_SAMPLE_FMT_FLTP, 2, 48000, 960);
+	check_frame(f, AV_SAMPLE_FMT_FLTP, 2, 960);
+	codec_frame_free(&f);
+	f = codec_frame_new(AV_SAMPLE_FMT_FLTP, 2, 48000, 960);
+	check_frame(f, AV_SAMPLE_FMT_FLTP, 2, 960);
+	codec_frame_free(&f);
+
+	check_counts(1, 1, 0, 0);
+}
+
+// a recycled struct with a newly allocated buffer is a miss
+static void test_frame_partial(void) {
+	printf("testing partial reuse\n");
+
+	AVFrame *a = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 160);
+	check_frame(a, AV_SAMPLE_FMT_S16, 1, 160);
+	// leaves a spare struct, but no spare buffer
+	AVFrame *x = codec_frame_alloc();
+	codec_frame_free(&x);
+
+	AVFrame *b = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 160);
+	check_frame(b, AV_SAMPLE_FMT_S16, 1, 160);
+	assert(a->data[0] != b->data[0]);
+	codec_frame_free(&a);
+	codec_frame_free(&b);
+
+	// both reused now
+	AVFrame *c = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 160);
+	check_frame(c, AV_SAMPLE_FMT_S16, 1, 160);
+	codec_frame_free(&c);
+
+	check_counts(1, 3, 0, 0);
+
+	// buffers released after the pools are gone must not be a problem
+	a = codec_frame_new(AV_SAMPLE_FMT_S16, 1, 8000, 160);
+	AVFrame *ref = codec_frame_clone(a);
+	assert(ref->data[0] == a->data[0]);
+	codec_frame_free(&a);
+	check_counts(0, 2, 0, 0);
+	codec_frame_free(&ref);
+	check_counts(0, 0, 0, 0);
+}
+
+static void test_packets(void) {
+	printf("testing packets\n");
+
+	AVPacket *p = codec_packet_alloc();
+	assert(p != NULL);
+	int ret = codec_packet_new(p, 100);
+	assert(ret == 0);
+	assert(p->size == 100);
+	uint8_t *data = p->data;
+	memset(p->data, 0x55, 100 + AV_INPUT_BUFFER_PADDING_SIZE);
+	codec_packet_free(&p);
+	assert(p == NULL);
+
+	p = codec_packet_alloc();
+	ret = codec_packet_new(p, 90);
+	assert(ret == 0);
+	assert(p->data == data);
+	assert(p->size == 90);
+	for (int i = 0; i < AV_INPUT_BUFFER_PADDING_SIZE; i++)
+		assert(p->data[90 + i] == 0);
+
+	// replaces the old buffer
+	ret = codec_packet_new(p, 1000);
+	assert(ret == 0);
+	assert(p->size == 1000);
+	codec_packet_free(&p);
+
+	check_counts(0, 0, 2, 3);
+}
+
+
+int main(void) {
+	rtpe_common_config_ptr = &rtpe_config.common;
+	codeclib_init(0);
+
+	int64_t fh, fm, ph, pm;
+	pools_reset(&fh, &fm, &ph, &pm);
+
+	test_frame_reuse();
+	test_frame_planar();
+	test_frame_partial();
+	test_packets();
+
+	printf("all tests done\n");
+	return 0;
+}
@@ -0,0 +1,264 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cookie_cache.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+
+static struct cookie_cache cache;
+
+#define NUM_KEYS 8
+static char key_bufs[NUM_KEYS][32];
+static str keys[NUM_KEYS];
+static unsigned int key_shard;
+
+
+// keys all falling into the same shard, so that they share buckets and the size limit
+static void make_keys(void) {
+	unsigned int n = 0;
+	for (unsigned int i = 0; n < NUM_KEYS; i++) {
+		char *buf = key_bufs[n];
+		str k = STR_LEN(buf, sprintf(buf, "cookie-%u", i));
+		unsigned int shard = str_hash(&k) % COOKIE_CACHE_SHARDS;
+		if (n == 0)
+			key_shard = shard;
+		else if (shard != key_shard)
+			continue;
+		keys[n++] = k;
+	}
+}
+
+static struct cookie_cache_shard *shard(void) {
+	return &cache.shards[key_shard];
+}
+
+static size_t entry_size(const str *key, const char *reply) {
+	return sizeof(struct cookie_cache_entry) + key->len + strlen(reply) + strlen("callid");
+}
+
+static void reset(time_t now, size_t max_shard_size) {
+	rtpe_now = (struct timeval) { now, 0 };
+	cookie_cache_init(&cache);
+	if (max_shard_size)
+		cache.max_shard_size = max_shard_size;
+}
+
+// the way the control code uses it: a miss must be followed by an insert or remove
+static void insert(const str *key, const char *reply) {
+	assert(cookie_cache_lookup(&cache, key) == NULL);
+	str r = STR(reply);
+	str callid = STR("callid");
+	struct cache_entry ce = { .reply = &r, .callid = &callid, .command = 3 };
+	cookie_cache_insert(&cache, key, &ce);
+}
+
+static bool present(const str *key) {
+	cache_entry *ce = cookie_cache_lookup(&cache, key);
+	if (!ce) {
+		cookie_cache_remove(&cache, key);
+		return false;
+	}
+	cache_entry_put(ce);
+	return true;
+}
+
+
+static void test_basic(void) {
+	printf("testing lookup, insert, remove\n");
+	reset(1000, 0);
+
+	insert(&keys[0], "reply-0");
+	assert(shard()->size == entry_size(&keys[0], "reply-0"));
+
+	cache_entry *ce = cookie_cache_lookup(&cache, &keys[0]);
+	assert(ce != NULL);
+	assert(str_cmp(ce->reply, "reply-0") == 0);
+	assert(str_cmp(ce->callid, "callid") == 0);
+	assert(ce->command == 3);
+	cache_entry_put(ce);
+
+	// replacing an entry
+	cookie_cache_remove(&cache, &keys[0]);
+	assert(shard()->size == 0);
+	insert(&keys[0], "reply-0b");
+	ce = cookie_cache_lookup(&cache, &keys[0]);
+	assert(ce != NULL);
+	assert(str_cmp(ce->reply, "reply-0b") == 0);
+	cache_entry_put(ce);
+
+	// a miss followed by a remove leaves nothing behind
+	assert(present(&keys[1]) == false);
+	assert(present(&keys[1]) == false);
+	assert(shard()->size == entry_size(&keys[0], "reply-0b"));
+
+	cookie_cache_remove(&cache, &keys[0]);
+	assert(present(&keys[0]) == false);
+	assert(shard()->size == 0);
+
+	cookie_cache_cleanup(&cache);
+}
+
+// entries go away with their bucket, once all buckets have been cycled through
+static void test_expire(void) {
+	printf("testing expiry\n");
+	reset(1009, 0);
+
+	insert(&keys[0], "reply-0");
+	rtpe_now.tv_sec = 1010;
+	insert(&keys[1], "reply-1");
+
+	// kept for COOKIE_CACHE_BUCKETS - 1 full slots
+	rtpe_now.tv_sec = 1039;
+	assert(present(&keys[0]));
+	assert(present(&keys[1]));
+
+	rtpe_now.tv_sec = 1040;
+	assert(!present(&keys[0]));
+	assert(present(&keys[1]));
+	assert(shard()->size == entry_size(&keys[1], "reply-1"));
+
+	rtpe_now.tv_sec = 1050;
+	assert(!present(&keys[1]));
+	assert(shard()->size == 0);
+
+	// time going backwards doesn't expire anything
+	insert(&keys[2], "reply-2");
+	rtpe_now.tv_sec = 1000;
+	assert(present(&keys[2]));
+	assert(shard()->slot == 1050 / COOKIE_CACHE_BUCKET_SECS);
+
+	cookie_cache_cleanup(&cache);
+}
+
+// a gap of more than COOKIE_CACHE_BUCKETS slots empties every bucket once, and leaves the
+// ring in line with the current time
+static void test_expire_skip(void) {
+	printf("testing expiry after a long gap\n");
+	reset(2000, 0);
+
+	for (unsigned int i = 0; i < COOKIE_CACHE_BUCKETS; i++) {
+		rtpe_now.tv_sec = 2000 + i * COOKIE_CACHE_BUCKET_SECS;
+		insert(&keys[i], "reply");
+	}
+	for (unsigned int i = 0; i < COOKIE_CACHE_BUCKETS; i++)
+		assert(present(&keys[i]));
+
+	rtpe_now.tv_sec = 5000;
+	for (unsigned int i = 0; i < COOKIE_CACHE_BUCKETS; i++)
+		assert(!present(&keys[i]));
+	assert(shard()->size == 0);
+	assert(shard()->slot == 5000 / COOKIE_CACHE_BUCKET_SECS);
+	for (unsigned int i = 0; i < COOKIE_CACHE_BUCKETS; i++)
+		assert(shard()->buckets[i].length == 0);
+
+	// normal ageing from there
+	insert(&keys[0], "reply");
+	rtpe_now.tv_sec = 5039;
+	assert(present(&keys[0]));
+	rtpe_now.tv_sec = 5040;
+	assert(!present(&keys[0]));
+
+	cookie_cache_cleanup(&cache);
+}
+
+// over the size limit, the oldest entries are dropped first
+static void test_size(void) {
+	printf("testing size limit\n");
+	size_t size = entry_size(&keys[0], "reply");
+	for (unsigned int i = 1; i < NUM_KEYS; i++)
+		assert(entry_size(&keys[i], "reply") == size);
+
+	reset(3000, size * 3);
+
+	insert(&keys[0], "reply");
+	rtpe_now.tv_sec = 3010;
+	insert(&keys[1], "reply");
+	insert(&keys[2], "reply");
+	assert(shard()->size == size * 3);
+
+	// oldest bucket first
+	insert(&keys[3], "reply");
+	assert(shard()->size == size * 3);
+	assert(!present(&keys[0]));
+	assert(present(&keys[1]));
+	assert(present(&keys[2]));
+	assert(present(&keys[3]));
+
+	// oldest within the same bucket
+	insert(&keys[4], "reply");
+	assert(!present(&keys[1]));
+	assert(present(&keys[2]));
+	assert(present(&keys[3]));
+	assert(present(&keys[4]));
+
+	cookie_cache_cleanup(&cache);
+
+	// a limit below the size of a single entry keeps nothing, but still works
+	reset(3000, size - 1);
+	insert(&keys[0], "reply");
+	assert(shard()->size == 0);
+	assert(!present(&keys[0]));
+	insert(&keys[0], "reply");
+	assert(!present(&keys[0]));
+	assert(shard()->size == 0);
+
+	cookie_cache_cleanup(&cache);
+}
+
+// a reply handed out stays valid after its entry has left the cache
+static void test_held(void) {
+	printf("testing held references\n");
+	size_t size = entry_size(&keys[0], "reply");
+
+	reset(4000, size);
+	insert(&keys[0], "reply");
+	cache_entry *ce = cookie_cache_lookup(&cache, &keys[0]);
+	assert(ce != NULL);
+
+	// evicted by size
+	insert(&keys[1], "reply");
+	assert(!present(&keys[0]));
+	assert(str_cmp(ce->reply, "reply") == 0);
+	cache_entry_put(ce);
+
+	// expired
+	ce = cookie_cache_lookup(&cache, &keys[1]);
+	assert(ce != NULL);
+	rtpe_now.tv_sec = 4100;
+	assert(!present(&keys[1]));
+	assert(shard()->size == 0);
+	assert(str_cmp(ce->reply, "reply") == 0);
+	assert(str_cmp(ce->callid, "callid") == 0);
+	cache_entry_put(ce);
+
+	// removed
+	insert(&keys[2], "reply");
+	ce = cookie_cache_lookup(&cache, &keys[2]);
+	assert(ce != NULL);
+	cookie_cache_remove(&cache, &keys[2]);
+	assert(str_cmp(ce->reply, "reply") == 0);
+	cache_entry_put(ce);
+
+	cookie_cache_cleanup(&cache);
+}
+
+
+int main(void) {
+	make_keys();
+
+	test_basic();
+	test_expire();
+	test_expire_skip();
+	test_size();
+	test_held();
+
+	printf("all tests passed\n");
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "codeclib.h"
+#include "str.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+struct rtpengine_config initial_rtpe_config;
+
+// G.722 is used as its decoder has state carried over from one packet to the next
+#define NUM_PACKETS 24
+#define PACKET_LEN 160 // 20 ms
+#define MAX_SAMPLES 640
+
+static unsigned char packets[NUM_PACKETS][PACKET_LEN];
+static int16_t reference[NUM_PACKETS][MAX_SAMPLES];
+static unsigned int reference_num[NUM_PACKETS];
+
+static const format_t out_format = { .clockrate = 16000, .channels = 1, .format = AV_SAMPLE_FMT_S16 };
+static codec_def_t *def;
+
+struct sink {
+	decoder_t *dec;
+	int16_t samples[MAX_SAMPLES];
+	unsigned int num;
+};
+
+static int frame_cb(decoder_t *dec, AVFrame *frame, void *u1, void *u2) {
+	struct sink *s = u1;
+	assert(frame->format == AV_SAMPLE_FMT_S16);
+	assert(s->num + frame->nb_samples <= MAX_SAMPLES);
+	memcpy(s->samples + s->num, frame->extended_data[0], frame->nb_samples * sizeof(int16_t));
+	s->num += frame->nb_samples;
+	codec_frame_free(&frame);
+	return 0;
+}
+
+static void sink_init(struct sink *s, decode_cache_t *cache) {
+	s->dec = decoder_new_fmt(def, 8000, 1, 20, &out_format);
+	assert(s->dec != NULL);
+	decoder_set_cache(s->dec, cache);
+}
+
+static void sink_decode(struct sink *s, unsigned int i) {
+	str data = STR_LEN((char *) packets[i], PACKET_LEN);
+	s->num = 0;
+	int ret = decoder_input_data(s->dec, &data, 1000 + i * PACKET_LEN, frame_cb, s, NULL);
+	assert(ret == 0);
+}
+
+// output must be the same as from a private decoder that has seen the whole stream
+static void sink_check(struct sink *s, unsigned int i) {
+	sink_decode(s, i);
+	assert(s->num == reference_num[i]);
+	assert(memcmp(s->samples, reference[i], s->num * sizeof(int16_t)) == 0);
+}
+
+
+int main(void) {
+	rtpe_common_config_ptr = &rtpe_config.common;
+	codeclib_init(0);
+
+	str name = STR_CONST("G722");
+	def = codec_find(&name, MT_AUDIO);
+	assert(def != NULL);
+	if (!def->support_decoding) {
+		printf("G.722 not supported - skipping test\n");
+		return 0;
+	}
+
+	unsigned int seed = 1;
+	for (unsigned int i = 0; i < NUM_PACKETS; i++) {
+		for (unsigned int j = 0; j < PACKET_LEN; j++)
+			packets[i][j] = rand_r(&seed);
+	}
+
+	struct sink ref = {0};
+	sink_init(&ref, NULL);
+	for (unsigned int i = 0; i < NUM_PACKETS; i++) {
+		sink_decode(&ref, i);
+		assert(ref.num > 0);
+		reference_num[i] = ref.num;
+		memcpy(reference[i], ref.samples, ref.num * sizeof(int16_t));
+	}
+	decoder_close(ref.dec);
+
+	decode_cache_t *cache = decode_cache_new(def, 8000, 1, 20, NULL, NULL, NULL);
+	assert(cache != NULL);
+	assert(!decode_cache_warm(cache));
+
+	struct sink a = {0}, b = {0}, c = {0}, d = {0};
+
+	// two sinks from the start, taking turns decoding first
+	sink_init(&a, cache);
+	sink_init(&b, cache);
+	for (unsigned int i = 0; i < 6; i++) {
+		if (i & 1) {
+			sink_check(&b, i);
+			sink_check(&a, i);
+		}
+		else {
+			sink_check(&a, i);
+			sink_check(&b, i);
+		}
+	}
+
+	// join: a new sink picks up the state of the shared decoder, both when it's the first
+	// to see a packet and when it's served from the cache
+	sink_init(&c, cache);
+	sink_check(&c, 6);
+	sink_check(&a, 6);
+	sink_check(&b, 6);
+	for (unsigned int i = 7; i < 12; i++) {
+		sink_check(&a, i);
+		sink_check(&b, i);
+		sink_check(&c, i);
+	}
+
+	// enough packets for a sink decoding on its own to switch over
+	assert(decode_cache_warm(cache));
+
+	// leave: the remaining sinks carry on
+	decoder_close(a.dec);
+	for (unsigned int i = 12; i < 16; i++) {
+		sink_check(&c, i);
+		sink_check(&b, i);
+	}
+	decoder_close(b.dec);
+	for (unsigned int i = 16; i < 18; i++)
+		sink_check(&c, i);
+
+	// lag: packets older than what's cached are decoded privately and must not take the
+	// shared decoder back in time
+	sink_init(&d, cache);
+	sink_decode(&d, 2);
+	assert(d.num == reference_num[2]);
+	sink_decode(&d, 3);
+	assert(d.num == reference_num[3]);
+	for (unsigned int i = 18; i < NUM_PACKETS; i++)
+		sink_check(&c, i);
+	// once caught up, it's served from the cache again
+	sink_check(&d, NUM_PACKETS - 1);
+
+	decoder_close(c.dec);
+	decoder_close(d.dec);
+	decode_cache_free(cache);
+
+	printf("all tests passed\n");
+	return 0;
+}
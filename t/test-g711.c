@@ -0,0 +1,201 @@
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <assert.h>
+#include "codeclib.h"
+#include "fix_frame_channel_layout.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+struct rtpengine_config initial_rtpe_config;
+
+static int16_t all_samples[65536];
+
+// reference output from libavcodec's own encoder
+static void av_encode(enum AVCodecID id, unsigned char *dst, const int16_t *src, unsigned int num) {
+	const AVCodec *codec = avcodec_find_encoder(id);
+	assert(codec != NULL);
+	AVCodecContext *avcctx = avcodec_alloc_context3(codec);
+	avcctx->sample_fmt = AV_SAMPLE_FMT_S16;
+	avcctx->sample_rate = 8000;
+	DEF_CH_LAYOUT(&avcctx->CH_LAYOUT, 1);
+	int ret = avcodec_open2(avcctx, codec, NULL);
+	assert(ret == 0);
+
+	AVFrame *frame = av_frame_alloc();
+	frame->nb_samples = num;
+	frame->format = AV_SAMPLE_FMT_S16;
+	frame->sample_rate = 8000;
+	DEF_CH_LAYOUT(&frame->CH_LAYOUT, 1);
+	ret = av_frame_get_buffer(frame, 0);
+	assert(ret == 0);
+	memcpy(frame->extended_data[0], src, num * sizeof(*src));
+
+	ret = avcodec_send_frame(avcctx, frame);
+	assert(ret == 0);
+	AVPacket *pkt = av_packet_alloc();
+	ret = avcodec_receive_packet(avcctx, pkt);
+	assert(ret == 0);
+	assert(pkt->size == num);
+	memcpy(dst, pkt->data, num);
+
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	avcodec_free_context(&avcctx);
+}
+
+static void av_decode(enum AVCodecID id, int16_t *dst, const unsigned char *src, unsigned int num) {
+	const AVCodec *codec = avcodec_find_decoder(id);
+	assert(codec != NULL);
+	AVCodecContext *avcctx = avcodec_alloc_context3(codec);
+	avcctx->sample_rate = 8000;
+	DEF_CH_LAYOUT(&avcctx->CH_LAYOUT, 1);
+	int ret = avcodec_open2(avcctx, codec, NULL);
+	assert(ret == 0);
+
+	AVPacket *pkt = av_packet_alloc();
+	ret = av_new_packet(pkt, num);
+	assert(ret == 0);
+	memcpy(pkt->data, src, num);
+	ret = avcodec_send_packet(avcctx, pkt);
+	assert(ret == 0);
+	AVFrame *frame = av_frame_alloc();
+	ret = avcodec_receive_frame(avcctx, frame);
+	assert(ret == 0);
+	assert(frame->nb_samples == num);
+	assert(frame->format == AV_SAMPLE_FMT_S16);
+	memcpy(dst, frame->extended_data[0], num * sizeof(*dst));
+
+	av_frame_free(&frame);
+	av_packet_free(&pkt);
+	avcodec_free_context(&avcctx);
+}
+
+static void check_encode(void (*enc)(unsigned char *, const int16_t *, unsigned int),
+		const unsigned char *exp)
+{
+	static unsigned char out[65536 + 1];
+
+	enc(out, all_samples, 65536);
+	for (unsigned int i = 0; i < 65536; i++) {
+		if (out[i] != exp[i]) {
+			printf("mismatch for sample %i: %02x != %02x\n", all_samples[i], out[i], exp[i]);
+			abort();
+		}
+	}
+
+	// all lengths and alignments up to a few vectors, to cover the remainder handling
+	for (unsigned int off = 0; off < 4; off++) {
+		for (unsigned int len = 0; len < 70; len++) {
+			memset(out, 0xaa, sizeof(out));
+			enc(out + off, all_samples + 1000 * len + off, len);
+			assert(memcmp(out + off, exp + 1000 * len + off, len) == 0);
+			assert(out[off + len] == 0xaa);
+		}
+	}
+}
+
+static void test_encode(const char *name, enum AVCodecID id,
+		void (*enc)(unsigned char *, const int16_t *, unsigned int))
+{
+	static unsigned char exp[65536];
+
+	printf("testing %s encoder\n", name);
+
+	av_encode(id, exp, all_samples, 65536);
+	check_encode(enc, exp);
+}
+
+// a vector kernel against the scalar one
+static void test_kernel(const char *name, g711_enc_fn_t *enc, g711_enc_fn_t *ref) {
+	static unsigned char exp[65536];
+
+	printf("testing %s kernel\n", name);
+
+	ref(exp, all_samples, 65536);
+	check_encode(enc, exp);
+}
+
+static void test_decode(const char *name, enum AVCodecID id,
+		void (*dec)(int16_t *, const unsigned char *, unsigned int))
+{
+	unsigned char codes[256];
+	int16_t exp[256], out[256];
+
+	printf("testing %s decoder\n", name);
+
+	for (unsigned int i = 0; i < 256; i++)
+		codes[i] = i;
+	av_decode(id, exp, codes, 256);
+	dec(out, codes, 256);
+	assert(memcmp(out, exp, sizeof(exp)) == 0);
+}
+
+static void test_xlate(const char *src_name, const char *dst_name,
+		void (*dec)(int16_t *, const unsigned char *, unsigned int),
+		void (*enc)(unsigned char *, const int16_t *, unsigned int))
+{
+	unsigned char codes[256], exp[256], out[256];
+	int16_t pcm[256];
+
+	printf("testing %s to %s\n", src_name, dst_name);
+
+	str n = STR(src_name);
+	codec_def_t *src = codec_find(&n, MT_AUDIO);
+	n = STR(dst_name);
+	codec_def_t *dst = codec_find(&n, MT_AUDIO);
+	assert(src != NULL && dst != NULL);
+
+	codec_xlate_f *xlate = codec_xlate(src, dst);
+	assert(xlate != NULL);
+
+	for (unsigned int i = 0; i < 256; i++)
+		codes[i] = i;
+	dec(pcm, codes, 256);
+	enc(exp, pcm, 256);
+	xlate(out, codes, 256);
+	assert(memcmp(out, exp, sizeof(exp)) == 0);
+
+	// same codec or anything else has no direct path
+	assert(codec_xlate(src, src) == NULL);
+	n = STR_CONST("opus");
+	codec_def_t *other = codec_find(&n, MT_AUDIO);
+	if (other)
+		assert(codec_xlate(src, other) == NULL);
+}
+
+int main(void) {
+	rtpe_common_config_ptr = &rtpe_config.common;
+	codeclib_init(0);
+
+	for (unsigned int i = 0; i < 65536; i++)
+		all_samples[i] = i - 32768;
+
+	test_encode("PCMA", AV_CODEC_ID_PCM_ALAW, g711_alaw_encode);
+	test_encode("PCMU", AV_CODEC_ID_PCM_MULAW, g711_ulaw_encode);
+
+	// each kernel on its own, not just the one picked for this CPU
+	test_encode("PCMA scalar", AV_CODEC_ID_PCM_ALAW, g711_alaw_enc_c);
+	test_encode("PCMU scalar", AV_CODEC_ID_PCM_MULAW, g711_ulaw_enc_c);
+#if defined(__x86_64__)
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2)) {
+		test_kernel("PCMA SSE2", g711_alaw_enc_sse2, g711_alaw_enc_c);
+		test_kernel("PCMU SSE2", g711_ulaw_enc_sse2, g711_ulaw_enc_c);
+	}
+	else
+		printf("no SSE2 - skipping SSE2 kernels\n");
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2)) {
+		test_kernel("PCMA AVX2", g711_alaw_enc_avx2, g711_alaw_enc_c);
+		test_kernel("PCMU AVX2", g711_ulaw_enc_avx2, g711_ulaw_enc_c);
+	}
+	else
+		printf("no AVX2 - skipping AVX2 kernels\n");
+#endif
+
+	test_decode("PCMA", AV_CODEC_ID_PCM_ALAW, g711_alaw_decode);
+	test_decode("PCMU", AV_CODEC_ID_PCM_MULAW, g711_ulaw_decode);
+	test_xlate("PCMA", "PCMU", g711_alaw_decode, g711_ulaw_encode);
+	test_xlate("PCMU", "PCMA", g711_ulaw_decode, g711_alaw_encode);
+
+	printf("all tests done\n");
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "jobsched.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+
+#define NUM_WORKERS 4
+#define NUM_UNITS 64
+#define NUM_ROUNDS 50
+
+// an affinity unit with its own backlog, run the same way as the transcoding jobs
+struct unit {
+	struct jobsched_job job; // must be first
+	unsigned int affinity;
+	mutex_t lock;
+	unsigned int submitted;
+	unsigned int done;
+	bool queued;
+	bool running;
+};
+
+static struct jobsched sched;
+static struct unit units[NUM_UNITS];
+static unsigned int jobs_run;
+
+
+static void unit_run(struct jobsched_job *j) {
+	struct unit *u = (struct unit *) j;
+
+	// never two workers on the same unit
+	assert(__atomic_exchange_n(&u->running, true, __ATOMIC_SEQ_CST) == false);
+	__atomic_add_fetch(&jobs_run, 1, __ATOMIC_SEQ_CST);
+
+	mutex_lock(&u->lock);
+	while (u->done < u->submitted) {
+		unsigned int seq = u->done;
+		mutex_unlock(&u->lock);
+		usleep(50);
+		mutex_lock(&u->lock);
+		// work items are done in order
+		assert(u->done == seq);
+		u->done++;
+	}
+	__atomic_store_n(&u->running, false, __ATOMIC_SEQ_CST);
+	u->queued = false;
+	mutex_unlock(&u->lock);
+}
+
+static void unit_add(struct unit *u) {
+	mutex_lock(&u->lock);
+	u->submitted++;
+	if (!u->queued) {
+		u->queued = true;
+		jobsched_submit(&sched, &u->job);
+	}
+	mutex_unlock(&u->lock);
+}
+
+static void *worker(void *p) {
+	jobsched_worker(&sched, GPOINTER_TO_UINT(p));
+	return NULL;
+}
+
+
+int main(void) {
+	pthread_t threads[NUM_WORKERS];
+
+	jobsched_init(&sched, NUM_WORKERS);
+	assert(sched.num_workers == NUM_WORKERS);
+
+	for (unsigned int i = 0; i < NUM_UNITS; i++) {
+		struct unit *u = &units[i];
+		mutex_init(&u->lock);
+		u->job.func = unit_run;
+		u->job.affinity = &u->affinity;
+		// everything starts out on the first worker, so the others must steal
+		u->affinity = 1;
+	}
+
+	for (unsigned int i = 0; i < NUM_WORKERS; i++)
+		pthread_create(&threads[i], NULL, worker, GUINT_TO_POINTER(i));
+
+	for (unsigned int r = 0; r < NUM_ROUNDS; r++) {
+		for (unsigned int i = 0; i < NUM_UNITS; i++)
+			unit_add(&units[i]);
+		usleep(1000);
+	}
+
+	// wait for everything to finish
+	while (true) {
+		bool busy = false;
+		for (unsigned int i = 0; i < NUM_UNITS; i++) {
+			struct unit *u = &units[i];
+			mutex_lock(&u->lock);
+			if (u->queued || u->done != u->submitted)
+				busy = true;
+			mutex_unlock(&u->lock);
+		}
+		if (!busy)
+			break;
+		usleep(1000);
+	}
+
+	for (unsigned int i = 0; i < NUM_UNITS; i++)
+		assert(units[i].done == NUM_ROUNDS);
+
+	jobsched_shutdown(&sched);
+	for (unsigned int i = 0; i < NUM_WORKERS; i++)
+		pthread_join(threads[i], NULL);
+
+	uint64_t jobs = 0, steals = 0;
+	for (unsigned int i = 0; i < NUM_WORKERS; i++) {
+		struct jobsched_worker *w = &sched.workers[i];
+		assert(jobsched_depth(w) == 0);
+		assert(atomic_get_na(&w->max_depth) <= NUM_UNITS);
+
+		uint64_t buckets = 0;
+		for (unsigned int b = 0; b < JOBSCHED_LATENCY_BUCKETS; b++)
+			buckets += atomic64_get_na(&w->latency[b]);
+		assert(buckets == atomic64_get_na(&w->jobs));
+
+		jobs += atomic64_get_na(&w->jobs);
+		steals += atomic64_get_na(&w->steals);
+	}
+	assert(jobs == jobs_run);
+	assert(steals > 0);
+
+	jobsched_free(&sched);
+
+	printf("all tests done\n");
+	return 0;
+}
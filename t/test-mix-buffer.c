@@ -2,7 +2,10 @@
 #include <assert.h>
 #include <libavutil/samplefmt.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include "statistics.h"
+#include "codeclib.h"
 
 
 struct rtpengine_config rtpe_config;
@@ -24,6 +27,54 @@ int get_local_log_level(unsigned int u) {
 }
 
 
+#define KERNEL_SOURCES 4
+#define KERNEL_SAMPLES 203
+
+// compares a kernel against the scalar one, with and without mix-minus, and with `dst` being
+// the first source
+static void test_mix_n(const char *name, mix_n_fn_t *fn) {
+	printf("testing mix_n %s\n", name);
+
+	int16_t in[KERNEL_SOURCES][KERNEL_SAMPLES], orig[KERNEL_SOURCES][KERNEL_SAMPLES];
+	int16_t mix[KERNEL_SAMPLES], ref_mix[KERNEL_SAMPLES];
+	int16_t mm[KERNEL_SOURCES][KERNEL_SAMPLES], ref_mm[KERNEL_SOURCES][KERNEL_SAMPLES];
+	const void *srcs[KERNEL_SOURCES];
+	void *minus[KERNEL_SOURCES], *ref_minus[KERNEL_SOURCES];
+
+	for (unsigned int j = 0; j < KERNEL_SOURCES; j++) {
+		for (unsigned int i = 0; i < KERNEL_SAMPLES; i++)
+			in[j][i] = random() % 65536 - 32768;
+		srcs[j] = in[j];
+		minus[j] = mm[j];
+		ref_minus[j] = ref_mm[j];
+	}
+	memcpy(orig, in, sizeof(in));
+
+	for (unsigned int num = 1; num <= KERNEL_SOURCES; num++) {
+		s16_mix_n_c(ref_mix, srcs, num, KERNEL_SAMPLES, ref_minus);
+
+		unsigned int done = fn(mix, srcs, num, KERNEL_SAMPLES, NULL);
+		assert(done <= KERNEL_SAMPLES);
+		assert(done >= KERNEL_SAMPLES - 16);
+		assert(memcmp(mix, ref_mix, done * sizeof(int16_t)) == 0);
+
+		memset(mm, 0, sizeof(mm));
+		done = fn(mix, srcs, num, KERNEL_SAMPLES, minus);
+		assert(memcmp(mix, ref_mix, done * sizeof(int16_t)) == 0);
+		for (unsigned int j = 0; j < num; j++)
+			assert(memcmp(mm[j], ref_mm[j], done * sizeof(int16_t)) == 0);
+
+		// in place, mix-minus outputs must be made from the original first source
+		memset(mm, 0, sizeof(mm));
+		done = fn(in[0], srcs, num, KERNEL_SAMPLES, minus);
+		assert(memcmp(in[0], ref_mix, done * sizeof(int16_t)) == 0);
+		for (unsigned int j = 0; j < num; j++)
+			assert(memcmp(mm[j], ref_mm[j], done * sizeof(int16_t)) == 0);
+		memcpy(in, orig, sizeof(in));
+	}
+}
+
+
 int main(void) {
 	struct mix_buffer mb;
 
@@ -507,5 +558,149 @@ int main(void) {
 
 	mix_buffer_destroy(&mb);
 
+
+
+	// three sources, saturated only once
+
+	memset(&mb, 0, sizeof(mb));
+	ret = mix_buffer_init(&mb, AV_SAMPLE_FMT_S16, 500, 1, 100, 0);
+	assert(ret == true);
+
+	ret = mix_buffer_write(&mb, 0x1234, (int16_t[]){30000,30000,30000,30000,30000,30000,30000,30000,30000,30000}, 10);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x6543, (int16_t[]){30000,30000,30000,30000,30000,30000,30000,30000,30000,30000}, 10);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x3333, (int16_t[]){-30000,-30000,-30000,-30000,-30000,-1,-2,-3,-4,-5}, 10);
+	assert(ret == true);
+
+	p = mix_buffer_read_fast(&mb, 10, &size);
+	assert(p != NULL);
+	assert(size == 20);
+	assert(memcmp(p, (int16_t[]){30000,30000,30000,30000,30000,32767,32767,32767,32767,32767}, size) == 0);
+	// read-pos = 10, write-pos = 10
+
+	// overlapping partial mix-ins across boundary, read out in pieces
+
+	p = mix_buffer_read_fast(&mb, 35, &size);
+	assert(p != NULL);
+	// read-pos = 45, write-pos = 45
+	ret = mix_buffer_write(&mb, 0x1234, (int16_t[]){10,10,10,10,10,10,10,10,10,10,10,10,10,10,10}, 15);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x6543, (int16_t[]){20,20,20,20,20,20,20,20,20,20}, 10);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x3333, (int16_t[]){1,2,3,4,5}, 5);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x3333, (int16_t[]){6,7,8,9,10,11,12,13,14,15}, 10);
+	assert(ret == true);
+	// read-pos = 45, write-pos = 10
+
+	p = mix_buffer_read_fast(&mb, 8, &size);
+	assert(p == NULL);
+	assert(size == 16);
+	mix_buffer_read_slow(&mb, buf, 8);
+	assert(memcmp(buf, (int16_t[]){31,32,33,34,35,36,37,38}, size) == 0);
+
+	p = mix_buffer_read_fast(&mb, 7, &size);
+	assert(p != NULL);
+	assert(size == 14);
+	assert(memcmp(p, (int16_t[]){39,40,21,22,23,24,25}, size) == 0);
+
+	mix_buffer_destroy(&mb);
+
+
+
+	// audio staged between a fast and a slow read around the boundary
+
+	memset(&mb, 0, sizeof(mb));
+	ret = mix_buffer_init(&mb, AV_SAMPLE_FMT_S16, 500, 1, 100, 0);
+	assert(ret == true);
+
+	p = mix_buffer_read_fast(&mb, 20, &size);
+	assert(p != NULL);
+	p = mix_buffer_read_fast(&mb, 25, &size);
+	assert(p != NULL);
+	// read-pos = 45, write-pos = 45
+
+	ret = mix_buffer_write(&mb, 0x1234, (int16_t[]){1,2,3,4,5,6,7,8,9,10}, 10);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x6543, (int16_t[]){0,0,0,0,0}, 5);
+	assert(ret == true);
+	// read-pos = 45, write-pos = 5, second source at 50/0
+
+	p = mix_buffer_read_fast(&mb, 10, &size);
+	assert(p == NULL);
+	assert(size == 20);
+	ret = mix_buffer_write(&mb, 0x6543, (int16_t[]){100,100,100,100,100}, 5);
+	assert(ret == true);
+	mix_buffer_read_slow(&mb, buf, 10);
+	assert(memcmp(buf, (int16_t[]){1,2,3,4,5,106,107,108,109,110}, size) == 0);
+	assert(mb.staged.length == 0);
+	// read-pos = 5, write-pos = 5
+
+	// second source isn't stuck behind the read position
+	ret = mix_buffer_write(&mb, 0x1234, (int16_t[]){1,1,1,1,1,1,1,1,1,1}, 10);
+	assert(ret == true);
+	ret = mix_buffer_write(&mb, 0x6543, (int16_t[]){2,2,2,2,2}, 5);
+	assert(ret == true);
+
+	p = mix_buffer_read_fast(&mb, 10, &size);
+	assert(p != NULL);
+	assert(size == 20);
+	assert(memcmp(p, (int16_t[]){3,3,3,3,3,1,1,1,1,1}, size) == 0);
+
+	mix_buffer_destroy(&mb);
+
+
+
+	// N-way mix with mix-minus outputs
+
+	int16_t in1[37], in2[37], in3[37], mix[37], mm1[37], mm2[37], mm3[37];
+	for (int i = 0; i < 37; i++) {
+		in1[i] = i * 900;
+		in2[i] = i * 800;
+		in3[i] = -i * 700;
+	}
+	mix_s16_n(mix, (const int16_t *[]){in1, in2, in3}, 3, 37, (int16_t *[]){mm1, mm2, mm3});
+	for (int i = 0; i < 37; i++) {
+		assert(mix[i] == CLAMP(i * 1000, -32768, 32767));
+		assert(mm1[i] == CLAMP(i * 100, -32768, 32767));
+		assert(mm2[i] == CLAMP(i * 200, -32768, 32767));
+		assert(mm3[i] == CLAMP(i * 1700, -32768, 32767));
+	}
+
+	// in place
+	int16_t in1_orig[37];
+	memcpy(in1_orig, in1, sizeof(in1));
+	mix_s16_n(in1, (const int16_t *[]){in1, in2, in3}, 3, 37, NULL);
+	assert(memcmp(in1, mix, sizeof(mix)) == 0);
+
+	// in place with mix-minus
+	int16_t mm1_ref[37], mm2_ref[37], mm3_ref[37];
+	memcpy(mm1_ref, mm1, sizeof(mm1));
+	memcpy(mm2_ref, mm2, sizeof(mm2));
+	memcpy(mm3_ref, mm3, sizeof(mm3));
+	memcpy(in1, in1_orig, sizeof(in1));
+	memset(mm1, 0, sizeof(mm1));
+	memset(mm2, 0, sizeof(mm2));
+	memset(mm3, 0, sizeof(mm3));
+	mix_s16_n(in1, (const int16_t *[]){in1, in2, in3}, 3, 37, (int16_t *[]){mm1, mm2, mm3});
+	assert(memcmp(in1, mix, sizeof(mix)) == 0);
+	assert(memcmp(mm1, mm1_ref, sizeof(mm1)) == 0);
+	assert(memcmp(mm2, mm2_ref, sizeof(mm2)) == 0);
+	assert(memcmp(mm3, mm3_ref, sizeof(mm3)) == 0);
+
+	// each kernel on its own, not just the one picked for this CPU
+	test_mix_n("scalar", s16_mix_n_c);
+#if defined(__x86_64__)
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2))
+		test_mix_n("SSE2", s16_mix_n_sse2);
+	else
+		printf("no SSE2 - skipping SSE2 kernel\n");
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2))
+		test_mix_n("AVX2", s16_mix_n_avx2);
+	else
+		printf("no AVX2 - skipping AVX2 kernel\n");
+#endif
+
 	return 0;
 }
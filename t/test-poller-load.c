@@ -0,0 +1,304 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "poller_load.h"
+#include "main.h"
+#include "call.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+
+#define NUM_POLLERS 3
+
+// only ever compared, never dereferenced
+static char poller_ids[NUM_POLLERS];
+#define P(i) ((struct poller *) &poller_ids[i])
+
+struct poller **rtpe_pollers = (struct poller *[]) { P(0), P(1), P(2) };
+unsigned int num_media_pollers = NUM_POLLERS;
+unsigned int rtpe_poller_rr_iter;
+
+
+// stands in for the call iterator: records what it was asked to do, and moves as many
+// calls as it's told to
+static unsigned int rebalance_runs;
+static struct poller_rebalance last_rb;
+static unsigned int calls_to_move;
+
+void call_poller_rebalance(struct poller_rebalance *rb) {
+	rebalance_runs++;
+	for (unsigned int i = 0; rb->from && i < calls_to_move; i++) {
+		poller_load_migrated(rb->from, rb->to);
+		rb->moved++;
+	}
+	last_rb = *rb;
+}
+
+
+static struct poller_load *load(unsigned int i) {
+	return &rtpe_poller_load[i];
+}
+
+static unsigned int calls(unsigned int i) {
+	return atomic_get_na(&load(i)->calls);
+}
+
+static void set_cpu(uint64_t a, uint64_t b, uint64_t c) {
+	atomic64_set(&load(0)->cpu_ppm, a);
+	atomic64_set(&load(1)->cpu_ppm, b);
+	atomic64_set(&load(2)->cpu_ppm, c);
+}
+
+static unsigned int assign(void) {
+	struct poller *p = poller_load_assign();
+	for (unsigned int i = 0; i < NUM_POLLERS; i++)
+		if (p == P(i))
+			return i;
+	abort();
+}
+
+static void reset(void) {
+	poller_load_free();
+	rtpe_poller_rr_iter = 0;
+	rebalance_runs = 0;
+	calls_to_move = 0;
+	ZERO(last_rb);
+	poller_load_init();
+	assert(rtpe_poller_load != NULL);
+}
+
+
+// nothing to balance with a single poller or a poller shared between threads
+static void test_disabled(void) {
+	printf("testing disabled load tracking\n");
+
+	rtpe_config.poller_per_thread = 0;
+	poller_load_init();
+	assert(rtpe_poller_load == NULL);
+	assert(!poller_load_can_migrate());
+	assert(poller_load_updater() == TLA_BREAK);
+	// falls back to round-robin
+	assert(assign() == 0);
+	assert(assign() == 1);
+	assert(assign() == 2);
+	assert(assign() == 0);
+	poller_load_release(P(0));
+
+	rtpe_config.poller_per_thread = 1;
+	num_media_pollers = 1;
+	poller_load_init();
+	assert(rtpe_poller_load == NULL);
+	num_media_pollers = NUM_POLLERS;
+}
+
+static void test_round_robin(void) {
+	printf("testing round-robin assignment\n");
+
+	rtpe_config.poller_assignment = PA_ROUND_ROBIN;
+	reset();
+	set_cpu(500000, 0, 0);
+
+	// load is ignored
+	for (unsigned int i = 0; i < 7; i++)
+		assert(assign() == i % NUM_POLLERS);
+	assert(calls(0) == 3);
+	assert(calls(1) == 2);
+	assert(calls(2) == 2);
+
+	poller_load_release(P(0));
+	poller_load_release(P(2));
+	assert(calls(0) == 2);
+	assert(calls(1) == 2);
+	assert(calls(2) == 1);
+
+	// not one of ours
+	poller_load_release(NULL);
+	poller_load_release((struct poller *) &rtpe_pollers);
+	assert(calls(0) + calls(1) + calls(2) == 5);
+}
+
+static void test_load(void) {
+	printf("testing load-based assignment\n");
+
+	rtpe_config.poller_assignment = PA_LOAD;
+	reset();
+
+	// equal load: ties go to the poller with fewer calls, then the one with fewer packets
+	assert(assign() == 0);
+	assert(assign() == 1);
+	assert(assign() == 2);
+	atomic_set_na(&load(0)->new_calls, 0);
+	atomic_set_na(&load(1)->new_calls, 0);
+	atomic_set_na(&load(2)->new_calls, 0);
+	atomic64_set(&load(0)->pps, 100);
+	atomic64_set(&load(1)->pps, 50);
+	atomic64_set(&load(2)->pps, 100);
+	assert(assign() == 1);
+	assert(calls(1) == 2);
+
+	// the busy poller is left alone, and new calls spread over the others even though
+	// the CPU usage hasn't been updated yet
+	reset();
+	set_cpu(50000, 0, 0);
+	for (unsigned int i = 0; i < 10; i++)
+		assert(assign() == 1 + i % 2);
+	assert(calls(0) == 0);
+	assert(calls(1) == 5);
+	assert(calls(2) == 5);
+
+	// once the new calls have shown up in the CPU usage, all three are equally busy, and
+	// the one without calls wins
+	atomic_set_na(&load(1)->new_calls, 0);
+	atomic_set_na(&load(2)->new_calls, 0);
+	set_cpu(50000, 50000, 50000);
+	assert(assign() == 0);
+	// its new call now counts at the average cost of 150000/11
+	assert(assign() == 1);
+	assert(calls(0) == 1);
+	assert(calls(1) == 6);
+}
+
+// packet rates are derived from the counters, and the calls since the last update are reset
+static void test_updater(void) {
+	printf("testing load updater\n");
+
+	rtpe_config.poller_assignment = PA_LOAD;
+	rtpe_config.poller_rebalance_interval = 0;
+	reset();
+
+	assert(poller_load_updater() == TLA_CONTINUE);
+
+	assign();
+	assign();
+	assert(atomic_get_na(&load(0)->new_calls) + atomic_get_na(&load(1)->new_calls) == 2);
+
+	poller_thread_load = load(2);
+	poller_load_packets(300);
+	poller_load_packets(700);
+	poller_thread_load = NULL;
+	poller_load_packets(1); // not a poller thread
+	assert(atomic64_get(&load(2)->packets) == 1000);
+
+	usleep(100000);
+	assert(poller_load_updater() == TLA_CONTINUE);
+
+	// 1000 packets in a bit over 100 ms
+	uint64_t pps = atomic64_get(&load(2)->pps);
+	assert(pps > 2000 && pps <= 10000);
+	assert(atomic64_get(&load(0)->pps) == 0);
+	assert(atomic64_get(&load(1)->pps) == 0);
+	for (unsigned int i = 0; i < NUM_POLLERS; i++)
+		assert(atomic_get_na(&load(i)->new_calls) == 0);
+	// assigned calls are kept
+	assert(calls(0) + calls(1) == 2);
+	// no rebalancing configured
+	assert(rebalance_runs == 0);
+}
+
+static void update(void) {
+	// keeps the busiest poller's packet rate non-zero
+	atomic64_add(&load(0)->packets, 100);
+	usleep(1000);
+	assert(poller_load_updater() == TLA_CONTINUE);
+}
+
+static void test_migrate(void) {
+	printf("testing call migration\n");
+
+	rtpe_config.poller_assignment = PA_ROUND_ROBIN;
+	rtpe_config.poller_rebalance_interval = 2;
+	rtpe_config.common.io_uring = 0;
+	reset();
+	assert(poller_load_can_migrate());
+
+	for (unsigned int i = 0; i < 6; i++)
+		assign();
+	set_cpu(400000, 100000, 200000);
+
+	// every other update
+	update();
+	assert(rebalance_runs == 0);
+	calls_to_move = 1;
+	update();
+	assert(rebalance_runs == 1);
+
+	// half the spread is moved from the busiest to the idlest poller
+	assert(last_rb.from == P(0));
+	assert(last_rb.to == P(1));
+	assert(last_rb.budget_ppm == 150000);
+	assert(last_rb.from_ppm == 400000);
+	assert(last_rb.from_pps == atomic64_get(&load(0)->pps));
+	assert(last_rb.from_pps > 0);
+	assert(last_rb.interval == 2);
+	assert(last_rb.moved == 1);
+
+	assert(calls(0) == 1);
+	assert(calls(1) == 3);
+	assert(calls(2) == 2);
+	assert(atomic64_get(&load(0)->migrations) == 1);
+	assert(atomic64_get(&load(1)->migrations) == 0);
+
+	// below the threshold, the calls are still walked to sample their rates
+	set_cpu(240000, 100000, 200000);
+	update();
+	update();
+	assert(rebalance_runs == 2);
+	assert(last_rb.from == NULL);
+	assert(last_rb.moved == 0);
+	assert(last_rb.interval == 2);
+	assert(calls(0) == 1);
+
+	// no packets on the busiest poller: nothing to base the cost of a call on
+	set_cpu(400000, 100000, 200000);
+	update();
+	assert(poller_load_updater() == TLA_CONTINUE);
+	assert(atomic64_get(&load(0)->pps) == 0);
+	assert(rebalance_runs == 3);
+	assert(last_rb.from == NULL);
+
+	// pollers that aren't ours are ignored
+	poller_load_migrated(P(0), NULL);
+	poller_load_migrated(NULL, P(0));
+	assert(calls(0) == 1);
+	assert(atomic64_get(&load(0)->migrations) == 1);
+
+	// no migration with io_uring
+	rtpe_config.common.io_uring = 1;
+	assert(!poller_load_can_migrate());
+	update();
+	update();
+	update();
+	assert(rebalance_runs == 3);
+	rtpe_config.common.io_uring = 0;
+
+	// or without an interval
+	rtpe_config.poller_rebalance_interval = 0;
+	update();
+	update();
+	assert(rebalance_runs == 3);
+}
+
+
+int main(void) {
+	test_disabled();
+
+	rtpe_config.poller_per_thread = 1;
+
+	test_round_robin();
+	test_load();
+	test_updater();
+	test_migrate();
+
+	poller_load_free();
+	assert(rtpe_poller_load == NULL);
+
+	printf("all tests passed\n");
+	return 0;
+}
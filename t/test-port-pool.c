@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "port_pool.h"
+#include "main.h"
+#include "ssllib.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+
+static void test_singles(unsigned int min, unsigned int max) {
+	struct port_pool pp;
+	unsigned int size = max - min + 1;
+	bool seen[65536] = {0};
+	unsigned int sequential = 0, last = 0;
+
+	assert(port_pool_init(&pp, min, max) == true);
+	assert(port_pool_size(&pp) == size);
+	assert(port_pool_free_count(&pp) == size);
+
+	for (unsigned int i = 0; i < size; i++) {
+		unsigned int port = port_pool_get(&pp, 1, NULL);
+		assert(port >= min && port <= max);
+		assert(!seen[port]);
+		seen[port] = true;
+		if (port == last + 1)
+			sequential++;
+		last = port;
+	}
+	assert(port_pool_free_count(&pp) == 0);
+	assert(port_pool_get(&pp, 1, NULL) == 0);
+	// randomised order
+	if (size > 10)
+		assert(sequential < size / 2);
+
+	// released port isn't handed out again straight away
+	port_pool_release(&pp, min);
+	port_pool_release(&pp, min); // double release is ignored
+	assert(port_pool_free_count(&pp) == 1);
+	assert(port_pool_get(&pp, 1, NULL) == min);
+	if (size > 1) {
+		port_pool_release(&pp, min);
+		port_pool_release(&pp, max);
+		unsigned int a = port_pool_get(&pp, 1, NULL);
+		unsigned int b = port_pool_get(&pp, 1, NULL);
+		assert(a != b);
+		assert(a == min || a == max);
+		assert(b == min || b == max);
+	}
+
+	for (unsigned int port = min; port <= max; port++)
+		port_pool_release(&pp, port);
+	assert(port_pool_free_count(&pp) == size);
+
+	port_pool_cleanup(&pp);
+}
+
+static void test_pairs(unsigned int min, unsigned int max, unsigned int exp_pairs) {
+	struct port_pool pp;
+	bool seen[65536] = {0};
+
+	assert(port_pool_init(&pp, min, max) == true);
+
+	for (unsigned int i = 0; i < exp_pairs; i++) {
+		unsigned int port = port_pool_get(&pp, 2, NULL);
+		assert(port != 0);
+		assert((port & 1) == 0);
+		assert(port >= min && port + 1 <= max);
+		assert(!seen[port] && !seen[port + 1]);
+		seen[port] = seen[port + 1] = true;
+	}
+	assert(port_pool_get(&pp, 2, NULL) == 0);
+	assert(port_pool_free_count(&pp) == max - min + 1 - exp_pairs * 2);
+
+	port_pool_cleanup(&pp);
+}
+
+static void test_reserve(void) {
+	struct port_pool pp;
+
+	assert(port_pool_init(&pp, 40000, 40009) == true);
+	assert(port_pool_reserve(&pp, 40004) == true);
+	assert(port_pool_reserve(&pp, 40004) == false);
+	assert(port_pool_reserve(&pp, 39999) == false);
+	assert(port_pool_reserve(&pp, 40010) == false);
+	assert(port_pool_free_count(&pp) == 9);
+
+	// the pair 40004/40005 is now unavailable
+	for (unsigned int i = 0; i < 4; i++) {
+		unsigned int port = port_pool_get(&pp, 2, NULL);
+		assert(port != 0 && port != 40004);
+	}
+	assert(port_pool_get(&pp, 2, NULL) == 0);
+	assert(port_pool_get(&pp, 1, NULL) == 40005);
+	assert(port_pool_get(&pp, 1, NULL) == 0);
+
+	port_pool_release(&pp, 40004);
+	assert(port_pool_reserve(&pp, 40004) == true);
+
+	port_pool_cleanup(&pp);
+
+	assert(port_pool_init(&pp, 40010, 40000) == false);
+	assert(port_pool_get(&pp, 1, NULL) == 0);
+	assert(port_pool_reserve(&pp, 40005) == false);
+	port_pool_cleanup(&pp);
+}
+
+
+// concurrent allocate/release
+
+#define STRESS_THREADS 8
+#define STRESS_ITERS 200000
+#define STRESS_HELD 64
+
+static struct port_pool stress_pool;
+static unsigned int owners[65536];
+static unsigned int total_contention;
+
+static void *stress_thread(void *p) {
+	unsigned int id = GPOINTER_TO_UINT(p);
+	unsigned int held[STRESS_HELD][2] = {{0}};
+	unsigned int contention = 0;
+	unsigned int seed = id;
+
+	for (unsigned int i = 0; i < STRESS_ITERS; i++) {
+		unsigned int slot = rand_r(&seed) % STRESS_HELD;
+
+		if (held[slot][0]) {
+			for (unsigned int j = 0; j < held[slot][1]; j++) {
+				unsigned int port = held[slot][0] + j;
+				assert(__atomic_exchange_n(&owners[port], 0, __ATOMIC_SEQ_CST) == id);
+				port_pool_release(&stress_pool, port);
+			}
+			held[slot][0] = 0;
+			continue;
+		}
+
+		unsigned int num = (rand_r(&seed) & 1) + 1;
+		unsigned int port = port_pool_get(&stress_pool, num, &contention);
+		if (!port)
+			continue;
+		if (num > 1)
+			assert((port & 1) == 0);
+		for (unsigned int j = 0; j < num; j++) {
+			unsigned int exp = 0;
+			assert(__atomic_compare_exchange_n(&owners[port + j], &exp, id, false,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+		}
+		held[slot][0] = port;
+		held[slot][1] = num;
+	}
+
+	for (unsigned int slot = 0; slot < STRESS_HELD; slot++) {
+		for (unsigned int j = 0; held[slot][0] && j < held[slot][1]; j++) {
+			unsigned int port = held[slot][0] + j;
+			assert(__atomic_exchange_n(&owners[port], 0, __ATOMIC_SEQ_CST) == id);
+			port_pool_release(&stress_pool, port);
+		}
+	}
+
+	__atomic_fetch_add(&total_contention, contention, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static void test_stress(unsigned int min, unsigned int max) {
+	GThread *threads[STRESS_THREADS];
+
+	memset(owners, 0, sizeof(owners));
+	total_contention = 0;
+	assert(port_pool_init(&stress_pool, min, max) == true);
+
+	for (unsigned int i = 0; i < STRESS_THREADS; i++)
+		threads[i] = g_thread_new("stress", stress_thread, GUINT_TO_POINTER(i + 1));
+	for (unsigned int i = 0; i < STRESS_THREADS; i++)
+		g_thread_join(threads[i]);
+
+	unsigned int size = max - min + 1;
+	assert(port_pool_free_count(&stress_pool) == size);
+	// every port must be obtainable exactly once
+	for (unsigned int i = 0; i < size; i++)
+		assert(port_pool_get(&stress_pool, 1, NULL) != 0);
+	assert(port_pool_get(&stress_pool, 1, NULL) == 0);
+
+	printf("stress test %u-%u: %u contended updates\n", min, max, total_contention);
+	port_pool_cleanup(&stress_pool);
+}
+
+
+int main(void) {
+	rtpe_ssl_init();
+
+	test_singles(30000, 30099);
+	test_singles(30001, 30001);
+	test_singles(1024, 65535);
+	test_pairs(30000, 30099, 50);
+	test_pairs(30001, 30100, 49);
+	test_pairs(30000, 30000, 0);
+	test_reserve();
+	// tight pool, lots of failed allocations
+	test_stress(20000, 20255);
+	// pool that never runs dry
+	test_stress(20001, 59999);
+
+	printf("all tests done\n");
+	return 0;
+}
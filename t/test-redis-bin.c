@@ -0,0 +1,309 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "redis_bin.h"
+#include "bencode.h"
+
+
+// call as stored by the first test in auto-daemon-tests-redis.pl
+static const char fixture[] =
+	"d"
+	"17:associated_tags-0l1:1e"
+	"17:associated_tags-1l1:0e"
+	"4:jsond10:block_dtmf1:010:call_flagsi65536e7:created10:172838451212:created_from0:17:created_from_addr0:7:deleted1:09:destroyed1:011:last_signal10:172838451210:ml_deleted1:08:num_maps1:210:num_medias1:28:num_sfds1:411:num_streams1:48:num_tags1:218:recording_metadata0:15:redis_hosted_db1:23:tos1:0e"
+	"5:map-0d8:endpoint17:198.51.100.1:300021:intf_preferred_family3:IP412:logical_intf3:foo9:num_ports1:28:wildcard1:0e"
+	"5:map-1d8:endpoint0:21:intf_preferred_family3:IP412:logical_intf3:foo9:num_ports1:28:wildcard1:1e"
+	"10:map_sfds-0l5:loc-01:01:1e"
+	"10:map_sfds-1l5:loc-01:21:3e"
+	"6:maps-0l1:0e"
+	"6:maps-1l1:1e"
+	"7:media-0d14:desired_family3:IP410:format_str3:0 85:index1:112:logical_intf3:foo11:media_flags7:22282368:protocol7:RTP/AVP5:ptime1:03:tag1:14:type5:audioe"
+	"7:media-1d14:desired_family3:IP410:format_str3:0 85:index1:112:logical_intf3:foo11:media_flags5:655488:protocol7:RTP/AVP5:ptime1:03:tag1:04:type5:audioe"
+	"8:medias-0l1:1e"
+	"8:medias-1l1:0e"
+	"15:payload_types-0l18:0/PCMU/8000///0/2018:8/PCMA/8000///0/20e"
+	"15:payload_types-1l18:0/PCMU/8000///0/2018:8/PCMA/8000///0/20e"
+	"12:rtcp_sinks-0le"
+	"12:rtcp_sinks-1l1:3e"
+	"12:rtcp_sinks-2le"
+	"12:rtcp_sinks-3l1:1e"
+	"11:rtp_sinks-0l1:2e"
+	"11:rtp_sinks-1le"
+	"11:rtp_sinks-2l1:0e"
+	"11:rtp_sinks-3le"
+	"5:sfd-0d2:fd10:172838451314:local_intf_uid1:09:localport10:172838451412:logical_intf3:foo11:pref_family3:IP46:stream1:0e"
+	"5:sfd-1d2:fd5:3000014:local_intf_uid1:09:localport2:3712:logical_intf3:foo11:pref_family3:IP46:stream1:1e"
+	"5:sfd-2d2:fd5:3000114:local_intf_uid1:09:localport2:3812:logical_intf3:foo11:pref_family3:IP46:stream1:2e"
+	"5:sfd-3d2:fd5:3000214:local_intf_uid1:09:localport2:3912:logical_intf3:foo11:pref_family3:IP46:stream1:3e"
+	"12:ssrc_table-0le"
+	"12:ssrc_table-1le"
+	"8:stream-0d19:advertised_endpoint0:9:component1:18:endpoint0:11:last_packet5:300035:media1:08:ps_flags5:6553612:rtcp_sibling1:13:sfd1:011:stats-bytes1:012:stats-errors1:013:stats-packets1:0e"
+	"8:stream-1d19:advertised_endpoint0:9:component1:28:endpoint0:11:last_packet2:405:media1:08:ps_flags6:13107212:rtcp_sibling10:42949672953:sfd1:111:stats-bytes1:012:stats-errors1:013:stats-packets1:0e"
+	"8:stream-2d19:advertised_endpoint17:198.51.100.1:30009:component1:18:endpoint17:198.51.100.1:300011:last_packet10:17283845135:media1:18:ps_flags8:6822297612:rtcp_sibling1:33:sfd1:211:stats-bytes1:012:stats-errors1:013:stats-packets1:0e"
+	"8:stream-3d19:advertised_endpoint17:198.51.100.1:30019:component1:28:endpoint17:198.51.100.1:300111:last_packet10:17283845135:media1:18:ps_flags8:6828851312:rtcp_sibling10:42949672953:sfd1:311:stats-bytes1:012:stats-errors1:013:stats-packets1:0e"
+	"13:stream_sfds-0l1:0e"
+	"13:stream_sfds-1l1:1e"
+	"13:stream_sfds-2l1:2e"
+	"13:stream_sfds-3l1:3e"
+	"9:streams-0l1:01:1e"
+	"9:streams-1l1:21:3e"
+	"21:media-subscriptions-0l7:1/1/0/0e"
+	"21:media-subscriptions-1l7:0/1/0/0e"
+	"5:tag-0d10:block_dtmf1:07:created10:172838451314:desired_family3:IP47:deleted1:012:logical_intf3:foo8:ml_flagsi0e3:tag16:ZbJE0P8xJN3dd3aKe"
+	"5:tag-1d10:block_dtmf1:07:created10:172838451314:desired_family3:IP47:deleted1:012:logical_intf3:foo8:ml_flagsi0ee"
+	"e";
+
+
+static str roundtrip(const char *doc, size_t len) {
+	bencode_buffer_t buf, buf2;
+	str in = STR_LEN(doc, len);
+
+	assert(bencode_buffer_init(&buf) == 0);
+	bencode_item_t *root = bencode_decode_expect_str(&buf, &in, BENCODE_DICTIONARY);
+	assert(root != NULL);
+
+	str enc = redis_bin_encode(root);
+	assert(redis_bin_is(&enc));
+
+	assert(bencode_buffer_init(&buf2) == 0);
+	bencode_item_t *dec = redis_bin_decode(&buf2, &enc);
+	assert(dec != NULL);
+	assert(dec->type == BENCODE_DICTIONARY);
+	str out = bencode_collapse_str(dec);
+	assert(out.len == len);
+	assert(memcmp(out.s, doc, len) == 0);
+
+	// dictionary lookups work on the decoded tree
+	bencode_item_t *first = root->child;
+	assert(bencode_dictionary_get_len(dec, first->iov[1].iov_base, first->iov[1].iov_len) != NULL);
+
+	bencode_buffer_free(&buf2);
+	bencode_buffer_free(&buf);
+	return enc;
+}
+
+static void test_fixture(void) {
+	size_t len = sizeof(fixture) - 1;
+	str enc = roundtrip(fixture, len);
+	printf("fixture: %zu bytes as bencode, %zu bytes as binary\n", len, enc.len);
+	assert(enc.len < len / 2);
+	g_free(enc.s);
+}
+
+static void test_values(void) {
+	static const char doc[] =
+		"d"
+		"4:jsond"
+			"7:created3:007"	// leading zero
+			"7:deleted2:-0"
+			"9:destroyed0:"
+			"3:tos3:-12"
+			"11:last_signal20:18446744073709551615"
+			"8:num_tags20:18446744073709551616"	// overflows
+			"10:call_flagsi-9223372036854775808e"
+			"8:num_mapsi9223372036854775807e"
+			"8:num_sfdsi0e"
+			"11:num_streams2:+1"
+			"10:num_medias2:1 "
+		"e"
+		"5:sfd-0d"
+			"11:sdes_in_tag1:1"
+			"18:sdes_in-master_key16:\0\1\2\3\4\5\6\7\x08\x09\x0a\x0b\x0c\x0d\x0e\xff"
+			"19:sdes_in-master_salt14:\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+			"19:sdes_out-master_key16:\0\1\2\3\4\5\6\7\x08\x09\x0a\x0b\x0c\x0d\x0e\xff"
+			"7:unknownl3:foo3:foo3:foo1:x1:xe"
+		"e"
+		"10:stream-007d8:endpoint17:198.51.100.1:3000e"	// not a canonical number
+		"7:stream-d8:endpoint17:198.51.100.1:3000e"
+		"14:rtp_sinks-1234le"
+		"10:foo-bar-42d0:0:e"
+		"e";
+
+	str enc = roundtrip(doc, sizeof(doc) - 1);
+	g_free(enc.s);
+}
+
+static void test_invalid(void) {
+	bencode_buffer_t buf;
+	str in = STR_LEN(fixture, sizeof(fixture) - 1);
+
+	assert(bencode_buffer_init(&buf) == 0);
+	bencode_item_t *root = bencode_decode_expect_str(&buf, &in, BENCODE_DICTIONARY);
+	assert(root != NULL);
+	str enc = redis_bin_encode(root);
+	bencode_buffer_free(&buf);
+
+	// every truncation fails cleanly
+	for (size_t len = 0; len < enc.len; len++) {
+		str s = STR_LEN(enc.s, len);
+		assert(bencode_buffer_init(&buf) == 0);
+		assert(redis_bin_decode(&buf, &s) == NULL);
+		bencode_buffer_free(&buf);
+	}
+
+	// trailing garbage
+	char *longer = g_malloc(enc.len + 1);
+	memcpy(longer, enc.s, enc.len);
+	longer[enc.len] = 0;
+	str s = STR_LEN(longer, enc.len + 1);
+	assert(bencode_buffer_init(&buf) == 0);
+	assert(redis_bin_decode(&buf, &s) == NULL);
+	bencode_buffer_free(&buf);
+
+	// unknown version
+	memcpy(longer, enc.s, enc.len);
+	longer[2]++;
+	s = STR_LEN(longer, enc.len);
+	assert(bencode_buffer_init(&buf) == 0);
+	assert(redis_bin_decode(&buf, &s) == NULL);
+	bencode_buffer_free(&buf);
+
+	// corrupted data must not crash
+	for (size_t i = REDIS_BIN_HDR_LEN; i < enc.len; i++) {
+		memcpy(longer, enc.s, enc.len);
+		longer[i] ^= 0x5a;
+		assert(bencode_buffer_init(&buf) == 0);
+		redis_bin_decode(&buf, &s);
+		bencode_buffer_free(&buf);
+	}
+
+	// inline keys longer than bencode allows are rejected, not passed on
+	for (size_t key_len = 99999; key_len <= 100001; key_len++) {
+		assert(bencode_buffer_init(&buf) == 0);
+		str val = redis_bin_encode_entry(bencode_string(&buf, "value"));
+		bencode_buffer_free(&buf);
+
+		char *key_s = g_malloc(key_len);
+		memset(key_s, 'x', key_len);
+		str key = STR_LEN(key_s, key_len);
+		GString *doc = g_string_new("");
+		redis_bin_dict_start(doc, 1);
+		assert(redis_bin_dict_add(doc, &key, &val));
+
+		s = STR_LEN(doc->str, doc->len);
+		assert(bencode_buffer_init(&buf) == 0);
+		bencode_item_t *dec = redis_bin_decode(&buf, &s);
+		if (key_len == 99999) {
+			assert(dec != NULL);
+			assert(bencode_dictionary_get_len(dec, key_s, key_len) != NULL);
+		}
+		else
+			assert(dec == NULL);
+		bencode_buffer_free(&buf);
+
+		g_string_free(doc, TRUE);
+		g_free(key_s);
+		g_free(val.s);
+	}
+
+	s = STR("not binary");
+	assert(!redis_bin_is(&s));
+	assert(bencode_buffer_init(&buf) == 0);
+	assert(redis_bin_decode(&buf, &s) == NULL);
+	bencode_buffer_free(&buf);
+
+	g_free(longer);
+	g_free(enc.s);
+}
+
+// top-level entries encoded separately (as done for delta updates) reassemble into the
+// same document as a complete encoding
+static void test_entries(void) {
+	bencode_buffer_t buf;
+	str in = STR_LEN(fixture, sizeof(fixture) - 1);
+
+	assert(bencode_buffer_init(&buf) == 0);
+	bencode_item_t *root = bencode_decode_expect_str(&buf, &in, BENCODE_DICTIONARY);
+	assert(root != NULL);
+	str full = redis_bin_encode(root);
+
+	unsigned int num = 0;
+	for (bencode_item_t *k = root->child; k; k = k->sibling->sibling)
+		num++;
+
+	GString *doc = g_string_new("");
+	redis_bin_dict_start(doc, num);
+	for (bencode_item_t *k = root->child; k; k = k->sibling->sibling) {
+		str key = STR_LEN(k->iov[1].iov_base, k->iov[1].iov_len);
+		str val = redis_bin_encode_entry(k->sibling);
+		assert(redis_bin_dict_add(doc, &key, &val));
+		g_free(val.s);
+	}
+	assert(doc->len == full.len);
+	assert(memcmp(doc->str, full.s, full.len) == 0);
+
+	str bad = STR("d1:ae");
+	str key = STR("json");
+	assert(!redis_bin_dict_add(doc, &key, &bad));
+
+	g_string_free(doc, TRUE);
+	g_free(full.s);
+	bencode_buffer_free(&buf);
+}
+
+static void assemble_check(const str *fields, unsigned int num, const char *exp, size_t exp_len) {
+	str doc = redis_fields_assemble(fields, num);
+	assert(doc.len == exp_len);
+	assert(memcmp(doc.s, exp, exp_len) == 0);
+	g_free(doc.s);
+}
+
+// call documents stored as a hash (delta updates) are reassembled from their fields in any
+// of the formats
+static void test_assemble(void) {
+	bencode_buffer_t buf;
+	str in = STR_LEN(fixture, sizeof(fixture) - 1);
+
+	assert(bencode_buffer_init(&buf) == 0);
+	bencode_item_t *root = bencode_decode_expect_str(&buf, &in, BENCODE_DICTIONARY);
+	assert(root != NULL);
+
+	unsigned int num = 0;
+	for (bencode_item_t *k = root->child; k; k = k->sibling->sibling)
+		num++;
+
+	str fields[num * 2], bin_fields[num * 2];
+	unsigned int i = 0;
+	for (bencode_item_t *k = root->child; k; k = k->sibling->sibling, i++) {
+		fields[i * 2] = bin_fields[i * 2] = STR_LEN(k->iov[1].iov_base, k->iov[1].iov_len);
+		fields[i * 2 + 1] = bencode_collapse_str(k->sibling);
+		bin_fields[i * 2 + 1] = redis_bin_encode_entry(k->sibling);
+	}
+
+	assemble_check(fields, num, fixture, sizeof(fixture) - 1);
+
+	str full = redis_bin_encode(root);
+	assemble_check(bin_fields, num, full.s, full.len);
+	g_free(full.s);
+
+	// mixed formats
+	str bin_val = bin_fields[3];
+	bin_fields[3] = fields[3];
+	assert(redis_fields_assemble(bin_fields, num).s == NULL);
+	bin_fields[3] = bin_val;
+
+	for (i = 0; i < num; i++)
+		g_free(bin_fields[i * 2 + 1].s);
+	bencode_buffer_free(&buf);
+
+	static const char json[] = "{\"json\":{\"created\":\"1\"},\"tag-0\":{\"tag\":\"a\"}}";
+	str json_fields[] = {
+		STR_CONST("json"), STR_CONST("{\"created\":\"1\"}"),
+		STR_CONST("tag-0"), STR_CONST("{\"tag\":\"a\"}"),
+	};
+	assemble_check(json_fields, 2, json, sizeof(json) - 1);
+
+	assert(redis_fields_assemble(NULL, 0).s == NULL);
+}
+
+int main(void) {
+	test_fixture();
+	test_values();
+	test_invalid();
+	test_entries();
+	test_assemble();
+
+	printf("all tests passed\n");
+	return 0;
+}
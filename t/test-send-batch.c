@@ -0,0 +1,370 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/udp.h>
+
+#include "socket.h"
+#include "uring.h"
+#include "poller.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+
+// every sendmsg() and sendmmsg() made by the batching code is recorded here, and then
+// passed on to the kernel
+
+struct send_call {
+	int fd;
+	bool mmsg;
+	unsigned int num; // iovecs for sendmsg, messages for sendmmsg
+	unsigned int seg; // GSO segment size, or zero
+};
+
+static struct send_call calls[MAX_SOCKET_BATCH * 2];
+static unsigned int num_calls;
+static bool fail_gso;
+
+ssize_t sendmsg(int fd, const struct msghdr *m, int flags) {
+	unsigned int seg = 0;
+	for (struct cmsghdr *cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR((struct msghdr *) m, cm)) {
+		if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_SEGMENT) {
+			uint16_t s;
+			memcpy(&s, CMSG_DATA(cm), sizeof(s));
+			seg = s;
+		}
+	}
+
+	assert(num_calls < G_N_ELEMENTS(calls));
+	calls[num_calls++] = (struct send_call) { .fd = fd, .num = m->msg_iovlen, .seg = seg };
+
+	if (seg && fail_gso) {
+		errno = EIO;
+		return -1;
+	}
+	return syscall(SYS_sendmsg, fd, m, flags);
+}
+
+int sendmmsg(int fd, struct mmsghdr *v, unsigned int vlen, int flags) {
+	assert(num_calls < G_N_ELEMENTS(calls));
+	calls[num_calls++] = (struct send_call) { .fd = fd, .mmsg = true, .num = vlen };
+	return syscall(SYS_sendmmsg, fd, v, vlen, flags);
+}
+
+
+struct pkt {
+	struct uring_req req; // must be first
+	struct msghdr mh;
+	struct iovec iov[2];
+	struct sockaddr_storage ss;
+	char buf[1500];
+	bool done;
+	int res;
+};
+
+static struct pkt pkts[MAX_SOCKET_BATCH];
+static socket_t tx1, tx2, rx_a, rx_b;
+
+
+static void open_lo(socket_t *s) {
+	sockaddr_t lo;
+	assert(sockaddr_parse_any(&lo, "127.0.0.1") == 0);
+	assert(open_socket(s, SOCK_DGRAM, 0, &lo) == 0);
+
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof(sin);
+	assert(getsockname(s->fd, (struct sockaddr *) &sin, &sinlen) == 0);
+	s->local.port = ntohs(sin.sin_port);
+
+	int size = 1 << 20;
+	setsockopt(s->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+static void pkt_done(struct uring_req *r, int32_t res, uint32_t flags) {
+	struct pkt *p = (struct pkt *) r;
+	assert(!p->done);
+	p->done = true;
+	p->res = res;
+}
+
+static void reset(void) {
+	memset(pkts, 0, sizeof(pkts));
+	num_calls = 0;
+}
+
+// queues packet `i` of `len` bytes, all of them set to `i`. with `split`, the payload is
+// handed over in two iovecs, which can't be sent through GSO
+static void queue_split(unsigned int i, socket_t *tx, socket_t *dst, size_t len, bool split) {
+	struct pkt *p = &pkts[i];
+	memset(p->buf, i, len);
+	p->req.handler = pkt_done;
+	p->iov[0] = (struct iovec) { .iov_base = p->buf, .iov_len = split ? len / 2 : len };
+	p->iov[1] = (struct iovec) { .iov_base = p->buf + len / 2, .iov_len = len - len / 2 };
+	p->mh = (struct msghdr) { .msg_iov = p->iov, .msg_iovlen = split ? 2 : 1 };
+	assert(uring_sendmsg(tx, &p->mh, &dst->local, &p->ss, &p->req) == 0);
+	// nothing goes out before the flush
+	assert(!p->done);
+}
+static void queue(unsigned int i, socket_t *tx, socket_t *dst, size_t len) {
+	queue_split(i, tx, dst, len, false);
+}
+
+static void flush(unsigned int num_pkts) {
+	assert(num_calls == 0);
+	uring_thread_loop();
+	for (unsigned int i = 0; i < num_pkts; i++) {
+		assert(pkts[i].done);
+		assert(pkts[i].res > 0);
+	}
+	// nothing left over
+	unsigned int n = num_calls;
+	uring_thread_loop();
+	assert(num_calls == n);
+}
+
+static void check_call(unsigned int n, socket_t *tx, bool mmsg, unsigned int num, unsigned int seg) {
+	assert(n < num_calls);
+	assert(calls[n].fd == tx->fd);
+	assert(calls[n].mmsg == mmsg);
+	assert(calls[n].num == num);
+	assert(calls[n].seg == seg);
+}
+#define check_gso(n, tx, num, seg) check_call(n, tx, false, num, seg)
+#define check_mmsg(n, tx, num) check_call(n, tx, true, num, 0)
+#define check_single(n, tx) check_call(n, tx, false, 1, 0)
+
+// expects the given packets to arrive on `rx` in this order, and nothing else
+static void check_recv(socket_t *rx, unsigned int num, const unsigned int *idx) {
+	for (unsigned int n = 0; n < num; n++) {
+		struct pkt *p = &pkts[idx[n]];
+		size_t len = p->iov[0].iov_len + (p->mh.msg_iovlen == 2 ? p->iov[1].iov_len : 0);
+		char buf[2000];
+		ssize_t ret = recv(rx->fd, buf, sizeof(buf), MSG_DONTWAIT);
+		assert(ret == (ssize_t) len);
+		assert(memcmp(buf, p->buf, len) == 0);
+	}
+	char buf[2000];
+	assert(recv(rx->fd, buf, sizeof(buf), MSG_DONTWAIT) == -1);
+	assert(errno == EAGAIN || errno == EWOULDBLOCK);
+}
+#define RECV(rx, ...) check_recv(rx, G_N_ELEMENTS(((unsigned int []) {__VA_ARGS__})), \
+		(unsigned int []) {__VA_ARGS__})
+
+
+static void test_equal(void) {
+	printf("testing equal sizes\n");
+	reset();
+
+	for (unsigned int i = 0; i < 4; i++)
+		queue(i, &tx1, &rx_a, 100);
+	flush(4);
+
+	assert(num_calls == 1);
+	check_gso(0, &tx1, 4, 100);
+	RECV(&rx_a, 0, 1, 2, 3);
+}
+
+// a shorter packet ends a run and is included in it, a longer one starts a new one
+static void test_sizes(void) {
+	printf("testing mixed sizes\n");
+	reset();
+
+	queue(0, &tx1, &rx_a, 100);
+	queue(1, &tx1, &rx_a, 100);
+	queue(2, &tx1, &rx_a, 100);
+	queue(3, &tx1, &rx_a, 60);
+	flush(4);
+	assert(num_calls == 1);
+	check_gso(0, &tx1, 4, 100);
+	RECV(&rx_a, 0, 1, 2, 3);
+
+	reset();
+	queue(0, &tx1, &rx_a, 100);
+	queue(1, &tx1, &rx_a, 100);
+	queue(2, &tx1, &rx_a, 60);
+	queue(3, &tx1, &rx_a, 100);
+	flush(4);
+	assert(num_calls == 2);
+	check_gso(0, &tx1, 3, 100);
+	check_mmsg(1, &tx1, 1);
+	RECV(&rx_a, 0, 1, 2, 3);
+
+	reset();
+	queue(0, &tx1, &rx_a, 50);
+	queue(1, &tx1, &rx_a, 100);
+	queue(2, &tx1, &rx_a, 100);
+	queue(3, &tx1, &rx_a, 100);
+	queue(4, &tx1, &rx_a, 120);
+	flush(5);
+	assert(num_calls == 3);
+	check_mmsg(0, &tx1, 1);
+	check_gso(1, &tx1, 3, 100);
+	check_mmsg(2, &tx1, 1);
+	RECV(&rx_a, 0, 1, 2, 3, 4);
+}
+
+// a run only covers consecutive packets to the same destination
+static void test_dests(void) {
+	printf("testing mixed destinations\n");
+	reset();
+
+	queue(0, &tx1, &rx_a, 100);
+	queue(1, &tx1, &rx_a, 100);
+	queue(2, &tx1, &rx_b, 100);
+	queue(3, &tx1, &rx_b, 100);
+	queue(4, &tx1, &rx_a, 100);
+	flush(5);
+	assert(num_calls == 3);
+	check_gso(0, &tx1, 2, 100);
+	check_gso(1, &tx1, 2, 100);
+	check_mmsg(2, &tx1, 1);
+	RECV(&rx_a, 0, 1, 4);
+	RECV(&rx_b, 2, 3);
+
+	// alternating: no runs at all, everything in one sendmmsg
+	reset();
+	queue(0, &tx1, &rx_a, 100);
+	queue(1, &tx1, &rx_b, 100);
+	queue(2, &tx1, &rx_a, 100);
+	queue(3, &tx1, &rx_b, 100);
+	flush(4);
+	assert(num_calls == 1);
+	check_mmsg(0, &tx1, 4);
+	RECV(&rx_a, 0, 2);
+	RECV(&rx_b, 1, 3);
+}
+
+// packets are grouped per socket first, keeping their order within each socket
+static void test_sockets(void) {
+	printf("testing mixed sockets\n");
+	reset();
+
+	queue(0, &tx1, &rx_a, 100);
+	queue(1, &tx2, &rx_a, 100);
+	queue(2, &tx1, &rx_a, 100);
+	queue(3, &tx2, &rx_b, 100);
+	queue(4, &tx1, &rx_a, 100);
+	flush(5);
+	assert(num_calls == 2);
+	check_gso(0, &tx1, 3, 100);
+	check_mmsg(1, &tx2, 2);
+	RECV(&rx_a, 0, 2, 4, 1);
+	RECV(&rx_b, 3);
+}
+
+// multiple iovecs can't be segmented
+static void test_not_capable(void) {
+	printf("testing packets not suitable for GSO\n");
+	reset();
+
+	queue_split(0, &tx1, &rx_a, 100, true);
+	queue(1, &tx1, &rx_a, 100);
+	queue(2, &tx1, &rx_a, 100);
+	queue_split(3, &tx1, &rx_a, 100, true);
+	queue_split(4, &tx1, &rx_a, 100, true);
+	flush(5);
+	assert(num_calls == 3);
+	check_mmsg(0, &tx1, 1);
+	check_gso(1, &tx1, 2, 100);
+	check_mmsg(2, &tx1, 2);
+	RECV(&rx_a, 0, 1, 2, 3, 4);
+}
+
+// a full batch goes out right away, and a run is capped in size
+static void test_full(void) {
+	printf("testing full batch\n");
+	reset();
+
+	for (unsigned int i = 0; i < MAX_SOCKET_BATCH - 1; i++)
+		queue(i, &tx1, &rx_a, 1200);
+	assert(num_calls == 0);
+
+	struct pkt *p = &pkts[MAX_SOCKET_BATCH - 1];
+	memset(p->buf, MAX_SOCKET_BATCH - 1, 1200);
+	p->req.handler = pkt_done;
+	p->iov[0] = (struct iovec) { .iov_base = p->buf, .iov_len = 1200 };
+	p->mh = (struct msghdr) { .msg_iov = p->iov, .msg_iovlen = 1 };
+	uring_sendmsg(&tx1, &p->mh, &rx_a.local, &p->ss, &p->req);
+
+	// 54 * 1200 is the most that fits into 65000 bytes
+	assert(num_calls == 2);
+	check_gso(0, &tx1, 54, 1200);
+	check_gso(1, &tx1, MAX_SOCKET_BATCH - 54, 1200);
+	for (unsigned int i = 0; i < MAX_SOCKET_BATCH; i++)
+		assert(pkts[i].done && pkts[i].res > 0);
+	num_calls = 0;
+	flush(MAX_SOCKET_BATCH);
+	assert(num_calls == 0);
+
+	unsigned int idx[MAX_SOCKET_BATCH];
+	for (unsigned int i = 0; i < MAX_SOCKET_BATCH; i++)
+		idx[i] = i;
+	check_recv(&rx_a, MAX_SOCKET_BATCH, idx);
+}
+
+// GSO rejected: the packets of the run are sent individually, and GSO is not tried again
+static void test_fallback(void) {
+	printf("testing GSO fallback\n");
+	reset();
+	fail_gso = true;
+
+	for (unsigned int i = 0; i < 3; i++)
+		queue(i, &tx1, &rx_a, 100);
+	flush(3);
+	assert(num_calls == 4);
+	check_gso(0, &tx1, 3, 100);
+	check_single(1, &tx1);
+	check_single(2, &tx1);
+	check_single(3, &tx1);
+	RECV(&rx_a, 0, 1, 2);
+
+	reset();
+	for (unsigned int i = 0; i < 3; i++)
+		queue(i, &tx1, &rx_a, 100);
+	flush(3);
+	assert(num_calls == 1);
+	check_mmsg(0, &tx1, 3);
+	RECV(&rx_a, 0, 1, 2);
+
+	fail_gso = false;
+}
+
+
+int main(void) {
+	socket_init();
+
+	open_lo(&tx1);
+	open_lo(&tx2);
+	open_lo(&rx_a);
+	open_lo(&rx_b);
+
+	uring_sendmsg_batch_init(MAX_SOCKET_BATCH);
+
+	test_equal();
+	test_sizes();
+	test_dests();
+	test_sockets();
+	test_not_capable();
+	test_full();
+	test_fallback(); // must be last, as GSO stays off afterwards
+
+	close_socket(&tx1);
+	close_socket(&tx2);
+	close_socket(&rx_a);
+	close_socket(&rx_b);
+
+	printf("all tests passed\n");
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "silence.h"
+#include "codeclib.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+struct rtpengine_config initial_rtpe_config;
+
+#define NUM_SAMPLES 4096
+
+
+// plain per-sample reference, the way silence detection used to work
+#define ref_scan(name, type) \
+static unsigned int ref_scan_ ## name(uint8_t *out, const type *s, unsigned int num, type thres) { \
+	unsigned int count = 0; \
+	for (unsigned int b = 0; b < silence_blocks(num); b++) { \
+		bool silent = true; \
+		for (unsigned int i = b * SILENCE_BLOCK; i < num && i < (b + 1) * SILENCE_BLOCK; i++) \
+			if (s[i] > thres || s[i] < -thres) \
+				silent = false; \
+		out[b] = silent; \
+		count += silent; \
+	} \
+	return count; \
+}
+
+ref_scan(s16, int16_t)
+ref_scan(s32, int32_t)
+ref_scan(flt, float)
+ref_scan(dbl, double)
+
+
+// random samples, with about half the blocks quiet and values right at the threshold
+#define fill(name, type) \
+static void fill_ ## name(type *s, unsigned int num, type thres, type (*rnd)(void)) { \
+	for (unsigned int i = 0; i < num; i++) \
+		s[i] = rnd(); \
+	for (unsigned int b = 0; b < silence_blocks(num); b++) { \
+		if (random() % 2) \
+			continue; \
+		for (unsigned int i = b * SILENCE_BLOCK; i < num && i < (b + 1) * SILENCE_BLOCK; i++) { \
+			switch (random() % 4) { \
+				case 0: s[i] = thres; break; \
+				case 1: s[i] = -thres; break; \
+				default: s[i] = 0; \
+			} \
+		} \
+		/* and the occasional single loud sample */ \
+		if (random() % 4 == 0) { \
+			unsigned int i = b * SILENCE_BLOCK + random() % SILENCE_BLOCK; \
+			if (i < num) \
+				s[i] = rnd(); \
+		} \
+	} \
+}
+
+fill(s16, int16_t)
+fill(s32, int32_t)
+fill(flt, float)
+fill(dbl, double)
+
+static int16_t rnd_s16(void) {
+	return random();
+}
+static int32_t rnd_s32(void) {
+	return random() << 1 ^ random();
+}
+static float rnd_flt(void) {
+	return (float) random() / RAND_MAX * 2 - 1;
+}
+static double rnd_dbl(void) {
+	return (double) random() / RAND_MAX * 2 - 1;
+}
+
+
+#define test(name, type, thres) \
+static void test_ ## name(void) { \
+	static type buf[NUM_SAMPLES + 4]; \
+	uint8_t exp[NUM_SAMPLES / SILENCE_BLOCK + 1], out[NUM_SAMPLES / SILENCE_BLOCK + 2]; \
+ \
+	printf("testing " #name "\n"); \
+ \
+	for (unsigned int iter = 0; iter < 1000; iter++) { \
+		type t = thres; \
+		/* misaligned, and lengths with and without a partial block */ \
+		type *s = buf + random() % 4; \
+		unsigned int num = iter < 100 ? iter : random() % NUM_SAMPLES; \
+		fill_ ## name(s, num, t, rnd_ ## name); \
+		memset(out, 0xaa, sizeof(out)); \
+		unsigned int e = ref_scan_ ## name(exp, s, num, t); \
+		unsigned int c = silence_scan_ ## name(out, s, num, t); \
+		assert(c == e); \
+		assert(memcmp(out, exp, silence_blocks(num)) == 0); \
+		assert(out[silence_blocks(num)] == 0xaa); \
+	} \
+}
+
+test(s16, int16_t, random() % 32768)
+test(s32, int32_t, random())
+test(flt, float, (float) random() / RAND_MAX / 10)
+test(dbl, double, (double) random() / RAND_MAX / 10)
+
+
+// each block kernel on its own, not just the one picked for this CPU
+#define test_kernel(name, type, thres) \
+static void test_kernel_ ## name(const char *variant, silence_blocks_ ## name ## _fn *fn) { \
+	static type buf[NUM_SAMPLES + 4]; \
+	uint8_t exp[NUM_SAMPLES / SILENCE_BLOCK], out[NUM_SAMPLES / SILENCE_BLOCK + 1]; \
+ \
+	printf("testing " #name " %s kernel\n", variant); \
+ \
+	for (unsigned int iter = 0; iter < 1000; iter++) { \
+		type t = thres; \
+		type *s = buf + random() % 4; \
+		unsigned int blocks = iter < 100 ? iter % 20 : random() % (NUM_SAMPLES / SILENCE_BLOCK); \
+		unsigned int num = blocks * SILENCE_BLOCK; \
+		fill_ ## name(s, num, t, rnd_ ## name); \
+		memset(out, 0xaa, sizeof(out)); \
+		ref_scan_ ## name(exp, s, num, t); \
+		fn(out, s, blocks, t); \
+		assert(memcmp(out, exp, blocks) == 0); \
+		assert(out[blocks] == 0xaa); \
+	} \
+}
+
+test_kernel(s16, int16_t, random() % 32768)
+test_kernel(s32, int32_t, random())
+test_kernel(flt, float, (float) random() / RAND_MAX / 10)
+test_kernel(dbl, double, (double) random() / RAND_MAX / 10)
+
+#define test_kernels(variant) \
+	test_kernel_s16(#variant, silence_blocks_s16_ ## variant); \
+	test_kernel_s32(#variant, silence_blocks_s32_ ## variant); \
+	test_kernel_flt(#variant, silence_blocks_flt_ ## variant); \
+	test_kernel_dbl(#variant, silence_blocks_dbl_ ## variant)
+
+
+static uint64_t mono_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define bench(name, type, thres) \
+static void bench_ ## name(unsigned int rounds) { \
+	static type s[NUM_SAMPLES]; \
+	uint8_t out[NUM_SAMPLES / SILENCE_BLOCK]; \
+	unsigned int sum = 0; \
+ \
+	fill_ ## name(s, NUM_SAMPLES, thres, rnd_ ## name); \
+ \
+	uint64_t t0 = mono_ns(); \
+	for (unsigned int i = 0; i < rounds; i++) \
+		sum += ref_scan_ ## name(out, s, NUM_SAMPLES, thres); \
+	uint64_t t_ref = mono_ns() - t0; \
+ \
+	t0 = mono_ns(); \
+	for (unsigned int i = 0; i < rounds; i++) \
+		sum -= silence_scan_ ## name(out, s, NUM_SAMPLES, thres); \
+	uint64_t t_scan = mono_ns() - t0; \
+ \
+	assert(sum == 0); \
+	uint64_t samples = (uint64_t) NUM_SAMPLES * rounds; \
+	printf("%s: per-sample %6.3f ns/sample, blocks %6.3f ns/sample\n", #name, \
+			(double) t_ref / samples, (double) t_scan / samples); \
+}
+
+bench(s16, int16_t, 1000)
+bench(s32, int32_t, 1000 << 16)
+bench(flt, float, 0.03)
+bench(dbl, double, 0.03)
+
+
+int main(int argc, char **argv) {
+	srandom(1234);
+
+	test_s16();
+	test_s32();
+	test_flt();
+	test_dbl();
+
+	test_kernels(c);
+#if defined(__x86_64__)
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_SSE2))
+		test_kernels(sse2);
+	else
+		printf("no SSE2 - skipping SSE2 kernels\n");
+	if (rtpe_has_cpu_flag(RTPE_CPU_FLAG_AVX2))
+		test_kernels(avx2);
+	else
+		printf("no AVX2 - skipping AVX2 kernels\n");
+#endif
+
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench_s16(20000);
+		bench_s32(20000);
+		bench_flt(20000);
+		bench_dbl(20000);
+	}
+
+	printf("all tests done\n");
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "socket.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+
+#define BATCH 8
+
+static socket_t rx, tx;
+static char bufs[BATCH][256];
+static void *data[BATCH];
+static size_t lens[BATCH];
+static endpoint_t eps[BATCH];
+static struct timeval tvs[BATCH];
+
+
+// opens a socket on an ephemeral loopback port and records the port it got
+static void open_lo(socket_t *s) {
+	sockaddr_t lo;
+	assert(sockaddr_parse_any(&lo, "127.0.0.1") == 0);
+	assert(open_socket(s, SOCK_DGRAM, 0, &lo) == 0);
+
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof(sin);
+	assert(getsockname(s->fd, (struct sockaddr *) &sin, &sinlen) == 0);
+	s->local.port = ntohs(sin.sin_port);
+}
+
+// packet `i` is `i + 1` bytes long, all of them set to `i`
+static void send_pkts(unsigned int from, unsigned int num) {
+	for (unsigned int i = from; i < from + num; i++) {
+		char buf[256];
+		memset(buf, i, i + 1);
+		assert(socket_sendto(&tx, buf, i + 1, &rx.local) == (ssize_t) (i + 1));
+	}
+}
+
+static int recv_batch(unsigned int num) {
+	memset(lens, 0, sizeof(lens));
+	memset(eps, 0, sizeof(eps));
+	memset(tvs, 0, sizeof(tvs));
+	return socket_recvmmsg_ts(&rx, data, sizeof(bufs[0]), num, lens, eps, tvs);
+}
+
+// checks the `n`-th received packet of a batch against packet `i` sent
+static void check_pkt(unsigned int n, unsigned int i) {
+	assert(lens[n] == i + 1);
+	for (unsigned int j = 0; j < i + 1; j++)
+		assert(bufs[n][j] == (char) i);
+	assert(endpoint_eq(&eps[n], &tx.local));
+	assert(tvs[n].tv_sec != 0);
+}
+
+static void check_drained(void) {
+	assert(recv_batch(BATCH) == -1);
+	assert(errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+
+static void test_full(void) {
+	printf("testing full batch\n");
+
+	send_pkts(0, BATCH);
+	assert(recv_batch(BATCH) == BATCH);
+	for (unsigned int i = 0; i < BATCH; i++)
+		check_pkt(i, i);
+	check_drained();
+}
+
+// fewer packets queued than the batch has room for: returns what there is without blocking
+static void test_partial(void) {
+	printf("testing partial batch\n");
+
+	send_pkts(10, 3);
+	assert(recv_batch(BATCH) == 3);
+	for (unsigned int i = 0; i < 3; i++)
+		check_pkt(i, 10 + i);
+	// slots past the end are left alone
+	for (unsigned int i = 3; i < BATCH; i++)
+		assert(lens[i] == 0);
+	check_drained();
+}
+
+// more packets queued than the batch has room for: the rest is left for the next call, in order
+static void test_overflow(void) {
+	printf("testing batch smaller than the queue\n");
+
+	send_pkts(20, 5);
+	assert(recv_batch(2) == 2);
+	check_pkt(0, 20);
+	check_pkt(1, 21);
+	assert(lens[2] == 0);
+	assert(recv_batch(BATCH) == 3);
+	check_pkt(0, 22);
+	check_pkt(1, 23);
+	check_pkt(2, 24);
+	check_drained();
+
+	// a batch of one behaves like a single recv
+	send_pkts(30, 2);
+	assert(recv_batch(1) == 1);
+	check_pkt(0, 30);
+	assert(recv_batch(1) == 1);
+	check_pkt(0, 31);
+	check_drained();
+}
+
+
+int main(void) {
+	socket_init();
+
+	for (unsigned int i = 0; i < BATCH; i++)
+		data[i] = bufs[i];
+
+	open_lo(&rx);
+	open_lo(&tx);
+	assert(socket_timestamping(&rx) == 0);
+
+	test_full();
+	test_partial();
+	test_overflow();
+
+	close_socket(&rx);
+	close_socket(&tx);
+
+	printf("all tests passed\n");
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "ssrc.h"
+#include "main.h"
+#include "statistics.h"
+
+struct rtpengine_config rtpe_config;
+struct global_stats_gauge rtpe_stats_gauge;
+struct global_gauge_min_max rtpe_gauge_min_max;
+struct global_stats_counter *rtpe_stats;
+struct global_stats_counter rtpe_stats_rate;
+struct global_stats_counter rtpe_stats_intv;
+struct global_stats_sampled rtpe_stats_sampled;
+struct global_sampled_min_max rtpe_sampled_min_max;
+struct global_sampled_min_max rtpe_sampled_graphite_min_max;
+struct global_sampled_min_max rtpe_sampled_graphite_min_max_sampled;
+__thread struct bufferpool *media_bufferpool;
+void append_thread_lpr_to_glob_lpr(void) {}
+struct bufferpool *shm_bufferpool;
+
+
+#define MAX_ENTRIES 21 // limit of 20 is checked before adding
+
+static unsigned int num_entries;
+
+static void free_entry(void *p) {
+	num_entries--;
+}
+static struct ssrc_entry *create_entry(void *uptr) {
+	num_entries++;
+	return obj_alloc0("ssrc_entry", sizeof(struct ssrc_entry), free_entry);
+}
+
+// looks up or creates an entry, and touches it
+static bool use(struct ssrc_hash *ht, uint32_t ssrc) {
+	bool created;
+	struct ssrc_entry *e = get_ssrc_full(ssrc, ht, &created);
+	assert(e != NULL);
+	assert(e->ssrc == ssrc);
+	assert(e->last_used == rtpe_now.tv_sec);
+	obj_put(e);
+	return created;
+}
+
+static bool contains(struct ssrc_hash *ht, uint32_t ssrc) {
+	return g_hash_table_contains(ht->ht, &ssrc);
+}
+
+
+// The first SSRC_HASH_INLINE entries are pinned in their slots. Once the size limit is hit,
+// the least recently used of the other entries go first, and entries in use stay.
+static void test_hot_cold(void) {
+	printf("testing hot and cold entries\n");
+
+	rtpe_now = (struct timeval) { 1000, 0 };
+	struct ssrc_hash *ht = create_ssrc_hash_full_fast(create_entry, NULL);
+
+	// cold: created first and never used again
+	for (uint32_t i = 1; i <= SSRC_HASH_INLINE; i++)
+		assert(use(ht, i) == true);
+	for (unsigned int i = 0; i < SSRC_HASH_INLINE; i++)
+		assert(ht->slots[i].ssrc == i + 1);
+
+	// hot: 0x1000 is kept in use throughout, the others come and go
+	rtpe_now.tv_sec++;
+	assert(use(ht, 0x1000) == true);
+
+	for (uint32_t i = 0; i < 100; i++) {
+		rtpe_now.tv_sec++;
+		assert(use(ht, 0x2000 + i) == true);
+		assert(use(ht, 0x1000) == false);
+		assert(g_hash_table_size(ht->ht) <= MAX_ENTRIES);
+		assert(ht->q.length == g_hash_table_size(ht->ht));
+	}
+	assert(g_hash_table_size(ht->ht) == MAX_ENTRIES);
+	assert(num_entries == MAX_ENTRIES);
+
+	// pinned
+	for (uint32_t i = 1; i <= SSRC_HASH_INLINE; i++)
+		assert(contains(ht, i));
+	for (unsigned int i = 0; i < SSRC_HASH_INLINE; i++)
+		assert(ht->slots[i].ssrc == i + 1 && ht->slots[i].entry != NULL);
+
+	// in use
+	assert(contains(ht, 0x1000));
+
+	// most recent ones: all but the pinned and the hot one
+	unsigned int recent = MAX_ENTRIES - SSRC_HASH_INLINE - 1;
+	for (uint32_t i = 0; i < 100; i++)
+		assert(contains(ht, 0x2000 + i) == (i >= 100 - recent));
+
+	// inline entries are found without creating new ones, and touched
+	rtpe_now.tv_sec++;
+	for (uint32_t i = 1; i <= SSRC_HASH_INLINE; i++)
+		assert(use(ht, i) == false);
+
+	// a reference held past eviction stays valid
+	struct ssrc_entry *held = get_ssrc_full(0x2000 + 99, ht, NULL);
+	for (uint32_t i = 0; i < MAX_ENTRIES; i++) {
+		rtpe_now.tv_sec++;
+		use(ht, 0x3000 + i);
+	}
+	assert(!contains(ht, 0x2000 + 99));
+	assert(held->ssrc == 0x2000 + 99);
+	assert(num_entries == MAX_ENTRIES + 1);
+	obj_put(held);
+	assert(num_entries == MAX_ENTRIES);
+
+	free_ssrc_hash(&ht);
+	assert(num_entries == 0);
+}
+
+
+int main(void) {
+	test_hot_cold();
+
+	printf("all tests passed\n");
+	return 0;
+}
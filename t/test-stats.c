@@ -1,5 +1,8 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
 #include "graphite.h"
 #include "statistics.h"
 #include "poller.h"
@@ -64,6 +67,77 @@ static void __assert_metrics_eq(stats_metric_q *q, const char *b, unsigned int l
 }
 #define assert_metrics_eq(a, b) __assert_metrics_eq(a, b, __LINE__)
 
+static void *shard_thread(void *p) {
+	for (int i = 0; i < 1000; i++) {
+		RTPE_STATS_SHARD_INC(packets_user);
+		RTPE_STATS_SHARD_ADD(bytes_user, 100);
+	}
+	return NULL;
+}
+
+static void test_shards(void) {
+	// per-thread counts only show up once folded
+	RTPE_STATS_SHARD_INC(packets_user);
+	RTPE_STATS_SHARD_ADD(bytes_user, 160);
+	assert(atomic64_get(&rtpe_stats->packets_user) == 0);
+	stats_shards_fold();
+	assert(atomic64_get(&rtpe_stats->packets_user) == 1);
+	assert(atomic64_get(&rtpe_stats->bytes_user) == 160);
+
+	// folding again doesn't count anything twice
+	stats_shards_fold();
+	assert(atomic64_get(&rtpe_stats->packets_user) == 1);
+
+	pthread_t threads[4];
+	for (int i = 0; i < 4; i++)
+		pthread_create(&threads[i], NULL, shard_thread, NULL);
+	for (int i = 0; i < 4; i++)
+		pthread_join(threads[i], NULL);
+	RTPE_STATS_SHARD_INC(errors_user);
+	stats_shards_fold();
+	assert(atomic64_get(&rtpe_stats->packets_user) == 4001);
+	assert(atomic64_get(&rtpe_stats->bytes_user) == 400160);
+	assert(atomic64_get(&rtpe_stats->errors_user) == 1);
+}
+
+static void test_snapshot(void) {
+	struct stats_snapshot *a = statistics_snapshot_get();
+	assert(strstr(a->prom->str, "# TYPE rtpengine_sessions gauge\n") != NULL);
+	assert(strstr(a->prom->str, "\nrtpengine_metrics_scrapes_total 1\n") != NULL);
+
+	// served from the same snapshot for up to a second
+	struct stats_snapshot *b = statistics_snapshot_get();
+	assert(a == b);
+	obj_put(b);
+	timeval_add_usec(&rtpe_now, 500000);
+	b = statistics_snapshot_get();
+	assert(a == b);
+	obj_put(b);
+
+	// not rebuilt by the stats thread
+	call_rate_stats_updater();
+	b = statistics_snapshot_get();
+	assert(a == b);
+	obj_put(b);
+
+	// rebuilt by the first scrape that finds it out of date
+	timeval_add_usec(&rtpe_now, 500000);
+	b = statistics_snapshot_get();
+	assert(a != b);
+	assert(strstr(b->prom->str, "\nrtpengine_metrics_scrapes_total 5\n") != NULL);
+	obj_put(a);
+	a = statistics_snapshot_get();
+	assert(a == b);
+	obj_put(a);
+	obj_put(b);
+
+	// and after a pause
+	rtpe_now.tv_sec += 400;
+	a = statistics_snapshot_get();
+	assert(strstr(a->prom->str, "\nrtpengine_metrics_scrapes_total 7\n") != NULL);
+	obj_put(a);
+}
+
 int main(void) {
 	rtpe_common_config_ptr = &rtpe_config.common;
 	bufferpool_init();
@@ -319,6 +393,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -461,6 +547,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -1125,6 +1283,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -1372,6 +1536,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -1514,6 +1690,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -2178,6 +2426,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -2422,6 +2676,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -2564,6 +2830,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -3228,6 +3566,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -3491,6 +3835,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -3633,6 +3989,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -4297,6 +4725,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -4549,6 +4983,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -4691,6 +5137,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -5355,6 +5873,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -5602,6 +6126,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -5744,6 +6280,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -6408,6 +7016,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -6657,6 +7271,18 @@ int main(void) {
 			"transcodedmedia\n"
 			"0\n"
 			"0\n"
+			"Player cache size in bytes\n"
+			"playercachesize\n"
+			"0\n"
+			"0\n"
+			"Player cache entries\n"
+			"playercacheentries\n"
+			"0\n"
+			"0\n"
+			"Player cache preloads pending\n"
+			"playerpreloadpending\n"
+			"0\n"
+			"0\n"
 			"Packets per second (userspace)\n"
 			"packetrate_user\n"
 			"0\n"
@@ -6799,6 +7425,78 @@ int main(void) {
 			"relayedbytes\n"
 			"0\n"
 			"0\n"
+			"Total batched receive calls (userspace)\n"
+			"recvbatches\n"
+			"0\n"
+			"0\n"
+			"Total packets received in batches (userspace)\n"
+			"recvbatchpackets\n"
+			"0\n"
+			"0\n"
+			"Average receive batch depth\n"
+			"avgrecvbatchdepth\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total media port allocations\n"
+			"portallocs\n"
+			"0\n"
+			"0\n"
+			"Average media port allocation time\n"
+			"avgportalloctime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total contended port pool updates\n"
+			"portalloccontention\n"
+			"0\n"
+			"0\n"
+			"Time to build the last metrics snapshot\n"
+			"metricsbuildtime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total metrics scrapes served\n"
+			"metricsscrapes\n"
+			"0\n"
+			"0\n"
+			"Calls queued for Redis write-behind\n"
+			"redisqueue\n"
+			"0\n"
+			"0\n"
+			"Total calls written to Redis\n"
+			"rediswrites\n"
+			"0\n"
+			"0\n"
+			"Average call updates per Redis write\n"
+			"rediscoalesceratio\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Average Redis write round trip time\n"
+			"avgrediswritetime\n"
+			"0.000000 seconds\n"
+			"0.000000\n"
+			"Total calls restored from Redis\n"
+			"redisrestored\n"
+			"0\n"
+			"0\n"
+			"Calls restored from Redis per second\n"
+			"redisrestorerate\n"
+			"0.000000\n"
+			"0.000000\n"
+			"Total audio frame allocations served from pools\n"
+			"framepoolhits\n"
+			"0\n"
+			"0\n"
+			"Total audio frame allocations not served from pools\n"
+			"framepoolmisses\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations served from pools\n"
+			"packetpoolhits\n"
+			"0\n"
+			"0\n"
+			"Total codec packet allocations not served from pools\n"
+			"packetpoolmisses\n"
+			"0\n"
+			"0\n"
 			"Total number of streams with no relayed packets\n"
 			"zerowaystreams\n"
 			"0\n"
@@ -7463,6 +8161,12 @@ int main(void) {
 			"interfaces\n"
 			"[\n"
 			"]\n"
+			"pollers\n"
+			"[\n"
+			"]\n"
+			"transcodeworkers\n"
+			"[\n"
+			"]\n"
 			"transcoders\n"
 			"\n"
 			"[\n"
@@ -7471,6 +8175,9 @@ int main(void) {
 			"}\n");
 
 
+	test_shards();
+	test_snapshot();
+
 	// cleanup
 
 	statistics_free();
@@ -0,0 +1,265 @@
+#include "timerwheel.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+
+#define TICK_US (1ULL << TIMER_WHEEL_TICK_BITS)
+
+struct obj {
+	struct timer_wheel_node node;
+	struct timeval tv;
+	bool deleted;
+	bool fired;
+	bool late;
+};
+
+static struct timer_wheel wheel;
+
+
+static struct timeval tv_us(uint64_t us) {
+	return (struct timeval) { .tv_sec = us / 1000000, .tv_usec = us % 1000000 };
+}
+static uint64_t rnd(uint64_t max) {
+	return ((uint64_t) random() << 31 ^ random()) % max;
+}
+
+// emulates the timer thread loop: sleep until the first node is due, then run it.
+// returns the number of nodes fired and checks they come out in order
+static unsigned int run_until(uint64_t *now, uint64_t end) {
+	unsigned int fired = 0;
+	uint64_t last = 0;
+
+	while (true) {
+		struct timeval tv = tv_us(*now);
+		struct timer_wheel_node *n = timer_wheel_first(&wheel, &tv);
+		if (!n)
+			break;
+		if (n->expires > *now) {
+			if (n->expires > end)
+				break;
+			*now = n->expires;
+			continue;
+		}
+		struct obj *o = (struct obj *) n;
+		assert(!o->deleted);
+		assert(!o->fired);
+		// nodes in the same tick may come out in any order
+		assert(n->expires + TICK_US > last);
+		if (n->expires > last)
+			last = n->expires;
+		assert(timer_wheel_del(&wheel, n) == true);
+		assert(!timer_wheel_node_scheduled(n));
+		o->fired = true;
+		fired++;
+	}
+
+	if (*now < end)
+		*now = end;
+	return fired;
+}
+
+static void test_order(uint64_t start, unsigned int num, uint64_t range) {
+	struct obj *objs = calloc(num, sizeof(*objs));
+	uint64_t now = start;
+	struct timeval tv = tv_us(now);
+	timer_wheel_init(&wheel, &tv);
+	assert(timer_wheel_first(&wheel, &tv) == NULL);
+
+	for (unsigned int i = 0; i < num; i++) {
+		objs[i].tv = tv_us(start + rnd(range));
+		timer_wheel_add(&wheel, &objs[i].node, &objs[i].tv);
+	}
+	assert(wheel.count == num);
+
+	// remove every third one
+	unsigned int deleted = 0;
+	for (unsigned int i = 0; i < num; i += 3) {
+		assert(timer_wheel_del(&wheel, &objs[i].node) == true);
+		assert(timer_wheel_del(&wheel, &objs[i].node) == false);
+		objs[i].deleted = true;
+		deleted++;
+	}
+
+	unsigned int fired = run_until(&now, start + range);
+	assert(fired == num - deleted);
+	assert(wheel.count == 0);
+	for (unsigned int i = 0; i < num; i++)
+		assert(objs[i].fired != objs[i].deleted);
+
+	free(objs);
+}
+
+// nodes are re-added while the wheel is running, including some that are already due
+static void test_reschedule(void) {
+	unsigned int num = 2000;
+	struct obj *objs = calloc(num, sizeof(*objs));
+	uint64_t now = 1700000000ULL * 1000000;
+	struct timeval tv = tv_us(now);
+	timer_wheel_init(&wheel, &tv);
+
+	for (unsigned int i = 0; i < num; i++) {
+		objs[i].tv = tv_us(now + rnd(20000));
+		timer_wheel_add(&wheel, &objs[i].node, &objs[i].tv);
+	}
+
+	uint64_t end = now + 5000000;
+	unsigned int fired = 0;
+	uint64_t last = 0;
+	while (now < end) {
+		tv = tv_us(now);
+		struct timer_wheel_node *n = timer_wheel_first(&wheel, &tv);
+		assert(n != NULL);
+		if (n->expires > now) {
+			now = n->expires;
+			continue;
+		}
+		struct obj *o = (struct obj *) n;
+		// late ones come out ahead of everything else, in no particular order
+		if (!o->late) {
+			assert(n->expires + TICK_US > last);
+			if (n->expires > last)
+				last = n->expires;
+		}
+		timer_wheel_del(&wheel, n);
+		fired++;
+
+		o->late = (fired % 17 == 0);
+		if (o->late)
+			o->tv = tv_us(now - rnd(1000));
+		else
+			o->tv = tv_us(now + 20000 + rnd(100));
+		timer_wheel_add(&wheel, n, &o->tv);
+	}
+	assert(fired > num * (5000 / 20) * 9 / 10);
+	assert(wheel.count == num);
+
+	unsigned int stolen = 0;
+	while (timer_wheel_steal(&wheel))
+		stolen++;
+	assert(stolen == num);
+	assert(wheel.count == 0);
+
+	free(objs);
+}
+
+// something scheduled before the current base must still come out first
+static void test_past(void) {
+	struct obj a = {0}, b = {0};
+	uint64_t now = 5000000000ULL;
+	struct timeval tv = tv_us(now);
+	timer_wheel_init(&wheel, &tv);
+	assert(timer_wheel_first(&wheel, &tv) == NULL);
+
+	a.tv = tv_us(now + 1000000);
+	timer_wheel_add(&wheel, &a.node, &a.tv);
+	assert(timer_wheel_first(&wheel, &tv) == &a.node);
+	b.tv = tv_us(now - 1000000);
+	timer_wheel_add(&wheel, &b.node, &b.tv);
+	assert(timer_wheel_first(&wheel, &tv) == &b.node);
+	timer_wheel_del(&wheel, &b.node);
+	assert(timer_wheel_first(&wheel, &tv) == &a.node);
+	tv = tv_us(now + 2000000);
+	assert(timer_wheel_first(&wheel, &tv) == &a.node);
+	timer_wheel_del(&wheel, &a.node);
+	assert(timer_wheel_first(&wheel, &tv) == NULL);
+}
+
+
+// comparison against a GTree used the same way as the timer thread does
+
+static int obj_cmp(const void *A, const void *B) {
+	const struct obj *a = A, *b = B;
+	if (a->tv.tv_sec != b->tv.tv_sec)
+		return a->tv.tv_sec < b->tv.tv_sec ? -1 : 1;
+	if (a->tv.tv_usec != b->tv.tv_usec)
+		return a->tv.tv_usec < b->tv.tv_usec ? -1 : 1;
+	if (a == b)
+		return 0;
+	return a < b ? -1 : 1;
+}
+
+static uint64_t mono_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench(unsigned int num, unsigned int rounds) {
+	struct obj *objs = calloc(num, sizeof(*objs));
+	uint64_t start = 1700000000ULL * 1000000;
+
+	// 20 ms packetisation, rescheduled as each one fires
+	for (unsigned int i = 0; i < num; i++)
+		objs[i].tv = tv_us(start + rnd(20000));
+	GTree *tree = g_tree_new(obj_cmp);
+	for (unsigned int i = 0; i < num; i++)
+		g_tree_insert(tree, &objs[i], &objs[i]);
+
+	uint64_t ops = (uint64_t) num * rounds;
+	uint64_t t0 = mono_ns();
+	for (uint64_t i = 0; i < ops; i++) {
+		GTreeNode *tn = g_tree_node_first(tree);
+		struct obj *o = g_tree_node_key(tn);
+		g_tree_remove(tree, o);
+		o->tv.tv_usec += 20000;
+		if (o->tv.tv_usec >= 1000000) {
+			o->tv.tv_usec -= 1000000;
+			o->tv.tv_sec++;
+		}
+		g_tree_insert(tree, o, o);
+	}
+	uint64_t t_tree = mono_ns() - t0;
+	g_tree_destroy(tree);
+
+	for (unsigned int i = 0; i < num; i++)
+		objs[i].tv = tv_us(start + rnd(20000));
+	struct timeval now = tv_us(start);
+	timer_wheel_init(&wheel, &now);
+	for (unsigned int i = 0; i < num; i++)
+		timer_wheel_add(&wheel, &objs[i].node, &objs[i].tv);
+	t0 = mono_ns();
+	for (uint64_t i = 0; i < ops; i++) {
+		struct timer_wheel_node *n = timer_wheel_first(&wheel, &now);
+		struct obj *o = (struct obj *) n;
+		if (timercmp(&o->tv, &now, >))
+			now = o->tv;
+		timer_wheel_del(&wheel, n);
+		o->tv.tv_usec += 20000;
+		if (o->tv.tv_usec >= 1000000) {
+			o->tv.tv_usec -= 1000000;
+			o->tv.tv_sec++;
+		}
+		timer_wheel_add(&wheel, n, &o->tv);
+	}
+	uint64_t t_wheel = mono_ns() - t0;
+
+	printf("%8u timers: tree %6.1f ns/op, wheel %6.1f ns/op\n", num,
+			(double) t_tree / ops, (double) t_wheel / ops);
+	free(objs);
+}
+
+
+int main(int argc, char **argv) {
+	srandom(1234);
+
+	test_past();
+	test_order(1000000, 1000, 10000); // all in level 0
+	test_order(1700000000ULL * 1000000, 10000, 60000000); // up to a minute
+	test_order(1700000000ULL * 1000000, 10000, 3600ULL * 1000000); // up to an hour
+	test_order(((1ULL << 37) - 5000), 1000, 20000); // crossing the top level boundary
+	test_order(1700000000ULL * 1000000, 1000, 7 * 86400ULL * 1000000); // into the overflow list
+	test_reschedule();
+
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench(1000, 2000);
+		bench(10000, 200);
+		bench(100000, 20);
+	}
+
+	printf("all tests done\n");
+	return 0;
+}
@@ -0,0 +1,295 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "wbqueue.h"
+#include "main.h"
+
+struct rtpengine_config rtpe_config;
+
+int get_local_log_level(unsigned int u) {
+	return -1;
+}
+
+
+#define NUM_OBJS 8
+
+struct obj {
+	int refs;
+	unsigned int written;
+	bool deleted;
+};
+
+static struct obj objs[NUM_OBJS];
+static unsigned int queue_len;
+
+
+static void obj_get_cb(void *p) {
+	struct obj *o = p;
+	__atomic_add_fetch(&o->refs, 1, __ATOMIC_SEQ_CST);
+}
+static void obj_put_cb(void *p) {
+	struct obj *o = p;
+	int refs = __atomic_sub_fetch(&o->refs, 1, __ATOMIC_SEQ_CST);
+	assert(refs >= 0);
+}
+static bool obj_skip_cb(void *p) {
+	struct obj *o = p;
+	return __atomic_load_n(&o->deleted, __ATOMIC_SEQ_CST);
+}
+static void length_cb(unsigned int len) {
+	queue_len = len;
+}
+
+static const struct wbqueue_ops ops = {
+	.get = obj_get_cb,
+	.put = obj_put_cb,
+	.skip = obj_skip_cb,
+	.length = length_cb,
+};
+
+static void reset(void) {
+	memset(objs, 0, sizeof(objs));
+	queue_len = 0;
+}
+
+static void check_refs(void) {
+	for (unsigned int i = 0; i < NUM_OBJS; i++)
+		assert(objs[i].refs == 0);
+}
+
+
+// further updates of a queued object are coalesced, order is oldest first
+static void test_coalesce(void) {
+	struct wbqueue q;
+	void *batch[NUM_OBJS];
+
+	reset();
+	wbqueue_init(&q, 0, &ops);
+
+	wbqueue_push(&q, &objs[0]);
+	wbqueue_push(&q, &objs[1]);
+	wbqueue_push(&q, &objs[0]);
+	wbqueue_push(&q, &objs[2]);
+	wbqueue_push(&q, &objs[1]);
+	assert(queue_len == 3);
+	assert(objs[0].refs == 1);
+	assert(objs[1].refs == 1);
+
+	// batch size is honoured
+	unsigned int num = wbqueue_take(&q, batch, 2);
+	assert(num == 2);
+	assert(batch[0] == &objs[0]);
+	assert(batch[1] == &objs[1]);
+	assert(queue_len == 1);
+
+	// once taken, a new update is queued again, but not handed out while still busy
+	wbqueue_push(&q, &objs[0]);
+	assert(queue_len == 2);
+	assert(objs[0].refs == 2);
+	void *more[NUM_OBJS];
+	num = wbqueue_take(&q, more, NUM_OBJS);
+	assert(num == 1);
+	assert(more[0] == &objs[2]);
+	assert(queue_len == 1);
+
+	wbqueue_done(&q, batch, 2);
+	num = wbqueue_take(&q, batch, NUM_OBJS);
+	assert(num == 1);
+	assert(batch[0] == &objs[0]);
+	wbqueue_done(&q, batch, 1);
+	wbqueue_done(&q, more, 1);
+
+	assert(queue_len == 0);
+	check_refs();
+	wbqueue_free(&q);
+}
+
+// nothing is handed out before it's due
+static void test_delay(void) {
+	struct wbqueue q;
+	void *batch[NUM_OBJS];
+
+	reset();
+	wbqueue_init(&q, 100000, &ops);
+
+	wbqueue_push(&q, &objs[0]);
+	assert(wbqueue_take(&q, batch, NUM_OBJS) == 0);
+	usleep(20000);
+	wbqueue_push(&q, &objs[1]);
+	usleep(100000);
+	unsigned int num = wbqueue_take(&q, batch, NUM_OBJS);
+	assert(num >= 1);
+	assert(batch[0] == &objs[0]);
+	wbqueue_done(&q, batch, num);
+
+	wbqueue_free(&q);
+	check_refs();
+}
+
+// deleted objects are neither queued nor written
+static void test_skip(void) {
+	struct wbqueue q;
+	void *batch[NUM_OBJS];
+
+	reset();
+	wbqueue_init(&q, 0, &ops);
+
+	wbqueue_push(&q, &objs[0]);
+	wbqueue_push(&q, &objs[1]);
+	objs[0].deleted = true;
+	wbqueue_push(&q, &objs[2]);
+	objs[2].deleted = true;
+	wbqueue_push(&q, &objs[2]);
+
+	unsigned int num = wbqueue_take(&q, batch, NUM_OBJS);
+	assert(num == 1);
+	assert(batch[0] == &objs[1]);
+	assert(queue_len == 0);
+	assert(objs[0].refs == 0);
+	assert(objs[2].refs == 0);
+	wbqueue_done(&q, batch, num);
+
+	objs[1].deleted = true;
+	wbqueue_push(&q, &objs[1]);
+	assert(queue_len == 0);
+
+	check_refs();
+	wbqueue_free(&q);
+}
+
+
+struct canceller {
+	struct wbqueue *q;
+	void *obj;
+	bool done;
+};
+
+static void *cancel_thread(void *p) {
+	struct canceller *c = p;
+	wbqueue_cancel(c->q, c->obj);
+	__atomic_store_n(&c->done, true, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+// cancelling drops a pending write, and waits for one in progress
+static void test_cancel(void) {
+	struct wbqueue q;
+	void *batch[NUM_OBJS];
+
+	reset();
+	wbqueue_init(&q, 0, &ops);
+
+	wbqueue_push(&q, &objs[0]);
+	wbqueue_push(&q, &objs[1]);
+	wbqueue_cancel(&q, &objs[0]);
+	assert(queue_len == 1);
+	assert(objs[0].refs == 0);
+
+	unsigned int num = wbqueue_take(&q, batch, NUM_OBJS);
+	assert(num == 1);
+	assert(batch[0] == &objs[1]);
+
+	// busy now, and queued again on top of that
+	wbqueue_push(&q, &objs[1]);
+	assert(objs[1].refs == 2);
+
+	struct canceller c = { .q = &q, .obj = &objs[1] };
+	pthread_t thread;
+	pthread_create(&thread, NULL, cancel_thread, &c);
+
+	usleep(50000);
+	assert(__atomic_load_n(&c.done, __ATOMIC_SEQ_CST) == false);
+	assert(queue_len == 0);
+
+	wbqueue_done(&q, batch, num);
+	pthread_join(thread, NULL);
+	assert(c.done == true);
+
+	assert(wbqueue_take(&q, batch, NUM_OBJS) == 0);
+	check_refs();
+	wbqueue_free(&q);
+}
+
+
+static void *worker_thread(void *p) {
+	struct wbqueue *q = p;
+	void *batch[2];
+	unsigned int num;
+
+	while ((num = wbqueue_next(q, batch, 2))) {
+		for (unsigned int i = 0; i < num; i++) {
+			struct obj *o = batch[i];
+			usleep(1000);
+			__atomic_add_fetch(&o->written, 1, __ATOMIC_SEQ_CST);
+		}
+		wbqueue_done(q, batch, num);
+	}
+
+	return NULL;
+}
+
+// stopping writes out everything that's still queued without waiting for the delay, and
+// lets the workers return
+static void test_drain(void) {
+	struct wbqueue q;
+
+	reset();
+	wbqueue_init(&q, 10000000, &ops);
+
+	pthread_t threads[2];
+	for (unsigned int i = 0; i < 2; i++)
+		pthread_create(&threads[i], NULL, worker_thread, &q);
+
+	for (unsigned int i = 0; i < NUM_OBJS; i++)
+		wbqueue_push(&q, &objs[i]);
+	usleep(20000);
+	for (unsigned int i = 0; i < NUM_OBJS; i++)
+		assert(objs[i].written == 0);
+
+	assert(wbqueue_stop(&q, 5000000) == 0);
+
+	for (unsigned int i = 0; i < 2; i++)
+		pthread_join(threads[i], NULL);
+
+	for (unsigned int i = 0; i < NUM_OBJS; i++)
+		assert(objs[i].written == 1);
+	assert(queue_len == 0);
+	check_refs();
+	wbqueue_free(&q);
+}
+
+// without anyone to write it out, stopping gives up after the timeout
+static void test_stop_timeout(void) {
+	struct wbqueue q;
+	void *batch[NUM_OBJS];
+
+	reset();
+	wbqueue_init(&q, 0, &ops);
+
+	wbqueue_push(&q, &objs[0]);
+	wbqueue_push(&q, &objs[1]);
+	assert(wbqueue_stop(&q, 10000) == 2);
+
+	// nothing more is handed out
+	assert(wbqueue_take(&q, batch, NUM_OBJS) == 0);
+	assert(wbqueue_next(&q, batch, NUM_OBJS) == 0);
+
+	wbqueue_free(&q);
+	check_refs();
+}
+
+
+int main(void) {
+	test_coalesce();
+	test_delay();
+	test_skip();
+	test_cancel();
+	test_drain();
+	test_stop_timeout();
+
+	printf("all tests passed\n");
+	return 0;
+}
@@ -630,6 +630,21 @@ do_recvmsg:
 	return real_recvmsg(fd, msg, flags);
 }
 
+int recvmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) {
+	// emulated through recvmsg() above for the address translation
+	unsigned int i;
+	for (i = 0; i < vlen; i++) {
+		ssize_t ret = recvmsg(fd, &msgvec[i].msg_hdr, flags | (i ? MSG_DONTWAIT : 0));
+		if (ret < 0) {
+			if (i)
+				break;
+			return -1;
+		}
+		msgvec[i].msg_len = ret;
+	}
+	return i;
+}
+
 ssize_t send(int fd, const void *buf, size_t len, int flags) {
 	check_bind(fd);
 	ssize_t (*real_send)(int, const void *, size_t, int) = dlsym(RTLD_NEXT, "send");
@@ -711,6 +726,21 @@ ssize_t sendmsg(int fd, const struct msghdr *msg, int flags) {
 	return real_sendmsg(fd, &msg2, flags);
 }
 
+int sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+	// emulated through sendmsg() above for the address translation
+	unsigned int i;
+	for (i = 0; i < vlen; i++) {
+		ssize_t ret = sendmsg(fd, &msgvec[i].msg_hdr, flags);
+		if (ret < 0) {
+			if (i)
+				break;
+			return -1;
+		}
+		msgvec[i].msg_len = ret;
+	}
+	return i;
+}
+
 int setsockopt(int fd, int level, int optname, const void *optval, socklen_t optlen) {
 	const char *err;
 	int (*real_setsockopt)(int, int, int, const void *, socklen_t) = dlsym(RTLD_NEXT, "setsockopt");